@@ -12,6 +12,33 @@ if (NOT GLIB232_FOUND)
     "Cannot find glib version >= 2.32, extaction plugin disabled")
 endif (NOT GLIB232_FOUND)
 pkg_check_modules(SIGC REQUIRED "sigc++-2.0 >= 2.2.0")
+# the debug log file is written by a background thread
+pkg_check_modules(GTHREAD2 REQUIRED "gthread-2.0 >= 2.16.0")
+# gio is optional and used only for compression of rotated debug log files
+pkg_check_modules(GIO QUIET "gio-2.0 >= 2.24.0")
+if (GIO_FOUND)
+  set(HAVE_GIO true)
+else (GIO_FOUND)
+  message(STATUS
+    "Cannot find gio version >= 2.24, compression of rotated debug logs disabled")
+endif (GIO_FOUND)
+
+##############################################################################
+##                      handling of system headers                          ##
+##############################################################################
+
+include(CheckIncludeFiles)
+# epoll is optional, libpurple input watches are multiplexed through a single
+# epoll descriptor when it is available
+check_include_files(sys/epoll.h HAVE_SYS_EPOLL_H)
+
+include(CheckSymbolExists)
+# dladdr is optional, it is used to name slow main loop callbacks in the log
+set(CMAKE_REQUIRED_DEFINITIONS -D_GNU_SOURCE)
+set(CMAKE_REQUIRED_LIBRARIES ${CMAKE_DL_LIBS})
+check_symbol_exists(dladdr dlfcn.h HAVE_DLADDR)
+unset(CMAKE_REQUIRED_DEFINITIONS)
+unset(CMAKE_REQUIRED_LIBRARIES)
 
 ##############################################################################
 ##              handling of (n)curses wide character                        ##
@@ -28,6 +55,8 @@ find_package(Cursesw)
 include_directories(
   ${CURSES_INCLUDE_DIRS}
   ${GLIB2_INCLUDE_DIRS}
+  ${GTHREAD2_INCLUDE_DIRS}
+  ${GIO_INCLUDE_DIRS}
   ${PURPLE_INCLUDE_DIRS}
   ${SIGC_INCLUDE_DIRS}
   ${centerim5_BINARY_DIR}
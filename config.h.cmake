@@ -15,3 +15,12 @@
 
 /* See if to use NLS features. */
 #cmakedefine01 ENABLE_NLS
+
+/* Define if GIO is available. */
+#cmakedefine HAVE_GIO 1
+
+/* Define to 1 if you have the <sys/epoll.h> header file. */
+#cmakedefine HAVE_SYS_EPOLL_H 1
+
+/* Define if dladdr() is available. */
+#cmakedefine HAVE_DLADDR 1
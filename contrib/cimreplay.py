@@ -0,0 +1,427 @@
+#!/usr/bin/env python
+
+"""
+This script works with trace files recorded by 'centerim5 --trace <file>'.
+
+  cimreplay.py profile <trace>
+      Prints timings of the recorded callbacks (libpurple ui-ops, timers,
+      input watches and CppConsUI callbacks) grouped by their names.
+
+  cimreplay.py script <trace> <script>
+      Writes the incoming events of the trace (presence changes, received
+      messages, typing notifications and notifications) into a script for
+      the loadgen protocol plugin. Set the script as the 'Script file' option
+      of a loadgen account and the account replays the events after it logs
+      in, so the replayed run gets the same load from the network as the
+      recorded one.
+
+  cimreplay.py replay [--max-speed] [--speed <factor>] <trace> [-- command]
+      Runs centerim5 (or the given command) on a pseudo-terminal and feeds it
+      the recorded input and screen resizes, either with the original timing
+      or as fast as the program can handle them. Prints how long it took the
+      program to respond to each input. With --max-speed the next input is
+      sent as soon as the program starts to respond, so the times include
+      the processing of the previous inputs. Pass '--trace <file>' to the
+      command to get a profile of the replayed run.
+
+The replay doesn't need the accounts of the user that recorded the trace, it
+is best to run it with a separate base directory and offline, which is the
+default command ('centerim5 --offline'). Only the loadgen account has to be
+enabled when the incoming events are replayed too.
+
+Names of buddies and chat rooms and texts of messages are not in the trace,
+they are replaced by numbers and lengths. The terminal input is recorded as
+it is though, so a trace contains everything that was typed while it was
+recorded, including passwords and messages.
+"""
+
+import errno
+import fcntl
+import math
+import os
+import pty
+import select
+import signal
+import struct
+import sys
+import termios
+import time
+
+MAGIC = b'CIMTRACE'
+VERSIONS = (1, 2)
+
+RECORD_INPUT = 1
+RECORD_RESIZE = 2
+RECORD_NAME = 3
+RECORD_CALLBACK = 4
+RECORD_UI_OP = 5
+
+SOURCES = ['cppconsui', 'purple-timer', 'purple-input', 'ui-op']
+
+UI_OP_BLIST_NEW_NODE = 1
+UI_OP_BLIST_UPDATE = 2
+UI_OP_BLIST_REMOVE = 3
+UI_OP_WRITE_CONV = 4
+UI_OP_BUDDY_TYPING = 5
+UI_OP_NOTIFY_MESSAGE = 6
+UI_OP_NOTIFY_USERINFO = 7
+
+# names and numbers of arguments of the recorded ui-ops
+UI_OPS = {
+    UI_OP_BLIST_NEW_NODE: ('blist-new-node', 3),
+    UI_OP_BLIST_UPDATE: ('blist-update', 3),
+    UI_OP_BLIST_REMOVE: ('blist-remove', 3),
+    UI_OP_WRITE_CONV: ('write-conv', 5),
+    UI_OP_BUDDY_TYPING: ('buddy-typing', 2),
+    UI_OP_NOTIFY_MESSAGE: ('notify-message', 4),
+    UI_OP_NOTIFY_USERINFO: ('notify-userinfo', 1),
+}
+
+# libpurple constants used by the script conversion
+PURPLE_BLIST_BUDDY_NODE = 2
+PURPLE_CONV_TYPE_IM = 1
+PURPLE_CONV_TYPE_CHAT = 2
+PURPLE_MESSAGE_RECV = 0x0002
+# status ids of PurpleStatusPrimitive values, the loadgen plugin knows only
+# these three
+STATUS_IDS = {1: 'offline', 2: 'available'}
+
+# time without any output after which the response to an input is complete
+SETTLE_TIME = 0.05
+
+class TraceError(Exception):
+    pass
+
+def read_trace(filename):
+    """
+    Parses a trace file and returns a list of (time, type, data) tuples. Time
+    is in microseconds since the start of the trace.
+    """
+    f = open(filename, 'rb')
+    buf = bytearray(f.read())
+    f.close()
+
+    if bytes(buf[:len(MAGIC)]) != MAGIC:
+        raise TraceError('%s is not a trace file' % filename)
+    if buf[len(MAGIC)] not in VERSIONS:
+        raise TraceError('unsupported trace version %d' % buf[len(MAGIC)])
+
+    pos = [len(MAGIC) + 1]
+
+    def varint():
+        res = 0
+        shift = 0
+        while True:
+            if pos[0] >= len(buf):
+                raise EOFError()
+            b = buf[pos[0]]
+            pos[0] += 1
+            res |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                return res
+
+    def data(length):
+        if pos[0] + length > len(buf):
+            raise EOFError()
+        res = bytes(buf[pos[0]:pos[0] + length])
+        pos[0] += length
+        return res
+
+    records = []
+    now = 0
+    try:
+        while pos[0] < len(buf):
+            rtype = buf[pos[0]]
+            pos[0] += 1
+            now += varint()
+            if rtype == RECORD_INPUT:
+                records.append((now, rtype, data(varint())))
+            elif rtype == RECORD_RESIZE:
+                cols = varint()
+                records.append((now, rtype, (cols, varint())))
+            elif rtype == RECORD_NAME:
+                name_id = varint()
+                name = data(varint()).decode('utf-8', 'replace')
+                records.append((now, rtype, (name_id, name)))
+            elif rtype == RECORD_CALLBACK:
+                source = varint()
+                name_id = varint()
+                records.append((now, rtype, (source, name_id, varint())))
+            elif rtype == RECORD_UI_OP:
+                op = varint()
+                if op not in UI_OPS:
+                    raise TraceError('unknown ui-op %d' % op)
+                args = tuple([varint() for i in range(UI_OPS[op][1])])
+                records.append((now, rtype, (op, args)))
+            else:
+                raise TraceError('unknown record type %d' % rtype)
+    except EOFError:
+        # the program was probably killed, use what was written
+        sys.stderr.write('warning: the trace is truncated\n')
+
+    return records
+
+def percentile(values, p):
+    if not values:
+        return 0
+    # nearest-rank method
+    idx = max(0, int(math.ceil(len(values) * p / 100.0)) - 1)
+    return values[idx]
+
+def print_table(header, rows):
+    widths = [len(h) for h in header]
+    for row in rows:
+        widths = [max(w, len(str(c))) for w, c in zip(widths, row)]
+    fmt = '  '.join(['%%-%ds' % widths[0]]
+                    + ['%%%ds' % w for w in widths[1:]])
+    print(fmt % tuple(header))
+    for row in rows:
+        print(fmt % tuple(row))
+
+def profile(filename):
+    records = read_trace(filename)
+
+    names = {}
+    durations = {}
+    inputs = 0
+    resizes = 0
+    ui_ops = 0
+    for now, rtype, data in records:
+        if rtype == RECORD_INPUT:
+            inputs += 1
+        elif rtype == RECORD_RESIZE:
+            resizes += 1
+        elif rtype == RECORD_UI_OP:
+            ui_ops += 1
+        elif rtype == RECORD_NAME:
+            names[data[0]] = data[1]
+        elif rtype == RECORD_CALLBACK:
+            source, name_id, usecs = data
+            durations.setdefault((source, name_id), []).append(usecs)
+
+    length = records[-1][0] if records else 0
+    print('trace length: %.3f s, %d inputs, %d resizes, %d incoming events'
+          % (length / 1e6, inputs, resizes, ui_ops))
+    print('')
+
+    rows = []
+    for (source, name_id), values in durations.items():
+        values.sort()
+        source_name = source < len(SOURCES) and SOURCES[source] or '?'
+        rows.append((source_name, names.get(name_id, '?'), len(values),
+                     '%.1f' % (sum(values) / 1000.0), percentile(values, 50),
+                     percentile(values, 99), values[-1]))
+    # the most expensive callbacks first
+    rows.sort(key=lambda r: -float(r[3]))
+    print_table(['source', 'callback', 'count', 'total ms', 'p50 us',
+                 'p99 us', 'max us'], rows)
+
+def write_script(filename, output):
+    """
+    Converts the ui-op records of a trace into a script for the loadgen
+    plugin. Only events that come from the network are written, messages sent
+    by the user and status lines are caused by the replayed input or by the
+    replayed events again.
+    """
+    records = [r for r in read_trace(filename) if r[1] == RECORD_UI_OP]
+
+    lines = []
+    statuses = {}
+    base = records[0][0] if records else 0
+    for now, rtype, (op, args) in records:
+        ms = (now - base) // 1000
+        if op == UI_OP_BLIST_UPDATE:
+            node_type, user, primitive = args
+            if node_type != PURPLE_BLIST_BUDDY_NODE or not user:
+                continue
+            status = STATUS_IDS.get(primitive, 'away')
+            # most of the updates don't change the status
+            if statuses.get(user) == status:
+                continue
+            statuses[user] = status
+            lines.append('%d presence %d %s' % (ms, user, status))
+        elif op == UI_OP_WRITE_CONV:
+            conv_type, conv, sender, flags, length = args
+            if not flags & PURPLE_MESSAGE_RECV or not conv:
+                continue
+            if conv_type == PURPLE_CONV_TYPE_IM:
+                lines.append('%d im %d %d' % (ms, conv, length))
+            elif conv_type == PURPLE_CONV_TYPE_CHAT and sender:
+                lines.append('%d chat %d %d %d' % (ms, conv, sender, length))
+        elif op == UI_OP_BUDDY_TYPING:
+            if args[0]:
+                lines.append('%d typing %d %d' % (ms, args[0], args[1]))
+        elif op == UI_OP_NOTIFY_MESSAGE:
+            lines.append('%d notify %d %d %d %d' % ((ms,) + args))
+        elif op == UI_OP_NOTIFY_USERINFO:
+            if args[0]:
+                lines.append('%d userinfo %d' % (ms, args[0]))
+
+    f = open(output, 'w')
+    f.write('# loadgen script written by cimreplay.py from %s\n'
+            % os.path.basename(filename))
+    for line in lines:
+        f.write(line + '\n')
+    f.close()
+    print('wrote %d events' % len(lines))
+
+def set_winsize(fd, cols, lines):
+    # the kernel sends SIGWINCH to the program when the size changes
+    fcntl.ioctl(fd, termios.TIOCSWINSZ,
+                struct.pack('HHHH', lines, cols, 0, 0))
+
+def drain(fd, timeout):
+    """
+    Reads the output of the program until it is quiet for the given time.
+    Returns the time when the first byte arrived or None if nothing was
+    written, and whether the program is still running.
+    """
+    first = None
+    while True:
+        ready = select.select([fd], [], [], timeout)[0]
+        if not ready:
+            return first, True
+        try:
+            out = os.read(fd, 65536)
+        except OSError as e:
+            if e.errno == errno.EIO:
+                return first, False
+            raise
+        if not out:
+            return first, False
+        if first is None:
+            first = time.time()
+
+def wait_output(fd, timeout):
+    """
+    Waits at most the given time for the program to write something and
+    reads what is available. Returns the time when the output arrived or None
+    if nothing was written, and whether the program is still running.
+    """
+    ready = select.select([fd], [], [], timeout)[0]
+    if not ready:
+        return None, True
+    try:
+        out = os.read(fd, 65536)
+    except OSError as e:
+        if e.errno == errno.EIO:
+            return None, False
+        raise
+    if not out:
+        return None, False
+    return time.time(), True
+
+def replay(filename, command, speed, max_speed):
+    records = read_trace(filename)
+    events = [r for r in records if r[1] in (RECORD_INPUT, RECORD_RESIZE)]
+
+    pid, fd = pty.fork()
+    if pid == 0:
+        os.environ.setdefault('TERM', 'xterm')
+        try:
+            os.execvp(command[0], command)
+        finally:
+            os._exit(127)
+
+    # let the program start with the recorded screen size
+    for now, rtype, data in events:
+        if rtype == RECORD_RESIZE:
+            set_winsize(fd, data[0], data[1])
+            break
+    running = drain(fd, 1.0)[1]
+
+    latencies = []
+    silent = 0
+    start = time.time()
+    base = events[0][0] if events else 0
+    for now, rtype, data in events:
+        if not running:
+            break
+        if max_speed:
+            # throw away the rest of the previous response without waiting
+            running = drain(fd, 0)[1]
+            if not running:
+                break
+        else:
+            delay = start + (now - base) / 1e6 / speed - time.time()
+            if delay > 0:
+                running = drain(fd, delay)[1]
+        sent = time.time()
+        if rtype == RECORD_RESIZE:
+            set_winsize(fd, data[0], data[1])
+        else:
+            os.write(fd, data)
+        if max_speed:
+            # don't wait until the program is quiet, only for its response
+            first, running = wait_output(fd, SETTLE_TIME)
+        else:
+            first, running = drain(fd, SETTLE_TIME)
+        if first is None:
+            silent += 1
+        else:
+            latencies.append((first - sent) * 1e6)
+    total = time.time() - start
+
+    if running:
+        os.kill(pid, signal.SIGTERM)
+    os.waitpid(pid, 0)
+    os.close(fd)
+
+    latencies.sort()
+    print('replayed %d events in %.3f s%s' % (len(events), total,
+          not running and ' (the program exited)' or ''))
+    print('events without any response: %d' % silent)
+    print_table(['response', 'p50 us', 'p90 us', 'p99 us', 'max us'],
+                [('first output', int(percentile(latencies, 50)),
+                  int(percentile(latencies, 90)),
+                  int(percentile(latencies, 99)),
+                  int(latencies and latencies[-1] or 0))])
+
+def usage(out):
+    out.write(__doc__.lstrip())
+
+def main():
+    args = sys.argv[1:]
+    if not args or args[0] in ('-h', '--help'):
+        usage(sys.stdout)
+        return 0
+
+    try:
+        if args[0] == 'profile' and len(args) == 2:
+            profile(args[1])
+            return 0
+
+        if args[0] == 'script' and len(args) == 3:
+            write_script(args[1], args[2])
+            return 0
+
+        if args[0] == 'replay':
+            args = args[1:]
+            command = ['centerim5', '--offline']
+            if '--' in args:
+                idx = args.index('--')
+                command = args[idx + 1:]
+                args = args[:idx]
+            speed = 1.0
+            max_speed = False
+            while args and args[0].startswith('--'):
+                opt = args.pop(0)
+                if opt == '--max-speed':
+                    max_speed = True
+                elif opt == '--speed' and args:
+                    speed = float(args.pop(0))
+                else:
+                    args = []
+            if len(args) == 1 and command and speed > 0:
+                replay(args[0], command, speed, max_speed)
+                return 0
+    except (IOError, OSError, TraceError) as e:
+        sys.stderr.write('%s\n' % e)
+        return 1
+
+    usage(sys.stderr)
+    return 1
+
+if __name__ == '__main__':
+    sys.exit(main())
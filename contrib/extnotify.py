@@ -2,16 +2,84 @@
 
 """
 This script processes events generated by the extaction plugin and displays
-notifications of these events on the screen.
+notifications of these events on the screen. It works both when it is
+executed for each event and when it runs as a helper that reads the events
+from its standard input.
 """
 
 import os
 import sys
-import base64
 import cgi
+import json
 import pynotify
 
+def notify(remote_user, message, icon_path):
+    title = 'Message from %s:' % remote_user
+    # message is in UTF-8, decode it to Unicode, then select first 256
+    # characters and encode them back to UTF-8
+    body = message.decode('utf-8')[0:256].encode('utf-8')
+    # and escape the '&', '<', '>' characters
+    body = cgi.escape(body)
+    n = pynotify.Notification(title, body)
+    if icon_path:
+        # the icon is a file in the icon cache of the plugin
+        try:
+            pixbuf = pynotify.gtk.gdk.pixbuf_new_from_file_at_size(icon_path,
+                                                                   48, 48)
+            n.set_icon_from_pixbuf(pixbuf)
+        except Exception:
+            # the cache removes the file as soon as no buddy uses the icon,
+            # so it can be gone if the buddy changed the icon meanwhile
+            pass
+
+    # get the notification on the screen
+    n.show()
+
+def read_netstring(f):
+    """
+    Reads one netstring ('<length>:<data>,') and returns its data, or None at
+    the end of the input.
+    """
+    length = ''
+    while True:
+        c = f.read(1)
+        if not c:
+            return None
+        if c == ':':
+            break
+        length += c
+    data = f.read(int(length))
+    if len(data) != int(length) or f.read(1) != ',':
+        return None
+    return data
+
+def run_helper():
+    while True:
+        record = read_netstring(sys.stdin)
+        if record is None:
+            # the plugin was unloaded or CenterIM exited
+            break
+
+        event = json.loads(record)
+        # this script can handle only the msg type
+        if event.get('type') != 'msg':
+            continue
+
+        # json returns Unicode strings, notify() expects UTF-8
+        icon_path = event.get('remote_user_icon_path')
+        notify(event['remote_user'].encode('utf-8'),
+               event['message'].encode('utf-8'),
+               icon_path and icon_path.encode('utf-8'))
+
 def main():
+    if not pynotify.init('Extaction-plugin handler'):
+        sys.exit(1)
+
+    if os.environ.get('EXTACTION_MODE') == 'helper':
+        run_helper()
+        pynotify.uninit()
+        return
+
     # make the parameters saved in enviromental variables easier accessible
     try:
         event_type = os.environ['EVENT_TYPE']
@@ -28,33 +96,8 @@ def main():
         # some necessary parameters are missing
         sys.exit(1)
 
-    if not pynotify.init('Extaction-plugin handler'):
-        sys.exit(1)
-
-    title = 'Message from %s:' % event_remote_user
-    # event_message is in UTF-8, decode it to Unicode, then select first 256
-    # characters and encode them back to UTF-8
-    body = event_message.decode('utf-8')[0:256].encode('utf-8')
-    # and escape the '&', '<', '>' characters
-    body = cgi.escape(body)
-    n = pynotify.Notification(title, body)
-    if os.environ.has_key('EVENT_REMOTE_USER_ICON'):
-        # the icon is encoded in base64, decode it first
-        icon_encoded = os.environ['EVENT_REMOTE_USER_ICON']
-        icon_decoded = base64.b64decode(icon_encoded)
-
-        # create a pixbuf loader
-        loader = pynotify.gtk.gdk.PixbufLoader();
-        loader.set_size(48, 48);
-        loader.write(icon_decoded);
-        loader.close()
-
-        # set icon from the pixbuf
-        pixbuf = loader.get_pixbuf()
-        n.set_icon_from_pixbuf(pixbuf)
-
-    # get the notification on the screen
-    n.show()
+    notify(event_remote_user, event_message,
+           os.environ.get('EVENT_REMOTE_USER_ICON_PATH'))
 
     pynotify.uninit()
 
@@ -27,6 +27,8 @@
 
 #include "ConsUICurses.h"
 
+#include "HeadlessScreen.h"
+
 /* In order to get wide characters support we must define
  * _XOPEN_SOURCE_EXTENDED when using cursesw.h. */
 #ifndef _XOPEN_SOURCE_EXTENDED
@@ -36,6 +38,7 @@
 #define NCURSES_NOMACROS
 #include <cursesw.h>
 
+#include <stdio.h>
 #include <string.h>
 
 namespace CppConsUI
@@ -44,19 +47,71 @@ namespace CppConsUI
 namespace Curses
 {
 
-static Stats stats = {0, 0, 0};
+static Stats stats = {0, 0, 0, 0, 0, 0};
+static Backend backend = BACKEND_NCURSES;
 bool ascii_mode = false;
 
+/* Exactly one of the members is set, depending on the backend that was
+ * active when the window was created. */
 struct Window::WindowInternals
 {
   WINDOW *win;
-  WindowInternals(WINDOW *w = NULL) : win(w) {}
+  Headless::Window *hwin;
+  WindowInternals(WINDOW *w = NULL) : win(w), hwin(NULL) {}
 };
 
+static gunichar get_line_char(LineChar c)
+{
+  switch (c) {
+    case LINE_HLINE:
+      return ascii_mode ? '-' : 0x2500;
+    case LINE_VLINE:
+      return ascii_mode ? '|' : 0x2502;
+    case LINE_LLCORNER:
+      return ascii_mode ? '+' : 0x2514;
+    case LINE_LRCORNER:
+      return ascii_mode ? '+' : 0x2518;
+    case LINE_ULCORNER:
+      return ascii_mode ? '+' : 0x250c;
+    case LINE_URCORNER:
+      return ascii_mode ? '+' : 0x2510;
+    case LINE_BTEE:
+      return ascii_mode ? '+' : 0x2534;
+    case LINE_LTEE:
+      return ascii_mode ? '+' : 0x251c;
+    case LINE_RTEE:
+      return ascii_mode ? '+' : 0x2524;
+    case LINE_TTEE:
+      return ascii_mode ? '+' : 0x252c;
+
+    case LINE_DARROW:
+      return ascii_mode ? 'v' : 0x2193;
+    case LINE_LARROW:
+      return ascii_mode ? '<' : 0x2190;
+    case LINE_RARROW:
+      return ascii_mode ? '>' : 0x2192;
+    case LINE_UARROW:
+      return ascii_mode ? '^' : 0x2191;
+    case LINE_BULLET:
+      return ascii_mode ? 'o' : 0x00b7;
+  }
+  return '?';
+}
+
 Window *Window::newpad(int ncols, int nlines)
 {
   stats.newpad_calls++;
 
+  if (backend == BACKEND_HEADLESS) {
+    Headless::Window *hwin;
+    if (!(hwin = Headless::Window::newpad(ncols, nlines)))
+      return NULL;
+
+    Window *a = new Window;
+    a->p->hwin = hwin;
+    return a;
+  }
+
   WINDOW *win;
 
   if (!(win = ::newpad(nlines, ncols)))
@@ -71,6 +126,16 @@ Window *Window::newwin(int begin_x, int begin_y, int ncols, int nlines)
 {
   stats.newwin_calls++;
 
+  if (backend == BACKEND_HEADLESS) {
+    Headless::Window *hwin;
+    if (!(hwin = Headless::Window::newwin(begin_x, begin_y, ncols, nlines)))
+      return NULL;
+
+    Window *a = new Window;
+    a->p->hwin = hwin;
+    return a;
+  }
+
   WINDOW *win;
 
   if (!(win = ::newwin(nlines, ncols, begin_y, begin_x)))
@@ -85,6 +150,16 @@ Window *Window::subpad(int begin_x, int begin_y, int ncols, int nlines)
 {
   stats.subpad_calls++;
 
+  if (p->hwin) {
+    Headless::Window *hwin;
+    if (!(hwin = p->hwin->subpad(begin_x, begin_y, ncols, nlines)))
+      return NULL;
+
+    Window *a = new Window;
+    a->p->hwin = hwin;
+    return a;
+  }
+
   WINDOW *win;
 
   if (!(win = ::subpad(p->win, nlines, ncols, begin_y, begin_x)))
@@ -97,7 +172,10 @@ Window *Window::subpad(int begin_x, int begin_y, int ncols, int nlines)
 
 Window::~Window()
 {
-  delwin(p->win);
+  if (p->hwin)
+    delete p->hwin;
+  else
+    delwin(p->win);
   delete p;
 }
 
@@ -105,7 +183,10 @@ int Window::mvaddstring(int x, int y, int w, const char *str)
 {
   g_assert(str);
 
-  wmove(p->win, y, x);
+  if (p->hwin)
+    p->hwin->move(x, y);
+  else
+    wmove(p->win, y, x);
 
   int printed = 0;
   while (printed < w && str && *str) {
@@ -119,7 +200,10 @@ int Window::mvaddstring(int x, int y, const char *str)
 {
   g_assert(str);
 
-  wmove(p->win, y, x);
+  if (p->hwin)
+    p->hwin->move(x, y);
+  else
+    wmove(p->win, y, x);
 
   int printed = 0;
   while (str && *str) {
@@ -137,7 +221,10 @@ int Window::mvaddstring(int x, int y, int w, const char *str, const char *end)
   if (str >= end)
     return 0;
 
-  wmove(p->win, y, x);
+  if (p->hwin)
+    p->hwin->move(x, y);
+  else
+    wmove(p->win, y, x);
 
   int printed = 0;
   while (printed < w && str < end && str && *str) {
@@ -155,7 +242,10 @@ int Window::mvaddstring(int x, int y, const char *str, const char *end)
   if (str >= end)
     return 0;
 
-  wmove(p->win, y, x);
+  if (p->hwin)
+    p->hwin->move(x, y);
+  else
+    wmove(p->win, y, x);
 
   int printed = 0;
   while (str < end && str && *str) {
@@ -167,12 +257,20 @@ int Window::mvaddstring(int x, int y, const char *str, const char *end)
 
 int Window::mvaddchar(int x, int y, gunichar uc)
 {
-  wmove(p->win, y, x);
+  if (p->hwin)
+    p->hwin->move(x, y);
+  else
+    wmove(p->win, y, x);
   return printChar(uc);
 }
 
 int Window::mvaddlinechar(int x, int y, LineChar c)
 {
+  if (p->hwin) {
+    p->hwin->move(x, y);
+    return p->hwin->addChar(get_line_char(c), 1);
+  }
+
   switch (c) {
     case LINE_HLINE:
       return mvwaddch(p->win, y, x, ascii_mode ? '-' : ACS_HLINE);
@@ -211,22 +309,38 @@ int Window::mvaddlinechar(int x, int y, LineChar c)
 
 int Window::attron(int attrs)
 {
+  if (p->hwin) {
+    p->hwin->attrOn(attrs);
+    return OK;
+  }
+
   return wattron(p->win, attrs);
 }
 
 int Window::attroff(int attrs)
 {
+  if (p->hwin) {
+    p->hwin->attrOff(attrs);
+    return OK;
+  }
+
   return wattroff(p->win, attrs);
 }
 
 int Window::mvchgat(int x, int y, int n, /* attr_t */ int attr, short color,
     const void *opts)
 {
+  if (p->hwin)
+    return p->hwin->changeAttrs(x, y, n, attr | COLOR_PAIR(color));
+
   return mvwchgat(p->win, y, x, n, attr, color, opts);
 }
 
 int Window::fill(int attrs)
 {
+  if (p->hwin)
+    return p->hwin->fill(attrs, 0, 0, getmaxx(), getmaxy());
+
   attr_t battrs;
   short pair;
 
@@ -255,6 +369,9 @@ int Window::fill(int attrs)
 
 int Window::fill(int attrs, int x, int y, int w, int h)
 {
+  if (p->hwin)
+    return p->hwin->fill(attrs, x, y, w, h);
+
   attr_t battrs;
   short pair;
 
@@ -279,16 +396,26 @@ int Window::fill(int attrs, int x, int y, int w, int h)
 
 int Window::erase()
 {
+  if (p->hwin)
+    return p->hwin->erase();
+
   return werase(p->win);
 }
 
 int Window::noutrefresh()
 {
+  if (p->hwin)
+    return p->hwin->noutrefresh();
+
   return wnoutrefresh(p->win);
 }
 
 int Window::touch()
 {
+  // the headless backend always copies whole windows
+  if (p->hwin)
+    return OK;
+
   return touchwin(p->win);
 }
 
@@ -296,17 +423,29 @@ int Window::copyto(Window *dstwin, int smincol, int sminrow,
     int dmincol, int dminrow, int dmaxcol, int dmaxrow,
     int overlay)
 {
+  if (p->hwin) {
+    g_assert(dstwin->p->hwin);
+    return p->hwin->copyto(dstwin->p->hwin, smincol, sminrow, dmincol,
+        dminrow, dmaxcol, dmaxrow, overlay);
+  }
+
   return copywin(p->win, dstwin->p->win, sminrow, smincol, dminrow, dmincol,
       dmaxrow, dmaxcol, overlay);
 }
 
 int Window::getmaxx()
 {
+  if (p->hwin)
+    return p->hwin->getmaxx();
+
   return ::getmaxx(p->win);
 }
 
 int Window::getmaxy()
 {
+  if (p->hwin)
+    return p->hwin->getmaxy();
+
   return ::getmaxy(p->win);
 }
 
@@ -318,7 +457,10 @@ int Window::printChar(gunichar uc)
 
   if (uc >= 0x7f && uc < 0xa0) {
     // filter out C1 (8-bit) control characters
-    waddch(p->win, '?');
+    if (p->hwin)
+      p->hwin->addChar('?', 1);
+    else
+      waddch(p->win, '?');
     return 1;
   }
 
@@ -336,8 +478,12 @@ int Window::printChar(gunichar uc)
   // tab character
   if (wch[0] == '\t') {
     int w = onscreen_width(wch[0]);
-    for (int i = 0; i < w; i++)
-      waddch(p->win, ' ');
+    for (int i = 0; i < w; i++) {
+      if (p->hwin)
+        p->hwin->addChar(' ', 1);
+      else
+        waddch(p->win, ' ');
+    }
     return w;
   }
 
@@ -345,6 +491,12 @@ int Window::printChar(gunichar uc)
   if (wch[0] < 32)
     wch[0] = 0x2400 + wch[0];
 
+  if (p->hwin) {
+    int w = onscreen_width(wch[0]);
+    p->hwin->addChar(wch[0], w);
+    return w;
+  }
+
   setcchar(&cc, wch, A_NORMAL, 0, NULL);
   wadd_wch(p->win, &cc);
   return onscreen_width(wch[0]);
@@ -375,8 +527,21 @@ const int Attr::BOLD = A_BOLD;
 const int C_OK = OK;
 const int C_ERR = ERR;
 
+void set_backend(Backend backend_)
+{
+  backend = backend_;
+}
+
+Backend get_backend()
+{
+  return backend;
+}
+
 int init_screen()
 {
+  if (backend == BACKEND_HEADLESS)
+    return Headless::init_screen();
+
   if (!::initscr())
     return ERR;
 
@@ -397,6 +562,9 @@ int init_screen()
 
 int finalize_screen()
 {
+  if (backend == BACKEND_HEADLESS)
+    return Headless::finalize_screen();
+
   return ::endwin();
 }
 
@@ -410,11 +578,24 @@ bool get_ascii_mode()
   return ascii_mode;
 }
 
+void set_bracketed_paste(bool enabled)
+{
+  if (backend == BACKEND_HEADLESS)
+    return;
+
+  // terminals that don't support the mode ignore the sequence
+  fputs(enabled ? "\033[?2004h" : "\033[?2004l", stdout);
+  fflush(stdout);
+}
+
 bool init_colorpair(int idx, int fg, int bg, int *res)
 {
   bool success;
 
-  success = (init_pair(idx, fg, bg) != ERR);
+  if (backend == BACKEND_HEADLESS)
+    success = Headless::init_colorpair(idx, fg, bg);
+  else
+    success = (init_pair(idx, fg, bg) != ERR);
 
   if (success)
     *res = COLOR_PAIR(idx);
@@ -424,11 +605,17 @@ bool init_colorpair(int idx, int fg, int bg, int *res)
 
 int nrcolors()
 {
+  if (backend == BACKEND_HEADLESS)
+    return Headless::nrcolors();
+
   return COLORS;
 }
 
 int nrcolorpairs()
 {
+  if (backend == BACKEND_HEADLESS)
+    return Headless::nrcolorpairs();
+
 #ifndef NCURSES_EXT_COLORS
   /* Ncurses reports more than 256 color pairs, even when compiled without
    * ext-color. */
@@ -441,6 +628,9 @@ int nrcolorpairs()
 #ifdef DEBUG
 bool colorpair_content(int colorpair, int *fg, int *bg)
 {
+  if (backend == BACKEND_HEADLESS)
+    return Headless::colorpair_content(PAIR_NUMBER(colorpair), fg, bg);
+
   short sfg, sbg;
 
   int ret = pair_content(PAIR_NUMBER(colorpair), &sfg, &sbg);
@@ -454,41 +644,67 @@ bool colorpair_content(int colorpair, int *fg, int *bg)
 
 int erase()
 {
+  if (backend == BACKEND_HEADLESS)
+    return Headless::erase();
+
   return ::erase();
 }
 
 int clear()
 {
+  if (backend == BACKEND_HEADLESS)
+    return Headless::clear();
+
   return ::clear();
 }
 
 int doupdate()
 {
+  stats.doupdate_calls++;
+
+  if (backend == BACKEND_HEADLESS)
+    return Headless::doupdate(&stats);
+
   return ::doupdate();
 }
 
 int beep()
 {
+  if (backend == BACKEND_HEADLESS)
+    return OK;
+
   return ::beep();
 }
 
 int noutrefresh()
 {
+  if (backend == BACKEND_HEADLESS)
+    return Headless::noutrefresh();
+
   return ::wnoutrefresh(stdscr);
 }
 
 int getmaxx()
 {
+  if (backend == BACKEND_HEADLESS)
+    return Headless::getmaxx();
+
   return ::getmaxx(stdscr);
 }
 
 int getmaxy()
 {
+  if (backend == BACKEND_HEADLESS)
+    return Headless::getmaxy();
+
   return ::getmaxy(stdscr);
 }
 
 int resizeterm(int lines, int columns)
 {
+  if (backend == BACKEND_HEADLESS)
+    return Headless::resizeterm(lines, columns);
+
   return ::resizeterm(lines, columns);
 }
 
@@ -527,6 +743,22 @@ void reset_stats()
   memset(&stats, 0, sizeof(stats));
 }
 
+bool get_cell(int x, int y, Cell *cell)
+{
+  if (backend != BACKEND_HEADLESS)
+    return false;
+
+  return Headless::get_cell(x, y, cell);
+}
+
+char *get_snapshot()
+{
+  if (backend != BACKEND_HEADLESS)
+    return NULL;
+
+  return Headless::get_snapshot();
+}
+
 } // namespace Curses
 
 } // namespace CppConsUI
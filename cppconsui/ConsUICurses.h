@@ -45,6 +45,27 @@ struct Stats
   unsigned newpad_calls;
   unsigned newwin_calls;
   unsigned subpad_calls;
+  unsigned doupdate_calls;
+  // counted only by the headless backend
+  unsigned cells_emitted;
+  unsigned bytes_emitted;
+};
+
+enum Backend {
+  // ncurses on the controlling terminal
+  BACKEND_NCURSES,
+  // in-memory screen without any terminal
+  BACKEND_HEADLESS
+};
+
+/**
+ * One cell of the headless screen. The uc member is zero for cells covered
+ * by a preceding wide character.
+ */
+struct Cell
+{
+  gunichar uc;
+  int attrs;
 };
 
 enum LineChar {
@@ -149,9 +170,19 @@ extern const int C_ERR;
 
 const int NUM_DEFAULT_COLORS = 16;
 
+/**
+ * Selects the backend, it has to be called before init_screen(). The
+ * headless backend never touches the terminal, its initial size is taken
+ * from the COLUMNS and LINES environment variables (80x24 by default) and
+ * can be changed by resizeterm().
+ */
+void set_backend(Backend backend);
+Backend get_backend();
+
 int init_screen();
 int finalize_screen();
 void set_ascii_mode(bool enabled);
+void set_bracketed_paste(bool enabled);
 bool get_ascii_mode();
 
 bool init_colorpair(int idx, int fg, int bg, int *res);
@@ -178,6 +209,19 @@ int onscreen_width(gunichar uc, int w = 0);
 const Stats *get_stats();
 void reset_stats();
 
+/**
+ * Returns a cell of the headless screen as it was left by the last
+ * doupdate(). Returns false if the position is outside of the screen or the
+ * backend is not headless.
+ */
+bool get_cell(int x, int y, Cell *cell);
+/**
+ * Returns a newly allocated UTF-8 text of the headless screen as it was left
+ * by the last doupdate(), each line is terminated by '\n'. Attributes are
+ * not included. Returns NULL if the backend is not headless.
+ */
+char *get_snapshot();
+
 } // namespace Curses
 
 } // namespace CppConsUI
@@ -24,13 +24,21 @@
 #include "ColorScheme.h"
 #include "KeyConfig.h"
 
+#include <errno.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <signal.h>
 #include <termios.h>
 #include <unistd.h>
 #include "gettext.h"
 
+/* A bracketed paste is left when no key of it arrived for PASTE_TIMEOUT
+ * milliseconds, in case the terminal lost its end. Collected text is handed
+ * over whenever it reaches PASTE_MAX_BYTES. */
+#define PASTE_TIMEOUT 1000
+#define PASTE_MAX_BYTES (64 * 1024)
+
 namespace CppConsUI
 {
 
@@ -38,7 +46,8 @@ namespace CppConsUI
 class SourceConnectionNode
 {
   public:
-    explicit inline SourceConnectionNode(const sigc::slot_base& nslot);
+    inline SourceConnectionNode(const sigc::slot_base& nslot,
+        const char *nname);
 
     static void *notify(void *data);
     static void destroy_notify_callback(void *data);
@@ -52,12 +61,14 @@ class SourceConnectionNode
   private:
     sigc::slot_base slot;
     GSource *source;
+    const char *name;
 };
 
 inline SourceConnectionNode::SourceConnectionNode(
-    const sigc::slot_base& nslot)
+    const sigc::slot_base& nslot, const char *nname)
 : slot(nslot)
 , source(0)
+, name(nname)
 {
   slot.set_parent(this, &SourceConnectionNode::notify);
 }
@@ -100,7 +111,19 @@ gboolean SourceConnectionNode::source_callback(void *data)
     = reinterpret_cast<SourceConnectionNode*>(data);
 
   // recreate the specific slot from the generic slot node
-  return (*static_cast<sigc::slot<bool>*>(conn_data->get_slot()))();
+  sigc::slot<bool> *slot
+    = static_cast<sigc::slot<bool>*>(conn_data->get_slot());
+
+  CoreManager::DispatchHook hook = COREMANAGER->getDispatchHook();
+  if (!hook)
+    return (*slot)();
+
+  // the node can be destroyed by the callback, remember its name
+  const char *name = conn_data->name ? conn_data->name : "timeout";
+  gint64 start = CoreManager::getMonotonicTime();
+  gboolean res = (*slot)();
+  hook(name, CoreManager::getMonotonicTime() - start);
+  return res;
 }
 
 inline void SourceConnectionNode::install(GSource *nsource)
@@ -257,14 +280,16 @@ void CoreManager::redraw()
 {
   if (!redraw_pending) {
     redraw_pending = true;
-    timeoutOnceConnect(sigc::mem_fun(this, &CoreManager::draw), 0);
+    redraw_time = getMonotonicTime();
+    timeoutOnceConnect(sigc::mem_fun(this, &CoreManager::draw), 0,
+        G_PRIORITY_DEFAULT, "draw");
   }
 }
 
 sigc::connection CoreManager::timeoutConnect(const sigc::slot<bool>& slot,
-    unsigned interval, int priority)
+    unsigned interval, int priority, const char *name)
 {
-  SourceConnectionNode *conn_node = new SourceConnectionNode(slot);
+  SourceConnectionNode *conn_node = new SourceConnectionNode(slot, name);
   sigc::connection connection(*conn_node->get_slot());
 
   GSource *source = g_timeout_source_new(interval);
@@ -283,15 +308,37 @@ sigc::connection CoreManager::timeoutConnect(const sigc::slot<bool>& slot,
 }
 
 sigc::connection CoreManager::timeoutOnceConnect(const sigc::slot<void>& slot,
-    unsigned interval, int priority)
+    unsigned interval, int priority, const char *name)
+{
+  return timeoutConnect(sigc::bind_return(slot, FALSE), interval, priority,
+      name);
+}
+
+void CoreManager::resetLatencies()
+{
+  input_latencies.clear();
+  background_latency.reset();
+}
+
+gint64 CoreManager::getMonotonicTime()
 {
-  return timeoutConnect(sigc::bind_return(slot, FALSE), interval, priority);
+#if GLIB_CHECK_VERSION(2, 28, 0)
+  return g_get_monotonic_time();
+#else
+  GTimeVal tv;
+  g_get_current_time(&tv);
+  return static_cast<gint64>(tv.tv_sec) * G_USEC_PER_SEC + tv.tv_usec;
+#endif
 }
 
 CoreManager::CoreManager()
 : top_input_processor(NULL), io_input_channel(NULL), io_input_channel_id(0)
 , resize_channel(NULL), resize_channel_id(0), pipe_valid(false), tk(NULL)
-, utf8(false), gmainloop(NULL), redraw_pending(false), resize_pending(false)
+, input_iconv(reinterpret_cast<GIConv>(-1)), input_partial_bytes(0)
+, paste_active(false), paste_time(0), gmainloop(NULL)
+, redraw_pending(false)
+, resize_pending(false), dispatch_hook(NULL), input_hook(NULL)
+, input_time(0), redraw_time(0)
 {
   initInput();
 
@@ -299,6 +346,8 @@ CoreManager::CoreManager()
    * @todo Check the return value. Throw an exception if we can't init curses.
    */
   Curses::init_screen();
+  // let the terminal mark pasted text so it can be inserted at once
+  Curses::set_bracketed_paste(true);
 
   // create the main loop
   gmainloop = g_main_loop_new(NULL, FALSE);
@@ -332,6 +381,7 @@ CoreManager::~CoreManager()
   Curses::noutrefresh();
   Curses::doupdate();
   Curses::finalize_screen();
+  Curses::set_bracketed_paste(false);
 }
 
 int CoreManager::init()
@@ -359,6 +409,14 @@ bool CoreManager::processInput(const TermKeyKey& key)
   return InputProcessor::processInput(key);
 }
 
+bool CoreManager::processPaste(const char *text, size_t bytes)
+{
+  if (top_input_processor && top_input_processor->processPaste(text, bytes))
+    return true;
+
+  return InputProcessor::processPaste(text, bytes);
+}
+
 gboolean CoreManager::io_input_error(GIOChannel * /*source*/,
     GIOCondition /*cond*/)
 {
@@ -369,55 +427,232 @@ gboolean CoreManager::io_input_error(GIOChannel * /*source*/,
   return TRUE;
 }
 
+gboolean CoreManager::io_input_(GIOChannel *source, GIOCondition cond,
+    gpointer data)
+{
+  CoreManager *self = reinterpret_cast<CoreManager*>(data);
+  if (!self->dispatch_hook)
+    return self->io_input(source, cond);
+
+  gint64 start = getMonotonicTime();
+  gboolean res = self->io_input(source, cond);
+  self->dispatch_hook("input", getMonotonicTime() - start);
+  return res;
+}
+
 gboolean CoreManager::io_input(GIOChannel * /*source*/, GIOCondition /*cond*/)
 {
   if (io_input_timeout_conn.connected())
     io_input_timeout_conn.disconnect();
 
-  termkey_advisereadable(tk);
+  input_time = getMonotonicTime();
+
+  if (input_iconv != reinterpret_cast<GIConv>(-1))
+    readConvertedInput();
+  else if (input_hook)
+    readRawInput();
+  else
+    termkey_advisereadable(tk);
 
   TermKeyKey key;
   TermKeyResult ret;
   while ((ret = termkey_getkey(tk, &key)) == TERMKEY_RES_KEY) {
-    if (key.type == TERMKEY_TYPE_UNICODE && !utf8) {
-      gsize bwritten;
-      GError *err = NULL;
-      char *utf8;
-
-      // convert data from user charset to UTF-8
-      if (!(utf8 = g_locale_to_utf8(key.utf8, -1, NULL, &bwritten, &err))) {
-        g_warning(_("Error converting input to UTF-8 (%s)."), err->message);
-        g_clear_error(&err);
-        continue;
-      }
-
-      memcpy(key.utf8, utf8, bwritten + 1);
-      g_free(utf8);
-
-      key.code.codepoint = g_utf8_get_char(key.utf8);
-    }
-
-    processInput(key);
+    dispatchKey(key);
   }
   if (ret == TERMKEY_RES_AGAIN) {
     int wait = termkey_get_waittime(tk);
     io_input_timeout_conn = timeoutOnceConnect(sigc::mem_fun(this,
-          &CoreManager::io_input_timeout), wait);
+          &CoreManager::io_input_timeout), wait, G_PRIORITY_DEFAULT,
+        "input-timeout");
   }
 
   return TRUE;
 }
 
+void CoreManager::pushInput(const char *bytes, size_t len)
+{
+  input_time = getMonotonicTime();
+  termkey_pushinput(tk, reinterpret_cast<const unsigned char*>(bytes), len);
+
+  TermKeyKey key;
+  TermKeyResult ret;
+  while ((ret = termkey_getkey(tk, &key)) == TERMKEY_RES_KEY)
+    dispatchKey(key);
+  // the input is complete, don't wait for the rest of an escape sequence
+  if (ret == TERMKEY_RES_AGAIN
+      && termkey_getkey_force(tk, &key) == TERMKEY_RES_KEY)
+    dispatchKey(key);
+}
+
 void CoreManager::io_input_timeout()
 {
+  input_time = getMonotonicTime();
+
   TermKeyKey key;
   if (termkey_getkey_force(tk, &key) == TERMKEY_RES_KEY) {
-    /* This should happen only for Esc key, so no need to do locale->utf8
-     * conversion. */
+    // this should happen only for Esc key
+    dispatchKey(key);
+  }
+}
+
+void CoreManager::dispatchKey(const TermKeyKey& key)
+{
+  processed_context = NULL;
+  if (!processPasteKey(key))
     processInput(key);
+
+  // a key that changed nothing on the screen has no latency to measure
+  if (!processed_context || !redraw_pending)
+    return;
+
+  // limit the memory used when the screen is not updated for a long time
+  if (pending_keys.size() >= 256)
+    return;
+
+  PendingKey pending;
+  pending.context = processed_context;
+  pending.time = input_time;
+  pending_keys.push_back(pending);
+}
+
+void CoreManager::readConvertedInput()
+{
+  char buf[1024];
+  char out[4096];
+
+  // start with the rest of an incomplete sequence from the previous read
+  memcpy(buf, input_partial, input_partial_bytes);
+  ssize_t len = read(STDIN_FILENO, buf + input_partial_bytes,
+      sizeof(buf) - input_partial_bytes);
+  if (len <= 0)
+    return;
+
+  if (input_hook)
+    input_hook(buf + input_partial_bytes, len);
+
+  gchar *inbuf = buf;
+  gsize inleft = input_partial_bytes + len;
+  input_partial_bytes = 0;
+  while (inleft) {
+    gchar *outbuf = out;
+    gsize outleft = sizeof(out);
+    gsize res = g_iconv(input_iconv, &inbuf, &inleft, &outbuf, &outleft);
+    int saved_errno = errno;
+    if (outbuf != out)
+      termkey_pushinput(tk, reinterpret_cast<unsigned char*>(out),
+          outbuf - out);
+
+    if (res != static_cast<gsize>(-1))
+      break;
+
+    if (saved_errno == E2BIG)
+      continue;
+    if (saved_errno == EINVAL && inleft < sizeof(input_partial)) {
+      // the sequence will be completed by the next read
+      memcpy(input_partial, inbuf, inleft);
+      input_partial_bytes = inleft;
+      break;
+    }
+
+    // skip an invalid byte
+    g_warning(_("Error converting input to UTF-8 (%s)."),
+        g_strerror(saved_errno));
+    inbuf++;
+    inleft--;
   }
 }
 
+void CoreManager::readRawInput()
+{
+  char buf[1024];
+
+  ssize_t len = read(STDIN_FILENO, buf, sizeof(buf));
+  if (len <= 0)
+    return;
+
+  input_hook(buf, len);
+  termkey_pushinput(tk, reinterpret_cast<unsigned char*>(buf), len);
+}
+
+bool CoreManager::processPasteKey(const TermKeyKey& key)
+{
+  if (key.type == TERMKEY_TYPE_KEYSYM
+      && key.code.sym == TERMKEY_SYM_PASTE_BEGIN) {
+    paste_active = true;
+    paste_buffer.clear();
+    paste_time = input_time;
+    if (!paste_timeout_conn.connected())
+      paste_timeout_conn = timeoutOnceConnect(sigc::mem_fun(this,
+            &CoreManager::onPasteTimeout), PASTE_TIMEOUT, G_PRIORITY_DEFAULT,
+          "paste-timeout");
+    return true;
+  }
+
+  if (!paste_active)
+    return false;
+
+  if (key.type == TERMKEY_TYPE_KEYSYM
+      && key.code.sym == TERMKEY_SYM_PASTE_END) {
+    finishPaste();
+    return true;
+  }
+
+  paste_time = input_time;
+
+  // only plain text is collected, control keys are ignored
+  TermKeyKey keyn = Keys::refineKey(key);
+  if (keyn.type != TERMKEY_TYPE_UNICODE)
+    return true;
+  if (!keyn.modifiers)
+    paste_buffer.append(keyn.utf8);
+  else if (keyn.modifiers == TERMKEY_KEYMOD_CTRL
+      && keyn.code.codepoint == 'j') {
+    // line feed, some terminals don't translate it to carriage return
+    paste_buffer.append("\n");
+  }
+
+  /* Don't let the buffer grow without bounds, the text is split only
+   * between characters. */
+  if (paste_buffer.size() >= PASTE_MAX_BYTES)
+    flushPaste();
+  return true;
+}
+
+void CoreManager::flushPaste()
+{
+  /* Deliver the collected text as a single block, it's silently dropped if
+   * there is no widget that can take it. */
+  if (!paste_buffer.empty())
+    processPaste(paste_buffer.data(), paste_buffer.size());
+  paste_buffer.clear();
+}
+
+void CoreManager::finishPaste()
+{
+  paste_active = false;
+  paste_timeout_conn.disconnect();
+  flushPaste();
+  // release the memory, pastes can be large
+  std::string().swap(paste_buffer);
+}
+
+void CoreManager::onPasteTimeout()
+{
+  if (!paste_active)
+    return;
+
+  gint64 idle = (getMonotonicTime() - paste_time) / 1000;
+  if (idle >= PASTE_TIMEOUT) {
+    // the end of the paste was lost
+    finishPaste();
+    return;
+  }
+
+  paste_timeout_conn = timeoutOnceConnect(sigc::mem_fun(this,
+        &CoreManager::onPasteTimeout), PASTE_TIMEOUT - idle,
+      G_PRIORITY_DEFAULT, "paste-timeout");
+}
+
 gboolean CoreManager::resize_input(GIOChannel *source, GIOCondition /*cond*/)
 {
   char buf[1024];
@@ -435,14 +670,40 @@ gboolean CoreManager::resize_input(GIOChannel *source, GIOCondition /*cond*/)
 
 void CoreManager::initInput()
 {
+  if (Curses::get_backend() == Curses::BACKEND_HEADLESS) {
+    /* There is no terminal to read from, input can be only pushed by
+     * pushInput(). */
+    TERMKEY_CHECK_VERSION;
+    if (!(tk = termkey_new(-1, TERMKEY_FLAG_NOTERMIOS | TERMKEY_FLAG_UTF8))) {
+      g_critical(_("Libtermkey initialization failed."));
+      exit(1);
+    }
+    termkey_set_canonflags(tk, TERMKEY_CANON_DELBS);
+    initResizePipe();
+    return;
+  }
+
+  /* If the user charset isn't UTF-8 then the input is converted to UTF-8
+   * before it is passed to libtermkey. One converter is kept for the whole
+   * session so partial and stateful sequences are handled correctly. */
+  int flags = TERMKEY_FLAG_NOTERMIOS;
+  const char *charset;
+  if (!g_get_charset(&charset)) {
+    input_iconv = g_iconv_open("UTF-8", charset);
+    if (input_iconv != reinterpret_cast<GIConv>(-1))
+      flags |= TERMKEY_FLAG_UTF8;
+    else
+      g_warning(_("Conversion of input from charset %s to UTF-8 is not "
+            "supported."), charset);
+  }
+
   // init libtermkey
   TERMKEY_CHECK_VERSION;
-  if (!(tk = termkey_new(STDIN_FILENO, TERMKEY_FLAG_NOTERMIOS))) {
+  if (!(tk = termkey_new(STDIN_FILENO, flags))) {
     g_critical(_("Libtermkey initialization failed."));
     exit(1);
   }
   termkey_set_canonflags(tk, TERMKEY_CANON_DELBS);
-  utf8 = g_get_charset(NULL);
 
   io_input_channel = g_io_channel_unix_new(STDIN_FILENO);
   // set channel encoding to NULL so it can be unbuffered
@@ -457,6 +718,11 @@ void CoreManager::initInput()
       io_input_error_, this, NULL);
   g_io_channel_unref(io_input_channel);
 
+  initResizePipe();
+}
+
+void CoreManager::initResizePipe()
+{
   // screen resizing
   if (!pipe(pipefd)) {
     pipe_valid = true;
@@ -475,10 +741,17 @@ void CoreManager::finalizeInput()
   termkey_destroy(tk);
   tk = NULL;
 
-  g_source_remove(io_input_channel_id);
-  io_input_channel_id = 0;
-  g_io_channel_unref(io_input_channel);
-  io_input_channel = NULL;
+  if (input_iconv != reinterpret_cast<GIConv>(-1)) {
+    g_iconv_close(input_iconv);
+    input_iconv = reinterpret_cast<GIConv>(-1);
+  }
+
+  if (io_input_channel_id) {
+    g_source_remove(io_input_channel_id);
+    io_input_channel_id = 0;
+    g_io_channel_unref(io_input_channel);
+    io_input_channel = NULL;
+  }
 
   if (pipe_valid) {
     g_source_remove(resize_channel_id);
@@ -502,7 +775,11 @@ void CoreManager::resize()
 
   resize_pending = false;
 
-  if (ioctl(fileno(stdout), TIOCGWINSZ, &size) >= 0) {
+  if (Curses::get_backend() == Curses::BACKEND_HEADLESS) {
+    // the size was set by Curses::resizeterm()
+    Curses::clear();
+  }
+  else if (ioctl(fileno(stdout), TIOCGWINSZ, &size) >= 0) {
     Curses::resizeterm(size.ws_row, size.ws_col);
 
     // make sure everything is redrawn from the scratch
@@ -542,12 +819,23 @@ void CoreManager::draw()
   // copy virtual ncurses screen to the physical screen
   Curses::doupdate();
 
+  gint64 now = getMonotonicTime();
+  if (pending_keys.empty())
+    background_latency.add(now - redraw_time);
+  else {
+    for (PendingKeys::iterator i = pending_keys.begin();
+        i != pending_keys.end(); i++)
+      input_latencies[i->context].add(now - i->time);
+    pending_keys.clear();
+  }
+
 #if defined(DEBUG) && GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 28
   const Curses::Stats *stats = Curses::get_stats();
   gint64 tdiff = g_get_monotonic_time() - t1;
   g_debug("redraw: time=%"G_GINT64_FORMAT"us, newpad/newwin/subpad "
-      "calls=%u/%u/%u", tdiff, stats->newpad_calls, stats->newwin_calls,
-      stats->subpad_calls);
+      "calls=%u/%u/%u, emitted cells/bytes=%u/%u", tdiff,
+      stats->newpad_calls, stats->newwin_calls, stats->subpad_calls,
+      stats->cells_emitted, stats->bytes_emitted);
 #endif // defined(DEBUG) && GLIB_VERSION >= 2.28
 
   redraw_pending = false;
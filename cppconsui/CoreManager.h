@@ -30,9 +30,12 @@
 #define __COREMANAGER_H__
 
 #include "FreeWindow.h"
+#include "LatencyHistogram.h"
 
 #include "libtermkey/termkey.h"
 #include <glib.h>
+#include <map>
+#include <string>
 #include <vector>
 
 namespace CppConsUI
@@ -50,6 +53,23 @@ class CoreManager
 : public InputProcessor
 {
 public:
+  /**
+   * Function that is called after each timeout or input callback dispatched
+   * by CoreManager. The name identifies the callback, usecs is the time that
+   * the callback took in microseconds.
+   */
+  typedef void (*DispatchHook)(const char *name, gint64 usecs);
+  /**
+   * Function that is called with raw bytes read from the terminal before
+   * they are processed.
+   */
+  typedef void (*InputHook)(const char *bytes, size_t len);
+
+  /**
+   * Latency histograms indexed by interned names of input contexts.
+   */
+  typedef std::map<const char*, LatencyHistogram> LatencyHistograms;
+
   static CoreManager *instance();
 
   /**
@@ -77,10 +97,45 @@ public:
 
   void redraw();
 
+  /**
+   * Connects a slot to a timeout. The optional name (a static string)
+   * identifies the timeout for the dispatch hook.
+   */
   sigc::connection timeoutConnect(const sigc::slot<bool>& slot,
-      unsigned interval, int priority = G_PRIORITY_DEFAULT);
+      unsigned interval, int priority = G_PRIORITY_DEFAULT,
+      const char *name = NULL);
   sigc::connection timeoutOnceConnect(const sigc::slot<void>& slot,
-      unsigned interval, int priority = G_PRIORITY_DEFAULT);
+      unsigned interval, int priority = G_PRIORITY_DEFAULT,
+      const char *name = NULL);
+
+  void setDispatchHook(DispatchHook hook) { dispatch_hook = hook; }
+  DispatchHook getDispatchHook() const { return dispatch_hook; }
+  void setInputHook(InputHook hook) { input_hook = hook; }
+  static gint64 getMonotonicTime();
+
+  /**
+   * Returns histograms of times from reading a key to the completion of the
+   * screen update that shows its effect. The histograms are indexed by the
+   * key binding context that handled the key, "text" for text input and
+   * "paste" for bracketed pastes. Keys that don't cause a screen update are
+   * not counted.
+   */
+  const LatencyHistograms& getInputLatencies() const
+    { return input_latencies; }
+  /**
+   * Returns a histogram of times from a redraw request to the completion of
+   * the screen update for updates that were not caused by input.
+   */
+  const LatencyHistogram& getBackgroundLatency() const
+    { return background_latency; }
+  void resetLatencies();
+
+  /**
+   * Processes terminal input as if it was read from the standard input. The
+   * bytes have to be in UTF-8 and contain only complete key sequences. This
+   * is the only source of input when the headless Curses backend is used.
+   */
+  void pushInput(const char *bytes, size_t len);
 
   TermKey *getTermKeyHandle() { return tk; };
 
@@ -105,13 +160,50 @@ private:
   bool pipe_valid;
 
   TermKey *tk;
-  bool utf8;
+
+  /**
+   * Converter from the user charset to UTF-8, (GIConv)-1 if the charset is
+   * UTF-8 and input is read directly by libtermkey.
+   */
+  GIConv input_iconv;
+  // incomplete multibyte sequence left at the end of the previous read
+  char input_partial[16];
+  size_t input_partial_bytes;
+
+  // true while a bracketed paste is being received
+  bool paste_active;
+  // text of the current bracketed paste in UTF-8
+  std::string paste_buffer;
+  // time when the last key of the current paste was read
+  gint64 paste_time;
+  sigc::connection paste_timeout_conn;
 
   GMainLoop *gmainloop;
 
   bool redraw_pending;
   bool resize_pending;
 
+  DispatchHook dispatch_hook;
+  InputHook input_hook;
+
+  struct PendingKey
+  {
+    // interned name of the context that handled the key
+    const char *context;
+    // time when the key was read
+    gint64 time;
+  };
+  typedef std::vector<PendingKey> PendingKeys;
+
+  // handled keys waiting for the screen update
+  PendingKeys pending_keys;
+  // time when the input that is being processed was read
+  gint64 input_time;
+  // time of the first redraw request since the last screen update
+  gint64 redraw_time;
+  LatencyHistograms input_latencies;
+  LatencyHistogram background_latency;
+
   static CoreManager *my_instance;
 
   CoreManager();
@@ -126,6 +218,7 @@ private:
 
   // InputProcessor
   virtual bool processInput(const TermKeyKey& key);
+  virtual bool processPaste(const char *text, size_t bytes);
 
   // glib IO callbacks
   /**
@@ -144,10 +237,34 @@ private:
    * InputProcessor.
    */
   static gboolean io_input_(GIOChannel *source, GIOCondition cond,
-      gpointer data)
-    { return reinterpret_cast<CoreManager*>(data)->io_input(source, cond); }
+      gpointer data);
   gboolean io_input(GIOChannel *source, GIOCondition cond);
   void io_input_timeout();
+  /**
+   * Reads data from the standard input, converts them from the user charset
+   * to UTF-8 and passes them to libtermkey.
+   */
+  void readConvertedInput();
+  /**
+   * Reads data from the standard input, passes them to the input hook and
+   * then to libtermkey.
+   */
+  void readRawInput();
+  /**
+   * Handles a key received during a bracketed paste. Returns false if the
+   * key doesn't belong to a paste and should be processed normally.
+   */
+  bool processPasteKey(const TermKeyKey& key);
+  // hands the collected text of the current paste over to the widgets
+  void flushPaste();
+  // leaves the paste mode
+  void finishPaste();
+  void onPasteTimeout();
+  /**
+   * Processes one key and remembers it for latency measurement if it caused
+   * a screen update.
+   */
+  void dispatchKey(const TermKeyKey& key);
 
   static gboolean resize_input_(GIOChannel *source, GIOCondition cond,
       gpointer data)
@@ -156,6 +273,7 @@ private:
   gboolean resize_input(GIOChannel *source, GIOCondition cond);
 
   void initInput();
+  void initResizePipe();
   void finalizeInput();
 
   static void signalHandler(int signum);
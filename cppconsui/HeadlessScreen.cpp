@@ -0,0 +1,486 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * @file
+ * In-memory terminal used by the headless curses backend.
+ *
+ * @ingroup cppconsui
+ */
+
+#include "HeadlessScreen.h"
+
+#ifndef _XOPEN_SOURCE_EXTENDED
+#define _XOPEN_SOURCE_EXTENDED
+#endif
+
+#define NCURSES_NOMACROS
+#include <cursesw.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_COLS 80
+#define DEFAULT_LINES 24
+#define COLORS_NUM 256
+#define COLOR_PAIRS_NUM 256
+
+namespace CppConsUI
+{
+
+namespace Curses
+{
+
+namespace Headless
+{
+
+static Window *stdscr_win = NULL;
+/* The virtual screen contains what should be displayed, the physical screen
+ * what the terminal displays after the last doupdate(). */
+static Cell *virtual_screen = NULL;
+static Cell *physical_screen = NULL;
+static int screen_cols = 0;
+static int screen_lines = 0;
+// the terminal has to be cleared by the next doupdate()
+static bool clear_pending = false;
+
+static short pair_fg[COLOR_PAIRS_NUM];
+static short pair_bg[COLOR_PAIRS_NUM];
+
+static void blank_cells(Cell *cells, int n)
+{
+  for (int i = 0; i < n; i++) {
+    cells[i].uc = ' ';
+    cells[i].attrs = 0;
+  }
+}
+
+static bool is_blank(const Cell& cell)
+{
+  return cell.uc == ' ' && !cell.attrs;
+}
+
+static void alloc_screens(int ncols, int nlines)
+{
+  delete [] virtual_screen;
+  delete [] physical_screen;
+
+  screen_cols = ncols;
+  screen_lines = nlines;
+  virtual_screen = new Cell[ncols * nlines];
+  physical_screen = new Cell[ncols * nlines];
+  blank_cells(virtual_screen, ncols * nlines);
+  blank_cells(physical_screen, ncols * nlines);
+}
+
+/* Returns a number of bytes of the escape sequence that a terminal would
+ * need to move the cursor to a given position. */
+static int cursor_move_length(int x, int y)
+{
+  char buf[32];
+  return g_snprintf(buf, sizeof(buf), "\033[%d;%dH", y + 1, x + 1);
+}
+
+/* Returns a number of bytes of the escape sequence that a terminal would
+ * need to switch to given attributes. */
+static int attrs_length(int attrs)
+{
+  char buf[64];
+  int len = g_snprintf(buf, sizeof(buf), "\033[0%s%s%s%s",
+      attrs & A_BOLD ? ";1" : "", attrs & A_DIM ? ";2" : "",
+      attrs & A_BLINK ? ";5" : "",
+      attrs & (A_REVERSE | A_STANDOUT) ? ";7" : "");
+
+  int pair = PAIR_NUMBER(attrs);
+  if (pair > 0 && pair < COLOR_PAIRS_NUM) {
+    if (pair_fg[pair] >= 0)
+      len += g_snprintf(buf, sizeof(buf), ";38;5;%d", pair_fg[pair]);
+    if (pair_bg[pair] >= 0)
+      len += g_snprintf(buf, sizeof(buf), ";48;5;%d", pair_bg[pair]);
+  }
+
+  // the final 'm'
+  return len + 1;
+}
+
+Window *Window::newpad(int ncols, int nlines)
+{
+  if (ncols <= 0 || nlines <= 0)
+    return NULL;
+
+  Grid *grid = new Grid;
+  grid->cells = new Cell[ncols * nlines];
+  grid->cols = ncols;
+  grid->lines = nlines;
+  grid->refs = 0;
+  blank_cells(grid->cells, ncols * nlines);
+
+  return new Window(grid, 0, 0, ncols, nlines, 0, 0, true);
+}
+
+Window *Window::newwin(int begin_x, int begin_y, int ncols, int nlines)
+{
+  if (begin_x < 0 || begin_y < 0 || begin_x >= screen_cols
+      || begin_y >= screen_lines)
+    return NULL;
+
+  // zero size extends the window to the edge of the screen as in curses
+  if (!ncols)
+    ncols = screen_cols - begin_x;
+  if (!nlines)
+    nlines = screen_lines - begin_y;
+
+  Window *win = newpad(ncols, nlines);
+  if (!win)
+    return NULL;
+
+  win->begin_x = begin_x;
+  win->begin_y = begin_y;
+  win->pad = false;
+  return win;
+}
+
+Window *Window::subpad(int begin_x, int begin_y, int ncols, int nlines)
+{
+  if (begin_x < 0 || begin_y < 0 || ncols <= 0 || nlines <= 0
+      || begin_x + ncols > cols || begin_y + nlines > lines)
+    return NULL;
+
+  return new Window(grid, off_x + begin_x, off_y + begin_y, ncols, nlines,
+      0, 0, true);
+}
+
+Window::~Window()
+{
+  if (--grid->refs)
+    return;
+
+  delete [] grid->cells;
+  delete grid;
+}
+
+int Window::addChar(gunichar uc, int width)
+{
+  if (cur_x < 0 || cur_y < 0 || cur_y >= lines || width > cols)
+    return ERR;
+
+  if (cur_x + width > cols) {
+    // the character doesn't fit, blank the rest of the line and wrap
+    for (; cur_x < cols; cur_x++) {
+      Cell *cell = getCell(cur_x, cur_y);
+      cell->uc = ' ';
+      cell->attrs = attrs;
+    }
+    cur_x = 0;
+    if (++cur_y >= lines)
+      return ERR;
+  }
+
+  Cell *cell = getCell(cur_x, cur_y);
+  cell->uc = uc;
+  cell->attrs = attrs;
+  // the rest of a wide character is covered by the first cell
+  for (int i = 1; i < width; i++) {
+    cell[i].uc = 0;
+    cell[i].attrs = attrs;
+  }
+
+  cur_x += width;
+  if (cur_x >= cols) {
+    cur_x = 0;
+    cur_y++;
+  }
+  return OK;
+}
+
+int Window::changeAttrs(int x, int y, int n, int attrs_)
+{
+  if (x < 0 || y < 0 || x >= cols || y >= lines)
+    return ERR;
+
+  // a negative count changes the rest of the line
+  if (n < 0 || n > cols - x)
+    n = cols - x;
+
+  Cell *cell = getCell(x, y);
+  for (int i = 0; i < n; i++)
+    cell[i].attrs = attrs_;
+  return OK;
+}
+
+int Window::fill(int attrs_, int x, int y, int w, int h)
+{
+  int a = attrs | attrs_;
+  for (int j = MAX(0, y); j < lines && j < y + h; j++)
+    for (int i = MAX(0, x); i < cols && i < x + w; i++) {
+      Cell *cell = getCell(i, j);
+      cell->uc = ' ';
+      cell->attrs = a;
+    }
+  return OK;
+}
+
+int Window::erase()
+{
+  for (int j = 0; j < lines; j++)
+    blank_cells(getCell(0, j), cols);
+  cur_x = cur_y = 0;
+  return OK;
+}
+
+int Window::noutrefresh()
+{
+  // pads are not tied to the screen
+  if (pad)
+    return ERR;
+
+  int w = MIN(cols, screen_cols - begin_x);
+  if (w <= 0)
+    return OK;
+  for (int j = 0; j < lines && begin_y + j < screen_lines; j++)
+    memcpy(virtual_screen + (begin_y + j) * screen_cols + begin_x,
+        getCell(0, j), w * sizeof(Cell));
+  return OK;
+}
+
+int Window::copyto(Window *dstwin, int smincol, int sminrow, int dmincol,
+    int dminrow, int dmaxcol, int dmaxrow, int overlay)
+{
+  g_assert(dstwin);
+
+  // the rectangle is clipped to both windows
+  for (int dy = MAX(0, dminrow); dy <= dmaxrow && dy < dstwin->lines;
+      dy++) {
+    int sy = sminrow + dy - dminrow;
+    if (sy < 0 || sy >= lines)
+      continue;
+    for (int dx = MAX(0, dmincol); dx <= dmaxcol && dx < dstwin->cols;
+        dx++) {
+      int sx = smincol + dx - dmincol;
+      if (sx < 0 || sx >= cols)
+        continue;
+      const Cell *src = getCell(sx, sy);
+      if (overlay && is_blank(*src))
+        continue;
+      *dstwin->getCell(dx, dy) = *src;
+    }
+  }
+  return OK;
+}
+
+Window::Window(Grid *grid_, int off_x_, int off_y_, int ncols, int nlines,
+    int begin_x_, int begin_y_, bool pad_)
+: grid(grid_), off_x(off_x_), off_y(off_y_), cols(ncols), lines(nlines)
+, begin_x(begin_x_), begin_y(begin_y_), pad(pad_), cur_x(0), cur_y(0)
+, attrs(0)
+{
+  grid->refs++;
+}
+
+int init_screen()
+{
+  int ncols = DEFAULT_COLS;
+  int nlines = DEFAULT_LINES;
+
+  // honor the usual environment variables so the size can be chosen
+  const char *env;
+  if ((env = g_getenv("COLUMNS")) && atoi(env) > 0)
+    ncols = atoi(env);
+  if ((env = g_getenv("LINES")) && atoi(env) > 0)
+    nlines = atoi(env);
+
+  for (int i = 0; i < COLOR_PAIRS_NUM; i++)
+    pair_fg[i] = pair_bg[i] = -1;
+
+  alloc_screens(ncols, nlines);
+  stdscr_win = Window::newwin(0, 0, ncols, nlines);
+  clear_pending = true;
+  return OK;
+}
+
+int finalize_screen()
+{
+  delete stdscr_win;
+  stdscr_win = NULL;
+
+  delete [] virtual_screen;
+  virtual_screen = NULL;
+  delete [] physical_screen;
+  physical_screen = NULL;
+  screen_cols = screen_lines = 0;
+  return OK;
+}
+
+bool init_colorpair(int idx, int fg, int bg)
+{
+  if (idx <= 0 || idx >= COLOR_PAIRS_NUM || fg >= COLORS_NUM
+      || bg >= COLORS_NUM)
+    return false;
+
+  pair_fg[idx] = fg;
+  pair_bg[idx] = bg;
+  return true;
+}
+
+int nrcolors()
+{
+  return COLORS_NUM;
+}
+
+int nrcolorpairs()
+{
+  return COLOR_PAIRS_NUM;
+}
+
+bool colorpair_content(int idx, int *fg, int *bg)
+{
+  if (idx < 0 || idx >= COLOR_PAIRS_NUM)
+    return false;
+
+  *fg = pair_fg[idx];
+  *bg = pair_bg[idx];
+  return true;
+}
+
+int erase()
+{
+  return stdscr_win->erase();
+}
+
+int clear()
+{
+  clear_pending = true;
+  return stdscr_win->erase();
+}
+
+int doupdate(Stats *stats)
+{
+  if (clear_pending) {
+    // the terminal is cleared and everything is painted again
+    stats->bytes_emitted += strlen("\033[H\033[2J");
+    blank_cells(physical_screen, screen_cols * screen_lines);
+    clear_pending = false;
+  }
+
+  // the cursor position and attributes of the terminal are unknown
+  int term_x = -1;
+  int term_y = -1;
+  int term_attrs = -1;
+  for (int y = 0; y < screen_lines; y++) {
+    Cell *vline = virtual_screen + y * screen_cols;
+    Cell *pline = physical_screen + y * screen_cols;
+    for (int x = 0; x < screen_cols; x++) {
+      if (vline[x].uc == pline[x].uc && vline[x].attrs == pline[x].attrs)
+        continue;
+
+      // repaint a whole wide character if only its end changed
+      int start = x;
+      if (!vline[x].uc && x > 0)
+        start = x - 1;
+      int end = start + 1;
+      while (end < screen_cols && !vline[end].uc)
+        end++;
+
+      if (start != term_x || y != term_y)
+        stats->bytes_emitted += cursor_move_length(start, y);
+      if (vline[start].attrs != term_attrs) {
+        term_attrs = vline[start].attrs;
+        stats->bytes_emitted += attrs_length(term_attrs);
+      }
+
+      gunichar uc = vline[start].uc ? vline[start].uc : ' ';
+      stats->bytes_emitted += g_unichar_to_utf8(uc, NULL);
+      stats->cells_emitted += end - start;
+
+      memcpy(pline + start, vline + start, (end - start) * sizeof(Cell));
+      term_x = end;
+      term_y = y;
+      x = end - 1;
+    }
+  }
+  return OK;
+}
+
+int noutrefresh()
+{
+  return stdscr_win->noutrefresh();
+}
+
+int getmaxx()
+{
+  return screen_cols;
+}
+
+int getmaxy()
+{
+  return screen_lines;
+}
+
+int resizeterm(int lines, int columns)
+{
+  if (lines <= 0 || columns <= 0)
+    return ERR;
+
+  if (lines == screen_lines && columns == screen_cols)
+    return OK;
+
+  delete stdscr_win;
+  alloc_screens(columns, lines);
+  stdscr_win = Window::newwin(0, 0, columns, lines);
+  clear_pending = true;
+  return OK;
+}
+
+bool get_cell(int x, int y, Cell *cell)
+{
+  if (x < 0 || y < 0 || x >= screen_cols || y >= screen_lines)
+    return false;
+
+  *cell = physical_screen[y * screen_cols + x];
+  return true;
+}
+
+char *get_snapshot()
+{
+  GString *res = g_string_sized_new(screen_lines * (screen_cols + 1));
+  for (int y = 0; y < screen_lines; y++) {
+    const Cell *line = physical_screen + y * screen_cols;
+    for (int x = 0; x < screen_cols; x++) {
+      if (line[x].uc)
+        g_string_append_unichar(res, line[x].uc);
+      else if (!x || !line[x - 1].uc
+          || !g_unichar_iswide(line[x - 1].uc)) {
+        // an orphaned end of an overwritten wide character
+        g_string_append_c(res, ' ');
+      }
+    }
+    g_string_append_c(res, '\n');
+  }
+  return g_string_free(res, FALSE);
+}
+
+} // namespace Headless
+
+} // namespace Curses
+
+} // namespace CppConsUI
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
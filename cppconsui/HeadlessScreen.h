@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * @file
+ * In-memory terminal used by the headless curses backend.
+ *
+ * @ingroup cppconsui
+ */
+
+#ifndef __HEADLESSSCREEN_H__
+#define __HEADLESSSCREEN_H__
+
+#include "ConsUICurses.h"
+
+#include <glib.h>
+
+namespace CppConsUI
+{
+
+namespace Curses
+{
+
+/**
+ * Headless implementation of the curses functions. It mimics the ncurses
+ * model: windows are copied to a virtual screen by noutrefresh() and
+ * doupdate() transfers the differences to a physical screen. Nothing is
+ * written to the terminal, the physical screen is only kept in memory and
+ * the amount of output that a real terminal would receive is counted.
+ */
+namespace Headless
+{
+
+class Window
+{
+public:
+  // these functions return NULL if such pad/window can not be created
+  static Window *newpad(int ncols, int nlines);
+  static Window *newwin(int begin_x, int begin_y, int ncols, int nlines);
+
+  Window *subpad(int begin_x, int begin_y, int ncols, int nlines);
+
+  ~Window();
+
+  void move(int x, int y) { cur_x = x; cur_y = y; }
+  /**
+   * Writes a character that occupies width cells at the cursor position
+   * and advances the cursor. Wraps to the next line as curses does.
+   */
+  int addChar(gunichar uc, int width);
+
+  void attrOn(int attrs_) { attrs |= attrs_; }
+  void attrOff(int attrs_) { attrs &= ~attrs_; }
+  int changeAttrs(int x, int y, int n, int attrs_);
+
+  int fill(int attrs_, int x, int y, int w, int h);
+  int erase();
+
+  int noutrefresh();
+
+  int copyto(Window *dstwin, int smincol, int sminrow, int dmincol,
+      int dminrow, int dmaxcol, int dmaxrow, int overlay);
+
+  int getmaxx() const { return cols; }
+  int getmaxy() const { return lines; }
+
+protected:
+  /**
+   * Cell storage shared by a pad and all its subpads.
+   */
+  struct Grid
+  {
+    Cell *cells;
+    int cols;
+    int lines;
+    int refs;
+  };
+
+  Grid *grid;
+  // position of the window in the grid
+  int off_x, off_y;
+  int cols, lines;
+  // position of the window on the screen, windows only
+  int begin_x, begin_y;
+  bool pad;
+
+  int cur_x, cur_y;
+  int attrs;
+
+  Cell *getCell(int x, int y)
+    { return grid->cells + (off_y + y) * grid->cols + off_x + x; }
+
+private:
+  Window(Grid *grid_, int off_x_, int off_y_, int ncols, int nlines,
+      int begin_x_, int begin_y_, bool pad_);
+  Window(const Window&);
+  Window& operator=(const Window&);
+};
+
+int init_screen();
+int finalize_screen();
+
+bool init_colorpair(int idx, int fg, int bg);
+int nrcolors();
+int nrcolorpairs();
+bool colorpair_content(int idx, int *fg, int *bg);
+
+int erase();
+int clear();
+int doupdate(Stats *stats);
+
+// stdscr
+int noutrefresh();
+int getmaxx();
+int getmaxy();
+
+int resizeterm(int lines, int columns);
+
+bool get_cell(int x, int y, Cell *cell);
+char *get_snapshot();
+
+} // namespace Headless
+
+} // namespace Curses
+
+} // namespace CppConsUI
+
+#endif // __HEADLESSSCREEN_H__
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -31,11 +31,19 @@
 namespace CppConsUI
 {
 
+const char *InputProcessor::processed_context = NULL;
+
 InputProcessor::InputProcessor()
-: input_child(NULL)
+: dispatch_table(NULL), dispatch_generation(0), input_child(NULL)
 {
 }
 
+InputProcessor::~InputProcessor()
+{
+  if (dispatch_table)
+    g_hash_table_destroy(dispatch_table);
+}
+
 bool InputProcessor::processInput(const TermKeyKey& key)
 {
   // process overriding key combinations first
@@ -52,8 +60,24 @@ bool InputProcessor::processInput(const TermKeyKey& key)
 
   // do non-combo input processing
   TermKeyKey keyn = Keys::refineKey(key);
-  if (keyn.type == TERMKEY_TYPE_UNICODE && processInputText(keyn))
+  if (keyn.type == TERMKEY_TYPE_UNICODE && processInputText(keyn)) {
+    processed_context = g_intern_static_string("text");
     return true;
+  }
+
+  return false;
+}
+
+bool InputProcessor::processPaste(const char *text, size_t bytes)
+{
+  // hand of the text to a child
+  if (input_child && input_child->processPaste(text, bytes))
+    return true;
+
+  if (processPasteText(text, bytes)) {
+    processed_context = g_intern_static_string("paste");
+    return true;
+  }
 
   return false;
 }
@@ -72,10 +96,54 @@ void InputProcessor::declareBindable(const char *context, const char *action,
     const sigc::slot<void>& function, BindableType type)
 {
   keybindings[context][action] = Bindable(function, type);
+
+  // the dispatch table has to be recompiled
+  dispatch_generation = 0;
 }
 
 bool InputProcessor::process(BindableType type, const TermKeyKey& key)
 {
+  if (keybindings.empty())
+    return false;
+
+  if (dispatch_generation != KEYCONFIG->getGeneration())
+    compileDispatchTable();
+
+  guint64 packed = Keys::packKey(key);
+  DispatchEntry *entry = static_cast<DispatchEntry*>(
+      g_hash_table_lookup(dispatch_table, &packed));
+  if (!entry || !entry->bindables[type])
+    return false;
+
+  /* Set the context before calling the function, it can destroy this
+   * object. */
+  processed_context = entry->contexts[type];
+  entry->bindables[type]->function();
+  return true;
+}
+
+bool InputProcessor::processInputText(const TermKeyKey& /*key*/)
+{
+  return false;
+}
+
+bool InputProcessor::processPasteText(const char * /*text*/,
+    size_t /*bytes*/)
+{
+  return false;
+}
+
+void InputProcessor::compileDispatchTable()
+{
+  if (dispatch_table)
+    g_hash_table_remove_all(dispatch_table);
+  else
+    dispatch_table = g_hash_table_new_full(dispatch_key_hash,
+        dispatch_key_equal, NULL, dispatch_entry_destroy);
+
+  /* Contexts are walked in the same order as the key binds used to be
+   * searched, so when several contexts bind the same key the first one
+   * still wins. */
   for (Bindables::iterator i = keybindings.begin(); i != keybindings.end();
       i++) {
     // get keys for this context
@@ -83,23 +151,51 @@ bool InputProcessor::process(BindableType type, const TermKeyKey& key)
       = KEYCONFIG->getKeyBinds(i->first.c_str());
     if (!keys)
       continue;
-    KeyConfig::KeyBindContext::const_iterator j = keys->find(key);
-    if (j == keys->end())
-      continue;
 
-    BindableContext::iterator k = i->second.find(j->second);
-    if (k != i->second.end() && k->second.type == type) {
-      k->second.function();
-      return true;
+    for (KeyConfig::KeyBindContext::const_iterator j = keys->begin();
+        j != keys->end(); j++) {
+      BindableContext::iterator k = i->second.find(j->second);
+      if (k == i->second.end())
+        continue;
+
+      guint64 packed = Keys::packKey(j->first);
+      DispatchEntry *entry = static_cast<DispatchEntry*>(
+          g_hash_table_lookup(dispatch_table, &packed));
+      if (!entry) {
+        entry = new DispatchEntry;
+        entry->key = packed;
+        entry->bindables[BINDABLE_NORMAL] = NULL;
+        entry->bindables[BINDABLE_OVERRIDE] = NULL;
+        entry->contexts[BINDABLE_NORMAL] = NULL;
+        entry->contexts[BINDABLE_OVERRIDE] = NULL;
+        g_hash_table_insert(dispatch_table, &entry->key, entry);
+      }
+
+      if (!entry->bindables[k->second.type]) {
+        entry->bindables[k->second.type] = &k->second;
+        entry->contexts[k->second.type] = g_intern_string(i->first.c_str());
+      }
     }
   }
 
-  return false;
+  dispatch_generation = KEYCONFIG->getGeneration();
 }
 
-bool InputProcessor::processInputText(const TermKeyKey& /*key*/)
+guint InputProcessor::dispatch_key_hash(gconstpointer key)
 {
-  return false;
+  guint64 packed = *static_cast<const guint64*>(key);
+  return static_cast<guint>(packed ^ (packed >> 32));
+}
+
+gboolean InputProcessor::dispatch_key_equal(gconstpointer a,
+    gconstpointer b)
+{
+  return *static_cast<const guint64*>(a) == *static_cast<const guint64*>(b);
+}
+
+void InputProcessor::dispatch_entry_destroy(gpointer data)
+{
+  delete static_cast<DispatchEntry*>(data);
 }
 
 } // namespace CppConsUI
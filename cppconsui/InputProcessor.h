@@ -33,6 +33,7 @@
 
 #include "libtermkey/termkey.h"
 
+#include <glib.h>
 #include <map>
 #include <string>
 
@@ -65,7 +66,7 @@ public:
   };
 
   InputProcessor();
-  virtual ~InputProcessor() {}
+  virtual ~InputProcessor();
 
   /**
    * There are 4 steps when processing input:
@@ -96,6 +97,15 @@ public:
    */
   virtual bool processInput(const TermKeyKey& key);
 
+  /**
+   * Processes a block of text pasted by the user (in UTF-8) at once. The text
+   * is handed to the input child first and then to processPasteText(). Key
+   * bindings are not considered.
+   *
+   * @return True if the text was accepted, false otherwise.
+   */
+  virtual bool processPaste(const char *text, size_t bytes);
+
 protected:
   /**
    * Bindable struct holds a function and a bindable type that is associated
@@ -129,6 +139,38 @@ protected:
    */
   Bindables keybindings;
 
+  /**
+   * Compiled key bindings of one key.
+   */
+  struct DispatchEntry
+  {
+    // packed key, see Keys::packKey()
+    guint64 key;
+    // matching Bindables indexed by BindableType, NULL if there is none
+    Bindable *bindables[2];
+    // interned names of contexts of the Bindables
+    const char *contexts[2];
+  };
+
+  /**
+   * Maps packed keys to DispatchEntries, {key: DispatchEntry}. The table is
+   * compiled from the declared Bindables and the KeyConfig binds so that
+   * processing a key takes a single lookup.
+   */
+  GHashTable *dispatch_table;
+  /**
+   * KeyConfig generation the dispatch table was compiled for, zero if the
+   * table needs to be recompiled.
+   */
+  guint dispatch_generation;
+
+  /**
+   * Interned name of the context of the last Bindable that was triggered,
+   * "text" or "paste" if the last input was accepted as text. It is never
+   * reset by InputProcessor itself.
+   */
+  static const char *processed_context;
+
   /**
    * The child that will get to process the input.
    */
@@ -157,6 +199,17 @@ protected:
   virtual bool process(BindableType type, const TermKeyKey& key);
 
   virtual bool processInputText(const TermKeyKey& key);
+  virtual bool processPasteText(const char *text, size_t bytes);
+
+  /**
+   * Rebuilds the dispatch table from the declared Bindables and the current
+   * key binds.
+   */
+  virtual void compileDispatchTable();
+
+  static guint dispatch_key_hash(gconstpointer key);
+  static gboolean dispatch_key_equal(gconstpointer a, gconstpointer b);
+  static void dispatch_entry_destroy(gpointer data);
 
 private:
   InputProcessor(const InputProcessor&);
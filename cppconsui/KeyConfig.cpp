@@ -51,6 +51,7 @@ bool KeyConfig::bindKey(const char *context, const char *action,
     return false;
 
   binds[context][tkey] = action;
+  bindsChanged();
   return true;
 }
 
@@ -103,6 +104,7 @@ bool KeyConfig::stringToTermKey(const char *key, TermKeyKey *termkey) const
 void KeyConfig::clear()
 {
   binds.clear();
+  bindsChanged();
 }
 
 void KeyConfig::loadDefaultKeyConfig()
@@ -127,6 +129,14 @@ void KeyConfig::loadDefaultKeyConfig()
 
   bindKey("coremanager", "redraw-screen", "Ctrl-l");
 
+  bindKey("listview", "cursor-up", "Up");
+  bindKey("listview", "cursor-down", "Down");
+  bindKey("listview", "cursor-page-up", "PageUp");
+  bindKey("listview", "cursor-page-down", "PageDown");
+  bindKey("listview", "cursor-begin", "Home");
+  bindKey("listview", "cursor-end", "End");
+  bindKey("listview", "activate", "Enter");
+
   bindKey("textentry", "cursor-right", "Right");
   bindKey("textentry", "cursor-left", "Left");
   bindKey("textentry", "cursor-down", "Down");
@@ -172,6 +182,13 @@ int KeyConfig::finalize()
   return 0;
 }
 
+void KeyConfig::bindsChanged()
+{
+  // zero is reserved for never compiled dispatch tables
+  if (!++generation)
+    generation++;
+}
+
 } // namespace CppConsUI
 
 /* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
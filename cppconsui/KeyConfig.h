@@ -100,6 +100,13 @@ public:
    */
   const char *getKeyBind(const char *context, const char *action) const;
 
+  /**
+   * Returns a non-zero number that changes every time the key binds are
+   * modified. Input processors use it to find out that their compiled
+   * dispatch tables are out of date.
+   */
+  guint getGeneration() const { return generation; }
+
   /**
    * Converts a TermKeyKey to its string representation.
    */
@@ -128,10 +135,11 @@ private:
    * Current key binds.
    */
   KeyBinds binds;
+  guint generation;
 
   static KeyConfig *my_instance;
 
-  KeyConfig() {}
+  KeyConfig() : generation(1) {}
   KeyConfig(const KeyConfig&);
   KeyConfig& operator=(const KeyConfig&);
   ~KeyConfig() {}
@@ -140,6 +148,8 @@ private:
   static int finalize();
   friend int initializeConsUI();
   friend int finalizeConsUI();
+
+  void bindsChanged();
 };
 
 } // namespace CppConsUI
@@ -60,6 +60,32 @@ TermKeyKey refineKey(const TermKeyKey& k)
   return res;
 }
 
+guint64 packKey(const TermKeyKey& k)
+{
+  TermKeyKey key = k;
+  termkey_canonicalise(COREMANAGER->getTermKeyHandle(), &key);
+
+  guint32 code = 0;
+  switch (key.type) {
+    case TERMKEY_TYPE_UNICODE:
+      code = key.code.codepoint;
+      break;
+    case TERMKEY_TYPE_FUNCTION:
+      code = key.code.number;
+      break;
+    case TERMKEY_TYPE_KEYSYM:
+      code = key.code.sym;
+      break;
+    case TERMKEY_TYPE_MOUSE:
+      memcpy(&code, key.code.mouse, sizeof(code));
+      break;
+  }
+
+  // | type (8 bits) | modifiers (24 bits) | code (32 bits) |
+  return static_cast<guint64>(key.type) << 56
+    | static_cast<guint64>(key.modifiers & 0xffffff) << 32 | code;
+}
+
 } // namespace Keys
 
 } // namespace CppConsUI
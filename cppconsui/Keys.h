@@ -24,6 +24,8 @@
 
 #include "libtermkey/termkey.h"
 
+#include <glib.h>
+
 namespace CppConsUI
 {
 
@@ -42,6 +44,12 @@ struct TermKeyCmp
  */
 TermKeyKey refineKey(const TermKeyKey& k);
 
+/**
+ * Packs a key into a single integer. Keys that are equal according to
+ * TermKeyCmp are packed into the same value.
+ */
+guint64 packKey(const TermKeyKey& k);
+
 } // namespace Keys
 
 } // namespace CppConsUI
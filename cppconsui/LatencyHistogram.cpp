@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * @file
+ * LatencyHistogram class implementation.
+ *
+ * @ingroup cppconsui
+ */
+
+#include "LatencyHistogram.h"
+
+#include <string.h>
+
+namespace CppConsUI
+{
+
+LatencyHistogram::LatencyHistogram()
+{
+  reset();
+}
+
+void LatencyHistogram::add(gint64 usecs)
+{
+  if (usecs < 0)
+    usecs = 0;
+
+  count++;
+  total += usecs;
+  if (usecs > max)
+    max = usecs;
+  buckets[getBucket(usecs)]++;
+}
+
+void LatencyHistogram::reset()
+{
+  count = 0;
+  total = 0;
+  max = 0;
+  memset(buckets, 0, sizeof(buckets));
+}
+
+gint64 LatencyHistogram::getAverage() const
+{
+  if (!count)
+    return 0;
+  return total / count;
+}
+
+gint64 LatencyHistogram::getPercentile(int percent) const
+{
+  if (!count)
+    return 0;
+
+  // rank of the value that is wanted, rounded up
+  guint64 rank = (count * CLAMP(percent, 0, 100) + 99) / 100;
+  if (!rank)
+    rank = 1;
+
+  guint64 seen = 0;
+  for (int i = 0; i < BUCKETS_NUM; i++) {
+    seen += buckets[i];
+    if (seen >= rank)
+      return MIN(getBucketUpperBound(i), max);
+  }
+  return max;
+}
+
+int LatencyHistogram::getBucket(gint64 usecs)
+{
+  if (usecs < SUB_BUCKETS)
+    return usecs;
+
+  if (usecs >= G_GINT64_CONSTANT(1) << MAX_BITS)
+    return BUCKETS_NUM - 1;
+
+  // index of the most significant bit
+  int msb = SUB_BITS;
+  while (usecs >> (msb + 1))
+    msb++;
+
+  return (msb - SUB_BITS + 1) * SUB_BUCKETS
+    + ((usecs >> (msb - SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+gint64 LatencyHistogram::getBucketUpperBound(int bucket)
+{
+  if (bucket < SUB_BUCKETS)
+    return bucket;
+
+  int group = bucket / SUB_BUCKETS;
+  int sub = bucket % SUB_BUCKETS;
+  gint64 lower = static_cast<gint64>(SUB_BUCKETS + sub) << (group - 1);
+  return lower + (G_GINT64_CONSTANT(1) << (group - 1)) - 1;
+}
+
+} // namespace CppConsUI
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * @file
+ * LatencyHistogram class.
+ *
+ * @ingroup cppconsui
+ */
+
+#ifndef __LATENCYHISTOGRAM_H__
+#define __LATENCYHISTOGRAM_H__
+
+#include <glib.h>
+
+namespace CppConsUI
+{
+
+/**
+ * Histogram of latencies in microseconds.
+ *
+ * Values are counted in logarithmic buckets, each power of two is split into
+ * four sub-buckets, so percentiles are estimated with an error below 25 %.
+ */
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+  virtual ~LatencyHistogram() {}
+
+  void add(gint64 usecs);
+  void reset();
+
+  guint64 getCount() const { return count; }
+  gint64 getMax() const { return max; }
+  gint64 getAverage() const;
+  /**
+   * Returns an estimate of the given percentile (0-100). The estimate is the
+   * upper bound of the bucket where the percentile falls.
+   */
+  gint64 getPercentile(int percent) const;
+
+protected:
+  enum {
+    SUB_BITS = 2,
+    SUB_BUCKETS = 1 << SUB_BITS,
+    // values up to 2^40 microseconds
+    MAX_BITS = 40,
+    BUCKETS_NUM = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS
+  };
+
+  guint64 count;
+  // sum of all values
+  guint64 total;
+  gint64 max;
+  guint64 buckets[BUCKETS_NUM];
+
+  static int getBucket(gint64 usecs);
+  static gint64 getBucketUpperBound(int bucket);
+};
+
+} // namespace CppConsUI
+
+#endif // __LATENCYHISTOGRAM_H__
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * @file
+ * ListView class implementation.
+ *
+ * @ingroup cppconsui
+ */
+
+#include "ListView.h"
+
+namespace CppConsUI
+{
+
+ListView::ListView(int w, int h)
+: Widget(w, h), model(NULL), renderer(NULL), view_top(0), cursor(-1)
+{
+  can_focus = true;
+  declareBindables();
+}
+
+ListView::~ListView()
+{
+  setModel(NULL);
+}
+
+void ListView::draw()
+{
+  proceedUpdateArea();
+
+  if (!area)
+    return;
+
+  area->erase();
+
+  // the view could have been resized since the last draw
+  makeCursorVisible();
+
+  int realw = area->getmaxx();
+  int realh = area->getmaxy();
+  int rows = getRowsNumber();
+
+  // only the rows that fit on the screen are drawn
+  for (int y = 0; y < realh && view_top + y < rows; y++) {
+    int row = view_top + y;
+    bool cursor_row = row == cursor && has_focus;
+
+    if (renderer) {
+      renderer->drawRow(*this, *area, y, *model, row, cursor_row);
+      continue;
+    }
+
+    int attrs = getRowAttrs(cursor_row);
+    area->attron(attrs);
+    area->fill(attrs, 0, y, realw, 1);
+    const char *text = model->getRowText(row);
+    if (text)
+      area->mvaddstring(0, y, realw, text);
+    area->attroff(attrs);
+  }
+}
+
+void ListView::setModel(Model *new_model)
+{
+  if (new_model == model)
+    return;
+
+  rows_inserted_conn.disconnect();
+  rows_removed_conn.disconnect();
+  rows_changed_conn.disconnect();
+  reset_conn.disconnect();
+
+  model = new_model;
+  if (model) {
+    rows_inserted_conn = model->signal_rows_inserted.connect(
+        sigc::mem_fun(this, &ListView::onRowsInserted));
+    rows_removed_conn = model->signal_rows_removed.connect(
+        sigc::mem_fun(this, &ListView::onRowsRemoved));
+    rows_changed_conn = model->signal_rows_changed.connect(
+        sigc::mem_fun(this, &ListView::onRowsChanged));
+    reset_conn = model->signal_reset.connect(
+        sigc::mem_fun(this, &ListView::onReset));
+  }
+
+  view_top = 0;
+  cursor = getRowsNumber() ? 0 : -1;
+  redraw();
+}
+
+void ListView::setRenderer(Renderer *new_renderer)
+{
+  if (new_renderer == renderer)
+    return;
+
+  renderer = new_renderer;
+  redraw();
+}
+
+void ListView::setCursor(int row)
+{
+  int rows = getRowsNumber();
+  if (!rows)
+    row = -1;
+  else if (row < 0)
+    row = 0;
+  else if (row >= rows)
+    row = rows - 1;
+
+  bool changed = row != cursor;
+  cursor = row;
+  makeCursorVisible();
+  redraw();
+
+  if (changed)
+    signal_cursor_changed(*this, cursor);
+}
+
+int ListView::getRowAttrs(bool cursor_row) const
+{
+  if (cursor_row)
+    return getColorPair("listview", "focus") | Curses::Attr::REVERSE;
+  return getColorPair("listview", "normal");
+}
+
+int ListView::getPageSize() const
+{
+  return MAX(getRealHeight(), 1);
+}
+
+void ListView::makeCursorVisible()
+{
+  int rows = getRowsNumber();
+  int page = getPageSize();
+
+  // don't leave an empty space at the bottom if the rows can fill it
+  if (view_top > rows - page)
+    view_top = MAX(rows - page, 0);
+
+  if (cursor < 0)
+    return;
+
+  if (cursor < view_top)
+    view_top = cursor;
+  else if (cursor >= view_top + page)
+    view_top = cursor - page + 1;
+}
+
+void ListView::onRowsInserted(Model& /*activator*/, int first, int count)
+{
+  int old_cursor = cursor;
+
+  // keep the cursor and the shown rows on the same data
+  if (cursor < 0)
+    cursor = 0;
+  else if (first <= cursor)
+    cursor += count;
+  if (first < view_top)
+    view_top += count;
+
+  makeCursorVisible();
+  redraw();
+
+  if (cursor != old_cursor)
+    signal_cursor_changed(*this, cursor);
+}
+
+void ListView::onRowsRemoved(Model& /*activator*/, int first, int count)
+{
+  int old_cursor = cursor;
+  int rows = getRowsNumber();
+
+  if (cursor >= first + count)
+    cursor -= count;
+  else if (cursor >= first)
+    cursor = MIN(first, rows - 1);
+
+  if (view_top >= first + count)
+    view_top -= count;
+  else if (view_top > first)
+    view_top = first;
+
+  makeCursorVisible();
+  redraw();
+
+  if (cursor != old_cursor)
+    signal_cursor_changed(*this, cursor);
+}
+
+void ListView::onRowsChanged(Model& /*activator*/, int first, int count)
+{
+  // nothing to do if none of the changed rows is shown
+  if (first + count <= view_top || first >= view_top + getPageSize())
+    return;
+
+  redraw();
+}
+
+void ListView::onReset(Model& /*activator*/)
+{
+  view_top = 0;
+  setCursor(0);
+}
+
+void ListView::actionMoveCursor(int direction)
+{
+  if (cursor < 0)
+    return;
+
+  setCursor(cursor + direction);
+}
+
+void ListView::actionMovePage(int direction)
+{
+  if (cursor < 0)
+    return;
+
+  // scroll the view together with the cursor
+  int page = getPageSize();
+  view_top = MAX(view_top + direction * page, 0);
+  setCursor(cursor + direction * page);
+}
+
+void ListView::actionMoveEnd(int direction)
+{
+  setCursor(direction < 0 ? 0 : getRowsNumber() - 1);
+}
+
+void ListView::actionActivate()
+{
+  if (cursor < 0)
+    return;
+
+  signal_activate(*this, cursor);
+}
+
+void ListView::declareBindables()
+{
+  declareBindable("listview", "cursor-up",
+      sigc::bind(sigc::mem_fun(this, &ListView::actionMoveCursor), -1),
+      InputProcessor::BINDABLE_NORMAL);
+  declareBindable("listview", "cursor-down",
+      sigc::bind(sigc::mem_fun(this, &ListView::actionMoveCursor), 1),
+      InputProcessor::BINDABLE_NORMAL);
+  declareBindable("listview", "cursor-page-up",
+      sigc::bind(sigc::mem_fun(this, &ListView::actionMovePage), -1),
+      InputProcessor::BINDABLE_NORMAL);
+  declareBindable("listview", "cursor-page-down",
+      sigc::bind(sigc::mem_fun(this, &ListView::actionMovePage), 1),
+      InputProcessor::BINDABLE_NORMAL);
+  declareBindable("listview", "cursor-begin",
+      sigc::bind(sigc::mem_fun(this, &ListView::actionMoveEnd), -1),
+      InputProcessor::BINDABLE_NORMAL);
+  declareBindable("listview", "cursor-end",
+      sigc::bind(sigc::mem_fun(this, &ListView::actionMoveEnd), 1),
+      InputProcessor::BINDABLE_NORMAL);
+  declareBindable("listview", "activate",
+      sigc::mem_fun(this, &ListView::actionActivate),
+      InputProcessor::BINDABLE_NORMAL);
+}
+
+} // namespace CppConsUI
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
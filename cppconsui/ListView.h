@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * @file
+ * ListView class.
+ *
+ * @ingroup cppconsui
+ */
+
+#ifndef __LISTVIEW_H__
+#define __LISTVIEW_H__
+
+#include "Widget.h"
+
+namespace CppConsUI
+{
+
+/**
+ * Widget that shows rows of a data model.
+ *
+ * Unlike ListBox, the rows are not widgets. The view keeps only the index of
+ * the first shown row and of the cursor row, and draws the rows that fit on
+ * the screen when it is drawn, so the cost of drawing and scrolling doesn't
+ * depend on the number of rows.
+ */
+class ListView
+: public Widget
+{
+public:
+  /**
+   * Data shown by a ListView. The model has to emit the signals when its
+   * rows change so that all views that show it stay consistent.
+   */
+  class Model
+  {
+  public:
+    Model() {}
+    virtual ~Model() {}
+
+    /**
+     * Returns the number of rows.
+     */
+    virtual int getRowsNumber() const = 0;
+    /**
+     * Returns a text of a given row. It is used by the default renderer,
+     * the returned string has to stay valid only until the next call of
+     * this method.
+     */
+    virtual const char *getRowText(int row) const = 0;
+
+    /**
+     * Emitted after rows were inserted. Parameters are the index of the
+     * first inserted row and the number of rows.
+     */
+    sigc::signal<void, Model&, int, int> signal_rows_inserted;
+    /**
+     * Emitted after rows were removed. Parameters are the index that the
+     * first removed row had and the number of rows.
+     */
+    sigc::signal<void, Model&, int, int> signal_rows_removed;
+    /**
+     * Emitted after data of rows were changed. Parameters are the index of
+     * the first changed row and the number of rows.
+     */
+    sigc::signal<void, Model&, int, int> signal_rows_changed;
+    /**
+     * Emitted after all rows were replaced.
+     */
+    sigc::signal<void, Model&> signal_reset;
+
+  protected:
+
+  private:
+    Model(const Model&);
+    Model& operator=(const Model&);
+  };
+
+  /**
+   * Draws rows of a model.
+   */
+  class Renderer
+  {
+  public:
+    Renderer() {}
+    virtual ~Renderer() {}
+
+    /**
+     * Draws a given row on line y of the area. The line is already cleared,
+     * cursor is true if the row is under the cursor and the view has the
+     * focus.
+     */
+    virtual void drawRow(ListView& view, Curses::Window& area, int y,
+        const Model& model, int row, bool cursor) = 0;
+
+  protected:
+
+  private:
+    Renderer(const Renderer&);
+    Renderer& operator=(const Renderer&);
+  };
+
+  ListView(int w, int h);
+  virtual ~ListView();
+
+  // Widget
+  virtual void draw();
+
+  /**
+   * Sets a model to show. The view doesn't take ownership of the model, it
+   * has to outlive the view or be unset. NULL shows no rows.
+   */
+  virtual void setModel(Model *new_model);
+  virtual Model *getModel() const { return model; }
+
+  /**
+   * Sets a renderer of the rows. The view doesn't take ownership of the
+   * renderer. NULL selects the default renderer that draws texts of the
+   * rows.
+   */
+  virtual void setRenderer(Renderer *new_renderer);
+  virtual Renderer *getRenderer() const { return renderer; }
+
+  /**
+   * Moves the cursor to a given row and scrolls the view so the row is
+   * visible.
+   */
+  virtual void setCursor(int row);
+  /**
+   * Returns the index of the cursor row or -1 if there are no rows.
+   */
+  virtual int getCursor() const { return cursor; }
+  /**
+   * Returns the index of the first shown row.
+   */
+  virtual int getViewTop() const { return view_top; }
+
+  /**
+   * Returns attributes that the default renderer uses for a row.
+   */
+  virtual int getRowAttrs(bool cursor_row) const;
+
+  /**
+   * Emitted when the cursor moves to another row.
+   */
+  sigc::signal<void, ListView&, int> signal_cursor_changed;
+  /**
+   * Emitted when the cursor row is activated.
+   */
+  sigc::signal<void, ListView&, int> signal_activate;
+
+protected:
+  Model *model;
+  Renderer *renderer;
+
+  // index of the first shown row
+  int view_top;
+  // index of the cursor row, -1 if there are no rows
+  int cursor;
+
+  sigc::connection rows_inserted_conn;
+  sigc::connection rows_removed_conn;
+  sigc::connection rows_changed_conn;
+  sigc::connection reset_conn;
+
+  virtual int getRowsNumber() const
+    { return model ? model->getRowsNumber() : 0; }
+  // returns the number of shown rows
+  virtual int getPageSize() const;
+
+  /**
+   * Changes view_top so the cursor row is visible.
+   */
+  virtual void makeCursorVisible();
+
+  virtual void onRowsInserted(Model& activator, int first, int count);
+  virtual void onRowsRemoved(Model& activator, int first, int count);
+  virtual void onRowsChanged(Model& activator, int first, int count);
+  virtual void onReset(Model& activator);
+
+private:
+  ListView(const ListView&);
+  ListView& operator=(const ListView&);
+
+  void actionMoveCursor(int direction);
+  void actionMovePage(int direction);
+  void actionMoveEnd(int direction);
+  void actionActivate();
+
+  void declareBindables();
+};
+
+} // namespace CppConsUI
+
+#endif // __LISTVIEW_H__
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -33,6 +33,7 @@
 #include "TextEdit.h"
 
 #include <algorithm>
+#include <string>
 #include <string.h>
 
 // gap expand size when the gap becomes filled
@@ -63,25 +64,40 @@ bool TextEdit::processInputText(const TermKeyKey &key)
   if (!editable)
     return false;
 
-  if (single_line_mode && key.code.codepoint == '\n')
+  // filter out unwanted input
+  if (!isCharAccepted(key.code.codepoint))
     return false;
 
-  if (!accept_tabs && key.code.codepoint == '\t')
+  insertTextAtCursor(key.utf8);
+  return true;
+}
+
+bool TextEdit::processPasteText(const char *text, size_t bytes)
+{
+  if (!editable || !g_utf8_validate(text, bytes, NULL))
     return false;
 
   // filter out unwanted input
-  if (flags) {
-    if ((flags & FLAG_ALPHABETIC) && !g_unichar_isalpha(key.code.codepoint))
-      return false;
-    if ((flags & FLAG_NUMERIC) && !g_unichar_isdigit(key.code.codepoint))
-      return false;
-    if ((flags & FLAG_NOSPACE) && g_unichar_isspace(key.code.codepoint))
-      return false;
-    if ((flags & FLAG_NOPUNCTUATION) && g_unichar_ispunct(key.code.codepoint))
-      return false;
+  std::string accepted;
+  accepted.reserve(bytes);
+  const char *end = text + bytes;
+  for (const char *p = text; p < end; ) {
+    const char *next = g_utf8_next_char(p);
+    gunichar uc = g_utf8_get_char(p);
+    if (single_line_mode && uc == '\n') {
+      // keep the pasted lines apart
+      if (isCharAccepted(' '))
+        accepted.append(" ");
+    }
+    else if (isCharAccepted(uc))
+      accepted.append(p, next - p);
+    p = next;
   }
 
-  insertTextAtCursor(key.utf8);
+  /* Insert the whole text at once so the screen lines are updated and
+   * signal_text_change is emitted only once. */
+  if (!accepted.empty())
+    insertTextAtCursor(accepted.data(), accepted.size());
   return true;
 }
 
@@ -600,6 +616,28 @@ void TextEdit::updateScreenCursor()
     view_top++;
 }
 
+bool TextEdit::isCharAccepted(gunichar uc) const
+{
+  if (single_line_mode && uc == '\n')
+    return false;
+
+  if (!accept_tabs && uc == '\t')
+    return false;
+
+  if (flags) {
+    if ((flags & FLAG_ALPHABETIC) && !g_unichar_isalpha(uc))
+      return false;
+    if ((flags & FLAG_NUMERIC) && !g_unichar_isdigit(uc))
+      return false;
+    if ((flags & FLAG_NOSPACE) && g_unichar_isspace(uc))
+      return false;
+    if ((flags & FLAG_NOPUNCTUATION) && g_unichar_ispunct(uc))
+      return false;
+  }
+
+  return true;
+}
+
 void TextEdit::insertTextAtCursor(const char *new_text, size_t new_text_bytes)
 {
   g_assert(new_text);
@@ -53,6 +53,7 @@ public:
 
   // InputProcessor
   virtual bool processInputText(const TermKeyKey &key);
+  virtual bool processPasteText(const char *text, size_t bytes);
 
   // Widget
   virtual void draw();
@@ -229,6 +230,11 @@ protected:
    */
   virtual void updateScreenCursor();
 
+  /**
+   * Returns true if the character can be inserted into the text.
+   */
+  virtual bool isCharAccepted(gunichar uc) const;
+
   /**
    * Inserts given text at the current cursor position.
    */
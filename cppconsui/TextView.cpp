@@ -27,6 +27,8 @@
 
 #include "TextView.h"
 
+#include <string.h>
+
 namespace CppConsUI
 {
 
@@ -70,26 +72,50 @@ void TextView::draw()
   else if (autoscroll && !autoscroll_suspended)
     view_top = screen_lines.size() - realh;
 
-  int attrs = getColorPair("textview", "text");
-  area->attron(attrs);
+  // resolve colors again in case the color scheme was changed
+  color_pairs.clear();
 
   ScreenLines::iterator i;
   int j;
   for (i = screen_lines.begin() + view_top, j = 0; i != screen_lines.end()
       && j < realh; i++, j++) {
-    int attrs2 = 0;
-    if (i->parent->color) {
-      char color[32];
-      int w = g_snprintf(color, sizeof(color), "color%d", i->parent->color);
-      g_assert(static_cast<int>(sizeof(color)) >= w); // just in case
-      attrs2 = getColorPair("textview", color);
-      area->attroff(attrs);
-      area->attron(attrs2);
-    }
-
+    const Line *line = i->parent;
     const char *p = i->text;
     int w = 0;
+
+    // find the color that is active at the start of this screen line
+    size_t span = 0;
+    int color = line->color;
+    while (span < line->spans_num
+        && line->spans[span].offset <= static_cast<size_t>(p - line->text))
+      color = line->spans[span++].color;
+
+    /* Draw a prefix of the line. It isn't a part of the text so spans don't
+     * apply to it, it has the color of the line. */
+    if (p == line->text) {
+      const char *prefix = getLinePrefix(*line);
+      if (prefix) {
+        int prefix_attrs = getColorAttrs(line->color);
+        area->attron(prefix_attrs);
+        w += area->mvaddstring(0, j, prefix);
+        area->attroff(prefix_attrs);
+      }
+    }
+
+    int attrs = getColorAttrs(color);
+    area->attron(attrs);
+
     for (int k = 0; k < i->length; k++) {
+      // switch attributes if a new span starts here
+      size_t offset = p - line->text;
+      if (span < line->spans_num && line->spans[span].offset <= offset) {
+        while (span < line->spans_num && line->spans[span].offset <= offset)
+          color = line->spans[span++].color;
+        area->attroff(attrs);
+        attrs = getColorAttrs(color);
+        area->attron(attrs);
+      }
+
       gunichar uc = g_utf8_get_char(p);
       if (uc == '\t') {
         int t = Curses::onscreen_width(uc, w);
@@ -102,14 +128,9 @@ void TextView::draw()
       p = g_utf8_next_char(p);
     }
 
-    if (i->parent->color) {
-      area->attroff(attrs2);
-      area->attron(attrs);
-    }
+    area->attroff(attrs);
   }
 
-  area->attroff(attrs);
-
   // draw scrollbar
   if (scrollbar) {
     int x1, x2;
@@ -171,39 +192,58 @@ void TextView::draw()
   */
 }
 
-void TextView::append(const char *text, int color)
+void TextView::append(const char *text, int color, const ColorSpan *spans,
+    size_t spans_num)
 {
-  insert(lines.size(), text, color);
+  insert(lines.size(), text, color, spans, spans_num);
 }
 
-void TextView::insert(size_t line_num, const char *text, int color)
+void TextView::insert(size_t line_num, const char *text, int color,
+    const ColorSpan *spans, size_t spans_num)
 {
   if (!text)
     return;
 
   g_assert(line_num <= lines.size());
 
-  const char *p = text;
   const char *s = text;
+  const char *p;
   size_t cur_line_num = line_num;
-
-  // parse lines
-  while (*p) {
-    if (*p == '\n') {
-      Line *l = new Line(s, p - s, color);
-      lines.insert(lines.begin() + cur_line_num, l);
-      cur_line_num++;
-      s = p = g_utf8_next_char(p);
-      continue;
+  size_t span = 0;
+  ColorSpan *line_spans = spans_num ? g_newa(ColorSpan, spans_num) : NULL;
+
+  /* Parse lines. Note that '\n' can't be a part of a multibyte UTF-8
+   * sequence so it is safe to search for it byte by byte. */
+  while (true) {
+    p = strchr(s, '\n');
+    if (!p && !*s)
+      break;
+    size_t bytes = p ? static_cast<size_t>(p - s) : strlen(s);
+
+    // spans that start on this line, offsets are made relative to the line
+    size_t start = s - text;
+    size_t first = span;
+    while (span < spans_num && spans[span].offset <= start + bytes)
+      span++;
+    if (span > first) {
+      for (size_t k = first; k < span; k++) {
+        line_spans[k - first].offset = spans[k].offset > start
+          ? spans[k].offset - start : 0;
+        line_spans[k - first].color = spans[k].color;
+      }
     }
 
-    p = g_utf8_next_char(p);
-  }
-
-  if (s < p) {
-    Line *l = new Line(s, p - s, color);
+    Line *l = new Line(s, bytes, color, line_spans, span - first);
     lines.insert(lines.begin() + cur_line_num, l);
     cur_line_num++;
+
+    // the next line continues with the last color of this one
+    if (span > first)
+      color = spans[span - 1].color;
+
+    if (!p)
+      break;
+    s = p + 1;
   }
 
   // update screen lines
@@ -213,6 +253,16 @@ void TextView::insert(size_t line_num, const char *text, int color)
   redraw();
 }
 
+void TextView::insertLine(size_t line_num, Line &line)
+{
+  g_assert(line_num <= lines.size());
+
+  lines.insert(lines.begin() + line_num, &line);
+  updateScreenLines(line_num);
+
+  redraw();
+}
+
 void TextView::erase(size_t line_num)
 {
   g_assert(line_num < lines.size());
@@ -282,18 +332,24 @@ void TextView::setScrollBar(bool new_scrollbar)
   redraw();
 }
 
-TextView::Line::Line(const char *text_, size_t bytes, int color_)
-: color(color_)
+TextView::Line::Line(const char *text_, size_t bytes, int color_,
+    const ColorSpan *spans_, size_t spans_num_)
+: color(color_), spans(NULL), spans_num(spans_num_)
 {
   g_assert(text_);
 
   text = g_strndup(text_, bytes);
   length = g_utf8_strlen(text, -1);
+
+  if (spans_num)
+    spans = static_cast<ColorSpan*>(g_memdup(spans_,
+          spans_num * sizeof(ColorSpan)));
 }
 
 TextView::Line::~Line()
 {
   g_free(text);
+  g_free(spans);
 }
 
 TextView::ScreenLine::ScreenLine(Line &parent_, const char *text_,
@@ -302,17 +358,39 @@ TextView::ScreenLine::ScreenLine(Line &parent_, const char *text_,
 {
 }
 
+int TextView::getColorAttrs(int color)
+{
+  if (color < 0)
+    color = 0;
+
+  if (static_cast<size_t>(color) >= color_pairs.size())
+    color_pairs.resize(color + 1, -1);
+
+  if (color_pairs[color] == -1) {
+    if (color) {
+      char name[32];
+      g_snprintf(name, sizeof(name), "color%d", color);
+      color_pairs[color] = getColorPair("textview", name);
+    }
+    else
+      color_pairs[color] = getColorPair("textview", "text");
+  }
+
+  return color_pairs[color];
+}
+
 const char *TextView::proceedLine(const char *text, int area_width,
-    int *res_length) const
+    int *res_length, int start_width) const
 {
   g_assert(text);
   g_assert(area_width > 0);
   g_assert(res_length);
+  g_assert(start_width >= 0 && start_width < area_width);
 
   const char *cur = text;
   const char *res = text;
-  int prev_width = 0;
-  int cur_width = 0;
+  int prev_width = start_width;
+  int cur_width = start_width;
   int cur_length = 0;
   bool space = false;
   *res_length = 0;
@@ -385,10 +463,18 @@ size_t TextView::updateScreenLines(size_t line_num, size_t start)
     realw -= 2;
   }
 
+  /* The text of the first screen line starts after the line prefix, at
+   * least one cell is always left for the text. Tabs are measured from
+   * there, the same way as draw() expands them. */
+  int prefixw = 0;
+  const char *prefix = getLinePrefix(*lines[line_num]);
+  if (prefix)
+    prefixw = MAX(MIN(Curses::onscreen_width(prefix), realw - 1), 0);
+
   int len;
   while (*p) {
     s = p;
-    p = proceedLine(p, realw, &len);
+    p = proceedLine(p, realw, &len, new_lines.empty() ? prefixw : 0);
     new_lines.push_back(ScreenLine(*lines[line_num], s, len));
   }
 
@@ -31,6 +31,7 @@
 #include "Widget.h"
 
 #include <deque>
+#include <vector>
 
 namespace CppConsUI
 {
@@ -42,6 +43,17 @@ class TextView
 : public Widget
 {
 public:
+  /**
+   * Changes color of text starting at a given byte offset. Colors are
+   * numbers of the "colorN" properties of the "textview" widget in the
+   * current color scheme, color 0 is the default "text" color.
+   */
+  struct ColorSpan
+  {
+    size_t offset;
+    int color;
+  };
+
   TextView(int w, int h, bool autoscroll_ = false, bool scrollbar_ = false);
   virtual ~TextView();
 
@@ -51,13 +63,17 @@ public:
   /**
    * Appends text after the last line.
    */
-  virtual void append(const char *text, int color = 0);
+  virtual void append(const char *text, int color = 0,
+      const ColorSpan *spans = NULL, size_t spans_num = 0);
   /**
    * Inserts text before specified line number. Text can contain multiple
    * lines and should end with '\\n' character just in front of '\\0'
-   * character.
+   * character. Optional spans (sorted by their offsets into text) change
+   * the color of parts of the text, the color parameter is used for text in
+   * front of the first span.
    */
-  virtual void insert(size_t line_num, const char *text, int color = 0);
+  virtual void insert(size_t line_num, const char *text, int color = 0,
+      const ColorSpan *spans = NULL, size_t spans_num = 0);
   /**
    * Removes a specified line.
    */
@@ -106,9 +122,20 @@ protected:
      * Color number.
      */
     int color;
+    /**
+     * Color changes inside the line, offsets are relative to text. NULL if
+     * the whole line has the same color.
+     */
+    ColorSpan *spans;
+    size_t spans_num;
 
-    Line(const char *text_, size_t bytes, int color_);
+    Line(const char *text_, size_t bytes, int color_,
+        const ColorSpan *spans_ = NULL, size_t spans_num_ = 0);
     virtual ~Line();
+
+  private:
+    Line(const Line&);
+    Line& operator=(const Line&);
   };
 
   /**
@@ -148,9 +175,25 @@ protected:
    * Array of on-screen lines.
    */
   ScreenLines screen_lines;
+  /**
+   * Color pairs of the "colorN" properties resolved during the current
+   * draw, -1 if not resolved yet.
+   */
+  std::vector<int> color_pairs;
 
+  /**
+   * Returns attributes of a specified color, the result is cached until the
+   * end of the current draw.
+   */
+  virtual int getColorAttrs(int color);
+
+  /**
+   * Finds where a screen line that starts with text ends. The screen line
+   * starts at column start_width of an area area_width cells wide, tabs are
+   * expanded from that column as draw() does.
+   */
   virtual const char *proceedLine(const char *text, int area_width,
-      int *res_length) const;
+      int *res_length, int start_width = 0) const;
   /**
    * Recalculates on-screen lines for a specified line number.
    */
@@ -163,6 +206,22 @@ protected:
   virtual size_t eraseScreenLines(size_t line_num, size_t start = 0,
       size_t *deleted = NULL);
 
+  /**
+   * Inserts an already created line before specified line number. The text
+   * of the line must not contain any '\\n' character. TextView takes
+   * ownership of the line.
+   */
+  virtual void insertLine(size_t line_num, Line &line);
+  /**
+   * Returns a prefix that should be drawn in front of the first screen line
+   * of a specified line, or NULL if there is no prefix. The prefix is not
+   * a part of the line text, it is formatted when the line is drawn or
+   * wrapped. This allows derived classes to store structured data in their
+   * lines instead of preformatted strings. The returned string has to stay
+   * valid only until the next call of this method.
+   */
+  virtual const char *getLinePrefix(const Line& /*line*/) { return NULL; }
+
 private:
   TextView(const TextView &);
   TextView& operator=(const TextView&);
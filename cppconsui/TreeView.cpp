@@ -21,6 +21,8 @@
 
 #include "TreeView.h"
 
+#include <algorithm>
+
 namespace CppConsUI
 {
 
@@ -57,8 +59,11 @@ TreeView::TreeView(int w, int h)
   root.collapsed = false;
   root.style = STYLE_NORMAL;
   root.widget = NULL;
+  root.row = NULL;
+  root.row_visible = false;
   thetree.set_head(root);
   focus_node = thetree.begin();
+  entry_node = thetree.begin();
 
   declareBindables();
 }
@@ -70,6 +75,9 @@ TreeView::~TreeView()
 
 void TreeView::draw()
 {
+  // row widgets that aren't needed anymore can be safely deleted now
+  releaseRowWidgets();
+
   proceedUpdateArea();
   // set virtual scroll area width
   if (screen_area)
@@ -114,9 +122,18 @@ void TreeView::cleanFocus()
 bool TreeView::grabFocus()
 {
   for (TheTree::pre_order_iterator i = ++thetree.begin();
-      i != thetree.end(); i++)
+      i != thetree.end(); i++) {
+    if (i->row) {
+      // a visible row can always take the focus
+      if (isNodeVisible(i)) {
+        materializeRow(i)->grabFocus();
+        return true;
+      }
+      continue;
+    }
     if (i->widget->grabFocus())
       return true;
+  }
   return false;
 }
 
@@ -137,7 +154,8 @@ bool TreeView::isWidgetVisible(const Widget& child) const
     return false;
 
   NodeReference node = findNode(child);
-  if (!isNodeVisible(node))
+  // a row widget that is being deleted isn't in the tree anymore
+  if (node == thetree.end() || !isNodeVisible(node))
     return false;
 
   return parent->isWidgetVisible(*this);
@@ -146,6 +164,7 @@ bool TreeView::isWidgetVisible(const Widget& child) const
 bool TreeView::setFocusChild(Widget& child)
 {
   NodeReference node = findNode(child);
+  g_assert(node != thetree.end());
   if (!isNodeVisible(node))
     return false;
 
@@ -164,19 +183,37 @@ void TreeView::getFocusChain(FocusChain& focus_chain,
    * predecessor is reached. */
   NodeReference act = focus_node;
   NodeReference top = thetree.begin();
+  /* The focused row can also lose its widget when it is being deleted, the
+   * widget has to stay in the chain until the focus is moved. */
+  if (focus_node->row && !focus_node->widget)
+    top = focus_node;
   while (act != thetree.begin()) {
-    if (!act->widget->isVisible())
+    if (!isNodeShown(*act))
       top = act;
     act = thetree.parent(act);
   }
 
+  /* Rows don't have widgets, offer a widget of one row so the focus can
+   * enter them if the focus isn't already on a row. The focus is then moved
+   * between rows by moveFocus(). */
+  if (!focus_node->row || !focus_node->widget || !isNodeVisible(focus_node))
+    entry_node = findEntryRow();
+  else
+    entry_node = thetree.begin();
+  if (entry_node != thetree.begin())
+    materializeRow(entry_node);
+
   // the preorder iterator starts with the root so we must skip it
   for (TheTree::pre_order_iterator i = ++thetree.begin();
       i != thetree.end(); i++) {
     Widget *widget = i->widget;
+    // only the focused row and the entry row are in the chain
+    if (i->row && i != focus_node && i != entry_node)
+      widget = NULL;
     Container *container = dynamic_cast<Container*>(widget);
+    bool shown = isNodeShown(*i);
 
-    if (container && container->isVisible()) {
+    if (container && shown) {
       // the widget is a container so add its widgets as well
       FocusChain::pre_order_iterator iter = focus_chain.append_child(parent,
           container);
@@ -187,11 +224,11 @@ void TreeView::getFocusChain(FocusChain& focus_chain,
       if (!focus_chain.number_of_children(iter))
         focus_chain.erase(iter);
     }
-    else if (widget->canFocus() && widget->isVisible()) {
+    else if (widget && widget->canFocus() && shown) {
       // widget can be focused
       focus_chain.append_child(parent, widget);
     }
-    else if (i == top) {
+    else if (i == top && focus_child) {
       /* This node is the focused node or the focused node is in a subtree of
        * this node. */
 
@@ -207,7 +244,7 @@ void TreeView::getFocusChain(FocusChain& focus_chain,
         focus_chain.append_child(parent, focus_child);
     }
 
-    if (i->collapsed || !widget->isVisible())
+    if (i->collapsed || !shown)
       i.skip_children();
   }
 }
@@ -224,6 +261,12 @@ Curses::Window *TreeView::getSubPad(const Widget& child, int begin_x,
   return ScrollPane::getSubPad(child, begin_x, begin_y, ncols, nlines);
 }
 
+void TreeView::moveFocus(FocusDirection direction)
+{
+  if (!moveRowFocus(direction))
+    ScrollPane::moveFocus(direction);
+}
+
 void TreeView::setCollapsed(NodeReference node, bool collapsed)
 {
   g_assert(node->treeview == this);
@@ -234,15 +277,14 @@ void TreeView::setCollapsed(NodeReference node, bool collapsed)
   node->collapsed = collapsed;
   fixFocus();
   redraw();
+  signal_collapsed_change(*this, node, collapsed);
 }
 
 void TreeView::toggleCollapsed(NodeReference node)
 {
   g_assert(node->treeview == this);
 
-  node->collapsed = !node->collapsed;
-  fixFocus();
-  redraw();
+  setCollapsed(node, !node->collapsed);
 }
 
 void TreeView::actionToggleCollapsed()
@@ -294,6 +336,62 @@ TreeView::NodeReference TreeView::appendNode(NodeReference parent,
   return iter;
 }
 
+TreeView::NodeReference TreeView::insertNode(NodeReference position,
+    Row& row)
+{
+  g_assert(position->treeview == this);
+
+  TreeNode node = addNode(row);
+  NodeReference iter = thetree.insert(position, node);
+  updateRow(iter);
+  return iter;
+}
+
+TreeView::NodeReference TreeView::insertNodeAfter(NodeReference position,
+    Row& row)
+{
+  g_assert(position->treeview == this);
+
+  TreeNode node = addNode(row);
+  NodeReference iter = thetree.insert_after(position, node);
+  updateRow(iter);
+  return iter;
+}
+
+TreeView::NodeReference TreeView::prependNode(NodeReference parent, Row& row)
+{
+  g_assert(parent->treeview == this);
+
+  TreeNode node = addNode(row);
+  NodeReference iter = thetree.prepend_child(parent, node);
+  updateRow(iter);
+  return iter;
+}
+
+TreeView::NodeReference TreeView::appendNode(NodeReference parent, Row& row)
+{
+  g_assert(parent->treeview == this);
+
+  TreeNode node = addNode(row);
+  NodeReference iter = thetree.append_child(parent, node);
+  updateRow(iter);
+  return iter;
+}
+
+void TreeView::updateRow(NodeReference node)
+{
+  g_assert(node->treeview == this);
+  g_assert(node->row);
+
+  bool visible = node->row->isRowVisible();
+  if (visible != node->row_visible) {
+    node->row_visible = visible;
+    // the focused row could have been hidden or the first row revealed
+    fixFocus();
+  }
+  redraw();
+}
+
 void TreeView::deleteNode(NodeReference node, bool keepchildren)
 {
   g_assert(node->treeview == this);
@@ -303,33 +401,18 @@ void TreeView::deleteNode(NodeReference node, bool keepchildren)
     thetree.flatten(node);
 
   int shrink = 0;
-  if (node->widget) {
-    int h = node->widget->getHeight();
-    if (h == AUTOSIZE)
-      h = node->widget->getWishHeight();
-    if (h == AUTOSIZE)
-      h = 1;
-    shrink += h;
-  }
+  if (node->widget || node->row)
+    shrink += getNodeHeight(*node);
 
   while (thetree.number_of_children(node)) {
     TheTree::pre_order_iterator i = thetree.begin_leaf(node);
-    int h = i->widget->getHeight();
-    if (h == AUTOSIZE)
-      h = i->widget->getWishHeight();
-    if (h == AUTOSIZE)
-      h = 1;
-    shrink += h;
+    shrink += getNodeHeight(*i);
 
     // remove the widget and instantly remove it from the tree
-    removeWidget(*i->widget);
-    thetree.erase(i);
+    eraseNode(i);
   }
 
-  if (node->widget)
-    removeWidget(*node->widget);
-
-  thetree.erase(node);
+  eraseNode(node);
   setScrollHeight(getScrollHeight() - shrink);
   redraw();
 }
@@ -416,20 +499,21 @@ int TreeView::drawNode(SiblingIterator node, int top)
   int realw = area->getmaxx();
 
   // draw the node Widget first
-  if (node->widget) {
-    if (!node->widget->isVisible())
+  if (node->widget || node->row) {
+    if (!isNodeShown(*node))
       return 0;
+    int x;
     if (node->style == STYLE_NORMAL && isNodeOpenable(node))
-      node->widget->move(depthoffset + 3, top);
+      x = depthoffset + 3;
     else
-      node->widget->move(depthoffset + 1, top);
-    node->widget->draw();
-    int h = node->widget->getHeight();
-    if (h == AUTOSIZE)
-      h = node->widget->getWishHeight();
-    if (h == AUTOSIZE)
-      h = 1;
-    height += h;
+      x = depthoffset + 1;
+    if (node->widget) {
+      node->widget->move(x, top);
+      node->widget->draw();
+    }
+    else if (x < realw)
+      node->row->drawRow(*area, x, top, realw - x);
+    height += getNodeHeight(*node);
   }
 
   if (!node->collapsed && isNodeOpenable(node)) {
@@ -442,17 +526,9 @@ int TreeView::drawNode(SiblingIterator node, int top)
     /* Note: it would be better to start from end towards begin but for some
      * reason it doesn't seem to work. */
     SiblingIterator last = node.begin();
-    for (i = node.begin(); i != node.end(); i++) {
-      if (!i->widget)
-        continue;
-      int h = i->widget->getHeight();
-      if (h == AUTOSIZE)
-        h = i->widget->getWishHeight();
-      if (h == AUTOSIZE)
-        h = 1;
-      if (h && i->widget->isVisible())
+    for (i = node.begin(); i != node.end(); i++)
+      if (getNodeHeight(*i) && isNodeShown(*i))
         last = i;
-    }
     SiblingIterator end = last;
     end++;
     for (i = node.begin(); i != end; i++) {
@@ -510,10 +586,54 @@ TreeView::TreeNode TreeView::addNode(Widget& widget)
   node.collapsed = false;
   node.style = STYLE_NORMAL;
   node.widget = &widget;
+  node.row = NULL;
+  node.row_visible = false;
+
+  return node;
+}
+
+TreeView::TreeNode TreeView::addNode(Row& row)
+{
+  // make room for this row
+  setScrollHeight(getScrollHeight() + 1);
+
+  // construct the new node, updateRow() sets the visibility
+  TreeNode node;
+  node.treeview = this;
+  node.collapsed = false;
+  node.style = STYLE_NORMAL;
+  node.widget = NULL;
+  node.row = &row;
+  node.row_visible = false;
 
   return node;
 }
 
+void TreeView::eraseNode(NodeReference node)
+{
+  if (node->row) {
+    if (node->widget) {
+      row_nodes.erase(std::find(row_nodes.begin(), row_nodes.end(), node));
+
+      /* Detach the widget first, it is no longer visible then and the focus
+       * is moved if it has it. */
+      Widget *widget = node->widget;
+      node->widget = NULL;
+      removeWidget(*widget);
+    }
+    delete node->row;
+  }
+  else if (node->widget)
+    removeWidget(*node->widget);
+
+  if (node == entry_node)
+    entry_node = thetree.begin();
+  if (node == focus_node)
+    focus_node = thetree.begin();
+
+  thetree.erase(node);
+}
+
 void TreeView::fixFocus()
 {
   /* This function is called when a widget tree is reorganized (a node was
@@ -539,28 +659,23 @@ void TreeView::fixFocus()
 
 TreeView::NodeReference TreeView::findNode(const Widget& child) const
 {
+  // the focused node is looked up most often
+  if (focus_node->widget == &child)
+    return focus_node;
+
   /// @todo Speed up this algorithm.
   TheTree::pre_order_iterator i;
   for (i = thetree.begin(); i != thetree.end(); i++)
     if (i->widget == &child)
       break;
-  g_assert(i != thetree.end());
   return i;
 }
 
 bool TreeView::isNodeOpenable(SiblingIterator& node) const
 {
-  for (SiblingIterator i = node.begin(); i != node.end(); i++) {
-    if (!i->widget)
-      continue;
-    int h = i->widget->getHeight();
-    if (h == AUTOSIZE)
-      h = i->widget->getWishHeight();
-    if (h == AUTOSIZE)
-      h = 1;
-    if (h && i->widget->isVisible())
+  for (SiblingIterator i = node.begin(); i != node.end(); i++)
+    if (getNodeHeight(*i) && isNodeShown(*i))
       return true;
-  }
   return false;
 }
 
@@ -570,7 +685,7 @@ bool TreeView::isNodeVisible(NodeReference& node) const
   NodeReference act = node;
   bool first = true;
   while (act != thetree.begin()) {
-    if (!act->widget->isVisible() || (!first && act->collapsed))
+    if (!isNodeShown(*act) || (!first && act->collapsed))
       return false;
     first = false;
     act = thetree.parent(act);
@@ -578,6 +693,190 @@ bool TreeView::isNodeVisible(NodeReference& node) const
   return true;
 }
 
+bool TreeView::isNodeShown(const TreeNode& node) const
+{
+  if (node.row)
+    return node.row_visible;
+  if (node.widget)
+    return node.widget->isVisible();
+  // the root node
+  return true;
+}
+
+int TreeView::getNodeHeight(const TreeNode& node) const
+{
+  // rows are always one line high
+  if (node.row)
+    return 1;
+
+  int h = node.widget->getHeight();
+  if (h == AUTOSIZE)
+    h = node.widget->getWishHeight();
+  if (h == AUTOSIZE)
+    h = 1;
+  return h;
+}
+
+TreeView::NodeReference TreeView::getNextVisibleNode(NodeReference node)
+  const
+{
+  // returns the end of the tree if there isn't any next visible node
+  TheTree::pre_order_iterator i = node;
+  if (i->collapsed || !isNodeShown(*i))
+    i.skip_children();
+  i++;
+  while (i != thetree.end() && !isNodeShown(*i)) {
+    i.skip_children();
+    i++;
+  }
+  return i;
+}
+
+TreeView::NodeReference TreeView::getPrevVisibleNode(NodeReference node)
+  const
+{
+  // returns the root node if there isn't any previous visible node
+  NodeReference parent = thetree.parent(node);
+  SiblingIterator i = node;
+  while (i != parent.begin()) {
+    i--;
+    if (!isNodeShown(*i))
+      continue;
+
+    // the previous node is the last visible node in the sibling's subtree
+    NodeReference last = i;
+    bool descend = true;
+    while (descend && !last->collapsed) {
+      descend = false;
+      SiblingIterator j = last.end();
+      while (j != last.begin()) {
+        j--;
+        if (isNodeShown(*j)) {
+          last = j;
+          descend = true;
+          break;
+        }
+      }
+    }
+    return last;
+  }
+  return parent;
+}
+
+TreeView::NodeReference TreeView::findEntryRow() const
+{
+  // prefer the row that follows the focused node
+  if (focus_node != thetree.begin()) {
+    NodeReference i = getNextVisibleNode(focus_node);
+    while (i != thetree.end() && !i->row)
+      i = getNextVisibleNode(i);
+    /* The focused node could have been hidden together with its ancestor,
+     * the found row has to be checked then. */
+    if (i != thetree.end() && isNodeVisible(i))
+      return i;
+  }
+
+  for (NodeReference i = getNextVisibleNode(thetree.begin());
+      i != thetree.end(); i = getNextVisibleNode(i))
+    if (i->row)
+      return i;
+
+  return thetree.begin();
+}
+
+Widget *TreeView::materializeRow(NodeReference node)
+{
+  g_assert(node->row);
+
+  if (node->widget)
+    return node->widget;
+
+  /* Set the widget before it is added so the node can be found when the
+   * widget grabs the focus in setParent(). */
+  Widget *widget = node->row->createRowWidget();
+  node->widget = widget;
+  row_nodes.push_back(node);
+  addWidget(*widget, 0, 0);
+  return widget;
+}
+
+void TreeView::releaseRowWidgets()
+{
+  /* Use an index, deleting a widget can move the focus and that can create
+   * another row widget. */
+  size_t i = 0;
+  while (i < row_nodes.size()) {
+    NodeReference node = row_nodes[i];
+    if (node == focus_node || node == entry_node) {
+      i++;
+      continue;
+    }
+
+    row_nodes.erase(row_nodes.begin() + i);
+    Widget *widget = node->widget;
+    node->widget = NULL;
+    removeWidget(*widget);
+  }
+}
+
+bool TreeView::moveRowFocus(FocusDirection direction)
+{
+  // only the focus of a visible row is moved here
+  if (!focus_node->row || !focus_node->widget
+      || focus_child != focus_node->widget || !isNodeVisible(focus_node))
+    return false;
+
+  bool forward;
+  int steps = 1;
+  switch (direction) {
+    case FOCUS_PREVIOUS:
+    case FOCUS_UP:
+    case FOCUS_LEFT:
+      forward = false;
+      break;
+    case FOCUS_NEXT:
+    case FOCUS_DOWN:
+    case FOCUS_RIGHT:
+      forward = true;
+      break;
+    case FOCUS_PAGE_UP:
+    case FOCUS_PAGE_DOWN:
+      if (!page_focus)
+        return false;
+      forward = direction == FOCUS_PAGE_DOWN;
+      steps = MAX(getRealHeight() / 2, 1);
+      break;
+    case FOCUS_BEGIN:
+    case FOCUS_END:
+      forward = direction == FOCUS_END;
+      steps = G_MAXINT;
+      break;
+    default:
+      return false;
+  }
+
+  /* Walk the visible rows, a widget node stops the walk and Container then
+   * handles the focus change. */
+  NodeReference target = focus_node;
+  NodeReference i = focus_node;
+  while (steps > 0) {
+    if (forward)
+      i = getNextVisibleNode(i);
+    else
+      i = getPrevVisibleNode(i);
+    if (i == thetree.end() || i == thetree.begin() || !i->row)
+      break;
+    target = i;
+    steps--;
+  }
+
+  if (target == focus_node)
+    return false;
+
+  materializeRow(target)->grabFocus();
+  return true;
+}
+
 void TreeView::onChildMoveResize(Widget& activator, const Rect &oldsize,
     const Rect &newsize)
 {
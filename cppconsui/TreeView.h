@@ -27,6 +27,8 @@
 
 #include "tree.hh"
 
+#include <vector>
+
 namespace CppConsUI
 {
 
@@ -63,6 +65,43 @@ public:
     STYLE_VOID ///< Don't draw any extra information.
   };
 
+  /**
+   * Lightweight node that isn't backed by a widget.
+   *
+   * A row is one line high and it is drawn directly into the area of the
+   * tree view. A real widget is created for the row only when it gets the
+   * focus, so a tree with thousands of rows doesn't need thousands of
+   * widgets. The focus is moved between rows by the tree view itself.
+   */
+  class Row
+  {
+  public:
+    Row() {}
+    virtual ~Row() {}
+
+    /**
+     * Returns whether the row and its children are shown. The tree view
+     * has to be told about a change by calling TreeView::updateRow().
+     */
+    virtual bool isRowVisible() const = 0;
+    /**
+     * Draws the row at a given position, at most w columns can be used.
+     */
+    virtual void drawRow(Curses::Window& area, int x, int y, int w) = 0;
+    /**
+     * Returns a new widget that represents the row while it has the focus.
+     * The widget has to be one line high. TreeView takes ownership of the
+     * widget and deletes it when it's no longer needed.
+     */
+    virtual Widget *createRowWidget() = 0;
+
+  protected:
+
+  private:
+    Row(const Row&);
+    Row& operator=(const Row&);
+  };
+
   typedef tree<TreeNode> TheTree;
   typedef TheTree::pre_order_iterator NodeReference;
   typedef TheTree::sibling_iterator SiblingIterator;
@@ -83,6 +122,7 @@ public:
       FocusChain::iterator parent);
   virtual Curses::Window *getSubPad(const Widget& child, int begin_x,
       int begin_y, int ncols, int nlines);
+  virtual void moveFocus(FocusDirection direction);
 
   /**
    * Folds/unfolds given node.
@@ -125,6 +165,32 @@ public:
    */
   virtual NodeReference appendNode(NodeReference parent, Widget& widget);
 
+  /**
+   * Inserts a row before a specified position. TreeView takes ownership of
+   * the row.
+   */
+  virtual NodeReference insertNode(NodeReference position, Row& row);
+  /**
+   * Inserts a row after a specified position. TreeView takes ownership of
+   * the row.
+   */
+  virtual NodeReference insertNodeAfter(NodeReference position, Row& row);
+  /**
+   * Prepends a row to a specified parent. TreeView takes ownership of the
+   * row.
+   */
+  virtual NodeReference prependNode(NodeReference parent, Row& row);
+  /**
+   * Appends a row to a specified parent. TreeView takes ownership of the
+   * row.
+   */
+  virtual NodeReference appendNode(NodeReference parent, Row& row);
+
+  /**
+   * Redraws a given row and moves the focus if the row was hidden.
+   */
+  virtual void updateRow(NodeReference node);
+
   /**
    * Deletes given node.
    */
@@ -162,6 +228,12 @@ public:
   virtual void setNodeStyle(NodeReference node, Style s);
   virtual Style getNodeStyle(NodeReference node) const;
 
+  /**
+   * Emitted when a node is folded or unfolded, the new state is passed in
+   * the last parameter.
+   */
+  sigc::signal<void, TreeView&, NodeReference, bool> signal_collapsed_change;
+
 protected:
   class TreeNode
   {
@@ -175,6 +247,7 @@ protected:
     bool isCollapsed() const { return collapsed; }
     Style getStyle() const { return style; }
     Widget *getWidget() const { return widget; }
+    Row *getRow() const { return row; }
 
   protected:
 
@@ -199,11 +272,35 @@ protected:
      * can show '...' when the text does not fit in the given space.
      */
     Widget *widget;
+
+    /**
+     * Row to show instead of a widget or NULL. The widget of a row node is
+     * set only while the row needs one.
+     */
+    Row *row;
+
+    /**
+     * Cached visibility of the row, it is updated by updateRow().
+     */
+    bool row_visible;
   };
 
+  typedef std::vector<NodeReference> RowNodes;
+
   TheTree thetree;
   NodeReference focus_node;
 
+  /**
+   * Row that offers its widget in the focus chain so the focus can enter
+   * the rows, the root node if there isn't any.
+   */
+  NodeReference entry_node;
+
+  /**
+   * Rows that have a widget created.
+   */
+  RowNodes row_nodes;
+
   // Container
   using ScrollPane::addWidget;
   using ScrollPane::removeWidget;
@@ -213,6 +310,8 @@ protected:
   virtual int drawNode(SiblingIterator node, int top);
 
   virtual TreeNode addNode(Widget& widget);
+  virtual TreeNode addNode(Row& row);
+  virtual void eraseNode(NodeReference node);
 
   virtual void fixFocus();
 
@@ -220,6 +319,16 @@ protected:
 
   virtual bool isNodeOpenable(SiblingIterator& node) const;
   virtual bool isNodeVisible(NodeReference& node) const;
+  virtual bool isNodeShown(const TreeNode& node) const;
+  virtual int getNodeHeight(const TreeNode& node) const;
+
+  virtual NodeReference getNextVisibleNode(NodeReference node) const;
+  virtual NodeReference getPrevVisibleNode(NodeReference node) const;
+
+  virtual NodeReference findEntryRow() const;
+  virtual Widget *materializeRow(NodeReference node);
+  virtual void releaseRowWidgets();
+  virtual bool moveRowFocus(FocusDirection direction);
 
   // signal handlers
   virtual void onChildMoveResize(Widget& activator, const Rect& oldsize,
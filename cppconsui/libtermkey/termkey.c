@@ -35,6 +35,7 @@ static struct TermKeyDriver *drivers[] = {
 // static void eat_bytes(TermKey *tk, size_t count);
 static void emit_codepoint(TermKey *tk, long codepoint, TermKeyKey *key);
 static TermKeyResult peekkey_simple(TermKey *tk, TermKeyKey *key, int force, size_t *nbytes);
+static TermKeyResult peekkey_paste(TermKey *tk, TermKeyKey *key, int force, size_t *nbytes);
 static TermKeyResult peekkey_mouse(TermKey *tk, TermKeyKey *key, size_t *nbytes);
 
 static TermKeySym register_c0(TermKey *tk, TermKeySym sym, unsigned char ctrl, const char *name);
@@ -104,6 +105,8 @@ static struct {
   { TERMKEY_SYM_KPCOMMA,   "KPComma" },
   { TERMKEY_SYM_KPPERIOD,  "KPPeriod" },
   { TERMKEY_SYM_KPEQUALS,  "KPEquals" },
+  { TERMKEY_SYM_PASTE_BEGIN, "PasteBegin" },
+  { TERMKEY_SYM_PASTE_END,   "PasteEnd" },
   { 0, NULL },
 };
 
@@ -634,6 +637,17 @@ void termkey_canonicalise(TermKey *tk, TermKeyKey *key)
   }
 }
 
+static void slide_buffer(TermKey *tk)
+{
+  // Slide the data down to stop it running away
+  size_t halfsize = tk->buffsize / 2;
+
+  if(tk->buffstart > halfsize) {
+    memcpy(tk->buffer, tk->buffer + halfsize, halfsize);
+    tk->buffstart -= halfsize;
+  }
+}
+
 static TermKeyResult peekkey(TermKey *tk, TermKeyKey *key, int force, size_t *nbytep)
 {
   int again = 0;
@@ -645,6 +659,17 @@ static TermKeyResult peekkey(TermKey *tk, TermKeyKey *key, int force, size_t *nb
 #endif
 
   TermKeyResult ret;
+
+  /* Bracketed paste markers are recognised before the drivers so they work
+   * regardless of the terminal type */
+  ret = peekkey_paste(tk, key, force, nbytep);
+  if(ret == TERMKEY_RES_KEY) {
+    slide_buffer(tk);
+    return ret;
+  }
+  if(ret == TERMKEY_RES_AGAIN)
+    again = 1;
+
   struct TermKeyDriverNode *p;
   for(p = tk->drivers; p; p = p->next) {
     ret = (p->driver->peekkey)(tk, p->info, key, force, nbytep);
@@ -658,15 +683,7 @@ static TermKeyResult peekkey(TermKey *tk, TermKeyKey *key, int force, size_t *nb
 #ifdef DEBUG
       print_key(tk, key); fprintf(stderr, "\n");
 #endif
-      // Slide the data down to stop it running away
-      {
-        size_t halfsize = tk->buffsize / 2;
-
-        if(tk->buffstart > halfsize) {
-          memcpy(tk->buffer, tk->buffer + halfsize, halfsize);
-          tk->buffstart -= halfsize;
-        }
-      }
+      slide_buffer(tk);
 
       /* fallthrough */
     case TERMKEY_RES_EOF:
@@ -688,6 +705,11 @@ static TermKeyResult peekkey(TermKey *tk, TermKeyKey *key, int force, size_t *nb
 
   ret = peekkey_simple(tk, key, force, nbytep);
 
+  /* Pasted text is mostly made of plain characters, the buffer has to be
+   * compacted after them too or a long paste keeps growing it */
+  if(ret == TERMKEY_RES_KEY)
+    slide_buffer(tk);
+
 #ifdef DEBUG
   fprintf(stderr, "getkey_simple(force=%d) yields %s\n", force, res2str(ret));
   if(ret == TERMKEY_RES_KEY) {
@@ -698,6 +720,41 @@ static TermKeyResult peekkey(TermKey *tk, TermKeyKey *key, int force, size_t *nb
   return ret;
 }
 
+static TermKeyResult peekkey_paste(TermKey *tk, TermKeyKey *key, int force, size_t *nbytep)
+{
+  // CSI 200 ~ starts and CSI 201 ~ ends a bracketed paste
+  static const char begin[] = "\x1b[200~";
+  static const char end[]   = "\x1b[201~";
+  const size_t len = sizeof(begin) - 1;
+
+  if(tk->buffcount == 0 || CHARAT(0) != 0x1b)
+    return TERMKEY_RES_NONE;
+
+  size_t n = tk->buffcount < len ? tk->buffcount : len;
+  int is_begin = 1, is_end = 1;
+  for(size_t i = 0; i < n; i++) {
+    if(CHARAT(i) != (unsigned char)begin[i])
+      is_begin = 0;
+    if(CHARAT(i) != (unsigned char)end[i])
+      is_end = 0;
+  }
+
+  if(!is_begin && !is_end)
+    return TERMKEY_RES_NONE;
+
+  if(n < len)
+    // Might be a marker split across reads
+    return force ? TERMKEY_RES_NONE : TERMKEY_RES_AGAIN;
+
+  key->type = TERMKEY_TYPE_KEYSYM;
+  key->code.sym = is_begin ? TERMKEY_SYM_PASTE_BEGIN : TERMKEY_SYM_PASTE_END;
+  key->modifiers = 0;
+  key->utf8[0] = 0;
+  *nbytep = len;
+
+  return TERMKEY_RES_KEY;
+}
+
 static TermKeyResult peekkey_simple(TermKey *tk, TermKeyKey *key, int force, size_t *nbytep)
 {
   if(tk->buffcount == 0)
@@ -87,6 +87,10 @@ typedef enum {
   TERMKEY_SYM_KPPERIOD,
   TERMKEY_SYM_KPEQUALS,
 
+  // Bracketed paste markers
+  TERMKEY_SYM_PASTE_BEGIN,
+  TERMKEY_SYM_PASTE_END,
+
   // et cetera ad nauseum
   TERMKEY_N_SYMS
 } TermKeySym;
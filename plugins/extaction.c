@@ -26,6 +26,22 @@
  *
  * An example how to use this plugin can be found in contrib/extnotify.py.
  *
+ * By default the program is executed for every event and the event is
+ * described by EVENT_* environment variables. In the helper mode the program
+ * is started only once with EXTACTION_MODE=helper set in its environment and
+ * events are written to its standard input. Each event is one netstring
+ * ("<length>:<data>,") that contains a JSON object with the same values as
+ * the environment variables, and the number of events dropped so far. Events
+ * are dropped when the helper doesn't keep up and too much data is waiting
+ * for it, or while it is being restarted after it exited. Events that were
+ * not completely written when the helper exited are dropped too. Events that
+ * were already written into the pipe but not read by the helper before it
+ * exited are lost without being counted, the plugin can't tell them apart
+ * from the events that the helper processed.
+ *
+ * Buddy icons are not passed by their contents, they are written to a cache
+ * directory once and handlers get paths of the cached files.
+ *
  * TODO Add support for more kinds of events, currently only received-im-msg
  * and received-chat-msg actions are supported.
  *
@@ -35,49 +51,270 @@
 
 #define PURPLE_PLUGINS
 
+#include <errno.h>
+#include <fcntl.h>
 #include <glib.h>
 #include <libpurple/purple.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 #define DEFAULT_TEXT_DOMAIN PACKAGE_NAME
 #include "gettext.h"
 
+#include "iconcache.h"
+
 #define PLUGIN_ID "core-cim_pack-ext_action"
 #define PLUGIN_PREF "/plugins/core/cim_pack-extaction"
 #define PLUGIN_PREF_COMMAND PLUGIN_PREF "/command"
+#define PLUGIN_PREF_HELPER PLUGIN_PREF "/helper"
+
+// limit of event data waiting for the helper in bytes
+#define HELPER_BUFFER_MAX (256 * 1024)
+// the longest delay before the helper is restarted in seconds
+#define HELPER_RESTART_MAX 60
 
 #define UNUSED(x) (void)(x)
 
+typedef struct
+{
+  // write end of the helper's standard input, -1 if it isn't running
+  int fd;
+  guint write_handle;
+  // data that the helper hasn't read yet
+  GString *buffer;
+  // sizes of the records in the buffer that weren't completely written
+  GQueue *records;
+  // number of bytes of the first record in the buffer that were written
+  gsize head_written;
+  // record that is being built, kept to reuse its allocation
+  GString *record;
+
+  guint restart_timer;
+  unsigned restart_delay;
+  time_t start_time;
+
+  // number of events completely written to the helper
+  unsigned long sent;
+  unsigned long dropped;
+} Helper;
+
 static PurplePlugin *ea_plugin = NULL;
+static Helper helper;
+static IconCache *icon_cache = NULL;
 
-static void on_new_message(PurpleAccount *account, const char *remote,
-    const char *message)
+static void helper_stop(void)
+{
+  if (helper.write_handle) {
+    purple_input_remove(helper.write_handle);
+    helper.write_handle = 0;
+  }
+  if (helper.fd != -1) {
+    // the helper gets EOF and should exit
+    close(helper.fd);
+    helper.fd = -1;
+  }
+
+  // events that weren't written completely are lost
+  helper.dropped += g_queue_get_length(helper.records);
+  g_queue_clear(helper.records);
+  helper.head_written = 0;
+  g_string_truncate(helper.buffer, 0);
+}
+
+static gboolean helper_restart(gpointer data)
+{
+  UNUSED(data);
+
+  // the helper is started again by the next event
+  helper.restart_timer = 0;
+  return FALSE;
+}
+
+static void helper_failed(const char *reason)
+{
+  purple_debug_error("extaction", "helper failed: %s\n", reason);
+  helper_stop();
+
+  // restart a helper that keeps failing less and less often
+  if (time(NULL) - helper.start_time >= HELPER_RESTART_MAX)
+    helper.restart_delay = 1;
+  helper.restart_timer = purple_timeout_add_seconds(helper.restart_delay,
+      helper_restart, NULL);
+  helper.restart_delay = MIN(helper.restart_delay * 2, HELPER_RESTART_MAX);
+}
+
+static gboolean helper_start(void)
 {
+  if (helper.fd != -1)
+    return TRUE;
+  if (helper.restart_timer)
+    return FALSE;
+
   const char *command = purple_prefs_get_path(PLUGIN_PREF_COMMAND);
+  if (!command || !command[0])
+    return FALSE;
 
-  // the command should be never NULL
-  g_return_if_fail(command);
+  char *argv[2];
+  argv[0] = g_strdup(command);
+  argv[1] = NULL;
 
-  if (!command[0]) {
-    // no command is set
-    return;
+  char **envp = g_get_environ();
+  envp = g_environ_setenv(envp, "EXTACTION_MODE", "helper", TRUE);
+
+  helper.start_time = time(NULL);
+
+  GError *err = NULL;
+  gboolean res = g_spawn_async_with_pipes(NULL, argv, envp,
+      G_SPAWN_SEARCH_PATH | G_SPAWN_STDOUT_TO_DEV_NULL
+      | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, NULL, &helper.fd, NULL, NULL,
+      &err);
+
+  g_free(argv[0]);
+  g_strfreev(envp);
+
+  if (!res) {
+    helper.fd = -1;
+    helper_failed(err->message);
+    g_clear_error(&err);
+    return FALSE;
   }
 
-  const char *protocol = purple_account_get_protocol_name(account);
-  char *local = g_strdup(purple_normalize(account,
-        purple_account_get_username(account)));
-  char *nohtml = purple_markup_strip_html(message);
-  PurpleBuddy *buddy = purple_find_buddy(account, remote);
-  char *icon_encoded = NULL;
-  if (buddy) {
-    // get buddy alias and icon
-    remote = purple_buddy_get_alias(buddy);
-    PurpleBuddyIcon *icon = purple_buddy_get_icon(buddy);
-    if (icon) {
-      size_t len;
-      gconstpointer data = purple_buddy_icon_get_data(icon, &len);
-      icon_encoded = g_base64_encode(data, len);
+  /* Writes must never block the IM process. The descriptor also must not
+   * leak to other children, the helper would not get EOF then. */
+  fcntl(helper.fd, F_SETFL, fcntl(helper.fd, F_GETFL) | O_NONBLOCK);
+  fcntl(helper.fd, F_SETFD, FD_CLOEXEC);
+
+  purple_debug_info("extaction", "helper started\n");
+  return TRUE;
+}
+
+static void helper_writable(gpointer data, gint fd,
+    PurpleInputCondition cond);
+
+static void helper_flush(void)
+{
+  while (helper.buffer->len) {
+    ssize_t n = write(helper.fd, helper.buffer->str, helper.buffer->len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      // the helper has most likely exited (EPIPE)
+      helper_failed(g_strerror(errno));
+      return;
+    }
+    g_string_erase(helper.buffer, 0, n);
+
+    // note the records that were written completely
+    helper.head_written += n;
+    while (!g_queue_is_empty(helper.records)) {
+      gsize size = GPOINTER_TO_SIZE(g_queue_peek_head(helper.records));
+      if (helper.head_written < size)
+        break;
+      helper.head_written -= size;
+      g_queue_pop_head(helper.records);
+      helper.sent++;
+    }
+  }
+
+  // wait until the helper reads the rest
+  if (helper.buffer->len && !helper.write_handle)
+    helper.write_handle = purple_input_add(helper.fd, PURPLE_INPUT_WRITE,
+        helper_writable, NULL);
+  else if (!helper.buffer->len && helper.write_handle) {
+    purple_input_remove(helper.write_handle);
+    helper.write_handle = 0;
+  }
+}
+
+static void helper_writable(gpointer data, gint fd,
+    PurpleInputCondition cond)
+{
+  UNUSED(data);
+  UNUSED(fd);
+  UNUSED(cond);
+
+  helper_flush();
+}
+
+// appends a JSON string literal
+static void json_append_string(GString *str, const char *value)
+{
+  g_string_append_c(str, '"');
+  for (const char *p = value; *p; p++) {
+    unsigned char c = *p;
+    if (c == '"' || c == '\\') {
+      g_string_append_c(str, '\\');
+      g_string_append_c(str, c);
     }
+    else if (c == '\n')
+      g_string_append(str, "\\n");
+    else if (c < 0x20)
+      g_string_append_printf(str, "\\u%04x", c);
+    else
+      g_string_append_c(str, c);
+  }
+  g_string_append_c(str, '"');
+}
+
+static void json_append_member(GString *str, const char *name,
+    const char *value)
+{
+  if (str->len > 1)
+    g_string_append_c(str, ',');
+  json_append_string(str, name);
+  g_string_append_c(str, ':');
+  json_append_string(str, value);
+}
+
+/* Queues an event for the helper. The record is built in a reused buffer,
+ * so the event costs only copying of its data and a write() call. */
+static void helper_send_message(const char *protocol, const char *local,
+    const char *remote, const char *icon_path, const char *nohtml,
+    const char *message)
+{
+  if (!helper_start()) {
+    helper.dropped++;
+    return;
   }
 
+  GString *record = helper.record;
+  g_string_assign(record, "{");
+  json_append_member(record, "type", "msg");
+  json_append_member(record, "network", protocol);
+  json_append_member(record, "local_user", local);
+  json_append_member(record, "remote_user", remote);
+  if (icon_path)
+    json_append_member(record, "remote_user_icon_path", icon_path);
+  json_append_member(record, "message", nohtml);
+  json_append_member(record, "message_html", message);
+  g_string_append_printf(record, ",\"dropped\":%lu}", helper.dropped);
+
+  // the whole netstring is about 12 bytes longer than the record
+  if (helper.buffer->len + record->len + 12 > HELPER_BUFFER_MAX) {
+    if (!helper.dropped)
+      purple_debug_warning("extaction",
+          "helper doesn't keep up, dropping events\n");
+    helper.dropped++;
+    return;
+  }
+
+  gsize start = helper.buffer->len;
+  g_string_append_printf(helper.buffer, "%" G_GSIZE_FORMAT ":",
+      record->len);
+  g_string_append_len(helper.buffer, record->str, record->len);
+  g_string_append_c(helper.buffer, ',');
+  g_queue_push_tail(helper.records,
+      GSIZE_TO_POINTER(helper.buffer->len - start));
+
+  helper_flush();
+}
+
+static void spawn_command(const char *command, const char *protocol,
+    const char *local, const char *remote, const char *icon_path,
+    const char *nohtml, const char *message)
+{
   char *argv[2];
   argv[0] = g_strdup(command);
   argv[1] = NULL;
@@ -88,8 +325,9 @@ static void on_new_message(PurpleAccount *account, const char *remote,
   envp = g_environ_setenv(envp, "EVENT_NETWORK", protocol, TRUE);
   envp = g_environ_setenv(envp, "EVENT_LOCAL_USER", local, TRUE);
   envp = g_environ_setenv(envp, "EVENT_REMOTE_USER", remote, TRUE);
-  if (icon_encoded)
-    envp = g_environ_setenv(envp, "EVENT_REMOTE_USER_ICON", icon_encoded, TRUE);
+  if (icon_path)
+    envp = g_environ_setenv(envp, "EVENT_REMOTE_USER_ICON_PATH", icon_path,
+        TRUE);
   envp = g_environ_setenv(envp, "EVENT_MESSAGE", nohtml, TRUE);
   envp = g_environ_setenv(envp, "EVENT_MESSAGE_HTML", message, TRUE);
 
@@ -105,10 +343,41 @@ static void on_new_message(PurpleAccount *account, const char *remote,
   // free all resources
   g_free(argv[0]);
   g_strfreev(envp);
+}
+
+static void on_new_message(PurpleAccount *account, const char *remote,
+    const char *message)
+{
+  const char *command = purple_prefs_get_path(PLUGIN_PREF_COMMAND);
+
+  // the command should be never NULL
+  g_return_if_fail(command);
+
+  if (!command[0]) {
+    // no command is set
+    return;
+  }
+
+  const char *protocol = purple_account_get_protocol_name(account);
+  char *local = g_strdup(purple_normalize(account,
+        purple_account_get_username(account)));
+  char *nohtml = purple_markup_strip_html(message);
+  PurpleBuddy *buddy = purple_find_buddy(account, remote);
+  const char *icon_path = NULL;
+  if (buddy) {
+    // get buddy alias and icon
+    remote = purple_buddy_get_alias(buddy);
+    icon_path = icon_cache_get_buddy_icon(icon_cache, buddy);
+  }
+
+  if (purple_prefs_get_bool(PLUGIN_PREF_HELPER))
+    helper_send_message(protocol, local, remote, icon_path, nohtml, message);
+  else
+    spawn_command(command, protocol, local, remote, icon_path, nohtml,
+        message);
 
   g_free(local);
   g_free(nohtml);
-  g_free(icon_encoded);
 }
 
 static void on_new_im_message(PurpleAccount *account, const char *name,
@@ -133,10 +402,57 @@ static void on_new_chat_message(PurpleAccount *account, const char *who,
   on_new_message(account, who, message);
 }
 
+static void on_buddy_changed(PurpleBuddy *buddy, gpointer data)
+{
+  UNUSED(data);
+
+  /* The cached icon is removed if no other buddy uses it, the new one is
+   * looked up when it is needed next time. */
+  icon_cache_forget_buddy(icon_cache, buddy);
+}
+
+static void on_prefs_changed(const char *name, PurplePrefType type,
+    gconstpointer val, gpointer data)
+{
+  UNUSED(name);
+  UNUSED(type);
+  UNUSED(val);
+  UNUSED(data);
+
+  // a new helper is started by the next event
+  helper_stop();
+  if (helper.restart_timer) {
+    purple_timeout_remove(helper.restart_timer);
+    helper.restart_timer = 0;
+  }
+  helper.restart_delay = 1;
+}
+
 static gboolean plugin_load(PurplePlugin *plugin)
 {
   ea_plugin = plugin;
 
+  helper.fd = -1;
+  helper.write_handle = 0;
+  helper.buffer = g_string_new(NULL);
+  helper.records = g_queue_new();
+  helper.head_written = 0;
+  helper.record = g_string_new(NULL);
+  helper.restart_timer = 0;
+  helper.restart_delay = 1;
+  helper.start_time = 0;
+  helper.sent = 0;
+  helper.dropped = 0;
+
+  char *dir = g_build_filename(purple_user_dir(), "extaction-icons", NULL);
+  icon_cache = icon_cache_new(dir);
+  g_free(dir);
+
+  purple_prefs_connect_callback(plugin, PLUGIN_PREF_COMMAND,
+      on_prefs_changed, NULL);
+  purple_prefs_connect_callback(plugin, PLUGIN_PREF_HELPER,
+      on_prefs_changed, NULL);
+
   void *conv_handle = purple_conversations_get_handle();
 
   // connect callbacks
@@ -146,6 +462,12 @@ static gboolean plugin_load(PurplePlugin *plugin)
   purple_signal_connect(conv_handle, "received-chat-msg", plugin,
       PURPLE_CALLBACK(on_new_chat_message), NULL);
 
+  void *blist_handle = purple_blist_get_handle();
+  purple_signal_connect(blist_handle, "buddy-icon-changed", plugin,
+      PURPLE_CALLBACK(on_buddy_changed), NULL);
+  purple_signal_connect(blist_handle, "buddy-removed", plugin,
+      PURPLE_CALLBACK(on_buddy_changed), NULL);
+
   return TRUE;
 }
 
@@ -153,6 +475,22 @@ static gboolean plugin_unload(PurplePlugin *plugin)
 {
   // disconnect callbacks
   purple_signals_disconnect_by_handle(plugin);
+  purple_prefs_disconnect_by_handle(plugin);
+
+  // stop the helper first so events that it didn't get are counted
+  on_prefs_changed(NULL, PURPLE_PREF_NONE, NULL, NULL);
+
+  if (helper.sent || helper.dropped)
+    purple_debug_info("extaction", "helper events sent: %lu, dropped: %lu\n",
+        helper.sent, helper.dropped);
+
+  g_string_free(helper.buffer, TRUE);
+  g_queue_free(helper.records);
+  g_string_free(helper.record, TRUE);
+
+  icon_cache_free(icon_cache);
+  icon_cache = NULL;
+
   return TRUE;
 }
 
@@ -167,6 +505,10 @@ static PurplePluginPrefFrame *plugin_get_pref_frame(PurplePlugin *plugin)
       PLUGIN_PREF_COMMAND, _("Command"));
   purple_plugin_pref_frame_add(frame, pref);
 
+  pref = purple_plugin_pref_new_with_name_and_label(PLUGIN_PREF_HELPER,
+      _("Keep the command running and send it events on standard input"));
+  purple_plugin_pref_frame_add(frame, pref);
+
   return frame;
 }
 
@@ -216,6 +558,7 @@ static void init_plugin(PurplePlugin *plugin)
 
   purple_prefs_add_none(PLUGIN_PREF);
   purple_prefs_add_path(PLUGIN_PREF_COMMAND, "");
+  purple_prefs_add_bool(PLUGIN_PREF_HELPER, FALSE);
 }
 
 PURPLE_INIT_PLUGIN(extaction, init_plugin, info)
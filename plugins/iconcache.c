@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2012-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "iconcache.h"
+
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <time.h>
+
+typedef struct
+{
+  // name of the file without the extension
+  char *key;
+  char *path;
+  // size of the icon data
+  size_t size;
+  // number of buddies that use this icon
+  int refs;
+} IconCacheEntry;
+
+struct _IconCache
+{
+  char *dir;
+  // buddy -> entry
+  GHashTable *buddies;
+  // key -> entry
+  GHashTable *entries;
+};
+
+static void icon_cache_entry_free(gpointer data)
+{
+  IconCacheEntry *entry = data;
+  g_free(entry->key);
+  g_free(entry->path);
+  g_free(entry);
+}
+
+// removes files that weren't used for a long time
+static void icon_cache_prune(IconCache *cache)
+{
+  GDir *dir = g_dir_open(cache->dir, 0, NULL);
+  if (!dir)
+    return;
+
+  time_t limit = time(NULL) - ICON_CACHE_MAX_AGE * 24 * 60 * 60;
+  const char *name;
+  while ((name = g_dir_read_name(dir))) {
+    char *path = g_build_filename(cache->dir, name, NULL);
+    struct stat st;
+    if (!g_stat(path, &st) && S_ISREG(st.st_mode) && st.st_mtime < limit)
+      g_unlink(path);
+    g_free(path);
+  }
+  g_dir_close(dir);
+}
+
+IconCache *icon_cache_new(const char *dir)
+{
+  g_return_val_if_fail(dir, NULL);
+
+  IconCache *cache = g_new(IconCache, 1);
+  cache->dir = g_strdup(dir);
+  cache->buddies = g_hash_table_new(g_direct_hash, g_direct_equal);
+  cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+      icon_cache_entry_free);
+
+  if (g_mkdir_with_parents(dir, 0700))
+    purple_debug_error("iconcache", "cannot create %s\n", dir);
+  else
+    icon_cache_prune(cache);
+
+  return cache;
+}
+
+void icon_cache_free(IconCache *cache)
+{
+  g_return_if_fail(cache);
+
+  g_hash_table_destroy(cache->buddies);
+  g_hash_table_destroy(cache->entries);
+  g_free(cache->dir);
+  g_free(cache);
+}
+
+static char *icon_cache_make_key(PurpleBuddy *buddy, PurpleBuddyIcon *icon,
+    gconstpointer data, size_t len)
+{
+  const char *checksum = purple_buddy_icon_get_checksum(icon);
+  if (!checksum || !checksum[0])
+    return g_compute_checksum_for_data(G_CHECKSUM_SHA1, data, len);
+
+  /* The checksum format depends on the protocol, it can be a short number,
+   * so the protocol is a part of the key. */
+  PurpleAccount *account = purple_buddy_get_account(buddy);
+  char *str = g_strdup_printf("%s\n%s",
+      purple_account_get_protocol_id(account), checksum);
+  char *key = g_compute_checksum_for_string(G_CHECKSUM_SHA1, str, -1);
+  g_free(str);
+  return key;
+}
+
+// checks if a file left by a previous run can hold the icon
+static gboolean icon_cache_file_matches(const char *path, size_t len)
+{
+  struct stat st;
+  return !g_stat(path, &st) && S_ISREG(st.st_mode)
+    && (size_t)st.st_size == len;
+}
+
+const char *icon_cache_get_buddy_icon(IconCache *cache, PurpleBuddy *buddy)
+{
+  g_return_val_if_fail(cache, NULL);
+  g_return_val_if_fail(buddy, NULL);
+
+  // the usual case, the icon was already cached for this buddy
+  IconCacheEntry *entry = g_hash_table_lookup(cache->buddies, buddy);
+  if (entry)
+    return entry->path;
+
+  PurpleBuddyIcon *icon = purple_buddy_get_icon(buddy);
+  if (!icon)
+    return NULL;
+
+  size_t len;
+  gconstpointer data = purple_buddy_icon_get_data(icon, &len);
+  if (!data)
+    return NULL;
+
+  char *key = icon_cache_make_key(buddy, icon, data, len);
+  entry = g_hash_table_lookup(cache->entries, key);
+  if (entry && entry->size != len) {
+    /* Two different icons got the same protocol checksum, tell them apart
+     * by their content. */
+    g_free(key);
+    key = g_compute_checksum_for_data(G_CHECKSUM_SHA1, data, len);
+    entry = g_hash_table_lookup(cache->entries, key);
+  }
+  if (entry)
+    g_free(key);
+  else {
+    const char *ext = purple_buddy_icon_get_extension(icon);
+    char *name = g_strdup_printf("%s.%s", key, ext ? ext : "icon");
+    char *path = g_build_filename(cache->dir, name, NULL);
+    g_free(name);
+
+    if (icon_cache_file_matches(path, len)) {
+      // written by a previous run, mark it as used
+      g_utime(path, NULL);
+    }
+    else {
+      GError *err = NULL;
+      if (!g_file_set_contents(path, data, len, &err)) {
+        purple_debug_error("iconcache", "%s\n", err->message);
+        g_clear_error(&err);
+        g_free(path);
+        g_free(key);
+        return NULL;
+      }
+    }
+
+    entry = g_new(IconCacheEntry, 1);
+    entry->key = key;
+    entry->path = path;
+    entry->size = len;
+    entry->refs = 0;
+    g_hash_table_insert(cache->entries, entry->key, entry);
+  }
+
+  entry->refs++;
+  g_hash_table_insert(cache->buddies, buddy, entry);
+  return entry->path;
+}
+
+void icon_cache_forget_buddy(IconCache *cache, PurpleBuddy *buddy)
+{
+  g_return_if_fail(cache);
+  g_return_if_fail(buddy);
+
+  IconCacheEntry *entry = g_hash_table_lookup(cache->buddies, buddy);
+  if (!entry)
+    return;
+
+  g_hash_table_remove(cache->buddies, buddy);
+  if (--entry->refs)
+    return;
+
+  /* No buddy uses the icon anymore, for example the buddy changed it. The
+   * file is removed right away so replaced icons don't pile up in the
+   * cache directory. */
+  g_unlink(entry->path);
+  g_hash_table_remove(cache->entries, entry->key);
+}
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2012-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Cache of buddy icons stored as files.
+ *
+ * Icons are written once into a cache directory, under a name derived from
+ * the protocol and the checksum that libpurple keeps for the icon, or from
+ * the SHA-1 of the icon data if the protocol doesn't provide a checksum.
+ * Buddies with the same icon share one file, so external programs can get
+ * icons by their paths instead of their contents.
+ *
+ * The owner of the cache has to call icon_cache_forget_buddy() for the
+ * "buddy-icon-changed" and "buddy-removed" signals. The file of an icon is
+ * removed when no buddy uses it anymore. Files of icons that were still in
+ * use are kept for the next run, those that weren't used for
+ * ICON_CACHE_MAX_AGE days are removed when a cache is created.
+ */
+
+#ifndef __ICONCACHE_H__
+#define __ICONCACHE_H__
+
+#include <glib.h>
+#include <libpurple/purple.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ICON_CACHE_MAX_AGE 30
+
+typedef struct _IconCache IconCache;
+
+/*
+ * Creates a cache in a given directory, the directory is created if it
+ * doesn't exist.
+ */
+IconCache *icon_cache_new(const char *dir);
+/*
+ * Frees the cache, the cached files are kept for the next run.
+ */
+void icon_cache_free(IconCache *cache);
+
+/*
+ * Returns the path of the buddy's icon, or NULL if the buddy has no icon or
+ * the icon couldn't be written. The path stays valid until the buddy is
+ * forgotten.
+ */
+const char *icon_cache_get_buddy_icon(IconCache *cache, PurpleBuddy *buddy);
+/*
+ * Releases the buddy's reference to its cached icon. The file is removed if
+ * no other buddy uses the icon.
+ */
+void icon_cache_forget_buddy(IconCache *cache, PurpleBuddy *buddy);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __ICONCACHE_H__
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -0,0 +1,869 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Protocol plugin that generates synthetic load for testing.
+ *
+ * An account of this protocol doesn't connect anywhere. After the login it
+ * fabricates a buddy list of a configurable size, joins several chat rooms
+ * and then continuously generates presence changes, instant messages, chat
+ * messages and typing notifications at configurable rates. Each kind of
+ * events has its own random generator initialized by a configurable seed and
+ * the number of due events is counted in fixed ticks, not in the real time
+ * elapsed, so the same sequence of events of each kind is produced on each
+ * run. When the main loop is late, a limited number of missed ticks is
+ * caught up.
+ *
+ * Instead of the random events, the plugin can replay a script file that
+ * contrib/cimreplay.py writes from a trace recorded by 'centerim5 --trace'.
+ * The script contains anonymized incoming events (presence changes, received
+ * messages, typing notifications and notifications) with their times
+ * relative to the first event, the first event is replayed right after the
+ * login. Buddies and chat rooms referenced by the script are created
+ * automatically. Lines of the script are:
+ *
+ *   <ms> presence <user> <status id>
+ *   <ms> im <user> <length>
+ *   <ms> chat <room> <user> <length>
+ *   <ms> typing <user> <typing state>
+ *   <ms> notify <type> <title length> <primary length> <secondary length>
+ *   <ms> userinfo <user>
+ *
+ * Users and rooms are numbers starting from 1, empty lines and lines
+ * starting with '#' are ignored.
+ *
+ * Numbers of generated events are periodically written to the debug log.
+ *
+ * The plugin is built only when enabled by --enable-loadgen (autotools) or
+ * -DBUILD_LOADGEN=ON (CMake).
+ */
+
+#define PURPLE_PLUGINS
+
+#include <glib.h>
+#include <libpurple/purple.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#define DEFAULT_TEXT_DOMAIN PACKAGE_NAME
+#include "gettext.h"
+
+#define PLUGIN_ID "prpl-centerim-loadgen"
+
+// interval of the event generator in milliseconds
+#define TICK_INTERVAL 10
+// limit of ticks caught up at once when the main loop is late
+#define MAX_LATE_TICKS 100
+// interval of the statistics reports in seconds
+#define REPORT_INTERVAL 10
+// limit of events of one kind generated by one tick
+#define MAX_EVENTS_PER_TICK 1000
+// number of occupants of each chat room
+#define CHAT_OCCUPANTS 50
+
+#define UNUSED(x) (void)(x)
+
+typedef enum
+{
+  EVENT_PRESENCE,
+  EVENT_IM,
+  EVENT_CHAT,
+  EVENT_TYPING,
+  EVENT_KINDS
+} EventKind;
+
+typedef enum
+{
+  SCRIPT_PRESENCE,
+  SCRIPT_IM,
+  SCRIPT_CHAT,
+  SCRIPT_TYPING,
+  SCRIPT_NOTIFY,
+  SCRIPT_USERINFO
+} ScriptKind;
+
+typedef struct
+{
+  // time from the start of the script in milliseconds
+  gint64 time;
+  ScriptKind kind;
+  // arguments in the order they are written in the script
+  int args[4];
+} ScriptEvent;
+
+typedef struct
+{
+  PurpleConnection *gc;
+  guint tick_timer;
+  guint report_timer;
+  // time of the last generated tick
+  gint64 last_tick;
+
+  // options
+  int buddies_num;
+  int groups_num;
+  int im_partners;
+  int rates[EVENT_KINDS];
+
+  GRand *rands[EVENT_KINDS];
+  // fractional numbers of events that are due
+  double due[EVENT_KINDS];
+  // numbers of events generated since the last report
+  guint counts[EVENT_KINDS];
+
+  // IDs of joined chats
+  GArray *chats;
+  int next_chat_id;
+
+  // replayed script, NULL when random events are generated
+  GArray *script;
+  guint script_pos;
+  gint64 script_start;
+  // IDs of chats indexed by room numbers of the script
+  GArray *rooms;
+} LoadGenData;
+
+static PurplePluginProtocolInfo prpl_info;
+
+static const char *words[] = {
+  "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing",
+  "elit", "duis", "dui", "interdum", "eget", "tempor", "auctor", "viverra",
+  "suscipit", "velit", "phasellus", "vel", "magna", "odio", "rutrum",
+  "tortor", "at", "nisi", "tincidunt", "mauris", "libero", "neque",
+  "faucibus", "semper", "in", "dictum", "ut", "lacinia", "justo", "non",
+  "blandit", "ultrices"
+};
+
+// returns a monotonic time in milliseconds
+static gint64 get_time(void)
+{
+#if GLIB_CHECK_VERSION(2, 28, 0)
+  return g_get_monotonic_time() / 1000;
+#else
+  GTimeVal tv;
+  g_get_current_time(&tv);
+  return (gint64)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#endif
+}
+
+static void get_buddy_name(int i, char *buf, size_t size)
+{
+  g_snprintf(buf, size, "buddy%05d", i);
+}
+
+static void get_random_buddy_name(GRand *rand, int limit, char *buf,
+    size_t size)
+{
+  get_buddy_name(g_rand_int_range(rand, 0, MAX(1, limit)), buf, size);
+}
+
+static const char *get_random_status(GRand *rand)
+{
+  int r = g_rand_int_range(rand, 0, 100);
+  if (r < 60)
+    return purple_primitive_get_id_from_type(PURPLE_STATUS_AVAILABLE);
+  if (r < 85)
+    return purple_primitive_get_id_from_type(PURPLE_STATUS_AWAY);
+  return purple_primitive_get_id_from_type(PURPLE_STATUS_OFFLINE);
+}
+
+// returns a newly allocated random message
+static char *get_random_text(GRand *rand)
+{
+  GString *text = g_string_new(NULL);
+  int n = g_rand_int_range(rand, 3, 21);
+  for (int i = 0; i < n; i++) {
+    if (i)
+      g_string_append_c(text, ' ');
+    g_string_append(text,
+        words[g_rand_int_range(rand, 0, G_N_ELEMENTS(words))]);
+  }
+  return g_string_free(text, FALSE);
+}
+
+// returns a newly allocated text of a given length in bytes
+static char *get_text_of_length(int length)
+{
+  GString *text = g_string_sized_new(length);
+  for (int i = length; (int)text->len < length; i++) {
+    if (text->len)
+      g_string_append_c(text, ' ');
+    g_string_append(text, words[i % G_N_ELEMENTS(words)]);
+  }
+  g_string_truncate(text, MAX(length, 0));
+  return g_string_free(text, FALSE);
+}
+
+static void create_buddies(LoadGenData *lg)
+{
+  PurpleAccount *account = purple_connection_get_account(lg->gc);
+
+  for (int i = 0; i < lg->buddies_num; i++) {
+    char name[32];
+    get_buddy_name(i, name, sizeof(name));
+
+    if (!purple_find_buddy(account, name)) {
+      char *group_name = g_strdup_printf("Load %02d",
+          i % MAX(1, lg->groups_num));
+      PurpleGroup *group = purple_find_group(group_name);
+      if (!group) {
+        group = purple_group_new(group_name);
+        purple_blist_add_group(group, NULL);
+      }
+      g_free(group_name);
+
+      PurpleBuddy *buddy = purple_buddy_new(account, name, NULL);
+      purple_blist_add_buddy(buddy, NULL, group, NULL);
+    }
+
+    purple_prpl_got_user_status(account, name,
+        get_random_status(lg->rands[EVENT_PRESENCE]), NULL);
+  }
+}
+
+// returns the ID of the joined chat or 0 if the chat couldn't be joined
+static int join_chat(LoadGenData *lg, const char *room)
+{
+  int id = lg->next_chat_id++;
+  PurpleConversation *conv = serv_got_joined_chat(lg->gc, id, room);
+  if (!conv)
+    return 0;
+
+  g_array_append_val(lg->chats, id);
+
+  GList *users = NULL;
+  GList *flags = NULL;
+  for (int i = 0; i < CHAT_OCCUPANTS && i < lg->buddies_num; i++) {
+    char name[32];
+    get_buddy_name(i, name, sizeof(name));
+    users = g_list_prepend(users, g_strdup(name));
+    flags = g_list_prepend(flags, GINT_TO_POINTER(PURPLE_CBFLAGS_NONE));
+  }
+  purple_conv_chat_add_users(purple_conversation_get_chat_data(conv), users,
+      NULL, flags, FALSE);
+
+  g_list_foreach(users, (GFunc)g_free, NULL);
+  g_list_free(users);
+  g_list_free(flags);
+  return id;
+}
+
+static void generate_presence(LoadGenData *lg, GRand *rand)
+{
+  char name[32];
+  get_random_buddy_name(rand, lg->buddies_num, name, sizeof(name));
+  purple_prpl_got_user_status(purple_connection_get_account(lg->gc), name,
+      get_random_status(rand), NULL);
+  lg->counts[EVENT_PRESENCE]++;
+}
+
+static void generate_im(LoadGenData *lg, GRand *rand)
+{
+  char name[32];
+  get_random_buddy_name(rand, MIN(lg->im_partners, lg->buddies_num), name,
+      sizeof(name));
+  char *text = get_random_text(rand);
+  serv_got_im(lg->gc, name, text, PURPLE_MESSAGE_RECV, time(NULL));
+  g_free(text);
+  lg->counts[EVENT_IM]++;
+}
+
+static void generate_chat(LoadGenData *lg, GRand *rand)
+{
+  if (!lg->chats->len)
+    return;
+
+  int id = g_array_index(lg->chats, int,
+      g_rand_int_range(rand, 0, lg->chats->len));
+  char name[32];
+  get_random_buddy_name(rand, MIN(CHAT_OCCUPANTS, lg->buddies_num), name,
+      sizeof(name));
+  char *text = get_random_text(rand);
+  serv_got_chat_in(lg->gc, id, name, PURPLE_MESSAGE_RECV, text, time(NULL));
+  g_free(text);
+  lg->counts[EVENT_CHAT]++;
+}
+
+static void generate_typing(LoadGenData *lg, GRand *rand)
+{
+  char name[32];
+  get_random_buddy_name(rand, MIN(lg->im_partners, lg->buddies_num), name,
+      sizeof(name));
+  // the notification expires after a few seconds
+  serv_got_typing(lg->gc, name, 3, PURPLE_TYPING);
+  lg->counts[EVENT_TYPING]++;
+}
+
+static void (* const generators[EVENT_KINDS])(LoadGenData *lg,
+    GRand *rand) = {
+  generate_presence,
+  generate_im,
+  generate_chat,
+  generate_typing
+};
+
+static gboolean parse_script_line(const char *line, ScriptEvent *ev)
+{
+  char kind[16];
+  unsigned long ms;
+  int n = 0;
+  if (sscanf(line, "%lu %15s %n", &ms, kind, &n) != 2)
+    return FALSE;
+  ev->time = ms;
+  memset(ev->args, 0, sizeof(ev->args));
+
+  const char *rest = line + n;
+  int *a = ev->args;
+  if (!strcmp(kind, "presence")) {
+    char status[32];
+    ev->kind = SCRIPT_PRESENCE;
+    if (sscanf(rest, "%d %31s", &a[0], status) != 2)
+      return FALSE;
+    a[1] = purple_primitive_get_type_from_id(status);
+    return a[0] > 0 && a[1] != PURPLE_STATUS_UNSET;
+  }
+  if (!strcmp(kind, "im")) {
+    ev->kind = SCRIPT_IM;
+    return sscanf(rest, "%d %d", &a[0], &a[1]) == 2 && a[0] > 0;
+  }
+  if (!strcmp(kind, "chat")) {
+    ev->kind = SCRIPT_CHAT;
+    return sscanf(rest, "%d %d %d", &a[0], &a[1], &a[2]) == 3 && a[0] > 0
+      && a[1] > 0;
+  }
+  if (!strcmp(kind, "typing")) {
+    ev->kind = SCRIPT_TYPING;
+    return sscanf(rest, "%d %d", &a[0], &a[1]) == 2 && a[0] > 0;
+  }
+  if (!strcmp(kind, "notify")) {
+    ev->kind = SCRIPT_NOTIFY;
+    return sscanf(rest, "%d %d %d %d", &a[0], &a[1], &a[2], &a[3]) == 4;
+  }
+  if (!strcmp(kind, "userinfo")) {
+    ev->kind = SCRIPT_USERINFO;
+    return sscanf(rest, "%d", &a[0]) == 1 && a[0] > 0;
+  }
+  return FALSE;
+}
+
+// returns a newly allocated array of script events or NULL on error
+static GArray *load_script(const char *filename, GError **err)
+{
+  char *contents;
+  if (!g_file_get_contents(filename, &contents, NULL, err))
+    return NULL;
+
+  GArray *script = g_array_new(FALSE, FALSE, sizeof(ScriptEvent));
+  char **lines = g_strsplit(contents, "\n", -1);
+  g_free(contents);
+  for (int i = 0; lines[i]; i++) {
+    const char *line = lines[i];
+    while (g_ascii_isspace(*line))
+      line++;
+    if (!*line || *line == '#')
+      continue;
+
+    ScriptEvent ev;
+    if (!parse_script_line(line, &ev)) {
+      g_set_error(err, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+          _("Invalid line %d in the script file '%s'."), i + 1, filename);
+      g_array_free(script, TRUE);
+      script = NULL;
+      break;
+    }
+    g_array_append_val(script, ev);
+  }
+  g_strfreev(lines);
+
+  return script;
+}
+
+// creates buddies and joins chat rooms used by the script
+static void prepare_script(LoadGenData *lg)
+{
+  PurpleAccount *account = purple_connection_get_account(lg->gc);
+
+  int users = 0;
+  int rooms = 0;
+  for (guint i = 0; i < lg->script->len; i++) {
+    ScriptEvent *ev = &g_array_index(lg->script, ScriptEvent, i);
+    if (ev->kind == SCRIPT_CHAT) {
+      rooms = MAX(rooms, ev->args[0]);
+      users = MAX(users, ev->args[1]);
+    }
+    else if (ev->kind != SCRIPT_NOTIFY)
+      users = MAX(users, ev->args[0]);
+  }
+
+  /* The script refers to users by numbers starting from 1, the buddy names
+   * start from 0. All buddies start offline, the script brings them
+   * online. */
+  PurpleGroup *group = purple_find_group("Load 00");
+  if (!group) {
+    group = purple_group_new("Load 00");
+    purple_blist_add_group(group, NULL);
+  }
+  for (int i = 0; i < users; i++) {
+    char name[32];
+    get_buddy_name(i, name, sizeof(name));
+    if (!purple_find_buddy(account, name))
+      purple_blist_add_buddy(purple_buddy_new(account, name, NULL), NULL,
+          group, NULL);
+  }
+
+  lg->rooms = g_array_new(FALSE, TRUE, sizeof(int));
+  g_array_set_size(lg->rooms, rooms + 1);
+  for (int i = 1; i <= rooms; i++) {
+    char *room = g_strdup_printf("room%02d", i);
+    g_array_index(lg->rooms, int, i) = join_chat(lg, room);
+    g_free(room);
+  }
+}
+
+static void play_script_event(LoadGenData *lg, const ScriptEvent *ev)
+{
+  PurpleAccount *account = purple_connection_get_account(lg->gc);
+  const int *a = ev->args;
+  char name[32];
+  char *text;
+
+  switch (ev->kind) {
+    case SCRIPT_PRESENCE:
+      get_buddy_name(a[0] - 1, name, sizeof(name));
+      purple_prpl_got_user_status(account, name,
+          purple_primitive_get_id_from_type(a[1]), NULL);
+      lg->counts[EVENT_PRESENCE]++;
+      break;
+    case SCRIPT_IM:
+      get_buddy_name(a[0] - 1, name, sizeof(name));
+      text = get_text_of_length(a[1]);
+      serv_got_im(lg->gc, name, text, PURPLE_MESSAGE_RECV, time(NULL));
+      g_free(text);
+      lg->counts[EVENT_IM]++;
+      break;
+    case SCRIPT_CHAT:
+      if (!g_array_index(lg->rooms, int, a[0]))
+        break;
+      get_buddy_name(a[1] - 1, name, sizeof(name));
+      text = get_text_of_length(a[2]);
+      serv_got_chat_in(lg->gc, g_array_index(lg->rooms, int, a[0]), name,
+          PURPLE_MESSAGE_RECV, text, time(NULL));
+      g_free(text);
+      lg->counts[EVENT_CHAT]++;
+      break;
+    case SCRIPT_TYPING:
+      get_buddy_name(a[0] - 1, name, sizeof(name));
+      if (a[1] == PURPLE_NOT_TYPING)
+        serv_got_typing_stopped(lg->gc, name);
+      else
+        serv_got_typing(lg->gc, name, 0, a[1]);
+      lg->counts[EVENT_TYPING]++;
+      break;
+    case SCRIPT_NOTIFY:
+      {
+        char *title = get_text_of_length(a[1]);
+        char *primary = get_text_of_length(a[2]);
+        char *secondary = get_text_of_length(a[3]);
+        purple_notify_message(lg->gc, a[0], title, primary,
+            a[3] ? secondary : NULL, NULL, NULL);
+        g_free(title);
+        g_free(primary);
+        g_free(secondary);
+      }
+      break;
+    case SCRIPT_USERINFO:
+      {
+        get_buddy_name(a[0] - 1, name, sizeof(name));
+        PurpleNotifyUserInfo *info = purple_notify_user_info_new();
+        purple_notify_userinfo(lg->gc, name, info, NULL, NULL);
+        purple_notify_user_info_destroy(info);
+      }
+      break;
+  }
+}
+
+// replays all script events that are due
+static void play_script(LoadGenData *lg)
+{
+  gint64 now = get_time() - lg->script_start;
+  for (int n = 0; n < MAX_EVENTS_PER_TICK && lg->script_pos < lg->script->len;
+      n++) {
+    ScriptEvent *ev = &g_array_index(lg->script, ScriptEvent,
+        lg->script_pos);
+    if (ev->time > now)
+      return;
+    lg->script_pos++;
+    play_script_event(lg, ev);
+  }
+}
+
+// generates events of all kinds that are due in one tick
+static void generate_tick(LoadGenData *lg)
+{
+  for (int k = 0; k < EVENT_KINDS; k++) {
+    lg->due[k] += (double)lg->rates[k] * TICK_INTERVAL / 1000;
+    int n = (int)lg->due[k];
+    lg->due[k] -= n;
+
+    n = MIN(n, MAX_EVENTS_PER_TICK);
+    for (int i = 0; i < n; i++)
+      generators[k](lg, lg->rands[k]);
+  }
+}
+
+static gboolean tick(gpointer data)
+{
+  LoadGenData *lg = data;
+
+  if (lg->script) {
+    play_script(lg);
+    return TRUE;
+  }
+
+  /* The timer only paces the generator, the events depend only on the
+   * number of ticks. If the main loop is too late, the rest of the delay is
+   * skipped instead of being caught up. */
+  gint64 now = get_time();
+  gint64 ticks = (now - lg->last_tick) / TICK_INTERVAL;
+  if (ticks > MAX_LATE_TICKS) {
+    lg->last_tick = now - MAX_LATE_TICKS * TICK_INTERVAL;
+    ticks = MAX_LATE_TICKS;
+  }
+  lg->last_tick += ticks * TICK_INTERVAL;
+
+  for (gint64 i = 0; i < ticks; i++)
+    generate_tick(lg);
+
+  return TRUE;
+}
+
+static void report(LoadGenData *lg, int seconds)
+{
+  purple_debug_info("loadgen", "%s: generated %u presence changes, %u IMs, "
+      "%u chat messages and %u typing notifications in %d s.\n",
+      purple_account_get_username(purple_connection_get_account(lg->gc)),
+      lg->counts[EVENT_PRESENCE], lg->counts[EVENT_IM],
+      lg->counts[EVENT_CHAT], lg->counts[EVENT_TYPING], seconds);
+
+  memset(lg->counts, 0, sizeof(lg->counts));
+}
+
+static gboolean report_timeout(gpointer data)
+{
+  report(data, REPORT_INTERVAL);
+  return TRUE;
+}
+
+// prpl
+static const char *loadgen_list_icon(PurpleAccount *account,
+    PurpleBuddy *buddy)
+{
+  UNUSED(account);
+  UNUSED(buddy);
+
+  return "loadgen";
+}
+
+static GList *loadgen_status_types(PurpleAccount *account)
+{
+  UNUSED(account);
+
+  GList *types = NULL;
+  types = g_list_append(types, purple_status_type_new(
+        PURPLE_STATUS_AVAILABLE, NULL, NULL, TRUE));
+  types = g_list_append(types, purple_status_type_new(
+        PURPLE_STATUS_AWAY, NULL, NULL, TRUE));
+  types = g_list_append(types, purple_status_type_new(
+        PURPLE_STATUS_OFFLINE, NULL, NULL, TRUE));
+  return types;
+}
+
+static GList *loadgen_chat_info(PurpleConnection *gc)
+{
+  UNUSED(gc);
+
+  struct proto_chat_entry *pce = g_new0(struct proto_chat_entry, 1);
+  pce->label = _("_Room:");
+  pce->identifier = "room";
+  pce->required = TRUE;
+  return g_list_append(NULL, pce);
+}
+
+static GHashTable *loadgen_chat_info_defaults(PurpleConnection *gc,
+    const char *chat_name)
+{
+  UNUSED(gc);
+
+  GHashTable *defaults = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+      g_free);
+  if (chat_name)
+    g_hash_table_insert(defaults, "room", g_strdup(chat_name));
+  return defaults;
+}
+
+static void loadgen_login(PurpleAccount *account)
+{
+  PurpleConnection *gc = purple_account_get_connection(account);
+
+  // all generated events are sent by buddies
+  int buddies_num = purple_account_get_int(account, "buddies", 1000);
+  if (buddies_num < 1) {
+    purple_connection_error_reason(gc,
+        PURPLE_CONNECTION_ERROR_INVALID_SETTINGS,
+        _("The number of buddies has to be at least 1."));
+    return;
+  }
+
+  // a script replaces the random events
+  GArray *script = NULL;
+  const char *script_file = purple_account_get_string(account, "script",
+      NULL);
+  if (script_file && script_file[0]) {
+    GError *err = NULL;
+    if (!(script = load_script(script_file, &err))) {
+      purple_connection_error_reason(gc,
+          PURPLE_CONNECTION_ERROR_INVALID_SETTINGS, err->message);
+      g_clear_error(&err);
+      return;
+    }
+  }
+
+  LoadGenData *lg = g_new0(LoadGenData, 1);
+  lg->gc = gc;
+  lg->script = script;
+  lg->buddies_num = buddies_num;
+  lg->groups_num = purple_account_get_int(account, "groups", 20);
+  lg->im_partners = purple_account_get_int(account, "im_partners", 20);
+  lg->rates[EVENT_PRESENCE] = purple_account_get_int(account,
+      "presence_rate", 20);
+  lg->rates[EVENT_IM] = purple_account_get_int(account, "im_rate", 5);
+  lg->rates[EVENT_CHAT] = purple_account_get_int(account, "chat_rate", 100);
+  lg->rates[EVENT_TYPING] = purple_account_get_int(account, "typing_rate",
+      2);
+
+  /* Every kind of events has its own sequence so changing the rate of one
+   * kind doesn't change events of the other kinds. */
+  guint32 seed[2];
+  seed[0] = purple_account_get_int(account, "seed", 1);
+  for (int k = 0; k < EVENT_KINDS; k++) {
+    seed[1] = k;
+    lg->rands[k] = g_rand_new_with_seed_array(seed, G_N_ELEMENTS(seed));
+  }
+
+  lg->chats = g_array_new(FALSE, FALSE, sizeof(int));
+  lg->next_chat_id = 1;
+  purple_connection_set_protocol_data(gc, lg);
+
+  purple_connection_set_state(gc, PURPLE_CONNECTED);
+
+  if (lg->script)
+    prepare_script(lg);
+  else {
+    create_buddies(lg);
+
+    int chats = purple_account_get_int(account, "chats", 2);
+    for (int i = 0; i < chats; i++) {
+      char *room = g_strdup_printf("room%02d", i);
+      join_chat(lg, room);
+      g_free(room);
+    }
+  }
+
+  lg->last_tick = get_time();
+  lg->script_start = lg->last_tick;
+  lg->tick_timer = purple_timeout_add(TICK_INTERVAL, tick, lg);
+  lg->report_timer = purple_timeout_add_seconds(REPORT_INTERVAL,
+      report_timeout, lg);
+}
+
+static void loadgen_close(PurpleConnection *gc)
+{
+  LoadGenData *lg = purple_connection_get_protocol_data(gc);
+  if (!lg)
+    return;
+
+  purple_timeout_remove(lg->tick_timer);
+  purple_timeout_remove(lg->report_timer);
+  for (int k = 0; k < EVENT_KINDS; k++)
+    g_rand_free(lg->rands[k]);
+  g_array_free(lg->chats, TRUE);
+  if (lg->script)
+    g_array_free(lg->script, TRUE);
+  if (lg->rooms)
+    g_array_free(lg->rooms, TRUE);
+  g_free(lg);
+  purple_connection_set_protocol_data(gc, NULL);
+}
+
+static int loadgen_send_im(PurpleConnection *gc, const char *who,
+    const char *message, PurpleMessageFlags flags)
+{
+  UNUSED(gc);
+  UNUSED(who);
+  UNUSED(message);
+  UNUSED(flags);
+
+  // the message is accepted and dropped
+  return 1;
+}
+
+static unsigned int loadgen_send_typing(PurpleConnection *gc,
+    const char *name, PurpleTypingState state)
+{
+  UNUSED(gc);
+  UNUSED(name);
+  UNUSED(state);
+
+  return 0;
+}
+
+static void loadgen_set_status(PurpleAccount *account, PurpleStatus *status)
+{
+  UNUSED(account);
+  UNUSED(status);
+}
+
+static void loadgen_add_buddy(PurpleConnection *gc, PurpleBuddy *buddy,
+    PurpleGroup *group)
+{
+  UNUSED(gc);
+  UNUSED(buddy);
+  UNUSED(group);
+}
+
+static void loadgen_remove_buddy(PurpleConnection *gc, PurpleBuddy *buddy,
+    PurpleGroup *group)
+{
+  UNUSED(gc);
+  UNUSED(buddy);
+  UNUSED(group);
+}
+
+static void loadgen_join_chat(PurpleConnection *gc, GHashTable *components)
+{
+  const char *room = g_hash_table_lookup(components, "room");
+  if (!room || !room[0])
+    return;
+
+  join_chat(purple_connection_get_protocol_data(gc), room);
+}
+
+static char *loadgen_get_chat_name(GHashTable *components)
+{
+  return g_strdup(g_hash_table_lookup(components, "room"));
+}
+
+static void loadgen_chat_leave(PurpleConnection *gc, int id)
+{
+  LoadGenData *lg = purple_connection_get_protocol_data(gc);
+  for (guint i = 0; i < lg->chats->len; i++)
+    if (g_array_index(lg->chats, int, i) == id) {
+      g_array_remove_index_fast(lg->chats, i);
+      break;
+    }
+}
+
+static int loadgen_chat_send(PurpleConnection *gc, int id,
+    const char *message, PurpleMessageFlags flags)
+{
+  // show the message in the room as a server would
+  serv_got_chat_in(gc, id,
+      purple_account_get_username(purple_connection_get_account(gc)), flags,
+      message, time(NULL));
+  return 0;
+}
+
+static PurplePluginInfo info = {
+  PURPLE_PLUGIN_MAGIC,
+  PURPLE_MAJOR_VERSION,
+  PURPLE_MINOR_VERSION,
+  PURPLE_PLUGIN_PROTOCOL,
+  NULL,
+  0,
+  NULL,
+  PURPLE_PRIORITY_DEFAULT,
+  PLUGIN_ID,
+  N_("Load Generator"),
+  "1.0",
+  N_("Generates synthetic load for testing."),
+  N_("Fabricates buddy lists, presence changes, instant messages, chat "
+      "messages and typing notifications at configurable rates without "
+      "connecting anywhere."),
+  "CenterIM developers",
+  PACKAGE_URL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  &prpl_info,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL
+};
+
+static void add_int_option(const char *text, const char *pref_name,
+    int default_value)
+{
+  prpl_info.protocol_options = g_list_append(prpl_info.protocol_options,
+      purple_account_option_int_new(text, pref_name, default_value));
+}
+
+static void init_plugin(PurplePlugin *plugin)
+{
+  UNUSED(plugin);
+
+  prpl_info.options = OPT_PROTO_NO_PASSWORD;
+  prpl_info.list_icon = loadgen_list_icon;
+  prpl_info.status_types = loadgen_status_types;
+  prpl_info.chat_info = loadgen_chat_info;
+  prpl_info.chat_info_defaults = loadgen_chat_info_defaults;
+  prpl_info.login = loadgen_login;
+  prpl_info.close = loadgen_close;
+  prpl_info.send_im = loadgen_send_im;
+  prpl_info.send_typing = loadgen_send_typing;
+  prpl_info.set_status = loadgen_set_status;
+  prpl_info.add_buddy = loadgen_add_buddy;
+  prpl_info.remove_buddy = loadgen_remove_buddy;
+  prpl_info.join_chat = loadgen_join_chat;
+  prpl_info.get_chat_name = loadgen_get_chat_name;
+  prpl_info.chat_leave = loadgen_chat_leave;
+  prpl_info.chat_send = loadgen_chat_send;
+  prpl_info.struct_size = sizeof(PurplePluginProtocolInfo);
+
+  add_int_option(_("Random seed"), "seed", 1);
+  add_int_option(_("Number of buddies"), "buddies", 1000);
+  add_int_option(_("Number of groups"), "groups", 20);
+  add_int_option(_("Number of buddies sending IMs"), "im_partners", 20);
+  add_int_option(_("Number of chat rooms"), "chats", 2);
+  add_int_option(_("Presence changes per second"), "presence_rate", 20);
+  add_int_option(_("IMs per second"), "im_rate", 5);
+  add_int_option(_("Chat messages per second"), "chat_rate", 100);
+  add_int_option(_("Typing notifications per second"), "typing_rate", 2);
+  prpl_info.protocol_options = g_list_append(prpl_info.protocol_options,
+      purple_account_option_string_new(_("Script file (replaces the random "
+          "events)"), "script", ""));
+}
+
+PURPLE_INIT_PLUGIN(loadgen, init_plugin, info)
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -22,6 +22,8 @@
 #ifndef __ACCOUNTS_H__
 #define __ACCOUNTS_H__
 
+#include "Watchdog.h"
+
 #include <cppconsui/SplitDialog.h>
 #include <cppconsui/TreeView.h>
 #include <libpurple/purple.h>
@@ -165,7 +167,11 @@ private:
       const char *id, const char *alias, const char *message)
     { ACCOUNTS->notify_added(account, remote_user, id, alias, message); }
   static void status_changed_(PurpleAccount *account, PurpleStatus *status)
-    { ACCOUNTS->status_changed(account, status); }
+  {
+    Watchdog::Scope scope(Watchdog::SOURCE_UI_OP, "status-changed", NULL,
+        account);
+    ACCOUNTS->status_changed(account, status);
+  }
   static void request_add_(PurpleAccount *account, const char *remote_user,
       const char *id, const char *alias, const char *message)
     { ACCOUNTS->request_add(account, remote_user, id, alias, message); }
@@ -473,7 +473,7 @@ void BuddyList::AddGroupWindow::onAddRequest(CppConsUI::Button& /*activator*/)
 }
 
 BuddyList::BuddyList()
-: Window(0, 0, 80, 24)
+: Window(0, 0, 80, 24), loading(false)
 {
   setColorScheme("buddylist");
 
@@ -485,6 +485,8 @@ BuddyList::BuddyList()
   lbox->appendWidget(*hbox);
   hbox->appendWidget(*(new CppConsUI::Spacer(1, AUTOSIZE)));
   treeview = new CppConsUI::TreeView(AUTOSIZE, AUTOSIZE);
+  treeview->signal_collapsed_change.connect(sigc::mem_fun(this,
+        &BuddyList::onTreeViewCollapsedChange));
   hbox->appendWidget(*treeview);
   hbox->appendWidget(*(new CppConsUI::Spacer(1, AUTOSIZE)));
 
@@ -541,13 +543,15 @@ BuddyList::BuddyList()
   //centerim_blist_ui_ops.save_account = save_account_;
   purple_blist_set_ui_ops(&centerim_blist_ui_ops);
 
-  COREMANAGER->timeoutOnceConnect(sigc::mem_fun(this, &BuddyList::load), 0);
+  COREMANAGER->timeoutOnceConnect(sigc::mem_fun(this, &BuddyList::load), 0,
+      G_PRIORITY_DEFAULT, "buddylist-load");
 
   declareBindables();
 }
 
 BuddyList::~BuddyList()
 {
+  build_conn.disconnect();
   purple_blist_set_ui_ops(NULL);
   purple_prefs_disconnect_by_handle(this);
 }
@@ -570,21 +574,34 @@ void BuddyList::finalize()
 
 void BuddyList::load()
 {
-  // load the buddy list from ~/.centerim5/blist.xml
+  /* Load the buddy list from ~/.centerim5/blist.xml. Only group widgets are
+   * created during the load, other nodes are created after it when the
+   * collapsed state of groups is known. */
+  loading = true;
   purple_blist_load();
+  loading = false;
 
   delayedGroupNodesInit();
+
+  // fill the screen now, the rest is created when the UI is idle
+  if (buildNodes(getScreenRows()))
+    scheduleBuild();
 }
 
 void BuddyList::rebuildList()
 {
   treeview->clear();
 
-  PurpleBlistNode *node = purple_blist_get_root();
-  while (node) {
-    new_node(node);
-    node = purple_blist_node_next(node, TRUE);
-  }
+  // recreate the groups and build their children incrementally again
+  for (PurpleBlistNode *node = purple_blist_get_root(); node;
+      node = purple_blist_node_get_sibling_next(node))
+    if (PURPLE_BLIST_NODE_IS_GROUP(node)) {
+      pending_groups[node] = NULL;
+      new_node(node);
+    }
+
+  if (buildNodes(getScreenRows()))
+    scheduleBuild();
 }
 
 void BuddyList::updateList(int flags)
@@ -613,6 +630,138 @@ void BuddyList::delayedGroupNodesInit()
     }
 }
 
+bool BuddyList::isNodeDeferred(PurpleBlistNode *node) const
+{
+  if (PURPLE_BLIST_NODE_IS_GROUP(node))
+    return false;
+
+  // find the group that the node belongs to
+  PurpleBlistNode *group = purple_blist_node_get_parent(node);
+  while (group && !PURPLE_BLIST_NODE_IS_GROUP(group))
+    group = purple_blist_node_get_parent(group);
+
+  /* A node without a parent is just being added. All nodes are added when
+   * the list is being loaded, other nodes are added by the user or by
+   * a protocol and are created at once. */
+  if (!group)
+    return loading;
+  return pending_groups.count(group);
+}
+
+void BuddyList::addNode(PurpleBlistNode *node)
+{
+  BuddyListNode *bnode = BuddyListNode::createNode(node);
+  if (!bnode)
+    return;
+
+  BuddyListNode *parent = bnode->getParentNode();
+  CppConsUI::TreeView::NodeReference nref = treeview->appendNode(
+      parent ? parent->getRefNode() : treeview->getRootNode(), *bnode);
+  bnode->setRefNode(nref);
+  bnode->update();
+}
+
+bool BuddyList::buildNodes(int limit)
+{
+  for (PurpleBlistNode *group = purple_blist_get_root(); group;
+      group = purple_blist_node_get_sibling_next(group)) {
+    if (!pending_groups.count(group))
+      continue;
+    // there are no collapsed groups in the flat mode
+    if (list_mode != LIST_FLAT && purple_blist_node_get_bool(group,
+          "collapsed"))
+      continue;
+
+    if (limit <= 0)
+      return true;
+    limit = buildGroupNodes(group, limit);
+  }
+
+  return false;
+}
+
+int BuddyList::buildGroupNodes(PurpleBlistNode *group, int limit)
+{
+  PendingGroups::iterator i = pending_groups.find(group);
+  if (i == pending_groups.end())
+    return limit;
+
+  /* Nodes are created in the order of the tree so parents are always
+   * created before their children. The scan continues where the previous
+   * batch stopped. Nodes that were added in front of that place in the
+   * meantime are found by one more pass from the first child. */
+  bool resumed = i->second;
+  PurpleBlistNode *node = resumed ? i->second
+    : purple_blist_node_get_first_child(group);
+  while (true) {
+    while (node && !PURPLE_BLIST_NODE_IS_GROUP(node)) {
+      if (!purple_blist_node_get_ui_data(node)) {
+        // only direct children of the group occupy a row
+        if (purple_blist_node_get_parent(node) == group) {
+          // don't stop between a contact and its buddies
+          if (limit <= 0) {
+            i->second = node;
+            return 0;
+          }
+          limit--;
+        }
+        addNode(node);
+      }
+      node = purple_blist_node_next(node, TRUE);
+    }
+
+    if (!resumed)
+      break;
+    resumed = false;
+    node = purple_blist_node_get_first_child(group);
+  }
+
+  pending_groups.erase(i);
+  return limit;
+}
+
+void BuddyList::scheduleBuild()
+{
+  if (build_conn.connected())
+    return;
+
+  build_conn = COREMANAGER->timeoutConnect(sigc::mem_fun(this,
+        &BuddyList::onBuildTimeout), 0, G_PRIORITY_DEFAULT_IDLE,
+      "buddylist-build");
+}
+
+bool BuddyList::onBuildTimeout()
+{
+  return buildNodes(BUILD_BATCH);
+}
+
+void BuddyList::onTreeViewCollapsedChange(
+    CppConsUI::TreeView& /*activator*/,
+    CppConsUI::TreeView::NodeReference node, bool collapsed)
+{
+  BuddyListGroup *gnode = dynamic_cast<BuddyListGroup*>(node->getRow());
+  if (!gnode)
+    return;
+
+  /* The state is also set when the group is created from the saved value,
+   * don't write the buddy list back in that case. */
+  PurpleBlistNode *group = gnode->getPurpleBlistNode();
+  if (purple_blist_node_get_bool(group, "collapsed") != collapsed)
+    purple_blist_node_set_bool(group, "collapsed", collapsed);
+
+  if (collapsed || !pending_groups.count(group))
+    return;
+
+  // show the first screen of the group now and the rest later
+  buildGroupNodes(group, getScreenRows());
+  scheduleBuild();
+}
+
+int BuddyList::getScreenRows() const
+{
+  return CENTERIM->getScreenArea(CenterIM::BUDDY_LIST_AREA).height;
+}
+
 void BuddyList::updateCachedPreference(const char *name)
 {
   if (!strcmp(name, CONF_PREFIX "/blist/show_empty_groups"))
@@ -724,20 +873,20 @@ void BuddyList::new_node(PurpleBlistNode *node)
 {
   g_return_if_fail(!purple_blist_node_get_ui_data(node));
 
-  if (PURPLE_BLIST_NODE_IS_GROUP(node) && list_mode == BuddyList::LIST_FLAT) {
-    // flat mode = no groups
-    return;
-  }
+  if (PURPLE_BLIST_NODE_IS_GROUP(node)) {
+    // children of loaded groups are created later
+    if (loading)
+      pending_groups[node] = NULL;
 
-  BuddyListNode *bnode = BuddyListNode::createNode(node);
-  if (!bnode)
+    if (list_mode == BuddyList::LIST_FLAT) {
+      // flat mode = no groups
+      return;
+    }
+  }
+  else if (isNodeDeferred(node))
     return;
 
-  BuddyListNode *parent = bnode->getParentNode();
-  CppConsUI::TreeView::NodeReference nref = treeview->appendNode(
-      parent ? parent->getRefNode() : treeview->getRootNode(), *bnode);
-  bnode->setRefNode(nref);
-  bnode->update();
+  addNode(node);
 }
 
 void BuddyList::update(PurpleBuddyList *list, PurpleBlistNode *node)
@@ -749,18 +898,30 @@ void BuddyList::update(PurpleBuddyList *list, PurpleBlistNode *node)
 
   BuddyListNode *bnode = reinterpret_cast<BuddyListNode*>(
       purple_blist_node_get_ui_data(node));
-  if (!bnode)
+  if (bnode) {
+    // update the node data
+    bnode->update();
+  }
+  else if (!isNodeDeferred(node))
     return;
 
-  // update the node data
-  bnode->update();
-
+  // the parent of a deferred node can exist and show its size
   if (node->parent)
     update(list, node->parent);
 }
 
 void BuddyList::remove(PurpleBuddyList *list, PurpleBlistNode *node)
 {
+  if (PURPLE_BLIST_NODE_IS_GROUP(node))
+    pending_groups.erase(node);
+  else {
+    // the scan of a pending group can't continue from a removed node
+    for (PendingGroups::iterator i = pending_groups.begin();
+        i != pending_groups.end(); i++)
+      if (i->second == node)
+        i->second = NULL;
+  }
+
   BuddyListNode *bnode = reinterpret_cast<BuddyListNode*>(
       purple_blist_node_get_ui_data(node));
   if (!bnode)
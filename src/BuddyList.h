@@ -23,6 +23,8 @@
 #define __BUDDYLIST_H__
 
 #include "BuddyListNode.h"
+#include "Tracer.h"
+#include "Watchdog.h"
 
 #include <cppconsui/Button.h>
 #include <cppconsui/CheckBox.h>
@@ -30,6 +32,7 @@
 #include <cppconsui/TreeView.h>
 #include <cppconsui/SplitDialog.h>
 #include <cppconsui/Window.h>
+#include <map>
 
 #define BUDDYLIST (BuddyList::instance())
 
@@ -92,6 +95,18 @@ private:
     UPDATE_OTHERS = 1 << 1
   };
 
+  /**
+   * Number of rows that are created by one idle callback when the list is
+   * built incrementally.
+   */
+  enum { BUILD_BATCH = 64 };
+
+  /**
+   * Maps a group to the child node where creating of its widgets continues,
+   * NULL means the first child.
+   */
+  typedef std::map<PurpleBlistNode*, PurpleBlistNode*> PendingGroups;
+
   class Filter
   : public CppConsUI::Widget
   {
@@ -295,6 +310,16 @@ private:
   GroupSortMode group_sort_mode;
   ColorizationMode colorization_mode;
 
+  /**
+   * Groups whose contacts, buddies and chats don't have their widgets yet.
+   * Widgets are created in batches from an idle callback, children of
+   * collapsed groups are created when the group is expanded.
+   */
+  PendingGroups pending_groups;
+  // true while purple_blist_load() is running
+  bool loading;
+  sigc::connection build_conn;
+
   Filter *filter;
   char filter_buffer[256];
   // length in bytes
@@ -317,6 +342,26 @@ private:
   void rebuildList();
   void updateList(int flags);
   void delayedGroupNodesInit();
+  // returns true if the widget for a given node shouldn't be created yet
+  bool isNodeDeferred(PurpleBlistNode *node) const;
+  void addNode(PurpleBlistNode *node);
+  /**
+   * Creates widgets of pending nodes in expanded groups. At most limit rows
+   * are created. Returns true if there are more nodes to create.
+   */
+  bool buildNodes(int limit);
+  // returns the number of rows that can be still created
+  int buildGroupNodes(PurpleBlistNode *group, int limit);
+  void scheduleBuild();
+  bool onBuildTimeout();
+  /**
+   * Saves the collapsed state of a group and creates its nodes if the group
+   * was expanded and they haven't been created yet.
+   */
+  void onTreeViewCollapsedChange(CppConsUI::TreeView& activator,
+      CppConsUI::TreeView::NodeReference node, bool collapsed);
+  // returns the number of rows that fill the buddy list area
+  int getScreenRows() const;
   void updateCachedPreference(const char *name);
   bool isAnyAccountConnected();
   void filterHide();
@@ -327,11 +372,29 @@ private:
   static void new_list_(PurpleBuddyList *list)
     { BUDDYLIST->new_list(list); }
   static void new_node_(PurpleBlistNode *node)
-    { BUDDYLIST->new_node(node); }
+  {
+    if (TRACER)
+      TRACER->recordBlistNode(Tracer::UI_OP_BLIST_NEW_NODE, node);
+    Watchdog::Scope scope(Watchdog::SOURCE_UI_OP, "blist-new-node", NULL,
+        Watchdog::getNodeAccount(node));
+    BUDDYLIST->new_node(node);
+  }
   static void update_(PurpleBuddyList *list, PurpleBlistNode *node)
-    { BUDDYLIST->update(list, node); }
+  {
+    if (TRACER)
+      TRACER->recordBlistNode(Tracer::UI_OP_BLIST_UPDATE, node);
+    Watchdog::Scope scope(Watchdog::SOURCE_UI_OP, "blist-update", NULL,
+        Watchdog::getNodeAccount(node));
+    BUDDYLIST->update(list, node);
+  }
   static void remove_(PurpleBuddyList *list, PurpleBlistNode *node)
-    { BUDDYLIST->remove(list, node); }
+  {
+    if (TRACER)
+      TRACER->recordBlistNode(Tracer::UI_OP_BLIST_REMOVE, node);
+    Watchdog::Scope scope(Watchdog::SOURCE_UI_OP, "blist-remove", NULL,
+        Watchdog::getNodeAccount(node));
+    BUDDYLIST->remove(list, node);
+  }
   static void destroy_(PurpleBuddyList *list)
     { BUDDYLIST->destroy(list); }
   static void request_add_buddy_(PurpleAccount *account,
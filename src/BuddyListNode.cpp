@@ -44,17 +44,15 @@ BuddyListNode *BuddyListNode::createNode(PurpleBlistNode *node)
   return NULL;
 }
 
-void BuddyListNode::setParent(CppConsUI::Container& parent)
+CppConsUI::Widget *BuddyListNode::createRowWidget()
 {
-  Button::setParent(parent);
-
-  treeview = dynamic_cast<CppConsUI::TreeView*>(&parent);
-  g_assert(treeview);
+  return new RowWidget(*this);
 }
 
 void BuddyListNode::setRefNode(CppConsUI::TreeView::NodeReference n)
 {
   ref = n;
+  treeview = ref->getTreeView();
   treeview->setCollapsed(ref, true);
 }
 
@@ -116,15 +114,15 @@ void BuddyListNode::sortIn()
     else
       stop_flag = true;
 
-    BuddyListNode *swidget = dynamic_cast<BuddyListNode*>(sref->getWidget());
-    g_assert(swidget);
+    BuddyListNode *snode = dynamic_cast<BuddyListNode*>(sref->getRow());
+    g_assert(snode);
     CppConsUI::TreeView::SiblingIterator j = sref;
     j++;
     while (j != parent_ref.end()) {
-      BuddyListNode *n = dynamic_cast<BuddyListNode*>(j->getWidget());
+      BuddyListNode *n = dynamic_cast<BuddyListNode*>(j->getRow());
       g_assert(n);
 
-      if (swidget->lessOrEqual(*n)) {
+      if (snode->lessOrEqual(*n)) {
         treeview->moveNodeBefore(sref, j);
         break;
       }
@@ -149,13 +147,52 @@ BuddyListNode *BuddyListNode::getParentNode() const
       purple_blist_node_get_ui_data(parent));
 }
 
+BuddyListNode::RowWidget::RowWidget(BuddyListNode& parent_node_)
+: Widget(AUTOSIZE, 1), parent_node(&parent_node_)
+{
+  can_focus = true;
+  declareBindables();
+}
+
+void BuddyListNode::RowWidget::draw()
+{
+  proceedUpdateArea();
+
+  if (!area)
+    return;
+
+  parent_node->drawLabel(*area, 0, 0, area->getmaxx(), has_focus);
+}
+
+void BuddyListNode::RowWidget::actionActivate()
+{
+  parent_node->onActivate();
+}
+
+void BuddyListNode::RowWidget::actionOpenContextMenu()
+{
+  parent_node->openContextMenu();
+}
+
+void BuddyListNode::RowWidget::declareBindables()
+{
+  declareBindable("button", "activate", sigc::mem_fun(this,
+        &RowWidget::actionActivate), InputProcessor::BINDABLE_NORMAL);
+  declareBindable("buddylist", "contextmenu", sigc::mem_fun(this,
+        &RowWidget::actionOpenContextMenu), InputProcessor::BINDABLE_NORMAL);
+}
+
 BuddyListNode::ContextMenu::ContextMenu(BuddyListNode& parent_node_)
-: MenuWindow(parent_node_, AUTOSIZE, AUTOSIZE), parent_node(&parent_node_)
+: MenuWindow(0, 0, AUTOSIZE, AUTOSIZE), parent_node(&parent_node_)
 {
+  // the menu is opened from the focused node so the node has a widget
+  CppConsUI::Widget *ref_widget = parent_node->getRefNode()->getWidget();
+  if (ref_widget)
+    setRefWidget(*ref_widget);
 }
 
-void BuddyListNode::ContextMenu::onMenuAction(Button& /*activator*/,
-    PurpleCallback callback, void *data)
+void BuddyListNode::ContextMenu::onMenuAction(
+    CppConsUI::Button& /*activator*/, PurpleCallback callback, void *data)
 {
   g_assert(callback);
 
@@ -239,11 +276,9 @@ void BuddyListNode::ContextMenu::appendExtendedMenu()
 }
 
 BuddyListNode::BuddyListNode(PurpleBlistNode *node_)
-: treeview(NULL), blist_node(node_), last_activity(0)
+: treeview(NULL), blist_node(node_), last_activity(0), visible(false)
 {
   purple_blist_node_set_ui_data(blist_node, this);
-  signal_activate.connect(sigc::mem_fun(this, &BuddyListNode::onActivate));
-  declareBindables();
 }
 
 BuddyListNode::~BuddyListNode()
@@ -276,12 +311,18 @@ bool BuddyListNode::lessOrEqualByBuddySort(PurpleBuddy *left,
       break;
     case BuddyList::BUDDY_SORT_BY_ACTIVITY:
       {
+        /* The buddies don't have to be created yet if the list is being
+         * built, read the activity from libpurple then. */
         BuddyListNode *bnode_left = reinterpret_cast<BuddyListNode*>(
             purple_blist_node_get_ui_data(PURPLE_BLIST_NODE(left)));
         BuddyListNode *bnode_right = reinterpret_cast<BuddyListNode*>(
             purple_blist_node_get_ui_data(PURPLE_BLIST_NODE(right)));
-        a = bnode_left->last_activity;
-        b = bnode_right->last_activity;
+        a = bnode_left ? bnode_left->last_activity
+          : purple_blist_node_get_int(PURPLE_BLIST_NODE(left),
+              "last_activity");
+        b = bnode_right ? bnode_right->last_activity
+          : purple_blist_node_get_int(PURPLE_BLIST_NODE(right),
+              "last_activity");
         if (a != b)
           return a > b;
       }
@@ -337,9 +378,66 @@ int BuddyListNode::getBuddyStatusWeight(PurpleBuddy *buddy) const
   }
 }
 
+void BuddyListNode::drawText(CppConsUI::Curses::Window& area, int x, int y,
+    int w, bool focus, const char *text, const char *suffix) const
+{
+  int attrs;
+  if (focus)
+    attrs = getColorPair("focus") | CppConsUI::Curses::Attr::REVERSE;
+  else
+    attrs = getColorPair("normal");
+  area.attron(attrs);
+
+  int printed = area.mvaddstring(x, y, w, text);
+  if (suffix)
+    area.mvaddstring(x + printed, y, w - printed, suffix);
+
+  area.attroff(attrs);
+}
+
+int BuddyListNode::getBuddyColorPair(const char *scheme, PurpleBuddy *buddy,
+    const char *property) const
+{
+  switch (BUDDYLIST->getColorizationMode()) {
+    case BuddyList::COLOR_BY_STATUS:
+      {
+        char *status_scheme = Utils::getColorSchemeString(scheme, buddy);
+        int res = COLORSCHEME->getColorPair(status_scheme, "button",
+            property);
+        g_free(status_scheme);
+        return res;
+      }
+    case BuddyList::COLOR_BY_ACCOUNT:
+      if (!strcmp(property, "normal")) {
+        PurpleAccount *account = purple_buddy_get_account(buddy);
+        int fg = purple_account_get_ui_int(account, "centerim5",
+            "buddylist-foreground-color",
+            CppConsUI::Curses::Color::DEFAULT);
+        int bg = purple_account_get_ui_int(account, "centerim5",
+            "buddylist-background-color",
+            CppConsUI::Curses::Color::DEFAULT);
+
+        CppConsUI::ColorScheme::Color c(fg, bg);
+        return COLORSCHEME->getColorPair(c);
+      }
+      break;
+    default:
+      break;
+  }
+
+  return COLORSCHEME->getColorPair(scheme, "button", property);
+}
+
+void BuddyListNode::setVisibility(bool new_visible)
+{
+  visible = new_visible;
+  // the tree view redraws the row and moves the focus if it was hidden
+  treeview->updateRow(ref);
+}
+
 void BuddyListNode::updateFilterVisibility(const char *name)
 {
-  if (!isVisible())
+  if (!visible)
     return;
 
   const char *filter = BUDDYLIST->getFilterString();
@@ -361,18 +459,6 @@ void BuddyListNode::retrieveUserInfoForName(PurpleConnection *gc,
   serv_get_info(gc, name);
 }
 
-void BuddyListNode::actionOpenContextMenu()
-{
-  openContextMenu();
-}
-
-void BuddyListNode::declareBindables()
-{
-  declareBindable("buddylist", "contextmenu", sigc::mem_fun(this,
-        &BuddyListNode::actionOpenContextMenu),
-      InputProcessor::BINDABLE_NORMAL);
-}
-
 bool BuddyListBuddy::lessOrEqual(const BuddyListNode& other) const
 {
   const BuddyListBuddy *o = dynamic_cast<const BuddyListBuddy*>(&other);
@@ -387,18 +473,9 @@ void BuddyListBuddy::update()
 
   const char *status = getBuddyStatus(buddy);
   const char *alias = purple_buddy_get_alias(buddy);
-  // if (status[0]) {
-  //   char *text = g_strdup_printf("%s %s", status, alias);
-  //   setText(text);
-  //   g_free(text);
-  // }
-  // else
-  setText(alias);
 
   sortIn();
 
-  updateColorScheme();
-
   if (!purple_account_is_connected(purple_buddy_get_account(buddy))) {
     // hide if account is offline
     setVisibility(false);
@@ -409,7 +486,7 @@ void BuddyListBuddy::update()
   updateFilterVisibility(alias);
 }
 
-void BuddyListBuddy::onActivate(Button& /*activator*/)
+void BuddyListBuddy::onActivate()
 {
   PurpleAccount *account = purple_buddy_get_account(buddy);
   const char *name = purple_buddy_get_name(buddy);
@@ -449,7 +526,8 @@ BuddyListBuddy::BuddyContextMenu::BuddyContextMenu(
         &BuddyContextMenu::onRemove));
 }
 
-void BuddyListBuddy::BuddyContextMenu::onInformation(Button& /*activator*/)
+void BuddyListBuddy::BuddyContextMenu::onInformation(
+    CppConsUI::Button& /*activator*/)
 {
   parent_buddy->retrieveUserInfo();
   close();
@@ -470,7 +548,8 @@ void BuddyListBuddy::BuddyContextMenu::changeAliasResponseHandler(
   close();
 }
 
-void BuddyListBuddy::BuddyContextMenu::onChangeAlias(Button& /*activator*/)
+void BuddyListBuddy::BuddyContextMenu::onChangeAlias(
+    CppConsUI::Button& /*activator*/)
 {
   PurpleBuddy *buddy = parent_buddy->getPurpleBuddy();
   CppConsUI::InputDialog *dialog = new CppConsUI::InputDialog(
@@ -498,7 +577,8 @@ void BuddyListBuddy::BuddyContextMenu::removeResponseHandler(
   purple_blist_remove_buddy(buddy);
 }
 
-void BuddyListBuddy::BuddyContextMenu::onRemove(Button& /*activator*/)
+void BuddyListBuddy::BuddyContextMenu::onRemove(
+    CppConsUI::Button& /*activator*/)
 {
   PurpleBuddy *buddy = parent_buddy->getPurpleBuddy();
   char *msg = g_strdup_printf(
@@ -512,52 +592,27 @@ void BuddyListBuddy::BuddyContextMenu::onRemove(Button& /*activator*/)
   dialog->show();
 }
 
-int BuddyListBuddy::getColorPair(const char *widget, const char *property)
-  const
-{
-  if (BUDDYLIST->getColorizationMode() != BuddyList::COLOR_BY_ACCOUNT
-      || strcmp(property, "normal"))
-    return Button::getColorPair(widget, property);
-
-  PurpleAccount *account = purple_buddy_get_account(buddy);
-  int fg = purple_account_get_ui_int(account, "centerim5",
-      "buddylist-foreground-color", CppConsUI::Curses::Color::DEFAULT);
-  int bg = purple_account_get_ui_int(account, "centerim5",
-      "buddylist-background-color", CppConsUI::Curses::Color::DEFAULT);
-
-  CppConsUI::ColorScheme::Color c(fg, bg);
-  return COLORSCHEME->getColorPair(c);
-}
-
 void BuddyListBuddy::openContextMenu()
 {
   ContextMenu *w = new BuddyContextMenu(*this);
   w->show();
 }
 
-BuddyListBuddy::BuddyListBuddy(PurpleBlistNode *node_)
-: BuddyListNode(node_)
+void BuddyListBuddy::drawLabel(CppConsUI::Curses::Window& area, int x, int y,
+    int w, bool focus) const
 {
-  setColorScheme("buddylistbuddy");
-
-  buddy = PURPLE_BUDDY(blist_node);
+  drawText(area, x, y, w, focus, purple_buddy_get_alias(buddy));
 }
 
-void BuddyListBuddy::updateColorScheme()
+int BuddyListBuddy::getColorPair(const char *property) const
 {
-  char *new_scheme;
+  return getBuddyColorPair("buddylistbuddy", buddy, property);
+}
 
-  switch (BUDDYLIST->getColorizationMode()) {
-    case BuddyList::COLOR_BY_STATUS:
-      new_scheme = Utils::getColorSchemeString("buddylistbuddy", buddy);
-      setColorScheme(new_scheme);
-      g_free(new_scheme);
-      break;
-    default:
-      // note: COLOR_BY_ACCOUNT case is handled by BuddyListBuddy::draw()
-      setColorScheme("buddylistbuddy");
-      break;
-  }
+BuddyListBuddy::BuddyListBuddy(PurpleBlistNode *node_)
+: BuddyListNode(node_)
+{
+  buddy = PURPLE_BUDDY(blist_node);
 }
 
 bool BuddyListChat::lessOrEqual(const BuddyListNode& other) const
@@ -574,7 +629,6 @@ void BuddyListChat::update()
   BuddyListNode::update();
 
   const char *name = purple_chat_get_name(chat);
-  setText(name);
 
   sortIn();
 
@@ -584,7 +638,7 @@ void BuddyListChat::update()
   updateFilterVisibility(name);
 }
 
-void BuddyListChat::onActivate(Button& /*activator*/)
+void BuddyListChat::onActivate()
 {
   PurpleAccount *account = purple_chat_get_account(chat);
   PurplePluginProtocolInfo *prpl_info = PURPLE_PLUGIN_PROTOCOL_INFO(
@@ -643,7 +697,8 @@ void BuddyListChat::ChatContextMenu::changeAliasResponseHandler(
   close();
 }
 
-void BuddyListChat::ChatContextMenu::onChangeAlias(Button& /*activator*/)
+void BuddyListChat::ChatContextMenu::onChangeAlias(
+    CppConsUI::Button& /*activator*/)
 {
   PurpleChat *chat = parent_chat->getPurpleChat();
   CppConsUI::InputDialog *dialog = new CppConsUI::InputDialog(
@@ -669,7 +724,8 @@ void BuddyListChat::ChatContextMenu::removeResponseHandler(
   purple_blist_remove_chat(chat);
 }
 
-void BuddyListChat::ChatContextMenu::onRemove(Button& /*activator*/)
+void BuddyListChat::ChatContextMenu::onRemove(
+    CppConsUI::Button& /*activator*/)
 {
   PurpleChat *chat = parent_chat->getPurpleChat();
   char *msg = g_strdup_printf(
@@ -689,11 +745,20 @@ void BuddyListChat::openContextMenu()
   w->show();
 }
 
+void BuddyListChat::drawLabel(CppConsUI::Curses::Window& area, int x, int y,
+    int w, bool focus) const
+{
+  drawText(area, x, y, w, focus, purple_chat_get_name(chat));
+}
+
+int BuddyListChat::getColorPair(const char *property) const
+{
+  return COLORSCHEME->getColorPair("buddylistchat", "button", property);
+}
+
 BuddyListChat::BuddyListChat(PurpleBlistNode *node_)
 : BuddyListNode(node_)
 {
-  setColorScheme("buddylistchat");
-
   chat = PURPLE_CHAT(blist_node);
 }
 
@@ -716,34 +781,15 @@ void BuddyListContact::update()
   if (!buddy) {
     /* The contact does not have any associated buddy, ignore it until it gets
      * a buddy assigned. */
-    setText("*Contact*");
     setVisibility(false);
     return;
   }
 
-  // format contact size
-  char *size;
-  if (contact->currentsize > 1)
-    size = g_strdup_printf(" (%d)", contact->currentsize);
-  else
-    size = NULL;
-
-  // format contact label
   const char *alias = purple_contact_get_alias(contact);
   const char *status = getBuddyStatus(buddy);
-  // char *text;
-  // if (status[0])
-  //   text = g_strdup_printf("%s %s%s", status, alias, size ? size : "");
-  // else
-  //   text = g_strdup_printf("%s%s", alias, size ? size : "");
-  setText(g_strdup_printf("%s%s", alias, size ? size : ""));
-  g_free(size);
-  // g_free(text);
 
   sortIn();
 
-  updateColorScheme();
-
   if (!purple_account_is_connected(purple_buddy_get_account(buddy))) {
     // hide if account is offline
     setVisibility(false);
@@ -754,13 +800,13 @@ void BuddyListContact::update()
   updateFilterVisibility(alias);
 }
 
-void BuddyListContact::onActivate(Button& activator)
+void BuddyListContact::onActivate()
 {
   PurpleBuddy *buddy = purple_contact_get_priority_buddy(contact);
   BuddyListNode *bnode = reinterpret_cast<BuddyListNode*>(
       purple_blist_node_get_ui_data(PURPLE_BLIST_NODE(buddy)));
   if (bnode)
-    bnode->onActivate(activator);
+    bnode->onActivate();
 }
 
 const char *BuddyListContact::toString() const
@@ -823,14 +869,14 @@ BuddyListContact::ContactContextMenu::ContactContextMenu(
 }
 
 void BuddyListContact::ContactContextMenu::onExpandRequest(
-    Button& /*activator*/, bool expand)
+    CppConsUI::Button& /*activator*/, bool expand)
 {
   parent_contact->setCollapsed(!expand);
   close();
 }
 
 void BuddyListContact::ContactContextMenu::onInformation(
-    Button& /*activator*/)
+    CppConsUI::Button& /*activator*/)
 {
   parent_contact->retrieveUserInfo();
   close();
@@ -857,7 +903,7 @@ void BuddyListContact::ContactContextMenu::changeAliasResponseHandler(
 }
 
 void BuddyListContact::ContactContextMenu::onChangeAlias(
-    Button& /*activator*/)
+    CppConsUI::Button& /*activator*/)
 {
   PurpleContact *contact = parent_contact->getPurpleContact();
   CppConsUI::InputDialog *dialog = new CppConsUI::InputDialog(
@@ -894,7 +940,8 @@ void BuddyListContact::ContactContextMenu::removeResponseHandler(
   purple_blist_remove_contact(contact);
 }
 
-void BuddyListContact::ContactContextMenu::onRemove(Button& /*activator*/)
+void BuddyListContact::ContactContextMenu::onRemove(
+    CppConsUI::Button& /*activator*/)
 {
   PurpleContact *contact = parent_contact->getPurpleContact();
   char *msg = g_strdup_printf(
@@ -908,8 +955,8 @@ void BuddyListContact::ContactContextMenu::onRemove(Button& /*activator*/)
   dialog->show();
 }
 
-void BuddyListContact::ContactContextMenu::onMoveTo(Button& /*activator*/,
-    PurpleGroup *group)
+void BuddyListContact::ContactContextMenu::onMoveTo(
+    CppConsUI::Button& /*activator*/, PurpleGroup *group)
 {
   PurpleContact *contact = parent_contact->getPurpleContact();
   close();
@@ -917,55 +964,37 @@ void BuddyListContact::ContactContextMenu::onMoveTo(Button& /*activator*/,
   purple_blist_add_contact(contact, group, NULL);
 }
 
-int BuddyListContact::getColorPair(const char *widget, const char *property)
-  const
-{
-  if (BUDDYLIST->getColorizationMode() != BuddyList::COLOR_BY_ACCOUNT
-      || strcmp(property, "normal"))
-    return Button::getColorPair(widget, property);
-
-  PurpleAccount *account =
-    purple_buddy_get_account(purple_contact_get_priority_buddy(contact));
-  int fg = purple_account_get_ui_int(account, "centerim5",
-      "buddylist-foreground-color", CppConsUI::Curses::Color::DEFAULT);
-  int bg = purple_account_get_ui_int(account, "centerim5",
-      "buddylist-background-color", CppConsUI::Curses::Color::DEFAULT);
-
-  CppConsUI::ColorScheme::Color c(fg,bg);
-  return COLORSCHEME->getColorPair(c);
-}
-
 void BuddyListContact::openContextMenu()
 {
   ContextMenu *w = new ContactContextMenu(*this);
   w->show();
 }
 
-BuddyListContact::BuddyListContact(PurpleBlistNode *node_)
-: BuddyListNode(node_)
+void BuddyListContact::drawLabel(CppConsUI::Curses::Window& area, int x,
+    int y, int w, bool focus) const
 {
-  setColorScheme("buddylistcontact");
+  // show the contact size
+  char size[16];
+  if (contact->currentsize > 1)
+    g_snprintf(size, sizeof(size), " (%d)", contact->currentsize);
+  else
+    size[0] = '\0';
 
-  contact = PURPLE_CONTACT(blist_node);
+  drawText(area, x, y, w, focus, purple_contact_get_alias(contact), size);
 }
 
-void BuddyListContact::updateColorScheme()
+int BuddyListContact::getColorPair(const char *property) const
 {
-  char *new_scheme;
-  PurpleBuddy *buddy;
+  PurpleBuddy *buddy = purple_contact_get_priority_buddy(contact);
+  if (!buddy)
+    return COLORSCHEME->getColorPair("buddylistcontact", "button", property);
+  return getBuddyColorPair("buddylistcontact", buddy, property);
+}
 
-  switch (BUDDYLIST->getColorizationMode()) {
-    case BuddyList::COLOR_BY_STATUS:
-      buddy = purple_contact_get_priority_buddy(contact);
-      new_scheme = Utils::getColorSchemeString("buddylistcontact", buddy);
-      setColorScheme(new_scheme);
-      g_free(new_scheme);
-      break;
-    default:
-      // note: COLOR_BY_ACCOUNT case is handled by BuddyListContact::draw()
-      setColorScheme("buddylistcontact");
-      break;
-  }
+BuddyListContact::BuddyListContact(PurpleBlistNode *node_)
+: BuddyListNode(node_)
+{
+  contact = PURPLE_CONTACT(blist_node);
 }
 
 bool BuddyListGroup::lessOrEqual(const BuddyListNode& other) const
@@ -984,8 +1013,6 @@ void BuddyListGroup::update()
 {
   BuddyListNode::update();
 
-  setText(purple_group_get_name(group));
-
   // sort in the group
   BuddyList::GroupSortMode mode = BUDDYLIST->getGroupSortMode();
   switch (mode) {
@@ -1030,10 +1057,10 @@ void BuddyListGroup::update()
   setVisibility(vis);
 }
 
-void BuddyListGroup::onActivate(Button& /*activator*/)
+void BuddyListGroup::onActivate()
 {
+  // the buddy list saves the new state and builds the group's rows
   treeview->toggleCollapsed(ref);
-  purple_blist_node_set_bool(blist_node, "collapsed", ref->isCollapsed());
 }
 
 const char *BuddyListGroup::toString() const
@@ -1111,7 +1138,8 @@ void BuddyListGroup::GroupContextMenu::renameResponseHandler(
   close();
 }
 
-void BuddyListGroup::GroupContextMenu::onRename(Button& /*activator*/)
+void BuddyListGroup::GroupContextMenu::onRename(
+    CppConsUI::Button& /*activator*/)
 {
   PurpleGroup *group = parent_group->getPurpleGroup();
   CppConsUI::InputDialog *dialog = new CppConsUI::InputDialog(
@@ -1165,7 +1193,8 @@ void BuddyListGroup::GroupContextMenu::removeResponseHandler(
   purple_blist_remove_group(group);
 }
 
-void BuddyListGroup::GroupContextMenu::onRemove(Button& /*activator*/)
+void BuddyListGroup::GroupContextMenu::onRemove(
+    CppConsUI::Button& /*activator*/)
 {
   PurpleGroup *group = parent_group->getPurpleGroup();
   char *msg = g_strdup_printf(
@@ -1179,8 +1208,8 @@ void BuddyListGroup::GroupContextMenu::onRemove(Button& /*activator*/)
   dialog->show();
 }
 
-void BuddyListGroup::GroupContextMenu::onMoveAfter(Button& /*activator*/,
-    PurpleGroup *group)
+void BuddyListGroup::GroupContextMenu::onMoveAfter(
+    CppConsUI::Button& /*activator*/, PurpleGroup *group)
 {
   PurpleGroup *moved_group = parent_group->getPurpleGroup();
   close();
@@ -1194,11 +1223,20 @@ void BuddyListGroup::openContextMenu()
   w->show();
 }
 
+void BuddyListGroup::drawLabel(CppConsUI::Curses::Window& area, int x, int y,
+    int w, bool focus) const
+{
+  drawText(area, x, y, w, focus, purple_group_get_name(group));
+}
+
+int BuddyListGroup::getColorPair(const char *property) const
+{
+  return COLORSCHEME->getColorPair("buddylistgroup", "button", property);
+}
+
 BuddyListGroup::BuddyListGroup(PurpleBlistNode *node_)
 : BuddyListNode(node_)
 {
-  setColorScheme("buddylistgroup");
-
   group = PURPLE_GROUP(blist_node);
 }
 
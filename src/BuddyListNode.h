@@ -23,24 +23,33 @@
 #define _BUDDYLISTNODE_H__
 
 #include <cppconsui/Button.h>
+#include <cppconsui/ConsUICurses.h>
 #include <cppconsui/InputDialog.h>
 #include <cppconsui/MenuWindow.h>
 #include <cppconsui/MessageDialog.h>
 #include <cppconsui/TreeView.h>
 #include <libpurple/purple.h>
 
+/**
+ * Buddy list nodes are rows of the buddy list tree view. They keep only
+ * pointers to libpurple data, their labels and colors are computed when they
+ * are drawn and a real widget is created only for the focused node.
+ */
 class BuddyListNode
-: public CppConsUI::Button
+: public CppConsUI::TreeView::Row
 {
 public:
   static BuddyListNode *createNode(PurpleBlistNode *node);
 
-  // Widget
-  virtual void setParent(CppConsUI::Container& parent);
+  // TreeView::Row
+  virtual bool isRowVisible() const { return visible; }
+  virtual void drawRow(CppConsUI::Curses::Window& area, int x, int y, int w)
+    { drawLabel(area, x, y, w, false); }
+  virtual CppConsUI::Widget *createRowWidget();
 
   virtual bool lessOrEqual(const BuddyListNode& other) const = 0;
   virtual void update();
-  virtual void onActivate(CppConsUI::Button& activator) = 0;
+  virtual void onActivate() = 0;
   // debugging method
   virtual const char *toString() const = 0;
 
@@ -56,6 +65,31 @@ public:
   BuddyListNode *getParentNode() const;
 
 protected:
+  /**
+   * Widget that represents the node while it has the focus.
+   */
+  class RowWidget
+  : public CppConsUI::Widget
+  {
+  public:
+    RowWidget(BuddyListNode& parent_node_);
+    virtual ~RowWidget() {}
+
+    // Widget
+    virtual void draw();
+
+  protected:
+    BuddyListNode *parent_node;
+
+  private:
+    RowWidget(const RowWidget&);
+    RowWidget& operator=(const RowWidget&);
+
+    void actionActivate();
+    void actionOpenContextMenu();
+    void declareBindables();
+  };
+
   class ContextMenu
   : public CppConsUI::MenuWindow
   {
@@ -66,7 +100,8 @@ protected:
   protected:
     BuddyListNode *parent_node;
 
-    void onMenuAction(Button& activator, PurpleCallback callback, void *data);
+    void onMenuAction(CppConsUI::Button& activator, PurpleCallback callback,
+        void *data);
     void appendMenuAction(MenuWindow& menu, PurpleMenuAction *act);
     void appendProtocolMenu(PurpleConnection *gc);
     void appendExtendedMenu();
@@ -84,11 +119,28 @@ protected:
   // cached value of purple_blist_node_get_int(blist_node, "last_activity")
   int last_activity;
 
+  bool visible;
+
   BuddyListNode(PurpleBlistNode *node_);
   virtual ~BuddyListNode();
 
   virtual void openContextMenu() = 0;
 
+  /* Draws the label of the node, the focused node is drawn by its RowWidget
+   * using the same method. */
+  virtual void drawLabel(CppConsUI::Curses::Window& area, int x, int y, int w,
+      bool focus) const = 0;
+  void drawText(CppConsUI::Curses::Window& area, int x, int y, int w,
+      bool focus, const char *text, const char *suffix = NULL) const;
+
+  /* Returns a color pair of the node label for the "normal" or "focus"
+   * property. */
+  virtual int getColorPair(const char *property) const = 0;
+  int getBuddyColorPair(const char *scheme, PurpleBuddy *buddy,
+      const char *property) const;
+
+  void setVisibility(bool new_visible);
+
   bool lessOrEqualByType(const BuddyListNode& other) const;
   bool lessOrEqualByBuddySort(PurpleBuddy *left, PurpleBuddy *right) const;
 
@@ -107,9 +159,6 @@ protected:
 private:
   BuddyListNode(BuddyListNode&);
   BuddyListNode& operator=(BuddyListNode&);
-
-  void actionOpenContextMenu();
-  void declareBindables();
 };
 
 class BuddyListBuddy
@@ -120,7 +169,7 @@ public:
   // BuddyListNode
   virtual bool lessOrEqual(const BuddyListNode& other) const;
   virtual void update();
-  virtual void onActivate(Button& activator);
+  virtual void onActivate();
   virtual const char *toString() const;
 
   PurpleBuddy *getPurpleBuddy() const { return buddy; }
@@ -137,15 +186,15 @@ protected:
   protected:
     BuddyListBuddy *parent_buddy;
 
-    void onInformation(Button& activator);
+    void onInformation(CppConsUI::Button& activator);
 
     void changeAliasResponseHandler(CppConsUI::InputDialog& activator,
         CppConsUI::AbstractDialog::ResponseType response);
-    void onChangeAlias(Button& activator);
+    void onChangeAlias(CppConsUI::Button& activator);
 
     void removeResponseHandler(CppConsUI::MessageDialog& activator,
         CppConsUI::AbstractDialog::ResponseType response);
-    void onRemove(Button& activator);
+    void onRemove(CppConsUI::Button& activator);
 
   private:
     BuddyContextMenu(const BuddyContextMenu&);
@@ -154,13 +203,11 @@ protected:
 
   PurpleBuddy *buddy;
 
-  // Widget
-  virtual int getColorPair(const char *widget, const char *property) const;
-
   // BuddyListNode
   virtual void openContextMenu();
-
-  void updateColorScheme();
+  virtual void drawLabel(CppConsUI::Curses::Window& area, int x, int y, int w,
+      bool focus) const;
+  virtual int getColorPair(const char *property) const;
 
 private:
   BuddyListBuddy(PurpleBlistNode *node_);
@@ -177,7 +224,7 @@ public:
   // BuddyListNode
   virtual bool lessOrEqual(const BuddyListNode& other) const;
   virtual void update();
-  virtual void onActivate(Button& activator);
+  virtual void onActivate();
   virtual const char *toString() const;
 
   PurpleChat *getPurpleChat() const { return chat; }
@@ -195,11 +242,11 @@ protected:
 
     void changeAliasResponseHandler(CppConsUI::InputDialog& activator,
         CppConsUI::AbstractDialog::ResponseType response);
-    void onChangeAlias(Button& activator);
+    void onChangeAlias(CppConsUI::Button& activator);
 
     void removeResponseHandler(CppConsUI::MessageDialog& activator,
         CppConsUI::AbstractDialog::ResponseType response);
-    void onRemove(Button& activator);
+    void onRemove(CppConsUI::Button& activator);
 
   private:
     ChatContextMenu(const ChatContextMenu&);
@@ -210,6 +257,9 @@ protected:
 
   // BuddyListNode
   virtual void openContextMenu();
+  virtual void drawLabel(CppConsUI::Curses::Window& area, int x, int y, int w,
+      bool focus) const;
+  virtual int getColorPair(const char *property) const;
 
 private:
   BuddyListChat(PurpleBlistNode *node_);
@@ -226,7 +276,7 @@ public:
   // BuddyListNode
   virtual bool lessOrEqual(const BuddyListNode& other) const;
   virtual void update();
-  virtual void onActivate(Button& activator);
+  virtual void onActivate();
   virtual const char *toString() const;
   virtual void setRefNode(CppConsUI::TreeView::NodeReference n);
 
@@ -248,18 +298,18 @@ protected:
   protected:
     BuddyListContact *parent_contact;
 
-    void onExpandRequest(Button& activator, bool expand);
-    void onInformation(Button& activator);
+    void onExpandRequest(CppConsUI::Button& activator, bool expand);
+    void onInformation(CppConsUI::Button& activator);
 
     void changeAliasResponseHandler(CppConsUI::InputDialog& activator,
         CppConsUI::AbstractDialog::ResponseType response);
-    void onChangeAlias(Button& activator);
+    void onChangeAlias(CppConsUI::Button& activator);
 
     void removeResponseHandler(CppConsUI::MessageDialog& activator,
         CppConsUI::AbstractDialog::ResponseType response);
-    void onRemove(Button& activator);
+    void onRemove(CppConsUI::Button& activator);
 
-    void onMoveTo(Button& activator, PurpleGroup *group);
+    void onMoveTo(CppConsUI::Button& activator, PurpleGroup *group);
 
   private:
     ContactContextMenu(const ContactContextMenu&);
@@ -268,13 +318,11 @@ protected:
 
   PurpleContact *contact;
 
-  // Widget
-  virtual int getColorPair(const char *widget, const char *property) const;
-
   // BuddyListNode
   virtual void openContextMenu();
-
-  void updateColorScheme();
+  virtual void drawLabel(CppConsUI::Curses::Window& area, int x, int y, int w,
+      bool focus) const;
+  virtual int getColorPair(const char *property) const;
 
 private:
   BuddyListContact(PurpleBlistNode *node_);
@@ -291,7 +339,7 @@ public:
   // BuddyListNode
   virtual bool lessOrEqual(const BuddyListNode& other) const;
   virtual void update();
-  virtual void onActivate(Button& activator);
+  virtual void onActivate();
   virtual const char *toString() const;
   virtual void setRefNode(CppConsUI::TreeView::NodeReference n);
 
@@ -312,13 +360,13 @@ protected:
 
     void renameResponseHandler(CppConsUI::InputDialog& activator,
         CppConsUI::AbstractDialog::ResponseType response);
-    void onRename(Button& activator);
+    void onRename(CppConsUI::Button& activator);
 
     void removeResponseHandler(CppConsUI::MessageDialog& activator,
         CppConsUI::AbstractDialog::ResponseType response);
-    void onRemove(Button& activator);
+    void onRemove(CppConsUI::Button& activator);
 
-    void onMoveAfter(Button& activator, PurpleGroup *group);
+    void onMoveAfter(CppConsUI::Button& activator, PurpleGroup *group);
 
   private:
     GroupContextMenu(const GroupContextMenu&);
@@ -329,6 +377,9 @@ protected:
 
   // BuddyListNode
   virtual void openContextMenu();
+  virtual void drawLabel(CppConsUI::Curses::Window& area, int x, int y, int w,
+      bool focus) const;
+  virtual int getColorPair(const char *property) const;
 
 private:
   BuddyListGroup(PurpleBlistNode *node_);
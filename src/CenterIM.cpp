@@ -30,7 +30,9 @@
 #include "Log.h"
 #include "Notify.h"
 #include "Request.h"
+#include "Tracer.h"
 #include "Transfers.h"
+#include "Watchdog.h"
 
 #include "AccountStatusMenu.h"
 #include "GeneralMenu.h"
@@ -43,6 +45,8 @@
 #include "gettext.h"
 
 CenterIM::LogBufferItems *CenterIM::logbuf = NULL;
+TimerWheel *CenterIM::timer_wheel = NULL;
+InputMultiplexer *CenterIM::input_multiplexer = NULL;
 
 const char *CenterIM::named_colors[] = {
   "default", /* -1 */
@@ -70,8 +74,11 @@ bool CenterIM::processInput(const TermKeyKey& key)
   return InputProcessor::processInput(key);
 }
 
-int CenterIM::run(const char *config_path, bool ascii, bool offline)
+int CenterIM::run(const char *config_path, bool ascii, bool offline,
+    const char *trace_file, StartupProfiler *profiler)
 {
+  startup_profiler = profiler;
+
   // ASCII mode
   if (ascii)
     CppConsUI::Curses::set_ascii_mode(ascii);
@@ -86,14 +93,24 @@ int CenterIM::run(const char *config_path, bool ascii, bool offline)
     path = g_build_path(G_DIR_SEPARATOR_S, purple_home_dir(), config_path,
         NULL);
 
-  if (purpleInit(path))
+  /* Read the config files in a worker thread while libpurple is being
+   * initialized. */
+  startup_loader = new StartupLoader(path);
+
+  startupPhase("purple-init");
+  if (purpleInit(path)) {
+    delete startup_loader;
+    startup_loader = NULL;
     return 1;
+  }
 
   g_free(path);
 
+  startupPhase("prefs-init");
   prefsInit();
 
   // initialize Log component
+  startupPhase("log-init");
   Log::init();
   if (logbuf) {
     for (LogBufferItems::iterator i = logbuf->begin();
@@ -107,32 +124,70 @@ int CenterIM::run(const char *config_path, bool ascii, bool offline)
     logbuf = NULL;
   }
 
+  // start measuring main loop callbacks once their slowness can be logged
+  Watchdog::init();
+  // record external events for a later replay if requested
+  if (trace_file)
+    Tracer::init(trace_file);
+
+  // all files have to be read before the UI is shown
+  startupPhase("loader-join");
+  startup_loader->join();
+  if (startup_profiler)
+    startup_profiler->addParallelPhase("config-read",
+        startup_loader->getTime());
+
   /* Init colorschemes and keybinds after the Log is initialized so the user
    * can see if there is any error in the configs. */
+  startupPhase("color-schemes");
   loadColorSchemeConfig();
+  startupPhase("key-config");
   loadKeyConfig();
 
+  // the rest of the files is read by libpurple
+  delete startup_loader;
+  startup_loader = NULL;
+
+  startupPhase("footer-init");
   Footer::init();
 
+  startupPhase("accounts-init");
   Accounts::init();
+  startupPhase("connections-init");
   Connections::init();
+  startupPhase("notify-init");
   Notify::init();
+  startupPhase("request-init");
   Request::init();
 
   // initialize UI
+  startupPhase("conversations-init");
   Conversations::init();
+  startupPhase("header-init");
   Header::init();
   // init BuddyList last so it takes the focus
+  startupPhase("buddylist-init");
   BuddyList::init();
 
   const char *key = KEYCONFIG->getKeyBind("centerim", "generalmenu");
   LOG->info(_("Welcome to CenterIM 5. Press %s to display main menu."), key);
 
   // restore last know status on all accounts
+  startupPhase("restore-statuses");
   ACCOUNTS->restoreStatuses(offline);
 
   mngr->setTopInputProcessor(*this);
   mngr->enableResizing();
+
+  if (startup_profiler) {
+    /* The first screen update is done by a default priority timeout, a low
+     * priority one is dispatched after it. */
+    startupPhase("first-draw");
+    mngr->timeoutOnceConnect(sigc::mem_fun(this,
+          &CenterIM::onStartupFinished), 0, G_PRIORITY_LOW,
+        "startup-finished");
+  }
+
   mngr->startMainLoop();
 
   purple_prefs_disconnect_by_handle(this);
@@ -151,6 +206,8 @@ int CenterIM::run(const char *config_path, bool ascii, bool offline)
 
   Footer::finalize();
 
+  Tracer::finalize();
+  Watchdog::finalize();
   Log::finalize();
 
   purpleFinalize();
@@ -179,8 +236,7 @@ CppConsUI::Rect CenterIM::getScreenAreaCentered(ScreenArea area)
 
 bool CenterIM::loadColorSchemeConfig()
 {
-  xmlnode *root = purple_util_read_xml_from_file("colorschemes.xml",
-      _("color schemes"));
+  xmlnode *root = readConfigFile("colorschemes.xml", _("color schemes"));
 
   if (!root) {
     // read error, first time run?
@@ -260,8 +316,7 @@ out:
 
 bool CenterIM::loadKeyConfig()
 {
-  xmlnode *root = purple_util_read_xml_from_file("binds.xml",
-      _("key bindings"));
+  xmlnode *root = readConfigFile("binds.xml", _("key bindings"));
 
   if (!root) {
     // read error, first time run?
@@ -311,8 +366,46 @@ out:
   return res;
 }
 
+xmlnode *CenterIM::readConfigFile(const char *filename,
+    const char *description)
+{
+  if (startup_loader) {
+    // use the contents that were read by the startup loader
+    gsize length;
+    char *contents = startup_loader->takeContents(filename, &length);
+    if (contents) {
+      xmlnode *root = NULL;
+      if (length > 0)
+        root = xmlnode_from_str(contents, length);
+      g_free(contents);
+      if (root)
+        return root;
+    }
+  }
+
+  /* Let libpurple read the file, it also takes care of reporting and
+   * backing up a file that can't be parsed. */
+  return purple_util_read_xml_from_file(filename, description);
+}
+
+void CenterIM::startupPhase(const char *name)
+{
+  if (startup_profiler)
+    startup_profiler->beginPhase(name);
+}
+
+void CenterIM::onStartupFinished()
+{
+  startup_profiler->endPhase();
+
+  char *report = startup_profiler->getReport();
+  LOG->info(_("Startup profile:\n%s"), report);
+  g_free(report);
+}
+
 CenterIM::CenterIM()
 : convs_expanded(false), idle_reporting_on_keyboard(false)
+, startup_profiler(NULL), startup_loader(NULL)
 {
   mngr = CppConsUI::CoreManager::instance();
   resize_conn = mngr->signal_resize.connect(sigc::mem_fun(this,
@@ -363,7 +456,10 @@ int CenterIM::purpleInit(const char *config_path)
   purple_core_set_ui_ops(&centerim_core_ui_ops);
 
   // set the uiops for the eventloop
+  timer_wheel = new TimerWheel;
+  input_multiplexer = new InputMultiplexer;
   centerim_glib_eventloops.timeout_add = timeout_add;
+  centerim_glib_eventloops.timeout_add_seconds = timeout_add_seconds;
   centerim_glib_eventloops.timeout_remove = timeout_remove;
   centerim_glib_eventloops.input_add = input_add;
   centerim_glib_eventloops.input_remove = input_remove;
@@ -400,6 +496,11 @@ void CenterIM::purpleFinalize()
   purple_core_set_ui_ops(NULL);
   //purple_eventloop_set_ui_ops(NULL);
   purple_core_quit();
+
+  delete input_multiplexer;
+  input_multiplexer = NULL;
+  delete timer_wheel;
+  timer_wheel = NULL;
 }
 
 void CenterIM::prefsInit()
@@ -540,66 +641,39 @@ GHashTable *CenterIM::get_ui_info()
 guint CenterIM::timeout_add(guint interval, GSourceFunc function,
     gpointer data)
 {
-  return g_timeout_add(interval, function, data);
-}
+  g_return_val_if_fail(timer_wheel, 0);
 
-gboolean CenterIM::timeout_remove(guint handle)
-{
-  return g_source_remove(handle);
+  return timer_wheel->add(interval, function, data);
 }
 
-#define PURPLE_GLIB_READ_COND  (G_IO_IN | G_IO_HUP | G_IO_ERR)
-#define PURPLE_GLIB_WRITE_COND (G_IO_OUT | G_IO_HUP | G_IO_ERR | G_IO_NVAL)
-
-guint CenterIM::input_add(int fd, PurpleInputCondition condition,
-  PurpleInputFunction function, gpointer data)
+guint CenterIM::timeout_add_seconds(guint interval, GSourceFunc function,
+    gpointer data)
 {
-  IOClosure *closure = new IOClosure;
-  GIOChannel *channel;
-  int cond = 0;
-
-  closure->function = function;
-  closure->data = data;
+  g_return_val_if_fail(timer_wheel, 0);
 
-  if (condition & PURPLE_INPUT_READ)
-    cond |= PURPLE_GLIB_READ_COND;
-  if (condition & PURPLE_INPUT_WRITE)
-    cond |= PURPLE_GLIB_WRITE_COND;
-
-  channel = g_io_channel_unix_new(fd);
-  closure->result = g_io_add_watch_full(channel, G_PRIORITY_DEFAULT,
-      static_cast<GIOCondition>(cond), purple_glib_io_input, closure,
-      purple_glib_io_destroy);
-
-  g_io_channel_unref(channel);
-  return closure->result;
+  return timer_wheel->addSeconds(interval, function, data);
 }
 
-gboolean CenterIM::input_remove(guint handle)
+gboolean CenterIM::timeout_remove(guint handle)
 {
-  return g_source_remove(handle);
+  g_return_val_if_fail(timer_wheel, FALSE);
+
+  return timer_wheel->remove(handle);
 }
 
-gboolean CenterIM::purple_glib_io_input(GIOChannel *source,
-    GIOCondition condition, gpointer data)
+guint CenterIM::input_add(int fd, PurpleInputCondition condition,
+  PurpleInputFunction function, gpointer data)
 {
-  IOClosure *closure = static_cast<IOClosure*>(data);
-  int purple_cond = 0;
-
-  if (condition & PURPLE_GLIB_READ_COND)
-    purple_cond |= PURPLE_INPUT_READ;
-  if (condition & PURPLE_GLIB_WRITE_COND)
-    purple_cond |= PURPLE_INPUT_WRITE;
-
-  closure->function(closure->data, g_io_channel_unix_get_fd(source),
-      static_cast<PurpleInputCondition>(purple_cond));
+  g_return_val_if_fail(input_multiplexer, 0);
 
-  return TRUE;
+  return input_multiplexer->add(fd, condition, function, data);
 }
 
-void CenterIM::purple_glib_io_destroy(gpointer data)
+gboolean CenterIM::input_remove(guint handle)
 {
-  delete static_cast<IOClosure*>(data);
+  g_return_val_if_fail(input_multiplexer, FALSE);
+
+  return input_multiplexer->remove(handle);
 }
 
 void CenterIM::tmp_purple_print(PurpleDebugLevel level, const char *category,
@@ -679,6 +753,12 @@ void CenterIM::loadDefaultColorSchemeConfig()
       CppConsUI::Curses::Color::CYAN, CppConsUI::Curses::Color::DEFAULT);
   COLORSCHEME->setColorPair("conversation", "textview", "color2",
       CppConsUI::Curses::Color::MAGENTA, CppConsUI::Curses::Color::DEFAULT);
+  COLORSCHEME->setColorPair("conversation", "textview", "color4",
+      CppConsUI::Curses::Color::MAGENTA, CppConsUI::Curses::Color::DEFAULT,
+      CppConsUI::Curses::Attr::BOLD);
+  COLORSCHEME->setColorPair("conversation", "textview", "color5",
+      CppConsUI::Curses::Color::CYAN, CppConsUI::Curses::Color::DEFAULT,
+      CppConsUI::Curses::Attr::BOLD);
   COLORSCHEME->setColorPair("conversation", "panel", "line",
       CppConsUI::Curses::Color::BLUE, CppConsUI::Curses::Color::DEFAULT,
       CppConsUI::Curses::Attr::BOLD);
@@ -903,6 +983,7 @@ void CenterIM::loadDefaultKeyConfig()
   KEYCONFIG->bindKey("centerim", "generalmenu", "Ctrl-g");
   KEYCONFIG->bindKey("centerim", "buddylist-toggle-offline", "F5");
   KEYCONFIG->bindKey("centerim", "conversation-expand", "F6");
+  KEYCONFIG->bindKey("centerim", "dump-log", "F12");
 
   KEYCONFIG->bindKey("centerim", "conversation-prev", "Ctrl-p");
   KEYCONFIG->bindKey("centerim", "conversation-next", "Ctrl-n");
@@ -1058,6 +1139,11 @@ void CenterIM::actionExpandConversation()
   mngr->onScreenResized();
 }
 
+void CenterIM::actionDumpLog()
+{
+  LOG->dumpRecorder();
+}
+
 void CenterIM::declareBindables()
 {
   declareBindable("centerim", "quit",
@@ -1094,6 +1180,9 @@ void CenterIM::declareBindables()
   declareBindable("centerim", "conversation-expand",
       sigc::mem_fun(this, &CenterIM::actionExpandConversation),
       InputProcessor::BINDABLE_OVERRIDE);
+  declareBindable("centerim", "dump-log",
+      sigc::mem_fun(this, &CenterIM::actionDumpLog),
+      InputProcessor::BINDABLE_OVERRIDE);
 }
 
 /* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -28,6 +28,11 @@
 #define _attribute(x)
 #endif
 
+#include "InputMultiplexer.h"
+#include "StartupLoader.h"
+#include "StartupProfiler.h"
+#include "TimerWheel.h"
+
 #include <cppconsui/CoreManager.h>
 #include <libpurple/purple.h>
 #include <vector>
@@ -57,7 +62,13 @@ public:
   // InputProcessor
   virtual bool processInput(const TermKeyKey& key);
 
-  int run(const char *config_path, bool ascii, bool offline);
+  /**
+   * Runs the application. If a profiler is passed then times of the startup
+   * phases are recorded in it and its report is logged when the startup is
+   * finished.
+   */
+  int run(const char *config_path, bool ascii, bool offline,
+      const char *trace_file, StartupProfiler *profiler);
   void quit();
 
   // returns a position and size of a selected area
@@ -74,15 +85,6 @@ public:
 protected:
 
 private:
-  struct IOClosure
-  {
-    PurpleInputFunction function;
-    guint result;
-    gpointer data;
-
-    IOClosure() : function(NULL), result(0), data(NULL) {}
-  };
-
   struct LogBufferItem
   {
     PurpleDebugLevel level;
@@ -94,6 +96,11 @@ private:
 
   static LogBufferItems *logbuf;
 
+  // timer wheel serving all libpurple timeouts
+  static TimerWheel *timer_wheel;
+  // multiplexer serving all libpurple input watches
+  static InputMultiplexer *input_multiplexer;
+
   CppConsUI::CoreManager *mngr;
   sigc::connection resize_conn;
   sigc::connection top_window_change_conn;
@@ -102,6 +109,11 @@ private:
   // flag to indicate if idle reporting is based on keyboard presses
   bool idle_reporting_on_keyboard;
 
+  // startup profiler, NULL if the startup isn't profiled
+  StartupProfiler *startup_profiler;
+  // reads config files in a worker thread, valid only during the startup
+  StartupLoader *startup_loader;
+
   PurpleCoreUiOps centerim_core_ui_ops;
   PurpleDebugUiOps logbuf_debug_ui_ops;
   PurpleEventLoopUiOps centerim_glib_eventloops;
@@ -125,6 +137,14 @@ private:
   void purpleFinalize();
   void prefsInit();
 
+  /**
+   * Reads an XML config file from the user directory, the contents that were
+   * read by the startup loader are used if available.
+   */
+  xmlnode *readConfigFile(const char *filename, const char *description);
+  void startupPhase(const char *name);
+  void onStartupFinished();
+
   // recalculates area sizes to fit into current screen size
   void onScreenResized();
 
@@ -135,23 +155,19 @@ private:
   static GHashTable *get_ui_info();
 
   // PurpleEventLoopUiOps callbacks
-  // adds timeout to glib main loop context
+  // adds timeout to the timer wheel
   static guint timeout_add(guint interval, GSourceFunc function, gpointer data);
-  // removes timeout from glib main loop context
+  // adds timeout with a granularity of one second to the timer wheel
+  static guint timeout_add_seconds(guint interval, GSourceFunc function,
+      gpointer data);
+  // removes timeout from the timer wheel
   static gboolean timeout_remove(guint handle);
-  // adds IO watch to glib main loop context
+  // adds IO watch to the input multiplexer
   static guint input_add(int fd, PurpleInputCondition condition,
       PurpleInputFunction function, gpointer data);
-  // removes input from glib main loop context
+  // removes IO watch from the input multiplexer
   static gboolean input_remove(guint handle);
 
-  // helper function for input_add
-  // process IO input to purple callback
-  static gboolean purple_glib_io_input(GIOChannel *source,
-      GIOCondition condition, gpointer data);
-  // destroyes libpurple io input callback internal data
-  static void purple_glib_io_destroy(gpointer data);
-
   // PurpleDebugUiOps callbacks
   // helper function to catch debug messages during libpurple initialization
   /* Catches and buffers libpurple debug messages until the Log object can be
@@ -195,6 +211,7 @@ private:
   void actionFocusNextConversation();
   void actionFocusConversation(int i);
   void actionExpandConversation();
+  void actionDumpLog();
 
   void declareBindables();
 };
@@ -37,7 +37,9 @@ static void print_usage(FILE *out, const char *prg_name)
 "  -h, --help                 display command line usage\n"
 "  -v, --version              show the program version info\n"
 "  -b, --basedir <directory>  specify another base directory\n"
-"  -o, --offline              start with all accounts set offline\n"),
+"  -o, --offline              start with all accounts set offline\n"
+"  -t, --trace <file>         record input and callback timings into a file\n"
+"  -p, --profile-startup      print times of the startup phases\n"),
       prg_name);
 }
 
@@ -62,10 +64,18 @@ int main(int argc, char *argv[])
 
   signal(SIGPIPE, SIG_IGN);
 
+#if !GLIB_CHECK_VERSION(2, 32, 0)
+  // the debug log file is written by a background thread
+  if (!g_thread_supported())
+    g_thread_init(NULL);
+#endif
+
   // parse args
   bool ascii = false;
   bool offline = false;
   const char *config_path = CIM_CONFIG_PATH;
+  const char *trace_file = NULL;
+  bool profile_startup = false;
   int opt;
   struct option long_options[] = {
     {"ascii",   no_argument,       NULL, 'a'},
@@ -73,9 +83,11 @@ int main(int argc, char *argv[])
     {"version", no_argument,       NULL, 'v'},
     {"basedir", required_argument, NULL, 'b'},
     {"offline", no_argument,       NULL, 'o'},
+    {"trace",   required_argument, NULL, 't'},
+    {"profile-startup", no_argument, NULL, 'p'},
     {NULL,      0,                 NULL,  0 }
   };
-  while ((opt = getopt_long(argc, argv, "ahvb:o", long_options, NULL))
+  while ((opt = getopt_long(argc, argv, "ahvb:ot:p", long_options, NULL))
       != -1) {
     switch (opt) {
       case 'a':
@@ -93,6 +105,12 @@ int main(int argc, char *argv[])
       case 'o':
         offline = true;
         break;
+      case 't':
+        trace_file = optarg;
+        break;
+      case 'p':
+        profile_startup = true;
+        break;
       default:
         print_usage(stderr, argv[0]);
         return 1;
@@ -106,6 +124,9 @@ int main(int argc, char *argv[])
     return 1;
   }
 
+  StartupProfiler profiler;
+  profiler.beginPhase("cppconsui-init");
+
   // initialize CppConsUI
   int consui_res = CppConsUI::initializeConsUI();
   if (consui_res) {
@@ -114,8 +135,10 @@ int main(int argc, char *argv[])
   }
 
   // initialize CenterIM and run it
+  profiler.beginPhase("centerim-init");
   CenterIM::init();
-  int cim_res = CenterIM::instance()->run(config_path, ascii, offline);
+  int cim_res = CenterIM::instance()->run(config_path, ascii, offline,
+      trace_file, profile_startup ? &profiler : NULL);
   CenterIM::finalize();
 
   // finalize CppConsUI
@@ -125,6 +148,13 @@ int main(int argc, char *argv[])
     return consui_res;
   }
 
+  // print the report when the terminal is restored
+  if (profile_startup) {
+    char *report = profiler.getReport();
+    fputs(report, stderr);
+    g_free(report);
+  }
+
   return cim_res;
 }
 
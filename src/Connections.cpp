@@ -166,7 +166,8 @@ void Connections::report_disconnect_reason(PurpleConnection *gc,
     unsigned delay = g_random_int_range(RECONNECTION_DELAY_MIN,
         RECONNECTION_DELAY_MAX);
     COREMANAGER->timeoutOnceConnect(sigc::bind(sigc::mem_fun(this,
-            &Connections::reconnectAccount), account), delay);
+            &Connections::reconnectAccount), account), delay,
+        G_PRIORITY_DEFAULT, "reconnect");
     LOG->message(ngettext("+ [%s] %s: Auto-reconnection in %d second",
           "+ [%s] %s: Auto-reconnection in %d seconds", delay / 1000),
         protocol, username, delay / 1000);
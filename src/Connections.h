@@ -22,6 +22,8 @@
 #ifndef __CONNECTIONS_H__
 #define __CONNECTIONS_H__
 
+#include "Watchdog.h"
+
 #include <libpurple/purple.h>
 
 #define CONNECTIONS (Connections::instance())
@@ -53,9 +55,17 @@ private:
       size_t step, size_t step_count)
     { CONNECTIONS->connect_progress(gc, text, step, step_count); }
   static void connected_(PurpleConnection *gc)
-    { CONNECTIONS->connected(gc) ;}
+  {
+    Watchdog::Scope scope(Watchdog::SOURCE_UI_OP, "connected", NULL,
+        purple_connection_get_account(gc));
+    CONNECTIONS->connected(gc);
+  }
   static void disconnected_(PurpleConnection *gc)
-    { CONNECTIONS->disconnected(gc); }
+  {
+    Watchdog::Scope scope(Watchdog::SOURCE_UI_OP, "disconnected", NULL,
+        purple_connection_get_account(gc));
+    CONNECTIONS->disconnected(gc);
+  }
   static void notice_(PurpleConnection *gc, const char *text)
     { CONNECTIONS->notice(gc, text); }
   static void network_connected_()
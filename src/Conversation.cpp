@@ -28,27 +28,19 @@
 #include <sys/stat.h>
 #include "gettext.h"
 
+// the maximum number of kept messages that aren't in the logfile
+#define PENDING_MAX 1000
+
 Conversation::Conversation(PurpleConversation *conv_)
-: Window(0, 0, 80, 24), conv(conv_), filename(NULL), logfile(NULL)
-, input_text_length(0)
+: Window(0, 0, 80, 24), view(NULL), input(NULL), line(NULL), conv(conv_)
+, filename(NULL), logfile(NULL), input_text_length(0)
+, history_loaded(false)
 {
   g_assert(conv);
 
-  setColorScheme("conversation");
+  scratch = g_string_new(NULL);
 
-  view = new CppConsUI::TextView(width - 2, height, true, true);
-  input = new CppConsUI::TextEdit(width - 2, height);
-  input->signal_text_change.connect(sigc::mem_fun(this,
-        &Conversation::onInputTextChange));
-  char *name = g_strdup_printf("[%s] %s",
-      purple_account_get_protocol_name(purple_conversation_get_account(conv)),
-      purple_conversation_get_name(conv));
-  line = new ConversationLine(name);
-  g_free(name);
-  addWidget(*view, 1, 0);
-  addWidget(*input, 1, 1);
-  addWidget(*line, 0, height);
-  input->grabFocus();
+  setColorScheme("conversation");
 
   // open logfile
   buildLogFilename();
@@ -60,8 +52,6 @@ Conversation::Conversation(PurpleConversation *conv_)
     g_clear_error(&err);
   }
 
-  loadHistory();
-
   declareBindables();
 }
 
@@ -70,11 +60,70 @@ Conversation::~Conversation()
   g_free(filename);
   if (logfile)
     g_io_channel_unref(logfile);
+  g_string_free(scratch, TRUE);
+
+  clearBuffer();
+}
+
+void Conversation::materialize()
+{
+  if (view)
+    return;
+
+  view = new ConversationView(width - 2, height);
+  input = new CppConsUI::TextEdit(width - 2, height);
+  input->signal_text_change.connect(sigc::mem_fun(this,
+        &Conversation::onInputTextChange));
+  char *name = g_strdup_printf("[%s] %s",
+      purple_account_get_protocol_name(purple_conversation_get_account(conv)),
+      purple_conversation_get_name(conv));
+  line = new ConversationLine(name);
+  g_free(name);
+  addWidget(*view, 1, 0);
+  addWidget(*input, 1, 1);
+  addWidget(*line, 0, height);
+  input->grabFocus();
+
+  // lay out the new widgets
+  onScreenResized();
+
+  /* Fill the view. The first time the history is loaded from the logfile
+   * and merged with the messages that aren't logged. Later the view is
+   * rebuilt from the lines saved when the window was demoted. */
+  if (history_loaded) {
+    MessageBuffer::const_iterator i = buffer.begin();
+    appendBuffered(i, -1);
+  }
+  else {
+    loadHistory();
+    history_loaded = true;
+  }
+  clearBuffer();
+}
+
+bool Conversation::demote()
+{
+  // keep the window if there is any text that hasn't been sent yet
+  if (!view || input->getTextLength())
+    return false;
+
+  // keep the lines in a compact form, the view is rebuilt from them
+  view->saveMessages(buffer);
+
+  removeWidget(*view);
+  removeWidget(*input);
+  removeWidget(*line);
+  view = NULL;
+  input = NULL;
+  line = NULL;
+  input_text_length = 0;
+
+  return true;
 }
 
 bool Conversation::processInput(const TermKeyKey& key)
 {
-  if (view->processInput(key))
+  if (view && view->processInput(key))
     return true;
 
   return Window::processInput(key);
@@ -84,6 +133,9 @@ void Conversation::moveResize(int newx, int newy, int neww, int newh)
 {
   Window::moveResize(newx, newy, neww, newh);
 
+  if (!view)
+    return;
+
   int percentage = purple_prefs_get_int(CONF_PREFIX "/chat/partitioning");
   percentage = CLAMP(percentage, 0, 100);
 
@@ -124,7 +176,8 @@ void Conversation::show()
    * is actually displayed, so screen lines recalculations in TextView (caused
    * by changing the scrollbar setting) aren't triggered if it isn't really
    * necessary. */
-  view->setScrollBar(!CENTERIM->getExpandedConversations());
+  if (view)
+    view->setScrollBar(!CENTERIM->getExpandedConversations());
 
   Window::show();
 }
@@ -172,58 +225,48 @@ void Conversation::write(const char *name, const char * alias,
   }
 
   // write the message
-  int color;
   const char *dir;
   const char *mtype;
   if (flags & PURPLE_MESSAGE_SEND) {
     dir = "OUT";
     mtype = "MSG2"; // cim5 message
-    color = 1;
   }
   else if (flags & PURPLE_MESSAGE_RECV) {
     dir = "IN";
     mtype = "MSG2"; // cim5 message
-    color = 2;
   }
   else {
     dir = "IN";
     mtype = "OTHER";
-    color = 0;
-
   }
 
   // write text into logfile
-  if (!(flags & PURPLE_MESSAGE_NO_LOG)) {
-    char *log_msg;
-    log_msg = g_strdup_printf("\f\n%s\n%s\n%lu\n%lu\n%s: %s\n", dir, mtype,
+  if (!(flags & PURPLE_MESSAGE_NO_LOG) && logfile) {
+    g_string_printf(scratch, "\f\n%s\n%s\n%lu\n%lu\n%s: %s\n", dir, mtype,
         mtime, cur_time, alias, message);
-    if (logfile) {
-      GError *err = NULL;
-      if (g_io_channel_write_chars(logfile, log_msg, -1, NULL, &err)
-          != G_IO_STATUS_NORMAL) {
-        LOG->error(_("Error writing to conversation logfile (%s)."),
-            err->message);
-        g_clear_error(&err);
-      }
-      if (g_io_channel_flush(logfile, &err) != G_IO_STATUS_NORMAL) {
-        LOG->error(_("Error flushing conversation logfile (%s)."),
-            err->message);
-        g_clear_error(&err);
-      }
+    GError *err = NULL;
+    if (g_io_channel_write_chars(logfile, scratch->str, scratch->len, NULL,
+          &err) != G_IO_STATUS_NORMAL) {
+      LOG->error(_("Error writing to conversation logfile (%s)."),
+          err->message);
+      g_clear_error(&err);
+    }
+    if (g_io_channel_flush(logfile, &err) != G_IO_STATUS_NORMAL) {
+      LOG->error(_("Error flushing conversation logfile (%s)."),
+          err->message);
+      g_clear_error(&err);
     }
-    g_free(log_msg);
   }
 
   // write text to the window
-  char *newline = purple_strdup_withhtml(message);
-  char *nohtml = purple_markup_strip_html(newline);
-  char *time = extractTime(mtime, cur_time);
-  char *msg = g_strdup_printf("(%s) %s: %s", time, alias, nohtml);
-  view->append(msg, color);
-  g_free(newline);
-  g_free(nohtml);
-  g_free(time);
-  g_free(msg);
+  if (view)
+    appendMessage(mtime, cur_time, alias, message, flags);
+  else if (history_loaded || (flags & PURPLE_MESSAGE_NO_LOG) || !logfile) {
+    /* Keep the message until the window is materialized. Once the history
+     * is loaded every message has to be kept, before that only those that
+     * won't be loaded from the logfile. */
+    bufferMessage(mtime, cur_time, alias, message, flags);
+  }
 }
 
 Conversation::ConversationLine::ConversationLine(const char *text_)
@@ -269,40 +312,192 @@ void Conversation::ConversationLine::draw()
   area->attroff(attrs);
 }
 
-char *Conversation::stripHTML(const char *str) const
+Conversation::ConversationView::ConversationView(int w, int h)
+: TextView(w, h, true, true), prefix_sent_minute(0), prefix_show_minute(0)
 {
-  /* Almost copy&paste from libpurple/util.c:purple_markup_strip_html(), but
-   * this version doesn't convert tab character to a space. */
+  sent_stamp.text[0] = '\0';
+  show_stamp.text[0] = '\0';
+  prefix = g_string_new(NULL);
+}
 
-  int i, j, k, entlen;
-  bool visible = true;
-  bool closing_td_p = false;
-  gchar *str2;
-  const gchar *cdata_close_tag = NULL, *ent;
-  gchar *href = NULL;
-  int href_st = 0;
+Conversation::ConversationView::~ConversationView()
+{
+  g_string_free(prefix, TRUE);
+}
 
-  if (!str)
+void Conversation::ConversationView::appendMessage(time_t sent_time,
+    time_t show_time, PurpleMessageFlags flags, const char *text, int color,
+    const ColorSpan *spans, size_t spans_num)
+{
+  g_assert(text);
+
+  // only the first line of the message carries the times
+  const char *p = strchr(text, '\n');
+  size_t bytes = p ? static_cast<size_t>(p - text) : strlen(text);
+  size_t first_num = 0;
+  while (first_num < spans_num && spans[first_num].offset <= bytes)
+    first_num++;
+  insertLine(lines.size(), *(new MessageLine(text, bytes, color, spans,
+          first_num, sent_time, show_time, flags)));
+
+  if (!p || !p[1])
+    return;
+
+  // the rest of the message continues with the last color of the first line
+  if (first_num)
+    color = spans[first_num - 1].color;
+  size_t rest_num = spans_num - first_num;
+  ColorSpan *rest = rest_num ? g_newa(ColorSpan, rest_num) : NULL;
+  for (size_t i = 0; i < rest_num; i++) {
+    rest[i].offset = spans[first_num + i].offset - (bytes + 1);
+    rest[i].color = spans[first_num + i].color;
+  }
+  append(p + 1, color, rest, rest_num);
+}
+
+void Conversation::ConversationView::saveMessages(MessageBuffer& out) const
+{
+  GString *text = g_string_new(NULL);
+  const MessageLine *msg = NULL;
+  for (Lines::const_iterator i = lines.begin(); ; i++) {
+    const MessageLine *next = NULL;
+    if (i != lines.end()) {
+      next = dynamic_cast<const MessageLine*>(*i);
+      if (!next) {
+        // continuation of the current message
+        if (msg) {
+          g_string_append_c(text, '\n');
+          g_string_append(text, (*i)->text);
+        }
+        continue;
+      }
+    }
+
+    if (msg) {
+      BufferedMessage saved;
+      saved.sent_time = msg->sent_time;
+      saved.show_time = msg->show_time;
+      saved.flags = msg->flags;
+      saved.nick_len = msg->spans_num > 1 ? msg->spans[1].offset : 0;
+      saved.text = g_strndup(text->str, text->len);
+      out.push_back(saved);
+    }
+
+    if (!next)
+      break;
+    msg = next;
+    g_string_assign(text, msg->text);
+  }
+  g_string_free(text, TRUE);
+}
+
+void Conversation::ConversationView::onTimestampFormatChange()
+{
+  sent_stamp.text[0] = '\0';
+  show_stamp.text[0] = '\0';
+  g_string_truncate(prefix, 0);
+
+  updateAllScreenLines();
+  redraw();
+}
+
+Conversation::ConversationView::MessageLine::MessageLine(const char *text_,
+    size_t bytes, int color_, const ColorSpan *spans_, size_t spans_num_,
+    time_t sent_time_, time_t show_time_, PurpleMessageFlags flags_)
+: Line(text_, bytes, color_, spans_, spans_num_), sent_time(sent_time_)
+, show_time(show_time_), flags(flags_)
+{
+}
+
+const char *Conversation::ConversationView::getLinePrefix(const Line& line)
+{
+  const MessageLine *msg = dynamic_cast<const MessageLine*>(&line);
+  if (!msg)
     return NULL;
 
-  str2 = g_strdup(str);
+  // the sent time is shown only if it differs significantly
+  bool show_sent = abs(msg->sent_time - msg->show_time) > 5;
+  time_t sent_minute = show_sent ? msg->sent_time / 60 : -1;
+  time_t show_minute = msg->show_time / 60;
+  if (prefix->len && sent_minute == prefix_sent_minute
+      && show_minute == prefix_show_minute)
+    return prefix->str;
+
+  // based on the extracttime() function from cim4
+  const char *t1 = formatTime(msg->show_time, show_stamp);
+
+  g_string_assign(prefix, "(");
+  g_string_append(prefix, t1);
+  const char *t2;
+  if (show_sent && strcmp(t1, t2 = formatTime(msg->sent_time, sent_stamp))) {
+    g_string_append(prefix, " [");
+    g_string_append(prefix, t2);
+    g_string_append_c(prefix, ']');
+  }
+  g_string_append(prefix, ") ");
+
+  prefix_sent_minute = sent_minute;
+  prefix_show_minute = show_minute;
+  return prefix->str;
+}
+
+const char *Conversation::ConversationView::formatTime(time_t t,
+    TimeStamp& stamp)
+{
+  /* The time is shown with a minute precision, so the formatted string can
+   * be reused for all messages from the same minute. */
+  time_t minute = t / 60;
+  if (stamp.text[0] && stamp.minute == minute)
+    return stamp.text;
+
+  // convert to local time, note that localtime_r() shouldn't really fail
+  struct tm local;
+  if (!localtime_r(&t, &local))
+    memset(&local, 0, sizeof(local));
+
+  g_strlcpy(stamp.text, purple_utf8_strftime(
+        CONVERSATIONS->getTimestampFormat(), &local), sizeof(stamp.text));
+  stamp.minute = minute;
+  return stamp.text;
+}
+
+void Conversation::appendStrippedHTML(GString *out, const char *str) const
+{
+  /* Based on libpurple/util.c:purple_markup_strip_html(), but this version
+   * writes directly into the out buffer, doesn't convert tab character to
+   * a space and handles newline characters the same way as
+   * purple_strdup_withhtml() + purple_markup_strip_html() would do. */
+
+  if (!str)
+    return;
 
-  for (i = 0, j = 0; str2[i]; i++) {
-    if (str2[i] == '<') {
+  gsize start = out->len;
+  bool visible = true;
+  bool closing_td_p = false;
+  const char *cdata_close_tag = NULL;
+  // address of the last <a> tag, it points into the str string
+  const char *href = NULL;
+  size_t href_len = 0;
+  gsize href_st = 0;
+  const char *ent;
+  int entlen;
+
+  for (const char *p = str; *p; p++) {
+    if (*p == '<') {
       if (cdata_close_tag) {
         // note: don't even assume any other tag is a tag in CDATA
-        if (g_ascii_strncasecmp(str2 + i, cdata_close_tag,
-              !strlen(cdata_close_tag))) {
-          i += strlen(cdata_close_tag) - 1;
+        size_t len = strlen(cdata_close_tag);
+        if (!g_ascii_strncasecmp(p, cdata_close_tag, len)) {
+          p += len - 1;
           cdata_close_tag = NULL;
         }
         continue;
       }
-      else if (!g_ascii_strncasecmp(str2 + i, "<td", 3) && closing_td_p) {
-        str2[j++] = '\t';
+      else if (!g_ascii_strncasecmp(p, "<td", 3) && closing_td_p) {
+        g_string_append_c(out, '\t');
         visible = true;
       }
-      else if (!g_ascii_strncasecmp(str2 + i, "</td>", 5)) {
+      else if (!g_ascii_strncasecmp(p, "</td>", 5)) {
         closing_td_p = true;
         visible = false;
       }
@@ -311,123 +506,124 @@ char *Conversation::stripHTML(const char *str) const
         visible = true;
       }
 
-      k = i + 1;
+      const char *k = p + 1;
 
-      if (g_ascii_isspace(str2[k]))
+      if (g_ascii_isspace(*k))
         visible = true;
-      else if (str2[k]) {
+      else if (*k) {
         /* Scan until we end the tag either implicitly (closed start tag) or
          * explicitly, using a sloppy method (i.e., < or > inside quoted
          * attributes will screw us up). */
-        while (str2[k] && str2[k] != '<' && str2[k] != '>')
+        while (*k && *k != '<' && *k != '>')
           k++;
 
         /* If we've got an <a> tag with an href, save the address to print
          * later. */
-        if (!g_ascii_strncasecmp(str2 + i, "<a", 2)
-            && g_ascii_isspace(str2[i + 2])) {
-          int st; // start of href, inclusive [
-          int end; // end of href, exclusive )
+        if (!g_ascii_strncasecmp(p, "<a", 2) && g_ascii_isspace(p[2])) {
+          const char *st; // start of href, inclusive [
+          const char *end; // end of href, exclusive )
           char delim = ' ';
           // find start of href
-          for (st = i + 3; st < k; st++) {
-            if (!g_ascii_strncasecmp(str2 + st, "href=", 5)) {
+          for (st = p + 3; st < k; st++) {
+            if (!g_ascii_strncasecmp(st, "href=", 5)) {
               st += 5;
-              if (str2[st] == '"' || str2[st] == '\'') {
-                delim = str2[st];
+              if (*st == '"' || *st == '\'') {
+                delim = *st;
                 st++;
               }
               break;
             }
           }
           // find end of address
-          for (end = st; end < k && str2[end] != delim; end++) {
+          for (end = st; end < k && *end != delim; end++) {
             // all the work is done in the loop construct above
           }
 
           /* If there's an address, save it. If there was already one saved,
-           * kill it. */
+           * forget it. */
           if (st < k) {
-            char *tmp;
-            g_free(href);
-            tmp = g_strndup(str2 + st, end - st);
-            href = purple_unescape_html(tmp);
-            g_free(tmp);
-            href_st = j;
+            href = st;
+            href_len = end - st;
+            href_st = out->len;
           }
         }
 
         /* Replace </a> with an ascii representation of the address the link
          * was pointing to. */
-        else if (href && !g_ascii_strncasecmp(str2 + i, "</a>", 4)) {
-          size_t hrlen = strlen(href);
+        else if (href && !g_ascii_strncasecmp(p, "</a>", 4)) {
+          // append the unescaped address
+          gsize link_st = out->len;
+          g_string_append(out, " (");
+          for (const char *h = href; h < href + href_len; h++) {
+            if (*h == '&' && (ent = purple_markup_unescape_entity(h,
+                    &entlen))) {
+              g_string_append(out, ent);
+              h += entlen - 1;
+            }
+            else
+              g_string_append_c(out, *h);
+          }
+          href = NULL;
 
-          /* Only insert the href if it's different from the CDATA.
+          /* Only keep the address if it's different from the CDATA.
            *  7 == strlen("http://") */
-          if ((hrlen != (unsigned)(j - href_st) ||
-                strncmp(str2 + href_st, href, hrlen)) &&
-              (hrlen != (unsigned)(j - href_st + 7) ||
-               strncmp(str2 + href_st, href + 7, hrlen - 7)))
-          {
-            str2[j++] = ' ';
-            str2[j++] = '(';
-            g_memmove(str2 + j, href, hrlen);
-            j += hrlen;
-            str2[j++] = ')';
-            g_free(href);
-            href = NULL;
-          }
+          const char *cdata = out->str + href_st;
+          size_t cdata_len = link_st - href_st;
+          const char *addr = out->str + link_st + 2;
+          size_t addr_len = out->len - link_st - 2;
+          if ((addr_len == cdata_len && !strncmp(cdata, addr, addr_len))
+              || (addr_len == cdata_len + 7
+                && !strncmp(cdata, addr + 7, addr_len - 7)))
+            g_string_truncate(out, link_st);
+          else
+            g_string_append_c(out, ')');
         }
 
         /* Check for tags which should be mapped to newline (but ignore some
          * of the tags at the beginning of the text) */
-        else if ((j && (!g_ascii_strncasecmp(str2 + i, "<p>", 3)
-                || !g_ascii_strncasecmp(str2 + i, "<tr", 3)
-                || !g_ascii_strncasecmp(str2 + i, "<hr", 3)
-                || !g_ascii_strncasecmp(str2 + i, "<li", 3)
-                || !g_ascii_strncasecmp(str2 + i, "<div", 4)))
-            || !g_ascii_strncasecmp(str2 + i, "<br", 3)
-            || !g_ascii_strncasecmp(str2 + i, "</table>", 8))
-          str2[j++] = '\n';
+        else if ((out->len > start && (!g_ascii_strncasecmp(p, "<p>", 3)
+                || !g_ascii_strncasecmp(p, "<tr", 3)
+                || !g_ascii_strncasecmp(p, "<hr", 3)
+                || !g_ascii_strncasecmp(p, "<li", 3)
+                || !g_ascii_strncasecmp(p, "<div", 4)))
+            || !g_ascii_strncasecmp(p, "<br", 3)
+            || !g_ascii_strncasecmp(p, "</table>", 8))
+          g_string_append_c(out, '\n');
         // check for tags which begin CDATA and need to be closed
-#if 0 // FIXME.. option is end tag optional, we can't handle this right now
-        else if (!g_ascii_strncasecmp(str2 + i, "<option", 7))
-        {
-          // FIXME we should not do this if the OPTION is SELECT'd
-          cdata_close_tag = "</option>";
-        }
-#endif
-        else if (!g_ascii_strncasecmp(str2 + i, "<script", 7))
+        else if (!g_ascii_strncasecmp(p, "<script", 7))
           cdata_close_tag = "</script>";
-        else if (!g_ascii_strncasecmp(str2 + i, "<style", 6))
+        else if (!g_ascii_strncasecmp(p, "<style", 6))
           cdata_close_tag = "</style>";
         // update the index and continue checking after the tag
-        i = (str2[k] == '<' || str2[k] == '\0') ? k - 1: k;
+        p = (*k == '<' || *k == '\0') ? k - 1 : k;
         continue;
       }
     }
     else if (cdata_close_tag)
       continue;
-    else if (!g_ascii_isspace(str2[i]))
+    else if (!g_ascii_isspace(*p))
       visible = true;
 
-    if (str2[i] == '&' && (ent = purple_markup_unescape_entity(str2 + i,
-            &entlen))) {
-      while (*ent)
-        str2[j++] = *ent++;
-      i += entlen - 1;
+    if (*p == '&' && (ent = purple_markup_unescape_entity(p, &entlen))) {
+      g_string_append(out, ent);
+      p += entlen - 1;
+      continue;
+    }
+
+    /* Newline characters would be converted to <br> tags by
+     * purple_strdup_withhtml(), carriage returns would be dropped. */
+    if (*p == '\n') {
+      g_string_append_c(out, '\n');
+      closing_td_p = false;
+      visible = true;
       continue;
     }
+    if (*p == '\r')
+      continue;
 
     if (visible)
-      str2[j++] = g_ascii_isspace(str2[i]) && str[i] != '\t' ? ' ': str2[i];
+      g_string_append_c(out, g_ascii_isspace(*p) && *p != '\t' ? ' ' : *p);
   }
-
-  g_free(href);
-
-  str2[j] = '\0';
-
-  return str2;
 }
 
 void Conversation::buildLogFilename()
@@ -462,37 +658,95 @@ void Conversation::buildLogFilename()
   g_free(acct_name);
 }
 
-char *Conversation::extractTime(time_t sent_time, time_t show_time) const
+size_t Conversation::formatMessage(const char *alias, const char *html)
 {
-  // based on the extracttime() function from cim4
+  /* Format "alias: text" into the scratch buffer, the time prefix is added
+   * by the view when the message is drawn. */
+  g_string_truncate(scratch, 0);
+  size_t nick_len = 0;
+  if (alias) {
+    g_string_append(scratch, alias);
+    g_string_append(scratch, ": ");
+    nick_len = scratch->len;
+  }
+  appendStrippedHTML(scratch, html);
+  return nick_len;
+}
 
-  // convert to local time, note that localtime_r() shouldn't really fail
-  struct tm show_time_local;
-  struct tm sent_time_local;
-  if (!localtime_r(&show_time, &show_time_local))
-    memset(&show_time_local, 0, sizeof(show_time_local));
-  if (!localtime_r(&sent_time, &sent_time_local))
-    memset(&sent_time_local, 0, sizeof(sent_time_local));
-
-  // format the times
-  char *t1 = g_strdup(purple_utf8_strftime(_("%d %b %Y %H:%M"), &show_time_local));
-  char *t2 = g_strdup(purple_utf8_strftime(_("%d %b %Y %H:%M"), &sent_time_local));
-
-  int tdiff = abs(sent_time - show_time);
-
-  if (tdiff > 5 && strcmp(t1, t2)) {
-    char *res = g_strdup_printf("%s [%s]", t1, t2);
-    g_free(t1);
-    g_free(t2);
-    return res;
+void Conversation::appendMessage(time_t sent_time, time_t show_time,
+    const char *alias, const char *html, PurpleMessageFlags flags)
+{
+  size_t nick_len = formatMessage(alias, html);
+  appendText(sent_time, show_time, scratch->str, nick_len, flags);
+}
+
+void Conversation::bufferMessage(time_t sent_time, time_t show_time,
+    const char *alias, const char *html, PurpleMessageFlags flags)
+{
+  BufferedMessage msg;
+  msg.sent_time = sent_time;
+  msg.show_time = show_time;
+  msg.flags = flags;
+  msg.nick_len = formatMessage(alias, html);
+  msg.text = g_strndup(scratch->str, scratch->len);
+  buffer.push_back(msg);
+
+  // the view isn't limited, only messages missing in the logfile are
+  if (!history_loaded && buffer.size() > PENDING_MAX) {
+    g_free(buffer.front().text);
+    buffer.pop_front();
+  }
+}
+
+void Conversation::appendLoggedMessage(time_t sent_time, time_t show_time,
+    const char *html, PurpleMessageFlags flags)
+{
+  g_string_truncate(scratch, 0);
+  appendStrippedHTML(scratch, html);
+
+  // the nick ends with the first ": " on the first line
+  const char *eol = strchr(scratch->str, '\n');
+  const char *sep = strstr(scratch->str, ": ");
+  size_t nick_len = 0;
+  if (sep && (!eol || sep < eol))
+    nick_len = sep - scratch->str + 2;
+  appendText(sent_time, show_time, scratch->str, nick_len, flags);
+}
+
+void Conversation::appendText(time_t sent_time, time_t show_time,
+    const char *text, size_t nick_len, PurpleMessageFlags flags)
+{
+  int color = COLOR_OTHER;
+  int nick_color = COLOR_OTHER;
+  if (flags & PURPLE_MESSAGE_SEND) {
+    color = COLOR_SENT;
+    nick_color = COLOR_SENT_NICK;
+  }
+  else if (flags & PURPLE_MESSAGE_RECV) {
+    color = COLOR_RECEIVED;
+    nick_color = COLOR_RECEIVED_NICK;
+  }
+
+  // only nicks of real messages are highlighted, not of status lines
+  if (!nick_len || color == COLOR_OTHER) {
+    view->appendMessage(sent_time, show_time, flags, text, color);
+    return;
   }
 
-  g_free(t2);
-  return t1;
+  CppConsUI::TextView::ColorSpan spans[2];
+  spans[0].offset = 0;
+  spans[0].color = nick_color;
+  spans[1].offset = nick_len;
+  spans[1].color = color;
+  view->appendMessage(sent_time, show_time, flags, text, color, spans, 2);
 }
 
 void Conversation::loadHistory()
 {
+  /* Buffered messages are merged with the logged ones by their show times,
+   * messages from the same second are placed after the logged ones. */
+  MessageBuffer::const_iterator next_buffered = buffer.begin();
+
   // open logfile
   GError *err = NULL;
   GIOChannel *chan;
@@ -501,132 +755,85 @@ void Conversation::loadHistory()
     LOG->error(_("Error opening conversation logfile '%s' (%s)."), filename,
         err->message);
     g_clear_error(&err);
+    appendBuffered(next_buffered, -1);
     return;
   }
   // this should never fail
   g_io_channel_set_encoding(chan, NULL, NULL);
 
+  /* Note: The line and msg buffers are reused for all messages to avoid
+   * allocations when a long history is loaded. */
   GIOStatus st;
-  char *line;
+  GString *line = g_string_new(NULL);
+  std::string msg;
   bool new_msg = false;
   // read conversation logfile line by line
-  while (new_msg || (st = g_io_channel_read_line(chan, &line, NULL, NULL,
+  while (new_msg || (st = g_io_channel_read_line_string(chan, line, NULL,
           &err)) == G_IO_STATUS_NORMAL) {
     new_msg = false;
 
     // start flag
-    if (strcmp(line, "\f\n")) {
-      g_free(line);
+    if (strcmp(line->str, "\f\n"))
       continue;
-    }
-    g_free(line);
 
     // parse direction (in/out)
-    if ((st = g_io_channel_read_line(chan, &line, NULL, NULL, &err))
+    if ((st = g_io_channel_read_line_string(chan, line, NULL, &err))
         != G_IO_STATUS_NORMAL)
       break;
-    int color = 3;
-    if (!strcmp(line, "OUT\n"))
-      color = 1;
-    else if (!strcmp(line, "IN\n"))
-      color = 2;
-    g_free(line);
-
-    // type
-    if ((st = g_io_channel_read_line(chan, &line, NULL, NULL, &err))
+    int flags = 0;
+    if (!strcmp(line->str, "OUT\n"))
+      flags = PURPLE_MESSAGE_SEND;
+    else if (!strcmp(line->str, "IN\n"))
+      flags = PURPLE_MESSAGE_RECV;
+
+    // type, status lines are logged as "OTHER"
+    if ((st = g_io_channel_read_line_string(chan, line, NULL, &err))
         != G_IO_STATUS_NORMAL)
       break;
-    bool cim4 = true;
-    // if (!strcmp(line, "MSG2\n"))
-    //   cim4 = false;
-    // else if (!strcmp(line, "OTHER\n")) {
-    //   cim4 = false;
-    //   color = 0;
-    // }
-    g_free(line);
+    if (!strcmp(line->str, "OTHER\n"))
+      flags = PURPLE_MESSAGE_SYSTEM;
 
     // sent time
-    if ((st = g_io_channel_read_line(chan, &line, NULL, NULL, &err))
+    if ((st = g_io_channel_read_line_string(chan, line, NULL, &err))
         != G_IO_STATUS_NORMAL)
       break;
-    time_t sent_time = atol(line);
-    g_free(line);
+    time_t sent_time = atol(line->str);
 
     // show time
-    if ((st = g_io_channel_read_line(chan, &line, NULL, NULL, &err))
+    if ((st = g_io_channel_read_line_string(chan, line, NULL, &err))
         != G_IO_STATUS_NORMAL)
       break;
-    time_t show_time = atol(line);
-    g_free(line);
-
-    if (!cim4) {
-      // cim5, read only one line and strip it off HTML
-      if ((st = g_io_channel_read_line(chan, &line, NULL, NULL, &err))
-          != G_IO_STATUS_NORMAL)
+    time_t show_time = atol(line->str);
+
+    /* The message continues up to the next start flag. This handles both
+     * multi-line cim4 messages and cim5 messages that contain newline
+     * characters. */
+    msg.clear();
+    while ((st = g_io_channel_read_line_string(chan, line, NULL, &err))
+        == G_IO_STATUS_NORMAL) {
+      if (!strcmp(line->str, "\f\n")) {
+        new_msg = true;
         break;
-
-      // validate UTF-8
-      if (!g_utf8_validate(line, -1, NULL)) {
-        g_free(line);
-        LOG->error(_("Invalid message detected in conversation logfile"
-              " '%s'. The message was skipped."), filename);
-        continue;
       }
 
-      // write text to the window
-      char *nohtml = stripHTML(line);
-      char *time = extractTime(sent_time, show_time);
-      char *msg = g_strdup_printf("(%s) %s", time, nohtml);
-      view->append(msg, color);
-      g_free(nohtml);
-      g_free(time);
-      g_free(msg);
-      g_free(line);
+      /* Note: '\r' characters don't have to be stripped here,
+       * appendStrippedHTML() skips them. */
+      msg.append(line->str, line->len);
     }
-    else {
-      // cim4, read multiple raw lines
-      gsize length;
-      std::string msg;
-      while ((st = g_io_channel_read_line(chan, &line, &length, NULL, &err))
-          == G_IO_STATUS_NORMAL && line != NULL) {
-        if (!strcmp(line, "\f\n")) {
-          new_msg = true;
-          break;
-        }
-
-        // strip '\r' if necessary
-        if (length > 1 && line[length - 2] == '\r') {
-          line[length - 2] = '\n';
-          line[length - 1] = '\0';
-        }
-        msg.append(line);
-        g_free(line);
-      }
-
-      // if (!new_msg) {
-      //   // EOL or I/O error
-      //   break;
-      // }
 
-      // validate UTF-8
-      if (!g_utf8_validate(msg.c_str(), -1, NULL)) {
-        LOG->error(_("Invalid message detected in conversation logfile"
-              " '%s'. The message was skipped."), filename);
-        continue;
-      }
-
-      // add the message to the window
-      char *newline = purple_strdup_withhtml(msg.c_str());
-      char *nohtml = purple_markup_strip_html(newline);
-      char *time = extractTime(sent_time, show_time);
-      char *final_msg = g_strdup_printf("(%s) %s", time, nohtml);
-      view->append(final_msg, color);
-      g_free(newline);
-      g_free(nohtml);
-      g_free(time);
-      g_free(final_msg);
+    // validate UTF-8
+    if (!g_utf8_validate(msg.c_str(), msg.size(), NULL)) {
+      LOG->error(_("Invalid message detected in conversation logfile"
+            " '%s'. The message was skipped."), filename);
+      continue;
     }
+
+    // add the message to the window
+    appendBuffered(next_buffered, show_time);
+    appendLoggedMessage(sent_time, show_time, msg.c_str(),
+        static_cast<PurpleMessageFlags>(flags));
   }
+  g_string_free(line, TRUE);
 
   if (st != G_IO_STATUS_EOF) {
     LOG->error(_("Error reading from conversation logfile '%s' (%s)."),
@@ -634,6 +841,22 @@ void Conversation::loadHistory()
     g_clear_error(&err);
   }
   g_io_channel_unref(chan);
+
+  appendBuffered(next_buffered, -1);
+}
+
+void Conversation::appendBuffered(MessageBuffer::const_iterator& i,
+    time_t before)
+{
+  for (; i != buffer.end() && (before < 0 || i->show_time < before); i++)
+    appendText(i->sent_time, i->show_time, i->text, i->nick_len, i->flags);
+}
+
+void Conversation::clearBuffer()
+{
+  for (MessageBuffer::iterator i = buffer.begin(); i != buffer.end(); i++)
+    g_free(i->text);
+  buffer.clear();
 }
 
 bool Conversation::processCommand(const char *raw, const char *html)
@@ -729,6 +952,9 @@ void Conversation::onInputTextChange(CppConsUI::TextEdit& activator)
 
 void Conversation::actionSend()
 {
+  if (!input)
+    return;
+
   const char *str = input->getText();
   if (!str || !str[0])
     return;
@@ -30,6 +30,8 @@
 #include <cppconsui/Window.h>
 #include <libpurple/purple.h>
 
+#include <deque>
+
 class Conversation
 : public CppConsUI::Window
 {
@@ -52,10 +54,42 @@ public:
 
   void write(const char *name, const char *alias, const char *message,
     PurpleMessageFlags flags, time_t mtime);
+  void onTimestampFormatChange()
+    { if (view) view->onTimestampFormatChange(); }
+
+  /**
+   * Creates widgets of the window and loads the conversation history. The
+   * window is created lightweight and has to be materialized before it is
+   * shown for the first time.
+   */
+  void materialize();
+  /**
+   * Destroys widgets of the window to save memory if the conversation
+   * hasn't been used for some time. Returns false if the window can't be
+   * demoted because the input field contains some text.
+   */
+  bool demote();
+  bool isMaterialized() const { return view != NULL; }
 
   PurpleConversation *getPurpleConversation() const { return conv; };
 
 protected:
+  /**
+   * Compact form of a message kept while the window isn't materialized. The
+   * text is already stripped of HTML and starts with the "alias: " part if
+   * nick_len isn't zero.
+   */
+  struct BufferedMessage
+  {
+    time_t sent_time;
+    time_t show_time;
+    PurpleMessageFlags flags;
+    size_t nick_len;
+    char *text;
+  };
+
+  typedef std::deque<BufferedMessage> MessageBuffer;
+
   class ConversationLine
   : public CppConsUI::AbstractLine
   {
@@ -75,7 +109,93 @@ protected:
     ConversationLine& operator=(const ConversationLine&);
   };
 
-  CppConsUI::TextView *view;
+  /**
+   * TextView that stores times of messages in its lines and formats them
+   * only when the lines are drawn. This saves memory on long scrollbacks and
+   * allows to change the timestamp format without reloading the
+   * conversation.
+   */
+  class ConversationView
+  : public CppConsUI::TextView
+  {
+  public:
+    ConversationView(int w, int h);
+    virtual ~ConversationView();
+
+    /**
+     * Appends a message. The "(time) " prefix is added in front of the
+     * first line of the text when it is drawn.
+     */
+    void appendMessage(time_t sent_time, time_t show_time,
+        PurpleMessageFlags flags, const char *text, int color,
+        const ColorSpan *spans = NULL, size_t spans_num = 0);
+    /**
+     * Appends all messages of the view to a buffer, the nick length is
+     * taken from the second color span of the first message line.
+     */
+    void saveMessages(MessageBuffer& out) const;
+    /**
+     * Drops cached timestamps and rewraps all lines. To be called when the
+     * timestamp format is changed.
+     */
+    void onTimestampFormatChange();
+
+  protected:
+    struct MessageLine
+    : public Line
+    {
+      time_t sent_time;
+      time_t show_time;
+      PurpleMessageFlags flags;
+
+      MessageLine(const char *text_, size_t bytes, int color_,
+          const ColorSpan *spans_, size_t spans_num_, time_t sent_time_,
+          time_t show_time_, PurpleMessageFlags flags_);
+    };
+
+    /**
+     * Formatted time of one minute, used to cache results of strftime().
+     */
+    struct TimeStamp
+    {
+      time_t minute;
+      char text[128];
+    };
+
+    TimeStamp sent_stamp;
+    TimeStamp show_stamp;
+
+    /**
+     * The last formatted prefix. It is reused while consecutive lines share
+     * the same times which is the common case when a view is drawn.
+     */
+    GString *prefix;
+    time_t prefix_sent_minute;
+    time_t prefix_show_minute;
+
+    // TextView
+    virtual const char *getLinePrefix(const Line& line);
+
+    const char *formatTime(time_t t, TimeStamp& stamp);
+
+  private:
+    ConversationView(const ConversationView&);
+    ConversationView& operator=(const ConversationView&);
+  };
+
+  /**
+   * Numbers of the "colorN" properties of the conversation textview used for
+   * messages.
+   */
+  enum MessageColor {
+    COLOR_OTHER = 0,
+    COLOR_SENT = 1,
+    COLOR_RECEIVED = 2,
+    COLOR_RECEIVED_NICK = 4,
+    COLOR_SENT_NICK = 5
+  };
+
+  ConversationView *view;
   CppConsUI::TextEdit *input;
   ConversationLine *line;
 
@@ -86,11 +206,54 @@ protected:
 
   size_t input_text_length;
 
-  char *stripHTML(const char *str) const;
+  /**
+   * Scratch buffer reused for formatting of every message.
+   */
+  GString *scratch;
+
+  /**
+   * Messages of the conversation while the window isn't materialized,
+   * ordered by their show times. Before the history is loaded for the first
+   * time only messages that can't be loaded from the logfile are kept here,
+   * at most PENDING_MAX of them. When the window is demoted all lines of the
+   * view are moved here, so the view can be rebuilt later without rereading
+   * the logfile.
+   */
+  MessageBuffer buffer;
+  bool history_loaded;
+
+  void appendStrippedHTML(GString *out, const char *str) const;
   void destroyPurpleConversation(PurpleConversation *conv);
   void buildLogFilename();
-  char *extractTime(time_t sent_time, time_t show_time) const;
+  /**
+   * Formats "alias: text" into the scratch buffer and returns length of the
+   * "alias: " part.
+   */
+  size_t formatMessage(const char *alias, const char *html);
+  void appendMessage(time_t sent_time, time_t show_time, const char *alias,
+      const char *html, PurpleMessageFlags flags);
+  void bufferMessage(time_t sent_time, time_t show_time, const char *alias,
+      const char *html, PurpleMessageFlags flags);
+  /**
+   * Appends a message from the logfile, the logfile stores the alias and
+   * the text together as "alias: text".
+   */
+  void appendLoggedMessage(time_t sent_time, time_t show_time,
+      const char *html, PurpleMessageFlags flags);
+  /**
+   * Appends already stripped text to the view. The first nick_len bytes
+   * hold the "alias: " part which is highlighted if the message was sent
+   * or received.
+   */
+  void appendText(time_t sent_time, time_t show_time, const char *text,
+      size_t nick_len, PurpleMessageFlags flags);
   void loadHistory();
+  /**
+   * Appends buffered messages starting at a given one that were shown before
+   * a given time, all remaining messages if the time is negative.
+   */
+  void appendBuffered(MessageBuffer::const_iterator& i, time_t before);
+  void clearBuffer();
   bool processCommand(const char *raw, const char *html);
   void onInputTextChange(CppConsUI::TextEdit& activator);
 
@@ -111,16 +111,33 @@ Conversations::Conversations()
   outer_list->appendWidget(*conv_list);
   outer_list->appendWidget(*right_spacer);
 
+  conversation_indexes = g_hash_table_new(g_direct_hash, g_direct_equal);
+  label_text = g_string_new(NULL);
+
   // init prefs
   purple_prefs_add_none(CONF_PREFIX "/chat");
   purple_prefs_add_int(CONF_PREFIX "/chat/partitioning", 80);
   purple_prefs_add_bool(CONF_PREFIX "/chat/beep_on_msg", false);
+  purple_prefs_add_string(CONF_PREFIX "/chat/timestamp_format",
+      "date_time");
+  purple_prefs_add_int(CONF_PREFIX "/chat/demote_timeout", 10);
 
   // send_typing caching
   send_typing = purple_prefs_get_bool("/purple/conversations/im/send_typing");
   purple_prefs_connect_callback(this, "/purple/conversations/im/send_typing",
       send_typing_pref_change_, this);
 
+  // timestamp format caching
+  timestamp_format_pref_change(CONF_PREFIX "/chat/timestamp_format",
+      PURPLE_PREF_STRING, NULL);
+  purple_prefs_connect_callback(this, CONF_PREFIX "/chat/timestamp_format",
+      timestamp_format_pref_change_, this);
+
+  // check for idle conversations every minute
+  demote_timer = COREMANAGER->timeoutConnect(sigc::mem_fun(this,
+        &Conversations::demoteIdleConversations), 60 * 1000,
+      G_PRIORITY_DEFAULT, "conversation-demote");
+
   memset(&centerim_conv_ui_ops, 0, sizeof(centerim_conv_ui_ops));
   centerim_conv_ui_ops.create_conversation = create_conversation_;
   centerim_conv_ui_ops.destroy_conversation = destroy_conversation_;
@@ -154,6 +171,11 @@ Conversations::~Conversations()
   while (conversations.size())
     purple_conversation_destroy(conversations.front().purple_conv);
 
+  demote_timer.disconnect();
+  label_update.disconnect();
+  g_hash_table_destroy(conversation_indexes);
+  g_string_free(label_text, TRUE);
+
   purple_conversations_set_ui_ops(NULL);
   purple_prefs_disconnect_by_handle(this);
   purple_signals_disconnect_by_handle(this);
@@ -177,11 +199,8 @@ void Conversations::finalize()
 
 int Conversations::findConversation(PurpleConversation *conv)
 {
-  for (int i = 0; i < static_cast<int>(conversations.size()); i++)
-    if (conversations[i].purple_conv == conv)
-      return i;
-
-  return -1;
+  return GPOINTER_TO_INT(g_hash_table_lookup(conversation_indexes, conv))
+    - 1;
 }
 
 int Conversations::prevActiveConversation(int current)
@@ -224,8 +243,10 @@ void Conversations::activateConversation(int i)
   g_assert(i < static_cast<int>(conversations.size()));
 
   if (active == i) {
-    if (active != -1)
+    if (active != -1) {
+      conversations[active].conv->materialize();
       conversations[active].conv->show();
+    }
     return;
   }
 
@@ -233,6 +254,7 @@ void Conversations::activateConversation(int i)
     // show a new active conversation
     conversations[i].label->setVisibility(true);
     conversations[i].label->setColorScheme("conversation-active");
+    conversations[i].conv->materialize();
     conversations[i].conv->show();
   }
 
@@ -240,31 +262,76 @@ void Conversations::activateConversation(int i)
   if (active != -1) {
     conversations[active].label->setColorScheme(NULL);
     conversations[active].conv->hide();
+    conversations[active].last_active = time(NULL);
   }
 
   active = i;
 }
 
+bool Conversations::demoteIdleConversations()
+{
+  int timeout = purple_prefs_get_int(CONF_PREFIX "/chat/demote_timeout");
+  if (timeout <= 0)
+    return true;
+
+  time_t now = time(NULL);
+  for (int i = 0; i < static_cast<int>(conversations.size()); i++) {
+    ConvChild &c = conversations[i];
+    if (i == active || !c.conv->isMaterialized())
+      continue;
+
+    if (now - c.last_active >= timeout * 60)
+      c.conv->demote();
+  }
+
+  return true;
+}
+
 void Conversations::updateLabel(int i)
 {
   g_assert(i >= 0);
   g_assert(i < static_cast<int>(conversations.size()));
 
-  char *name = g_strdup_printf(" %d|%s%c", i + 1,
-      purple_conversation_get_title(conversations[i].purple_conv),
-      conversations[i].typing_status);
-  conversations[i].label->setText(name);
-  g_free(name);
+  ConvChild &c = conversations[i];
+  c.label_dirty = false;
+
+  g_string_printf(label_text, " %d|%s%c", i + 1,
+      purple_conversation_get_title(c.purple_conv), c.typing_status);
+
+  // setting the same text would only cause a needless redraw
+  const char *old_text = c.label->getText();
+  if (!old_text || strcmp(old_text, label_text->str))
+    c.label->setText(label_text->str);
 }
 
-void Conversations::updateLabels()
+void Conversations::updateLabels(int start)
 {
-  /* Note: This can be a little slow if there are too many opened
-   * conversations. */
-  for (int i = 0; i < static_cast<int>(conversations.size()); i++)
+  for (int i = start; i < static_cast<int>(conversations.size()); i++)
     updateLabel(i);
 }
 
+void Conversations::scheduleLabelUpdate(int i)
+{
+  g_assert(i >= 0);
+  g_assert(i < static_cast<int>(conversations.size()));
+
+  conversations[i].label_dirty = true;
+
+  /* Use a high priority so the labels are updated before the screen is
+   * redrawn. */
+  if (!label_update.connected())
+    label_update = COREMANAGER->timeoutOnceConnect(sigc::mem_fun(this,
+          &Conversations::updateDirtyLabels), 0, G_PRIORITY_HIGH,
+        "conversation-labels");
+}
+
+void Conversations::updateDirtyLabels()
+{
+  for (int i = 0; i < static_cast<int>(conversations.size()); i++)
+    if (conversations[i].label_dirty)
+      updateLabel(i);
+}
+
 void Conversations::create_conversation(PurpleConversation *conv)
 {
   g_return_if_fail(conv);
@@ -284,9 +351,13 @@ void Conversations::create_conversation(PurpleConversation *conv)
   c.conv = conversation;
   c.label = new CppConsUI::Label(AUTOSIZE, 1);
   c.typing_status = ' ';
+  c.last_active = time(NULL);
+  c.label_dirty = false;
   conv_list->appendWidget(*c.label);
   conversations.push_back(c);
-  updateLabels();
+  g_hash_table_insert(conversation_indexes, conv,
+      GINT_TO_POINTER(conversations.size()));
+  updateLabel(conversations.size() - 1);
 
   // show the first conversation if there isn't any already
   if (active == -1)
@@ -319,13 +390,18 @@ void Conversations::destroy_conversation(PurpleConversation *conv)
   delete conversations[i].conv;
   conv_list->removeWidget(*conversations[i].label);
   conversations.erase(conversations.begin() + i);
+  g_hash_table_remove(conversation_indexes, conv);
 
   if (active > i) {
     // fix up the number of the active conversation
     active--;
   }
 
-  updateLabels();
+  // renumber the following conversations
+  for (int j = i; j < static_cast<int>(conversations.size()); j++)
+    g_hash_table_insert(conversation_indexes, conversations[j].purple_conv,
+        GINT_TO_POINTER(j + 1));
+  updateLabels(i);
 }
 
 void Conversations::write_conv(PurpleConversation *conv, const char *name,
@@ -380,7 +456,7 @@ void Conversations::buddy_typing(PurpleAccount *account, const char *who)
   else
     conversations[i].typing_status = ' ';
 
-  updateLabel(i);
+  scheduleLabelUpdate(i);
 }
 
 void Conversations::send_typing_pref_change(const char *name,
@@ -390,4 +466,23 @@ void Conversations::send_typing_pref_change(const char *name,
   send_typing = purple_prefs_get_bool(name);
 }
 
+void Conversations::timestamp_format_pref_change(const char *name,
+    PurplePrefType /*type*/, gconstpointer /*val*/)
+{
+  g_assert(!strcmp(name, CONF_PREFIX "/chat/timestamp_format"));
+
+  const char *value = purple_prefs_get_string(name);
+  if (!strcmp(value, "time"))
+    timestamp_format = "%H:%M";
+  else if (!strcmp(value, "iso"))
+    timestamp_format = "%Y-%m-%d %H:%M";
+  else
+    timestamp_format = _("%d %b %Y %H:%M");
+
+  // reformat times in all opened conversations
+  for (ConversationsVector::iterator i = conversations.begin();
+      i != conversations.end(); i++)
+    i->conv->onTimestampFormatChange();
+}
+
 /* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -23,6 +23,8 @@
 #define __CONVERSATIONS_H__
 
 #include "Conversation.h"
+#include "Tracer.h"
+#include "Watchdog.h"
 
 #include <cppconsui/FreeWindow.h>
 #include <cppconsui/HorizontalListBox.h>
@@ -50,6 +52,10 @@ public:
   void setExpandedConversations(bool expanded);
 
   bool getSendTypingPref() const { return send_typing; }
+  /**
+   * Returns strftime() format used to show times of messages.
+   */
+  const char *getTimestampFormat() const { return timestamp_format; }
 
 protected:
 
@@ -60,11 +66,20 @@ private:
     Conversation *conv;
     CppConsUI::Label *label;
     char typing_status;
+    // time when the conversation stopped being active
+    time_t last_active;
+    // the label text has to be recomputed
+    bool label_dirty;
   };
 
   typedef std::vector<ConvChild> ConversationsVector;
 
   ConversationsVector conversations;
+  /**
+   * Maps PurpleConversation pointers to indexes into the conversations
+   * vector (incremented by one so a missing conversation can be detected).
+   */
+  GHashTable *conversation_indexes;
 
   // active conversation, -1 if none
   int active;
@@ -76,6 +91,15 @@ private:
 
   // cached value of the "/purple/conversations/im/send_typing" pref
   bool send_typing;
+  // strftime() format selected by the "/chat/timestamp_format" pref
+  const char *timestamp_format;
+
+  // periodically demotes conversations that weren't used for some time
+  sigc::connection demote_timer;
+  // pending update of dirty conversation labels
+  sigc::connection label_update;
+  // buffer reused for formatting of label texts
+  GString *label_text;
 
   PurpleConversationUiOps centerim_conv_ui_ops;
 
@@ -98,20 +122,42 @@ private:
 
   void activateConversation(int i);
 
+  /**
+   * Demotes inactive conversations that haven't been shown for the time set
+   * by the "/chat/demote_timeout" pref.
+   */
+  bool demoteIdleConversations();
+
   // update a single conversation label
   void updateLabel(int i);
-  // update all conversation labels
-  void updateLabels();
+  // update labels of all conversations starting at a given index
+  void updateLabels(int start = 0);
+  /**
+   * Marks a conversation label as dirty. All dirty labels are updated at
+   * once before the next redraw so several changes of the typing status
+   * cost only one label update.
+   */
+  void scheduleLabelUpdate(int i);
+  void updateDirtyLabels();
 
   static void create_conversation_(PurpleConversation *conv)
-    { CONVERSATIONS->create_conversation(conv); }
+  {
+    Watchdog::Scope scope(Watchdog::SOURCE_UI_OP, "create-conversation",
+        NULL, purple_conversation_get_account(conv));
+    CONVERSATIONS->create_conversation(conv);
+  }
   static void destroy_conversation_(PurpleConversation *conv)
     { CONVERSATIONS->destroy_conversation(conv); }
   static void write_conv_(PurpleConversation *conv, const char *name,
       const char *alias, const char *message, PurpleMessageFlags flags,
       time_t mtime)
-    { CONVERSATIONS->write_conv(conv, name, alias, message, flags,
-        mtime); }
+  {
+    if (TRACER)
+      TRACER->recordWriteConv(conv, name, flags, message);
+    Watchdog::Scope scope(Watchdog::SOURCE_UI_OP, "write-conv", NULL,
+        purple_conversation_get_account(conv));
+    CONVERSATIONS->write_conv(conv, name, alias, message, flags, mtime);
+  }
   static void present_(PurpleConversation *conv)
     { CONVERSATIONS->present(conv); }
 
@@ -124,7 +170,13 @@ private:
 
   static void buddy_typing_(PurpleAccount *account, const char *who,
       gpointer data)
-    { reinterpret_cast<Conversations*>(data)->buddy_typing(account, who); }
+  {
+    if (TRACER)
+      TRACER->recordBuddyTyping(account, who);
+    Watchdog::Scope scope(Watchdog::SOURCE_UI_OP, "buddy-typing", NULL,
+        account);
+    reinterpret_cast<Conversations*>(data)->buddy_typing(account, who);
+  }
   void buddy_typing(PurpleAccount *account, const char *who);
 
   // called when "/purple/conversations/im/send_typing" pref is changed
@@ -134,6 +186,14 @@ private:
         type, val); }
   void send_typing_pref_change(const char *name, PurplePrefType type,
       gconstpointer val);
+
+  // called when "/chat/timestamp_format" pref is changed
+  static void timestamp_format_pref_change_(const char *name,
+      PurplePrefType type, gconstpointer val, gpointer data)
+    { reinterpret_cast<Conversations*>(data)->timestamp_format_pref_change(
+        name, type, val); }
+  void timestamp_format_pref_change(const char *name, PurplePrefType type,
+      gconstpointer val);
 };
 
 #endif // __CONVERSATIONS_H__
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FlightRecorder.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "gettext.h"
+
+// names of levels, the order matches Log::Level
+static const char *level_names[] = {
+  "none",
+  "error",
+  "critical",
+  "warning",
+  "message",
+  "info",
+  "debug"
+};
+
+static gint64 get_monotonic_time()
+{
+#if GLIB_CHECK_VERSION(2, 28, 0)
+  return g_get_monotonic_time();
+#else
+  GTimeVal tv;
+  g_get_current_time(&tv);
+  return static_cast<gint64>(tv.tv_sec) * G_USEC_PER_SEC + tv.tv_usec;
+#endif
+}
+
+/* Appends a decimal number to buf, at least min_digits digits are written.
+ * Returns the number of written characters. */
+static size_t format_number(char *buf, guint64 num, int min_digits)
+{
+  char tmp[32];
+  size_t len = 0;
+  do {
+    tmp[len++] = '0' + num % 10;
+    num /= 10;
+  } while (num || static_cast<int>(len) < min_digits);
+
+  for (size_t i = 0; i < len; i++)
+    buf[i] = tmp[len - 1 - i];
+  return len;
+}
+
+FlightRecorder::FlightRecorder()
+: next(0)
+{
+  start_time = get_monotonic_time();
+}
+
+void FlightRecorder::record(int level, const char *source, const char *text)
+{
+  Slot &slot = slots[next % SLOTS_NUM];
+  next++;
+
+  slot.time = get_monotonic_time();
+  slot.level = level;
+  slot.source = source;
+
+  size_t len = text ? strlen(text) : 0;
+  // strip a trailing newline, every record is written on its own line
+  if (len && text[len - 1] == '\n')
+    len--;
+  if (len > TEXT_SIZE)
+    len = TEXT_SIZE;
+  memcpy(slot.text, text, len);
+  slot.length = len;
+}
+
+bool FlightRecorder::dump(const char *filename, GError **err) const
+{
+  int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd == -1) {
+    int saved_errno = errno;
+    g_set_error(err, G_FILE_ERROR, g_file_error_from_errno(saved_errno),
+        _("Error opening file '%s' (%s)."), filename,
+        g_strerror(saved_errno));
+    return false;
+  }
+
+  dumpToFd(fd);
+
+  if (close(fd) == -1) {
+    int saved_errno = errno;
+    g_set_error(err, G_FILE_ERROR, g_file_error_from_errno(saved_errno),
+        _("Error writing file '%s' (%s)."), filename,
+        g_strerror(saved_errno));
+    return false;
+  }
+
+  return true;
+}
+
+void FlightRecorder::dumpToFd(int fd) const
+{
+  /* Note: Only async-signal-safe functions can be used here, so all
+   * formatting is done manually. */
+  guint64 first = next > SLOTS_NUM ? next - SLOTS_NUM : 0;
+  for (guint64 i = first; i < next; i++) {
+    const Slot &slot = slots[i % SLOTS_NUM];
+
+    // "[seconds.microseconds] level source: text\n"
+    char line[TEXT_SIZE + 128];
+    size_t len = 0;
+    gint64 t = slot.time - start_time;
+    if (t < 0)
+      t = 0;
+    line[len++] = '[';
+    len += format_number(line + len, t / G_USEC_PER_SEC, 1);
+    line[len++] = '.';
+    len += format_number(line + len, t % G_USEC_PER_SEC, 6);
+    line[len++] = ']';
+    line[len++] = ' ';
+
+    const char *level = "unknown";
+    if (slot.level >= 0 && slot.level
+        < static_cast<int>(G_N_ELEMENTS(level_names)))
+      level = level_names[slot.level];
+    size_t l = strlen(level);
+    memcpy(line + len, level, l);
+    len += l;
+    line[len++] = ' ';
+
+    l = strlen(slot.source);
+    if (l > 64)
+      l = 64;
+    memcpy(line + len, slot.source, l);
+    len += l;
+    line[len++] = ':';
+    line[len++] = ' ';
+
+    memcpy(line + len, slot.text, slot.length);
+    len += slot.length;
+    line[len++] = '\n';
+
+    const char *p = line;
+    while (len) {
+      ssize_t res = write(fd, p, len);
+      if (res == -1) {
+        if (errno == EINTR)
+          continue;
+        return;
+      }
+      p += res;
+      len -= res;
+    }
+  }
+}
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
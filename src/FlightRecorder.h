@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __FLIGHTRECORDER_H__
+#define __FLIGHTRECORDER_H__
+
+#include <glib.h>
+
+/**
+ * Fixed-size in-memory ring of the most recent log records.
+ *
+ * Recording a message is just a copy into a preallocated slot, so all log
+ * records can be captured without any disk writes. The ring can be dumped
+ * into a file when something goes wrong, dumpToFd() can be safely used even
+ * from a signal handler.
+ */
+class FlightRecorder
+{
+public:
+  FlightRecorder();
+  virtual ~FlightRecorder() {}
+
+  /**
+   * Records a message. Texts longer than the slot size are truncated.
+   */
+  void record(int level, const char *source, const char *text);
+
+  /**
+   * Writes all records (oldest first) into a file. Returns false and sets
+   * err on failure.
+   */
+  bool dump(const char *filename, GError **err) const;
+  /**
+   * Writes all records into a file descriptor. This method uses only
+   * async-signal-safe functions.
+   */
+  void dumpToFd(int fd) const;
+
+protected:
+  enum {
+    SLOTS_NUM = 1024,
+    TEXT_SIZE = 232
+  };
+
+  struct Slot
+  {
+    // monotonic time in microseconds
+    gint64 time;
+    int level;
+    // static string describing the source of the message
+    const char *source;
+    unsigned short length;
+    char text[TEXT_SIZE];
+  };
+
+  Slot slots[SLOTS_NUM];
+  /**
+   * Total number of recorded messages, the next message goes into slot
+   * (next % SLOTS_NUM).
+   */
+  guint64 next;
+  gint64 start_time;
+
+private:
+  FlightRecorder(const FlightRecorder&);
+  FlightRecorder& operator=(const FlightRecorder&);
+};
+
+#endif // __FLIGHTRECORDER_H__
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -27,6 +27,7 @@
 #include "Log.h"
 #include "OptionWindow.h"
 #include "PluginWindow.h"
+#include "WatchdogWindow.h"
 
 #include "gettext.h"
 
@@ -51,6 +52,8 @@ GeneralMenu::GeneralMenu()
         &GeneralMenu::openOptionWindow));
   appendItem(_("Plugins..."), sigc::mem_fun(this,
         &GeneralMenu::openPluginWindow));
+  appendItem(_("Main loop latency..."), sigc::mem_fun(this,
+        &GeneralMenu::openWatchdogWindow));
   appendSeparator();
 #ifdef DEBUG
   MenuWindow *submenu = new MenuWindow(0, 0, AUTOSIZE, AUTOSIZE);
@@ -128,6 +131,13 @@ void GeneralMenu::openPluginWindow(CppConsUI::Button& /*activator*/)
   close();
 }
 
+void GeneralMenu::openWatchdogWindow(CppConsUI::Button& /*activator*/)
+{
+  WatchdogWindow *win = new WatchdogWindow;
+  win->show();
+  close();
+}
+
 #ifdef DEBUG
 void GeneralMenu::openRequestInputTest(CppConsUI::Button& /*activator*/)
 {
@@ -50,6 +50,7 @@ private:
   void openPendingRequests(CppConsUI::Button& activator);
   void openOptionWindow(CppConsUI::Button& activator);
   void openPluginWindow(CppConsUI::Button& activator);
+  void openWatchdogWindow(CppConsUI::Button& activator);
 
 #ifdef DEBUG
   void openRequestInputTest(CppConsUI::Button& activator);
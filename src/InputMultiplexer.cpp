@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "InputMultiplexer.h"
+
+#include "Watchdog.h"
+
+#include "config.h"
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+#define PURPLE_GLIB_READ_COND  (G_IO_IN | G_IO_HUP | G_IO_ERR)
+#define PURPLE_GLIB_WRITE_COND (G_IO_OUT | G_IO_HUP | G_IO_ERR | G_IO_NVAL)
+
+// maximum number of events read by one epoll_wait() call
+#define MAX_EVENTS 64
+
+GSourceFuncs InputMultiplexer::source_funcs = {
+  source_prepare,
+  source_check,
+  source_dispatch,
+  NULL,
+  NULL,
+  NULL
+};
+
+InputMultiplexer::InputMultiplexer()
+: next_handle(1), epoll_fd(-1), source(NULL), next_entry_id(1)
+{
+  watches = g_hash_table_new(g_direct_hash, g_direct_equal);
+  entries_by_fd = g_hash_table_new(g_direct_hash, g_direct_equal);
+  entries_by_id = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+#ifdef HAVE_SYS_EPOLL_H
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd == -1)
+    return;
+
+  source = g_source_new(&source_funcs, sizeof(MultiplexerSource));
+  reinterpret_cast<MultiplexerSource*>(source)->multiplexer = this;
+  poll_fd.fd = epoll_fd;
+  poll_fd.events = G_IO_IN;
+  poll_fd.revents = 0;
+  g_source_add_poll(source, &poll_fd);
+  g_source_attach(source, NULL);
+#endif
+}
+
+InputMultiplexer::~InputMultiplexer()
+{
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, watches);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    Watch *watch = static_cast<Watch*>(value);
+    if (watch->source_id)
+      g_source_remove(watch->source_id);
+    delete watch;
+  }
+  g_hash_table_destroy(watches);
+
+  g_hash_table_iter_init(&iter, entries_by_id);
+  while (g_hash_table_iter_next(&iter, NULL, &value))
+    delete static_cast<FdEntry*>(value);
+  g_hash_table_destroy(entries_by_id);
+  g_hash_table_destroy(entries_by_fd);
+
+  if (source) {
+    g_source_destroy(source);
+    g_source_unref(source);
+  }
+  if (epoll_fd != -1)
+    close(epoll_fd);
+}
+
+guint InputMultiplexer::add(int fd, PurpleInputCondition condition,
+    PurpleInputFunction function, gpointer data)
+{
+  g_return_val_if_fail(function, 0);
+
+  // find an unused handle
+  while (!next_handle
+      || g_hash_table_lookup(watches, GUINT_TO_POINTER(next_handle)))
+    next_handle++;
+
+  Watch *watch = new Watch;
+  watch->handle = next_handle++;
+  watch->fd = fd;
+  watch->condition = condition;
+  watch->function = function;
+  watch->data = data;
+  watch->source_id = 0;
+  watch->entry = NULL;
+  watch->next_in_entry = NULL;
+
+  if (!addToEpoll(watch)) {
+    /* Epoll is not available or it can't watch this descriptor (e.g. a
+     * regular file), fall back to a GIOChannel watch. */
+    int cond = 0;
+    if (condition & PURPLE_INPUT_READ)
+      cond |= PURPLE_GLIB_READ_COND;
+    if (condition & PURPLE_INPUT_WRITE)
+      cond |= PURPLE_GLIB_WRITE_COND;
+
+    GIOChannel *channel = g_io_channel_unix_new(fd);
+    watch->source_id = g_io_add_watch(channel,
+        static_cast<GIOCondition>(cond), io_watch_, watch);
+    g_io_channel_unref(channel);
+  }
+
+  g_hash_table_insert(watches, GUINT_TO_POINTER(watch->handle), watch);
+  return watch->handle;
+}
+
+bool InputMultiplexer::remove(guint handle)
+{
+  Watch *watch = static_cast<Watch*>(g_hash_table_lookup(watches,
+        GUINT_TO_POINTER(handle)));
+  if (!watch)
+    return false;
+
+  g_hash_table_remove(watches, GUINT_TO_POINTER(handle));
+
+  if (watch->source_id)
+    g_source_remove(watch->source_id);
+  else
+    removeFromEpoll(watch);
+
+  delete watch;
+  return true;
+}
+
+gboolean InputMultiplexer::source_prepare(GSource * /*source*/,
+    gint *timeout)
+{
+  // wait for the epoll descriptor
+  *timeout = -1;
+  return FALSE;
+}
+
+gboolean InputMultiplexer::source_check(GSource *source)
+{
+  InputMultiplexer *multiplexer
+    = reinterpret_cast<MultiplexerSource*>(source)->multiplexer;
+  return multiplexer->poll_fd.revents & G_IO_IN;
+}
+
+gboolean InputMultiplexer::source_dispatch(GSource *source,
+    GSourceFunc /*callback*/, gpointer /*user_data*/)
+{
+  reinterpret_cast<MultiplexerSource*>(source)->multiplexer->dispatch();
+  return TRUE;
+}
+
+gboolean InputMultiplexer::io_watch_(GIOChannel * /*source*/,
+    GIOCondition condition, gpointer data)
+{
+  Watch *watch = static_cast<Watch*>(data);
+  int purple_cond = 0;
+
+  if (condition & PURPLE_GLIB_READ_COND)
+    purple_cond |= PURPLE_INPUT_READ;
+  if (condition & PURPLE_GLIB_WRITE_COND)
+    purple_cond |= PURPLE_INPUT_WRITE;
+
+  // the watch can be removed by the callback, don't touch it afterwards
+  Watchdog::Scope scope(Watchdog::SOURCE_PURPLE_INPUT, NULL,
+      reinterpret_cast<const void*>(watch->function));
+  watch->function(watch->data, watch->fd,
+      static_cast<PurpleInputCondition>(purple_cond));
+
+  return TRUE;
+}
+
+bool InputMultiplexer::addToEpoll(Watch *watch)
+{
+  if (epoll_fd == -1)
+    return false;
+
+  FdEntry *entry = static_cast<FdEntry*>(g_hash_table_lookup(entries_by_fd,
+        GINT_TO_POINTER(watch->fd)));
+  bool new_entry = !entry;
+  if (new_entry) {
+    entry = new FdEntry;
+    entry->fd = watch->fd;
+    entry->id = next_entry_id++;
+    entry->events = 0;
+    entry->dev = 0;
+    entry->ino = 0;
+    entry->watches = NULL;
+  }
+
+  // append the watch so the watches are dispatched in the order of addition
+  Watch **tail = &entry->watches;
+  while (*tail)
+    tail = &(*tail)->next_in_entry;
+  *tail = watch;
+  watch->entry = entry;
+
+  if (!updateEntry(entry)) {
+    *tail = NULL;
+    watch->entry = NULL;
+    if (new_entry)
+      delete entry;
+    return false;
+  }
+
+  if (new_entry) {
+    g_hash_table_insert(entries_by_fd, GINT_TO_POINTER(entry->fd), entry);
+    g_hash_table_insert(entries_by_id, GUINT_TO_POINTER(entry->id), entry);
+  }
+  return true;
+}
+
+void InputMultiplexer::removeFromEpoll(Watch *watch)
+{
+  FdEntry *entry = watch->entry;
+  if (!entry)
+    return;
+
+  for (Watch **w = &entry->watches; *w; w = &(*w)->next_in_entry)
+    if (*w == watch) {
+      *w = watch->next_in_entry;
+      break;
+    }
+  watch->entry = NULL;
+  watch->next_in_entry = NULL;
+
+  if (entry->watches) {
+    updateEntry(entry);
+    return;
+  }
+
+  // this was the last watch of the descriptor
+#ifdef HAVE_SYS_EPOLL_H
+  /* The descriptor could be already closed (and so removed from the epoll
+   * set by the kernel), ignore errors. */
+  struct epoll_event event = {0, {0}};
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, entry->fd, &event);
+#endif
+  g_hash_table_remove(entries_by_fd, GINT_TO_POINTER(entry->fd));
+  g_hash_table_remove(entries_by_id, GUINT_TO_POINTER(entry->id));
+  delete entry;
+}
+
+bool InputMultiplexer::updateEntry(FdEntry *entry)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  guint32 events = 0;
+  for (Watch *w = entry->watches; w; w = w->next_in_entry) {
+    if (w->condition & PURPLE_INPUT_READ)
+      events |= EPOLLIN;
+    if (w->condition & PURPLE_INPUT_WRITE)
+      events |= EPOLLOUT;
+  }
+
+  /* The descriptor might have been closed and reused without removing its
+   * watches first. The kernel dropped the old file from the epoll set, so
+   * the new one has to be added even if the events didn't change. */
+  bool reused = false;
+  struct stat st;
+  if (!fstat(entry->fd, &st)) {
+    reused = entry->events
+      && (st.st_dev != entry->dev || st.st_ino != entry->ino);
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+  }
+
+  if (events == entry->events && !reused)
+    return true;
+
+  struct epoll_event event;
+  event.events = events;
+  event.data.u64 = entry->id;
+
+  int res;
+  if (entry->events && !reused)
+    res = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, entry->fd, &event);
+  else
+    res = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, entry->fd, &event);
+
+  // the kernel and the entry can still disagree if the file was reopened
+  if (res == -1 && errno == ENOENT)
+    res = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, entry->fd, &event);
+  else if (res == -1 && errno == EEXIST)
+    res = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, entry->fd, &event);
+
+  if (res == -1)
+    return false;
+
+  entry->events = events;
+  return true;
+#else
+  (void)entry;
+  return false;
+#endif
+}
+
+void InputMultiplexer::dispatch()
+{
+#ifdef HAVE_SYS_EPOLL_H
+  struct epoll_event events[MAX_EVENTS];
+  int num = epoll_wait(epoll_fd, events, MAX_EVENTS, 0);
+
+  for (int i = 0; i < num; i++) {
+    guint id = events[i].data.u64;
+    FdEntry *entry = static_cast<FdEntry*>(g_hash_table_lookup(entries_by_id,
+          GUINT_TO_POINTER(id)));
+    if (!entry)
+      continue; // removed by a previous callback
+
+    int cond = 0;
+    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+      cond |= PURPLE_INPUT_READ;
+    if (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+      cond |= PURPLE_INPUT_WRITE;
+
+    /* Callbacks can add and remove watches (including the ones of this
+     * descriptor) so remember the handles first and check that each watch
+     * still exists before calling it. */
+    dispatched_handles.clear();
+    for (Watch *w = entry->watches; w; w = w->next_in_entry)
+      if (w->condition & cond)
+        dispatched_handles.push_back(w->handle);
+
+    int fd = entry->fd;
+    for (std::vector<guint>::iterator j = dispatched_handles.begin();
+        j != dispatched_handles.end(); j++) {
+      Watch *watch = static_cast<Watch*>(g_hash_table_lookup(watches,
+            GUINT_TO_POINTER(*j)));
+      if (!watch || !watch->entry || watch->entry->id != id)
+        continue;
+
+      Watchdog::Scope scope(Watchdog::SOURCE_PURPLE_INPUT, NULL,
+          reinterpret_cast<const void*>(watch->function));
+      watch->function(watch->data, fd,
+          static_cast<PurpleInputCondition>(cond & watch->condition));
+    }
+  }
+#endif
+}
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
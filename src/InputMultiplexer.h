@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __INPUTMULTIPLEXER_H__
+#define __INPUTMULTIPLEXER_H__
+
+#include <glib.h>
+#include <libpurple/purple.h>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * Multiplexes all libpurple input watches through a single GSource.
+ *
+ * When epoll is available all watched descriptors are registered in one
+ * epoll descriptor and only this descriptor is polled by the GLib main loop,
+ * so the cost of a main loop iteration doesn't depend on the number of
+ * watched descriptors. The epoll descriptor is level-triggered, same as
+ * poll(2) used by GLib, which is what libpurple expects. Descriptors that
+ * can't be watched by epoll (or all of them when epoll is not available) are
+ * watched by a regular GIOChannel watch.
+ */
+class InputMultiplexer
+{
+public:
+  InputMultiplexer();
+  virtual ~InputMultiplexer();
+
+  /**
+   * Adds a watch that calls function when fd becomes ready for the given
+   * condition. Returns a non-zero handle of the watch.
+   */
+  guint add(int fd, PurpleInputCondition condition,
+      PurpleInputFunction function, gpointer data);
+  /**
+   * Removes a watch. Returns false if there is no watch with this handle.
+   */
+  bool remove(guint handle);
+
+protected:
+  struct FdEntry;
+
+  struct Watch
+  {
+    guint handle;
+    int fd;
+    PurpleInputCondition condition;
+    PurpleInputFunction function;
+    gpointer data;
+
+    // source ID of the GIOChannel watch if epoll is not used for this watch
+    guint source_id;
+    // descriptor entry in the epoll set, NULL for GIOChannel watches
+    FdEntry *entry;
+    Watch *next_in_entry;
+  };
+
+  /**
+   * A descriptor registered in the epoll set. Several watches can share one
+   * descriptor (e.g. separate read and write watches).
+   */
+  struct FdEntry
+  {
+    int fd;
+    // unique ID passed through epoll
+    guint id;
+    // currently registered epoll events
+    guint32 events;
+    /* Identity of the open file when it was registered, it tells apart
+     * a descriptor that was closed and reused for another file. */
+    dev_t dev;
+    ino_t ino;
+    Watch *watches;
+  };
+
+  struct MultiplexerSource
+  {
+    GSource source;
+    InputMultiplexer *multiplexer;
+  };
+
+  // all watches, indexed by the handle
+  GHashTable *watches;
+  guint next_handle;
+
+  int epoll_fd;
+  GSource *source;
+  GPollFD poll_fd;
+  // epoll entries indexed by the descriptor and by their unique ID
+  GHashTable *entries_by_fd;
+  GHashTable *entries_by_id;
+  guint next_entry_id;
+  // handles of watches that are being dispatched
+  std::vector<guint> dispatched_handles;
+
+  static GSourceFuncs source_funcs;
+
+  static gboolean source_prepare(GSource *source, gint *timeout);
+  static gboolean source_check(GSource *source);
+  static gboolean source_dispatch(GSource *source, GSourceFunc callback,
+      gpointer user_data);
+
+  static gboolean io_watch_(GIOChannel *source, GIOCondition condition,
+      gpointer data);
+
+  bool addToEpoll(Watch *watch);
+  void removeFromEpoll(Watch *watch);
+  // updates the epoll registration of the entry to match its watches
+  bool updateEntry(FdEntry *entry);
+  void dispatch();
+
+private:
+  InputMultiplexer(const InputMultiplexer&);
+  InputMultiplexer& operator=(const InputMultiplexer&);
+};
+
+#endif // __INPUTMULTIPLEXER_H__
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -23,10 +23,28 @@
 
 #include <cppconsui/HorizontalListBox.h>
 #include <cppconsui/Spacer.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
 #include "gettext.h"
 
 Log *Log::my_instance = NULL;
 
+// minimal number of seconds between two dumps caused by errors
+#define RECORDER_DUMP_INTERVAL 60
+
+// signals that cause the flight recorder to be dumped
+static const int fatal_signals[] = {
+  SIGSEGV,
+  SIGBUS,
+  SIGFPE,
+  SIGILL,
+  SIGABRT
+};
+static struct sigaction
+  fatal_signals_old_actions[G_N_ELEMENTS(fatal_signals)];
+
 Log *Log::instance()
 {
   return my_instance;
@@ -43,14 +61,14 @@ void Log::name(const char *fmt, ...)                    \
   va_list args;                                         \
   char *text;                                           \
                                                         \
-  if (getLogLevel("cim") < level)                       \
+  if (getGateLevel(TYPE_CIM) < level)                   \
     return; /* we don't want to see this log message */ \
                                                         \
   va_start(args, fmt);                                  \
   text = g_strdup_vprintf(fmt, args);                   \
   va_end(args);                                         \
                                                         \
-  write(text);                                          \
+  log(TYPE_CIM, level, text);                           \
   g_free(text);                                         \
 }
 
@@ -65,8 +83,20 @@ WRITE_METHOD(debug, LEVEL_DEBUG)
 
 Log::Log()
 : Window(0, 0, 80, 24, NULL, TYPE_NON_FOCUSABLE)
-, logfile(NULL)
+, recorder_level(LEVEL_NONE), debug_enabled(false)
+, purple_categories(NULL), logfile(NULL), last_error_dump(0)
 {
+  // nothing is logged until the prefs are read
+  for (int i = 0; i < TYPES_NUM; i++) {
+    g_atomic_int_set(&log_levels[i], LEVEL_NONE);
+    g_atomic_int_set(&gate_levels[i], LEVEL_NONE);
+  }
+
+  /* The filename is prepared in advance so it doesn't have to be built in
+   * the signal handler. */
+  recorder_filename = g_build_filename(purple_user_dir(),
+      "flight-recorder.log", NULL);
+
   setColorScheme("log");
 
   memset(&centerim_debug_ui_ops, 0, sizeof(centerim_debug_ui_ops));
@@ -101,20 +131,41 @@ Log::Log()
   purple_prefs_add_string(CONF_PREFIX "/log/log_level_cppconsui", "warning");
   purple_prefs_add_string(CONF_PREFIX "/log/log_level_purple", "critical");
   purple_prefs_add_string(CONF_PREFIX "/log/log_level_glib", "warning");
+  purple_prefs_add_string(CONF_PREFIX "/log/purple_categories", "");
+  purple_prefs_add_int(CONF_PREFIX "/log/rotate_size", 10240);
+  purple_prefs_add_int(CONF_PREFIX "/log/rotate_time", 0);
+  purple_prefs_add_int(CONF_PREFIX "/log/rotate_keep", 3);
+  purple_prefs_add_bool(CONF_PREFIX "/log/rotate_compress", false);
+  /* The recorder gets every logged message, its level additionally opens
+   * the gate of each source. Keep it low by default so libpurple's chatter
+   * is still discarded unformatted. */
+  purple_prefs_add_string(CONF_PREFIX "/log/recorder_level", "warning");
+
+  updateCachedPreference(CONF_PREFIX "/log/debug");
+  updateCachedPreference(CONF_PREFIX "/log/log_level_cim");
+  updateCachedPreference(CONF_PREFIX "/log/log_level_cppconsui");
+  updateCachedPreference(CONF_PREFIX "/log/log_level_purple");
+  updateCachedPreference(CONF_PREFIX "/log/log_level_glib");
+  updateCachedPreference(CONF_PREFIX "/log/purple_categories");
+  updateCachedPreference(CONF_PREFIX "/log/recorder_level");
 
   // connect callbacks
-  purple_prefs_connect_callback(this, CONF_PREFIX "/log/debug", debug_change_,
+  purple_prefs_connect_callback(this, CONF_PREFIX "/log", log_pref_change_,
       this);
 
   // set the purple debug callbacks
   centerim_debug_ui_ops.print = purple_print_;
   centerim_debug_ui_ops.is_enabled = is_enabled_;
   purple_debug_set_ui_ops(&centerim_debug_ui_ops);
+
+  installSignalHandlers();
 }
 
 Log::~Log()
 {
+  restoreSignalHandlers();
   purple_debug_set_ui_ops(NULL);
+  error_dump_conn.disconnect();
 
   g_log_remove_handler(NULL, default_handler);
   g_log_remove_handler("GLib", glib_handler);
@@ -125,8 +176,10 @@ Log::~Log()
 
   purple_prefs_disconnect_by_handle(this);
 
-  if (logfile)
-    g_io_channel_unref(logfile);
+  delete logfile;
+  if (purple_categories)
+    g_hash_table_destroy(purple_categories);
+  g_free(recorder_filename);
 }
 
 void Log::init()
@@ -145,10 +198,59 @@ void Log::finalize()
   my_instance = NULL;
 }
 
+void Log::dumpRecorder()
+{
+  if (recorder_level == LEVEL_NONE)
+    return; // the recorder is disabled
+
+  GError *err = NULL;
+  if (!recorder.dump(recorder_filename, &err)) {
+    writeErrorToWindow(_("centerim/log: Error dumping flight recorder "
+          "(%s)."), err->message);
+    g_clear_error(&err);
+    return;
+  }
+
+  writeErrorToWindow(_("centerim/log: Flight recorder dumped to '%s'."),
+      recorder_filename);
+}
+
+void Log::dumpRecorderOnError(bool fatal)
+{
+  // a fatal error terminates the program, dump everything right away
+  if (fatal) {
+    dumpRecorder();
+    return;
+  }
+
+  /* Errors tend to come in bursts. Writing the whole recorder for each of
+   * them would block the main loop, so after a dump the following errors
+   * are dumped together once RECORDER_DUMP_INTERVAL elapses. */
+  if (error_dump_conn.connected())
+    return;
+
+  time_t now = time(NULL);
+  time_t next = last_error_dump + RECORDER_DUMP_INTERVAL;
+  if (!last_error_dump || now >= next) {
+    onErrorDumpTimeout();
+    return;
+  }
+
+  error_dump_conn = COREMANAGER->timeoutOnceConnect(sigc::mem_fun(this,
+        &Log::onErrorDumpTimeout), (next - now) * 1000, G_PRIORITY_LOW,
+      "log-recorder-dump");
+}
+
+void Log::onErrorDumpTimeout()
+{
+  last_error_dump = time(NULL);
+  dumpRecorder();
+}
+
 void Log::purple_print(PurpleDebugLevel purplelevel, const char *category,
     const char *arg_s)
 {
-  if (getLogLevel("purple") < convertPurpleDebugLevel(purplelevel))
+  if (!is_enabled(purplelevel, category))
     return; // we don't want to see this log message
 
   if (!category) {
@@ -158,16 +260,25 @@ void Log::purple_print(PurpleDebugLevel purplelevel, const char *category,
   }
 
   char *text = g_strdup_printf("libpurple/%s: %s", category, arg_s);
-  write(text);
+  Level level = convertPurpleDebugLevel(purplelevel);
+  log(TYPE_PURPLE, level, text);
   g_free(text);
+
+  if (purplelevel == PURPLE_DEBUG_FATAL)
+    dumpRecorderOnError(true);
 }
 
 gboolean Log::is_enabled(PurpleDebugLevel purplelevel,
-    const char * /*category*/)
+    const char *category)
 {
   Level level = convertPurpleDebugLevel(purplelevel);
 
-  if (getLogLevel("purple") < level)
+  if (getGateLevel(TYPE_PURPLE) < level)
+    return FALSE;
+
+  // messages without a category are always let through
+  if (purple_categories && category
+      && !g_hash_table_lookup(purple_categories, category))
     return FALSE;
 
   return TRUE;
@@ -176,57 +287,178 @@ gboolean Log::is_enabled(PurpleDebugLevel purplelevel,
 void Log::default_log_handler(const char *domain, GLogLevelFlags flags,
   const char *msg)
 {
-  if (getLogLevel("glib") < convertGlibDebugLevel(flags))
+  Level level = convertGlibDebugLevel(flags);
+  if (getGateLevel(TYPE_GLIB) < level)
     return; // we don't want to see this log message
 
   if (!msg)
     return;
 
   char *text = g_strdup_printf("%s: %s", domain ? domain : "g_log", msg);
-  write(text);
+  log(TYPE_GLIB, level, text);
   g_free(text);
+
+  if (flags & (G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_ERROR | G_LOG_FLAG_FATAL))
+    dumpRecorderOnError(flags & (G_LOG_LEVEL_ERROR | G_LOG_FLAG_FATAL));
 }
 
 void Log::glib_log_handler(const char *domain, GLogLevelFlags flags,
   const char *msg)
 {
-  if (getLogLevel("glib") < convertGlibDebugLevel(flags))
+  Level level = convertGlibDebugLevel(flags);
+  if (getGateLevel(TYPE_GLIB) < level)
     return; // we don't want to see this log message
 
   if (!msg)
     return;
 
   char *text = g_strdup_printf("%s: %s", domain ? domain : "g_log", msg);
-  write(text);
+  log(TYPE_GLIB, level, text);
   g_free(text);
+
+  if (flags & (G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_ERROR | G_LOG_FLAG_FATAL))
+    dumpRecorderOnError(flags & (G_LOG_LEVEL_ERROR | G_LOG_FLAG_FATAL));
 }
 
 void Log::cppconsui_log_handler(const char *domain, GLogLevelFlags flags,
   const char *msg)
 {
-  if (getLogLevel("cppconsui") < convertGlibDebugLevel(flags))
+  Level level = convertGlibDebugLevel(flags);
+  if (getGateLevel(TYPE_CPPCONSUI) < level)
     return; // we don't want to see this log message
 
   if (!msg)
     return;
 
   char *text = g_strdup_printf("%s: %s", domain ? domain : "g_log", msg);
-  write(text);
+  log(TYPE_CPPCONSUI, level, text);
   g_free(text);
+
+  if (flags & (G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_ERROR | G_LOG_FLAG_FATAL))
+    dumpRecorderOnError(flags & (G_LOG_LEVEL_ERROR | G_LOG_FLAG_FATAL));
 }
 
-void Log::debug_change(const char * /*name*/, PurplePrefType type,
-    gconstpointer val)
+void Log::log_pref_change(const char *name, PurplePrefType /*type*/,
+    gconstpointer /*val*/)
 {
-  g_assert(type == PURPLE_PREF_BOOLEAN);
-
-  // debug was disabled so close logfile if it's opened
-  if (!*static_cast<const gboolean*>(val) && logfile) {
-    g_io_channel_unref(logfile);
+  // log/* preference changed
+  updateCachedPreference(name);
+
+  /* Close the logfile if debug was disabled or the file settings were
+   * changed, it is reopened with the new settings by the next write. */
+  if (logfile && ((!strcmp(name, CONF_PREFIX "/log/debug") && !debug_enabled)
+        || !strcmp(name, CONF_PREFIX "/log/filename")
+        || g_str_has_prefix(name, CONF_PREFIX "/log/rotate_"))) {
+    delete logfile;
     logfile = NULL;
   }
 }
 
+void Log::updateCachedPreference(const char *name)
+{
+  if (!strcmp(name, CONF_PREFIX "/log/debug"))
+    debug_enabled = purple_prefs_get_bool(name);
+  else if (!strcmp(name, CONF_PREFIX "/log/log_level_cim"))
+    g_atomic_int_set(&log_levels[TYPE_CIM],
+        stringToLevel(purple_prefs_get_string(name)));
+  else if (!strcmp(name, CONF_PREFIX "/log/log_level_cppconsui"))
+    g_atomic_int_set(&log_levels[TYPE_CPPCONSUI],
+        stringToLevel(purple_prefs_get_string(name)));
+  else if (!strcmp(name, CONF_PREFIX "/log/log_level_purple"))
+    g_atomic_int_set(&log_levels[TYPE_PURPLE],
+        stringToLevel(purple_prefs_get_string(name)));
+  else if (!strcmp(name, CONF_PREFIX "/log/log_level_glib"))
+    g_atomic_int_set(&log_levels[TYPE_GLIB],
+        stringToLevel(purple_prefs_get_string(name)));
+  else if (!strcmp(name, CONF_PREFIX "/log/recorder_level"))
+    recorder_level = stringToLevel(purple_prefs_get_string(name));
+  else if (!strcmp(name, CONF_PREFIX "/log/purple_categories")) {
+    if (purple_categories) {
+      g_hash_table_destroy(purple_categories);
+      purple_categories = NULL;
+    }
+
+    /* The pref contains a list of categories separated by commas or
+     * spaces, an empty list allows all categories. */
+    char **categories = g_strsplit_set(purple_prefs_get_string(name), ", ",
+        -1);
+    for (char **c = categories; *c; c++) {
+      if (!**c)
+        continue;
+      if (!purple_categories)
+        purple_categories = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+      g_hash_table_insert(purple_categories, g_strdup(*c),
+          GINT_TO_POINTER(1));
+    }
+    g_strfreev(categories);
+  }
+
+  updateGateLevels();
+}
+
+void Log::fatal_signal_handler(int signum)
+{
+  /* Note: Only async-signal-safe functions can be used here. The original
+   * action is restored by SA_RESETHAND so raising the signal again
+   * terminates the program as usual. */
+  if (my_instance) {
+    int fd = ::open(my_instance->recorder_filename,
+        O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd != -1) {
+      my_instance->recorder.dumpToFd(fd);
+      ::close(fd);
+    }
+  }
+
+  raise(signum);
+}
+
+void Log::installSignalHandlers()
+{
+  struct sigaction act;
+  memset(&act, 0, sizeof(act));
+  act.sa_handler = fatal_signal_handler;
+  sigemptyset(&act.sa_mask);
+  act.sa_flags = SA_RESETHAND;
+
+  for (size_t i = 0; i < G_N_ELEMENTS(fatal_signals); i++)
+    sigaction(fatal_signals[i], &act, &fatal_signals_old_actions[i]);
+}
+
+void Log::restoreSignalHandlers()
+{
+  for (size_t i = 0; i < G_N_ELEMENTS(fatal_signals); i++)
+    sigaction(fatal_signals[i], &fatal_signals_old_actions[i], NULL);
+}
+
+void Log::updateGateLevels()
+{
+  for (int i = 0; i < TYPES_NUM; i++) {
+    Level level = getLogLevel(static_cast<Type>(i));
+    g_atomic_int_set(&gate_levels[i], MAX(level, recorder_level));
+  }
+}
+
+void Log::log(Type type, Level level, const char *text)
+{
+  static const char *sources[TYPES_NUM] = {
+    "cim",
+    "cppconsui",
+    "glib",
+    "purple"
+  };
+
+  /* Every message passing the gate goes into the flight recorder, unless it
+   * is disabled. The recorder level only opens the gate for messages that
+   * would not be logged otherwise. */
+  if (recorder_level != LEVEL_NONE)
+    recorder.record(level, sources[type], text);
+
+  if (getLogLevel(type) >= level)
+    write(text);
+}
+
 void Log::shortenWindowText()
 {
   size_t lines_num = textview->getLinesNumber();
@@ -249,7 +481,7 @@ void Log::writeErrorToWindow(const char *fmt, ...)
   va_list args;
   char *text;
 
-  if (getLogLevel("cim") < LEVEL_ERROR)
+  if (getLogLevel(TYPE_CIM) < LEVEL_ERROR)
     return; // we don't want to see this log message
 
   va_start(args, fmt);
@@ -266,46 +498,31 @@ void Log::writeToFile(const char *text)
 {
   g_return_if_fail(text);
 
-  GError *err = NULL;
-
-  if (purple_prefs_get_bool(CONF_PREFIX "/log/debug")) {
-    // open logfile if it isn't already opened
-    if (!logfile) {
-      char *filename = g_build_filename(purple_user_dir(),
-          purple_prefs_get_string(CONF_PREFIX "/log/filename"), NULL);
-      if (!(logfile = g_io_channel_new_file(filename, "a", &err))) {
-        writeErrorToWindow(
-            _("centerim/log: Error opening logfile '%s' (%s)."), filename,
-            err->message);
-        g_clear_error(&err);
-      }
-      g_free(filename);
-    }
+  if (!debug_enabled)
+    return;
 
-    // write text into logfile
-    if (logfile) {
-      if (g_io_channel_write_chars(logfile, text, -1, NULL, &err)
-          != G_IO_STATUS_NORMAL) {
-        writeErrorToWindow(_("centerim/log: Error writing to logfile (%s)."),
-            err->message);
-        g_clear_error(&err);
-      }
-      else {
-        // if necessary write missing EOL character
-        size_t len = strlen(text);
-        if (len && text[len - 1] != '\n') {
-          // ignore all errors
-          g_io_channel_write_chars(logfile, "\n", -1, NULL, NULL);
-        }
-      }
-
-      if (g_io_channel_flush(logfile, &err) != G_IO_STATUS_NORMAL) {
-        writeErrorToWindow(_("centerim/log: Error flushing logfile (%s)."),
-            err->message);
-        g_clear_error(&err);
-      }
-    }
+  // create the logfile writer if it doesn't exist yet
+  if (!logfile) {
+    char *filename = g_build_filename(purple_user_dir(),
+        purple_prefs_get_string(CONF_PREFIX "/log/filename"), NULL);
+
+    LogWriter::Options options;
+    options.max_size = static_cast<goffset>(MAX(0,
+          purple_prefs_get_int(CONF_PREFIX "/log/rotate_size"))) * 1024;
+    options.max_age = MAX(0,
+        purple_prefs_get_int(CONF_PREFIX "/log/rotate_time")) * 60 * 60;
+    options.keep_files = purple_prefs_get_int(CONF_PREFIX "/log/rotate_keep");
+    options.compress = purple_prefs_get_bool(
+        CONF_PREFIX "/log/rotate_compress");
+
+    logfile = new LogWriter(filename, options, log_writer_error_);
+    g_free(filename);
   }
+
+  /* The text is written by a background thread, if it can't keep up then
+   * the message is dropped and the count of dropped messages is noted in
+   * the file later. */
+  logfile->write(text);
 }
 
 Log::Level Log::convertPurpleDebugLevel(PurpleDebugLevel purplelevel)
@@ -352,13 +569,10 @@ Log::Level Log::convertGlibDebugLevel(GLogLevelFlags gliblevel)
   return LEVEL_DEBUG;
 }
 
-Log::Level Log::getLogLevel(const char *type)
+Log::Level Log::stringToLevel(const char *slevel) const
 {
-  char *pref = g_strconcat(CONF_PREFIX "/log/log_level_", type, NULL);
-  const char *slevel = "none";
-  if (purple_prefs_exists(pref))
-    slevel = purple_prefs_get_string(pref);
-  g_free(pref);
+  if (!slevel)
+    return LEVEL_NONE;
 
   Level level;
   if (!g_ascii_strcasecmp(slevel, "none"))
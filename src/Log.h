@@ -23,6 +23,8 @@
 #define __LOG_H__
 
 #include "CenterIM.h"
+#include "FlightRecorder.h"
+#include "LogWriter.h"
 
 #include <cppconsui/TextView.h>
 #include <cppconsui/Window.h>
@@ -57,18 +59,59 @@ public:
   void info(const char *fmt, ...) _attribute((format(printf, 2, 3)));
   void debug(const char *fmt, ...) _attribute((format(printf, 2, 3)));
 
+  /**
+   * Writes the content of the flight recorder into a file in the user
+   * directory and reports the result in the log window.
+   */
+  void dumpRecorder();
+
 protected:
 
 private:
   enum Type {
     TYPE_CIM,
+    TYPE_CPPCONSUI,
     TYPE_GLIB,
-    TYPE_PURPLE
+    TYPE_PURPLE,
+    TYPES_NUM
   };
 
   PurpleDebugUiOps centerim_debug_ui_ops;
 
-  GIOChannel *logfile;
+  /**
+   * Cached values of the "/log/log_level_*" prefs, indexed by Type. They are
+   * accessed atomically so the levels can be checked from any thread.
+   */
+  volatile gint log_levels[TYPES_NUM];
+  /**
+   * Maximum of the log level and the recorder level for each Type, messages
+   * above this level are discarded without any formatting.
+   */
+  volatile gint gate_levels[TYPES_NUM];
+  // cached value of the "/log/recorder_level" pref
+  Level recorder_level;
+  // cached value of the "/log/debug" pref
+  bool debug_enabled;
+  /**
+   * Set of libpurple debug categories that should be logged, NULL if all
+   * categories are allowed. It is built from the "/log/purple_categories"
+   * pref.
+   */
+  GHashTable *purple_categories;
+
+  // writer of the debug log file, created when the first line is logged
+  LogWriter *logfile;
+
+  /**
+   * In-memory ring of recent log records, it is dumped into recorder_filename
+   * on demand or when something goes wrong.
+   */
+  FlightRecorder recorder;
+  char *recorder_filename;
+  // time of the last dump caused by an error
+  time_t last_error_dump;
+  // pending dump of errors that came too soon after the last one
+  sigc::connection error_dump_conn;
 
   CppConsUI::TextView *textview;
 
@@ -125,20 +168,43 @@ private:
   void cppconsui_log_handler(const char *domain, GLogLevelFlags flags,
       const char *msg);
 
-  // called when log/debug pref is changed
-  static void debug_change_(const char *name, PurplePrefType type,
+  // called when any of log/* prefs is changed
+  static void log_pref_change_(const char *name, PurplePrefType type,
       gconstpointer val, gpointer data)
-    { reinterpret_cast<Log*>(data)->debug_change(name, type, val); }
-  void debug_change(const char *name, PurplePrefType type,
+    { reinterpret_cast<Log*>(data)->log_pref_change(name, type, val); }
+  void log_pref_change(const char *name, PurplePrefType type,
       gconstpointer val);
 
+  void updateCachedPreference(const char *name);
+  /**
+   * Dumps the flight recorder after an error. Dumps are rate-limited unless
+   * the error is fatal.
+   */
+  void dumpRecorderOnError(bool fatal);
+  void onErrorDumpTimeout();
+
+  // called from the main loop when the log writer fails
+  static void log_writer_error_(const char *message)
+    { if (LOG) LOG->writeErrorToWindow("%s", message); }
+
+  // called when the program is killed by a fatal signal
+  static void fatal_signal_handler(int signum);
+  void installSignalHandlers();
+  void restoreSignalHandlers();
+
+  void updateGateLevels();
+  void log(Type type, Level level, const char *text);
   void shortenWindowText();
   void write(const char *text);
   void writeErrorToWindow(const char *fmt, ...);
   void writeToFile(const char *text);
   Level convertPurpleDebugLevel(PurpleDebugLevel purplelevel);
   Level convertGlibDebugLevel(GLogLevelFlags gliblevel);
-  Level getLogLevel(const char *type);
+  Level getLogLevel(Type type) const
+    { return static_cast<Level>(g_atomic_int_get(&log_levels[type])); }
+  Level getGateLevel(Type type) const
+    { return static_cast<Level>(g_atomic_int_get(&gate_levels[type])); }
+  Level stringToLevel(const char *slevel) const;
 };
 
 #endif // __LOG_H__
@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "LogWriter.h"
+
+#include "config.h"
+#include <errno.h>
+#include <string.h>
+#include <glib/gprintf.h>
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include "gettext.h"
+
+#ifdef HAVE_GIO
+#include <gio/gio.h>
+#endif
+
+// pushed into the queue to stop the writer thread
+static char stop_marker;
+
+// seconds to wait before a failed rotation is tried again
+#define ROTATE_RETRY_INTERVAL 60
+
+namespace {
+
+struct ErrorReport
+{
+  LogWriter::ErrorFunc func;
+  char *message;
+};
+
+} // anonymous namespace
+
+LogWriter::LogWriter(const char *filename_, const Options& options_,
+    ErrorFunc error_func_)
+: options(options_), error_func(error_func_), thread(NULL), queued(0)
+, dropped(0), file(NULL), open_failed(false), file_size(0), file_opened(0)
+, rotate_failed(0), dropped_reported(0)
+{
+  g_assert(filename_);
+
+  filename = g_strdup(filename_);
+
+#ifndef HAVE_GIO
+  // compression of rotated files requires GIO
+  options.compress = false;
+#endif
+
+  queue = g_async_queue_new();
+
+#if GLIB_CHECK_VERSION(2, 32, 0)
+  thread = g_thread_try_new("logwriter", writer_thread_, this, NULL);
+#else
+  thread = g_thread_create(writer_thread_, this, TRUE, NULL);
+#endif
+  /* If the thread can't be created then the messages are written
+   * synchronously by write(). */
+}
+
+LogWriter::~LogWriter()
+{
+  if (thread) {
+    // the thread writes all queued messages before it exits
+    g_async_queue_push(queue, &stop_marker);
+    g_thread_join(thread);
+  }
+
+  closeFile();
+  g_async_queue_unref(queue);
+  g_free(filename);
+}
+
+bool LogWriter::write(const char *text)
+{
+  g_return_val_if_fail(text, false);
+
+  if (!thread) {
+    writeText(text);
+    if (file)
+      fflush(file);
+    return true;
+  }
+
+  // never block the caller, drop the message if the writer is too slow
+  if (g_atomic_int_get(&queued) >= MAX_QUEUED) {
+    g_atomic_int_inc(&dropped);
+    return false;
+  }
+
+  g_atomic_int_inc(&queued);
+  g_async_queue_push(queue, g_strdup(text));
+  return true;
+}
+
+unsigned LogWriter::getDroppedCount() const
+{
+  return g_atomic_int_get(&dropped);
+}
+
+gpointer LogWriter::writer_thread()
+{
+  bool stop = false;
+  while (!stop) {
+    gpointer data = g_async_queue_pop(queue);
+
+    /* Write everything that is queued and flush the file only once for the
+     * whole batch. */
+    while (data) {
+      if (data == &stop_marker) {
+        stop = true;
+        break;
+      }
+
+      g_atomic_int_add(&queued, -1);
+      writeText(static_cast<char*>(data));
+      g_free(data);
+
+      data = g_async_queue_try_pop(queue);
+    }
+
+    if (file)
+      fflush(file);
+  }
+
+  return NULL;
+}
+
+void LogWriter::writeText(const char *text)
+{
+  if (!file && !openFile())
+    return;
+
+  // rotate the file if it is too big or too old
+  time_t now = time(NULL);
+  bool too_big = options.max_size && file_size >= options.max_size;
+  bool too_old = options.max_age && now - file_opened >= options.max_age;
+  bool can_retry = !rotate_failed
+    || now - rotate_failed >= ROTATE_RETRY_INTERVAL;
+  if (file_size > 0 && (too_big || too_old) && can_retry) {
+    rotate();
+    if (!file)
+      return;
+  }
+
+  // note the number of messages that were dropped since the last write
+  unsigned cur_dropped = g_atomic_int_get(&dropped);
+  if (cur_dropped != dropped_reported) {
+    int res = fprintf(file, "centerim/log: %u messages dropped\n",
+        cur_dropped - dropped_reported);
+    if (res > 0)
+      file_size += res;
+    dropped_reported = cur_dropped;
+  }
+
+  size_t len = strlen(text);
+  if (fwrite(text, 1, len, file) != len) {
+    reportError(_("centerim/log: Error writing to logfile (%s)."),
+        g_strerror(errno));
+    return;
+  }
+  file_size += len;
+
+  // if necessary write missing EOL character
+  if (len && text[len - 1] != '\n' && fputc('\n', file) != EOF)
+    file_size++;
+}
+
+bool LogWriter::openFile()
+{
+  if (open_failed)
+    return false;
+
+  if (!(file = g_fopen(filename, "a"))) {
+    open_failed = true;
+    reportError(_("centerim/log: Error opening logfile '%s' (%s)."),
+        filename, g_strerror(errno));
+    return false;
+  }
+
+  fseek(file, 0, SEEK_END);
+  file_size = ftell(file);
+  file_opened = file_size > 0 ? getFileStartTime() : time(NULL);
+  return true;
+}
+
+time_t LogWriter::getFileStartTime() const
+{
+  /* There is no portable way to get the creation time of a file. The
+   * current file was started when the previous segment was rotated, so the
+   * modification time of that segment is used if there is one. Otherwise
+   * the status change time of the file is the best estimate, both survive
+   * a restart of the program. */
+  struct stat st;
+  if (options.keep_files > 0) {
+    char *segment = g_strdup_printf("%s.1%s", filename,
+        options.compress ? ".gz" : "");
+    int res = g_stat(segment, &st);
+    g_free(segment);
+    if (!res)
+      return st.st_mtime;
+  }
+
+  if (!fstat(fileno(file), &st))
+    return st.st_ctime;
+  return time(NULL);
+}
+
+void LogWriter::closeFile()
+{
+  if (!file)
+    return;
+
+  fclose(file);
+  file = NULL;
+}
+
+void LogWriter::rotate()
+{
+  closeFile();
+
+  if (options.keep_files > 0 && !saveSegment()) {
+    /* Never throw away the content that couldn't be saved, keep appending
+     * to the current file and try the rotation again later. */
+    rotate_failed = time(NULL);
+    openFile();
+    return;
+  }
+
+  // start a new file
+  rotate_failed = 0;
+  g_unlink(filename);
+  openFile();
+}
+
+bool LogWriter::saveSegment()
+{
+  const char *suffix = options.compress ? ".gz" : "";
+  char *first = g_strdup_printf("%s.1%s", filename, suffix);
+  char *tmp = g_strdup_printf("%s.tmp", first);
+
+  /* Write the new segment under a temporary name first, the kept segments
+   * are touched only after it is complete so a failure (e.g. a full disk)
+   * doesn't lose any of them. */
+  bool saved;
+  if (options.compress)
+    saved = compressFile(filename, tmp);
+  else if (!(saved = !g_rename(filename, tmp)))
+    reportError(_("centerim/log: Error rotating logfile '%s' (%s)."),
+        filename, g_strerror(errno));
+
+  if (saved) {
+    // drop the oldest segment and shift the others
+    char *from;
+    char *to = g_strdup_printf("%s.%d%s", filename, options.keep_files,
+        suffix);
+    g_unlink(to);
+    for (int i = options.keep_files - 1; i >= 1; i--) {
+      from = g_strdup_printf("%s.%d%s", filename, i, suffix);
+      g_rename(from, to);
+      g_free(to);
+      to = from;
+    }
+    g_free(to);
+
+    // the content is kept in the temporary file if this fails
+    if (g_rename(tmp, first))
+      reportError(_("centerim/log: Error rotating logfile '%s' (%s)."), tmp,
+          g_strerror(errno));
+  }
+
+  g_free(tmp);
+  g_free(first);
+  return saved;
+}
+
+bool LogWriter::compressFile(const char *src, const char *dest)
+{
+#ifdef HAVE_GIO
+  FILE *in = g_fopen(src, "rb");
+  if (!in) {
+    reportError(_("centerim/log: Error rotating logfile '%s' (%s)."), src,
+        g_strerror(errno));
+    return false;
+  }
+
+  GError *err = NULL;
+  GFile *gfile = g_file_new_for_path(dest);
+  GFileOutputStream *fout = g_file_replace(gfile, NULL, FALSE,
+      G_FILE_CREATE_NONE, NULL, &err);
+  g_object_unref(gfile);
+  if (!fout) {
+    reportError(_("centerim/log: Error rotating logfile '%s' (%s)."), dest,
+        err->message);
+    g_clear_error(&err);
+    fclose(in);
+    return false;
+  }
+
+  GZlibCompressor *compressor = g_zlib_compressor_new(
+      G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+  GOutputStream *out = g_converter_output_stream_new(G_OUTPUT_STREAM(fout),
+      G_CONVERTER(compressor));
+  g_object_unref(compressor);
+  g_object_unref(fout);
+
+  char buf[8192];
+  size_t bytes;
+  while ((bytes = fread(buf, 1, sizeof(buf), in)) > 0)
+    if (!g_output_stream_write_all(out, buf, bytes, NULL, NULL, &err))
+      break;
+  if (!err && ferror(in))
+    g_set_error_literal(&err, G_FILE_ERROR, g_file_error_from_errno(errno),
+        g_strerror(errno));
+  if (!err)
+    g_output_stream_close(out, NULL, &err);
+
+  g_object_unref(out);
+  fclose(in);
+
+  if (err) {
+    reportError(_("centerim/log: Error rotating logfile '%s' (%s)."), dest,
+        err->message);
+    g_clear_error(&err);
+    // don't leave a truncated segment behind
+    g_unlink(dest);
+    return false;
+  }
+  return true;
+#else
+  (void)src;
+  (void)dest;
+  g_assert_not_reached();
+  return false;
+#endif
+}
+
+void LogWriter::reportError(const char *fmt, ...)
+{
+  if (!error_func)
+    return;
+
+  va_list args;
+  va_start(args, fmt);
+  ErrorReport *report = g_new(ErrorReport, 1);
+  report->func = error_func;
+  report->message = g_strdup_vprintf(fmt, args);
+  va_end(args);
+
+  // errors are reported from the main thread
+  g_idle_add(report_error_, report);
+}
+
+gboolean LogWriter::report_error_(gpointer data)
+{
+  ErrorReport *report = static_cast<ErrorReport*>(data);
+  report->func(report->message);
+  g_free(report->message);
+  g_free(report);
+  return FALSE;
+}
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
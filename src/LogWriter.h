@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __LOGWRITER_H__
+#define __LOGWRITER_H__
+
+#include <glib.h>
+#include <stdio.h>
+
+/**
+ * Writes the debug log file from a background thread.
+ *
+ * Messages are passed to the thread through a bounded queue. If the queue is
+ * full then new messages are dropped (and counted) instead of blocking the
+ * UI thread. The file can be rotated when it reaches a given size or age,
+ * rotated segments can be optionally compressed by gzip.
+ */
+class LogWriter
+{
+public:
+  struct Options
+  {
+    /**
+     * Maximum size of the log file in bytes before it is rotated, 0 disables
+     * size-based rotation.
+     */
+    goffset max_size;
+    /**
+     * Maximum age of the log file in seconds before it is rotated, 0
+     * disables time-based rotation.
+     */
+    int max_age;
+    /**
+     * Number of rotated segments that are kept.
+     */
+    int keep_files;
+    /**
+     * Compress rotated segments by gzip. This is available only when
+     * CenterIM is built with GIO support.
+     */
+    bool compress;
+  };
+
+  /**
+   * Callback that is called in the main thread when an error occurs in the
+   * writer thread.
+   */
+  typedef void (*ErrorFunc)(const char *message);
+
+  LogWriter(const char *filename_, const Options& options_,
+      ErrorFunc error_func_);
+  /**
+   * Writes all queued messages and stops the writer thread.
+   */
+  virtual ~LogWriter();
+
+  /**
+   * Queues text to be written into the log file, a missing EOL character is
+   * added automatically. Returns false if the message was dropped.
+   */
+  bool write(const char *text);
+
+  /**
+   * Returns the total number of dropped messages.
+   */
+  unsigned getDroppedCount() const;
+
+protected:
+  /**
+   * Maximum number of messages waiting in the queue.
+   */
+  enum { MAX_QUEUED = 4096 };
+
+  char *filename;
+  Options options;
+  ErrorFunc error_func;
+
+  GThread *thread;
+  GAsyncQueue *queue;
+  volatile gint queued;
+  volatile gint dropped;
+
+  // members below are accessed only by the writer thread
+  FILE *file;
+  // the file couldn't be opened, don't try it again
+  bool open_failed;
+  goffset file_size;
+  // time when the current file was started
+  time_t file_opened;
+  // time of the last failed rotation, 0 if the last one succeeded
+  time_t rotate_failed;
+  // value of dropped that was already reported in the file
+  unsigned dropped_reported;
+
+  static gpointer writer_thread_(gpointer data)
+    { return reinterpret_cast<LogWriter*>(data)->writer_thread(); }
+  gpointer writer_thread();
+
+  void writeText(const char *text);
+  bool openFile();
+  // estimates when the existing log file was started
+  time_t getFileStartTime() const;
+  void closeFile();
+  void rotate();
+  /**
+   * Saves the current file as the first rotated segment and shifts the older
+   * ones. Returns false if the file couldn't be saved, the kept segments are
+   * untouched then.
+   */
+  bool saveSegment();
+  // returns true if the compressed file was written completely
+  bool compressFile(const char *src, const char *dest);
+  void reportError(const char *fmt, ...) G_GNUC_PRINTF(2, 3);
+
+  static gboolean report_error_(gpointer data);
+
+private:
+  LogWriter(const LogWriter&);
+  LogWriter& operator=(const LogWriter&);
+};
+
+#endif // __LOGWRITER_H__
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
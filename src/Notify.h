@@ -21,6 +21,9 @@
 #ifndef __NOTIFY_H__
 #define __NOTIFY_H__
 
+#include "Tracer.h"
+#include "Watchdog.h"
+
 #include <cppconsui/MessageDialog.h>
 #include <cppconsui/SplitDialog.h>
 #include <cppconsui/TreeView.h>
@@ -87,10 +90,21 @@ private:
 
   static void *notify_message_(PurpleNotifyMsgType type, const char *title,
       const char *primary, const char *secondary)
-    { return NOTIFY->notify_message(type, title, primary, secondary); }
+  {
+    if (TRACER)
+      TRACER->recordNotifyMessage(type, title, primary, secondary);
+    Watchdog::Scope scope(Watchdog::SOURCE_UI_OP, "notify-message");
+    return NOTIFY->notify_message(type, title, primary, secondary);
+  }
   static void *notify_userinfo_(PurpleConnection *gc, const char *who,
       PurpleNotifyUserInfo *user_info)
-    { return NOTIFY->notify_userinfo(gc, who, user_info); }
+  {
+    if (TRACER)
+      TRACER->recordNotifyUserInfo(gc, who);
+    Watchdog::Scope scope(Watchdog::SOURCE_UI_OP, "notify-userinfo", NULL,
+        purple_connection_get_account(gc));
+    return NOTIFY->notify_userinfo(gc, who, user_info);
+  }
   static void close_notify_(PurpleNotifyType type, void *ui_handle)
     { NOTIFY->close_notify(type, ui_handle); }
 
@@ -103,6 +103,16 @@ OptionWindow::OptionWindow()
   treeview->setCollapsed(parent, true);
   treeview->appendNode(parent, *(new BooleanOption(_("Beep on new message"),
           CONF_PREFIX "/chat/beep_on_msg")));
+  c = new ChoiceOption(_("Timestamp format"),
+      CONF_PREFIX "/chat/timestamp_format");
+  c->addOption(_("Date and time"), "date_time");
+  c->addOption(_("Time only"), "time");
+  c->addOption(_("ISO 8601"), "iso");
+  treeview->appendNode(parent, *c);
+  treeview->appendNode(parent, *(new IntegerOption(
+          _("Unload hidden conversations after"),
+          CONF_PREFIX "/chat/demote_timeout",
+          sigc::mem_fun(this, &OptionWindow::getMinUnit))));
   treeview->appendNode(parent, *(new BooleanOption(
           _("Send typing notification"),
           "/purple/conversations/im/send_typing")));
@@ -134,13 +144,25 @@ do {                                       \
       CONF_PREFIX "/log/log_level_purple");
   ADD_DEBUG_OPTIONS();
   treeview->appendNode(parent, *c);
+  treeview->appendNode(parent, *(new StringOption(
+          _("Purple log categories"),
+          CONF_PREFIX "/log/purple_categories")));
 
   c = new ChoiceOption(_("GLib log level"),
       CONF_PREFIX "/log/log_level_glib");
   ADD_DEBUG_OPTIONS();
   treeview->appendNode(parent, *c);
+
+  c = new ChoiceOption(_("Flight recorder level"),
+      CONF_PREFIX "/log/recorder_level");
+  ADD_DEBUG_OPTIONS();
+  treeview->appendNode(parent, *c);
 #undef ADD_DEBUG_OPTIONS
 
+  treeview->appendNode(parent, *(new IntegerOption(
+          _("Slow callback threshold (ms, 0 disables)"),
+          CONF_PREFIX "/watchdog/threshold")));
+
   parent = treeview->appendNode(treeview->getRootNode(),
       *(new CppConsUI::TreeView::ToggleCollapseButton(
           _("Libpurple logging"))));
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StartupLoader.h"
+
+#include <cppconsui/CoreManager.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+StartupLoader::File StartupLoader::files_template[] = {
+  // the biggest file first, libpurple reads it after probing plugins
+  {"blist.xml", false, NULL, 0},
+  {"prefs.xml", false, NULL, 0},
+  {"accounts.xml", false, NULL, 0},
+  {"status.xml", false, NULL, 0},
+  {"pounces.xml", false, NULL, 0},
+  {"colorschemes.xml", true, NULL, 0},
+  {"binds.xml", true, NULL, 0},
+};
+
+StartupLoader::StartupLoader(const char *user_dir_)
+: thread(NULL), time(0)
+{
+  g_assert(user_dir_);
+
+  user_dir = g_strdup(user_dir_);
+  files_num = G_N_ELEMENTS(files_template);
+  files = new File[files_num];
+  memcpy(files, files_template, sizeof(files_template));
+
+#if GLIB_CHECK_VERSION(2, 32, 0)
+  thread = g_thread_try_new("startuploader", loader_thread_, this, NULL);
+#else
+  thread = g_thread_create(loader_thread_, this, TRUE, NULL);
+#endif
+  /* If the thread can't be created then nothing is read ahead and the files
+   * are read by their users as usual. */
+}
+
+StartupLoader::~StartupLoader()
+{
+  join();
+
+  for (int i = 0; i < files_num; i++)
+    g_free(files[i].contents);
+  delete [] files;
+  g_free(user_dir);
+}
+
+void StartupLoader::join()
+{
+  if (!thread)
+    return;
+
+  g_thread_join(thread);
+  thread = NULL;
+}
+
+char *StartupLoader::takeContents(const char *basename, gsize *length)
+{
+  g_assert(basename);
+  g_assert(length);
+
+  // the contents are safe to access only after the thread finished
+  join();
+
+  for (int i = 0; i < files_num; i++)
+    if (!strcmp(files[i].basename, basename)) {
+      char *contents = files[i].contents;
+      *length = files[i].length;
+      files[i].contents = NULL;
+      return contents;
+    }
+
+  return NULL;
+}
+
+gpointer StartupLoader::loader_thread()
+{
+  gint64 start = CppConsUI::CoreManager::getMonotonicTime();
+  readFiles();
+  time = CppConsUI::CoreManager::getMonotonicTime() - start;
+  return NULL;
+}
+
+void StartupLoader::readFiles()
+{
+  for (int i = 0; i < files_num; i++) {
+    char *filename = g_build_filename(user_dir, files[i].basename, NULL);
+    if (files[i].keep) {
+      if (!g_file_get_contents(filename, &files[i].contents, &files[i].length,
+            NULL))
+        files[i].contents = NULL;
+    }
+    else
+      prefetchFile(filename);
+    g_free(filename);
+  }
+}
+
+void StartupLoader::prefetchFile(const char *filename)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1)
+    return;
+
+  // read the file to get it into the page cache, the data are not needed
+  char buf[65536];
+  while (read(fd, buf, sizeof(buf)) > 0)
+    ;
+  close(fd);
+}
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __STARTUPLOADER_H__
+#define __STARTUPLOADER_H__
+
+#include <glib.h>
+
+/**
+ * Reads configuration files in a worker thread during the startup.
+ *
+ * Libpurple isn't thread-safe so its initialization has to stay in the main
+ * thread. The loader reads CenterIM's own XML configs so they are ready when
+ * they are needed, and reads the libpurple files (the buddy list and others)
+ * ahead so they are already in the page cache when libpurple parses them
+ * while the main thread is probing plugins.
+ */
+class StartupLoader
+{
+public:
+  /**
+   * Starts the worker thread. Files are read from a given directory.
+   */
+  StartupLoader(const char *user_dir_);
+  /**
+   * Waits for the worker thread.
+   */
+  virtual ~StartupLoader();
+
+  /**
+   * Waits until all files are read.
+   */
+  void join();
+
+  /**
+   * Returns newly allocated contents of a file that is kept by the loader,
+   * or NULL if the file couldn't be read. The contents can be taken only
+   * once, the caller should read the file itself if NULL is returned.
+   */
+  char *takeContents(const char *basename, gsize *length);
+
+  /**
+   * Returns the time that the worker thread spent reading in microseconds.
+   */
+  gint64 getTime() const { return time; }
+
+protected:
+  struct File
+  {
+    const char *basename;
+    // keep the contents, otherwise the file is only read into the page cache
+    bool keep;
+    char *contents;
+    gsize length;
+  };
+
+  static File files_template[];
+
+  char *user_dir;
+  File *files;
+  int files_num;
+  GThread *thread;
+  gint64 time;
+
+  static gpointer loader_thread_(gpointer data)
+    { return reinterpret_cast<StartupLoader*>(data)->loader_thread(); }
+  gpointer loader_thread();
+
+  void readFiles();
+  void prefetchFile(const char *filename);
+
+private:
+  StartupLoader(const StartupLoader&);
+  StartupLoader& operator=(const StartupLoader&);
+};
+
+#endif // __STARTUPLOADER_H__
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StartupProfiler.h"
+
+#include <cppconsui/CoreManager.h>
+
+#include <sys/resource.h>
+#include "gettext.h"
+
+StartupProfiler::StartupProfiler()
+: current(NULL), wall_start(0), cpu_start(0)
+{
+}
+
+void StartupProfiler::beginPhase(const char *name)
+{
+  g_assert(name);
+
+  endPhase();
+
+  current = name;
+  wall_start = CppConsUI::CoreManager::getMonotonicTime();
+  cpu_start = getCPUTime();
+}
+
+void StartupProfiler::endPhase()
+{
+  if (!current)
+    return;
+
+  Phase phase;
+  phase.name = current;
+  phase.wall = CppConsUI::CoreManager::getMonotonicTime() - wall_start;
+  phase.cpu = getCPUTime() - cpu_start;
+  phase.parallel = false;
+  phases.push_back(phase);
+
+  current = NULL;
+}
+
+void StartupProfiler::addParallelPhase(const char *name, gint64 usecs)
+{
+  g_assert(name);
+
+  Phase phase;
+  phase.name = name;
+  phase.wall = usecs;
+  phase.cpu = -1;
+  phase.parallel = true;
+  phases.push_back(phase);
+}
+
+char *StartupProfiler::getReport() const
+{
+  GString *report = g_string_new(NULL);
+  g_string_append_printf(report, "%-24s %10s %10s\n", _("Startup phase"),
+      _("wall ms"), _("cpu ms"));
+
+  gint64 wall_total = 0;
+  gint64 cpu_total = 0;
+  for (Phases::const_iterator i = phases.begin(); i != phases.end(); i++) {
+    if (i->parallel) {
+      // parallel phases don't add to the total time
+      g_string_append_printf(report, "%-24s %10.1f %10s\n", i->name,
+          i->wall / 1000.0, _("(thread)"));
+      continue;
+    }
+
+    g_string_append_printf(report, "%-24s %10.1f %10.1f\n", i->name,
+        i->wall / 1000.0, i->cpu / 1000.0);
+    wall_total += i->wall;
+    cpu_total += i->cpu;
+  }
+  g_string_append_printf(report, "%-24s %10.1f %10.1f\n", _("total"),
+      wall_total / 1000.0, cpu_total / 1000.0);
+
+  return g_string_free(report, FALSE);
+}
+
+gint64 StartupProfiler::getCPUTime()
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage))
+    return 0;
+
+  return (static_cast<gint64>(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec)
+    * G_USEC_PER_SEC + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
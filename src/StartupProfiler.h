@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __STARTUPPROFILER_H__
+#define __STARTUPPROFILER_H__
+
+#include <glib.h>
+#include <vector>
+
+/**
+ * Measures wall and CPU time of the startup phases.
+ *
+ * Phases follow each other, starting a phase ends the previous one. Work
+ * done in worker threads is added separately as parallel phases. The CPU
+ * time is measured for the whole process so it includes the CPU time of
+ * the worker threads.
+ */
+class StartupProfiler
+{
+public:
+  StartupProfiler();
+  virtual ~StartupProfiler() {}
+
+  /**
+   * Ends the current phase and starts a new one. The name has to be a static
+   * string.
+   */
+  void beginPhase(const char *name);
+  void endPhase();
+  /**
+   * Adds a phase that ran in a worker thread for a given wall time.
+   */
+  void addParallelPhase(const char *name, gint64 usecs);
+
+  /**
+   * Returns a newly allocated report with one line per phase.
+   */
+  char *getReport() const;
+
+protected:
+  struct Phase
+  {
+    const char *name;
+    // times in microseconds
+    gint64 wall;
+    gint64 cpu;
+    bool parallel;
+  };
+
+  typedef std::vector<Phase> Phases;
+
+  Phases phases;
+
+  // currently running phase or NULL
+  const char *current;
+  gint64 wall_start;
+  gint64 cpu_start;
+
+  // returns the CPU time used by the process in microseconds
+  static gint64 getCPUTime();
+
+private:
+  StartupProfiler(const StartupProfiler&);
+  StartupProfiler& operator=(const StartupProfiler&);
+};
+
+#endif // __STARTUPPROFILER_H__
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -0,0 +1,419 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "TimerWheel.h"
+
+#include "Watchdog.h"
+
+#include <string.h>
+
+#define SLOT_MASK (static_cast<guint64>(SLOTS_NUM - 1))
+
+// returns the index of the lowest set bit, mask must not be zero
+static int lowest_bit(guint64 mask)
+{
+  int low = g_bit_nth_lsf(static_cast<guint32>(mask), -1);
+  if (low != -1)
+    return low;
+  return 32 + g_bit_nth_lsf(static_cast<guint32>(mask >> 32), -1);
+}
+
+GSourceFuncs TimerWheel::source_funcs = {
+  source_prepare,
+  source_check,
+  source_dispatch,
+  NULL,
+  NULL,
+  NULL
+};
+
+TimerWheel::TimerWheel()
+: next_handle(1), overflow(NULL), expired(NULL), expired_tail(NULL)
+, pending(NULL)
+{
+  memset(slots, 0, sizeof(slots));
+  memset(occupied, 0, sizeof(occupied));
+  memset(&stats, 0, sizeof(stats));
+
+  timers = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  current = getTime();
+  /* Don't align the seconds timers exactly to the second boundaries to
+   * avoid waking up at the same time as other processes. */
+  perturbation = g_random_int_range(0, 1000);
+
+  source = g_source_new(&source_funcs, sizeof(WheelSource));
+  reinterpret_cast<WheelSource*>(source)->wheel = this;
+  g_source_attach(source, NULL);
+}
+
+TimerWheel::~TimerWheel()
+{
+  g_source_destroy(source);
+  g_source_unref(source);
+
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, timers);
+  while (g_hash_table_iter_next(&iter, NULL, &value))
+    delete static_cast<Timer*>(value);
+  g_hash_table_destroy(timers);
+}
+
+guint TimerWheel::add(guint interval, GSourceFunc function, gpointer data)
+{
+  return addTimer(interval, false, function, data);
+}
+
+guint TimerWheel::addSeconds(guint interval, GSourceFunc function,
+    gpointer data)
+{
+  return addTimer(interval, true, function, data);
+}
+
+bool TimerWheel::remove(guint handle)
+{
+  Timer *timer = static_cast<Timer*>(g_hash_table_lookup(timers,
+        GUINT_TO_POINTER(handle)));
+  if (!timer)
+    return false;
+
+  g_hash_table_remove(timers, GUINT_TO_POINTER(handle));
+  stats.timers--;
+
+  if (timer->level == LEVEL_NONE) {
+    // the timer is being dispatched, dispatch() deletes it
+    timer->removed = true;
+    return true;
+  }
+
+  unlink(timer);
+  delete timer;
+  return true;
+}
+
+gboolean TimerWheel::source_prepare(GSource *source, gint *timeout)
+{
+  TimerWheel *wheel = reinterpret_cast<WheelSource*>(source)->wheel;
+
+  guint64 now = getTime();
+  wheel->advance(now);
+  if (wheel->expired) {
+    *timeout = 0;
+    return TRUE;
+  }
+
+  gint64 next = wheel->getNextExpiration();
+  if (next == -1)
+    *timeout = -1;
+  else
+    *timeout = MIN(static_cast<guint64>(next) - now, G_MAXINT);
+  return FALSE;
+}
+
+gboolean TimerWheel::source_check(GSource *source)
+{
+  TimerWheel *wheel = reinterpret_cast<WheelSource*>(source)->wheel;
+
+  wheel->advance(getTime());
+  return wheel->expired != NULL;
+}
+
+gboolean TimerWheel::source_dispatch(GSource *source,
+    GSourceFunc /*callback*/, gpointer /*user_data*/)
+{
+  reinterpret_cast<WheelSource*>(source)->wheel->dispatch();
+  return TRUE;
+}
+
+guint64 TimerWheel::getTime()
+{
+#if GLIB_CHECK_VERSION(2, 28, 0)
+  return g_get_monotonic_time() / 1000;
+#else
+  GTimeVal tv;
+  g_get_current_time(&tv);
+  return static_cast<guint64>(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+#endif
+}
+
+guint TimerWheel::addTimer(guint interval, bool seconds,
+    GSourceFunc function, gpointer data)
+{
+  g_return_val_if_fail(function, 0);
+
+  // find an unused handle
+  while (!next_handle
+      || g_hash_table_lookup(timers, GUINT_TO_POINTER(next_handle)))
+    next_handle++;
+
+  Timer *timer = new Timer;
+  timer->handle = next_handle++;
+  timer->interval = interval;
+  timer->seconds = seconds;
+  timer->removed = false;
+  timer->function = function;
+  timer->data = data;
+  timer->level = LEVEL_NONE;
+  timer->prev = timer->next = NULL;
+
+  g_hash_table_insert(timers, GUINT_TO_POINTER(timer->handle), timer);
+  stats.timers++;
+
+  schedule(timer, getTime());
+  return timer->handle;
+}
+
+void TimerWheel::schedule(Timer *timer, guint64 now)
+{
+  if (timer->seconds) {
+    // round up to the next (perturbed) second boundary
+    guint64 t = now + static_cast<guint64>(timer->interval) * 1000
+      + 1000 - perturbation;
+    timer->expires = (t + 999) / 1000 * 1000 - 1000 + perturbation;
+  }
+  else
+    timer->expires = now + timer->interval;
+
+  insert(timer);
+}
+
+void TimerWheel::insert(Timer *timer)
+{
+  if (timer->expires <= current) {
+    appendExpired(timer);
+    return;
+  }
+
+  /* Find the lowest level where the timer expires in the same block as the
+   * current time. */
+  Timer **head = &overflow;
+  timer->level = LEVEL_OVERFLOW;
+  for (int level = 0; level < LEVELS_NUM; level++) {
+    int shift = (level + 1) * SLOT_BITS;
+    if (timer->expires >> shift == current >> shift) {
+      int slot = (timer->expires >> (level * SLOT_BITS)) & SLOT_MASK;
+      head = &slots[level][slot];
+      occupied[level] |= G_GUINT64_CONSTANT(1) << slot;
+      timer->level = level;
+      timer->slot = slot;
+      break;
+    }
+  }
+
+  timer->prev = NULL;
+  timer->next = *head;
+  if (*head)
+    (*head)->prev = timer;
+  *head = timer;
+}
+
+TimerWheel::Timer **TimerWheel::getListHead(Timer *timer)
+{
+  switch (timer->level) {
+    case LEVEL_OVERFLOW:
+      return &overflow;
+    case LEVEL_EXPIRED:
+      return &expired;
+    case LEVEL_PENDING:
+      return &pending;
+    case LEVEL_NONE:
+      return NULL;
+  }
+  return &slots[timer->level][timer->slot];
+}
+
+void TimerWheel::unlink(Timer *timer)
+{
+  Timer **head = getListHead(timer);
+  if (!head)
+    return;
+
+  if (timer->level == LEVEL_EXPIRED && expired_tail == timer)
+    expired_tail = timer->prev;
+
+  if (timer->prev)
+    timer->prev->next = timer->next;
+  else
+    *head = timer->next;
+  if (timer->next)
+    timer->next->prev = timer->prev;
+
+  if (timer->level < LEVELS_NUM && !*head)
+    occupied[timer->level] &= ~(G_GUINT64_CONSTANT(1) << timer->slot);
+
+  timer->level = LEVEL_NONE;
+  timer->prev = timer->next = NULL;
+}
+
+void TimerWheel::appendExpired(Timer *timer)
+{
+  timer->level = LEVEL_EXPIRED;
+  timer->prev = expired_tail;
+  timer->next = NULL;
+  if (expired_tail)
+    expired_tail->next = timer;
+  else
+    expired = timer;
+  expired_tail = timer;
+}
+
+void TimerWheel::cascade(int level)
+{
+  Timer *list;
+  if (level == LEVELS_NUM) {
+    list = overflow;
+    overflow = NULL;
+  }
+  else {
+    int slot = (current >> (level * SLOT_BITS)) & SLOT_MASK;
+    list = slots[level][slot];
+    slots[level][slot] = NULL;
+    occupied[level] &= ~(G_GUINT64_CONSTANT(1) << slot);
+  }
+
+  // redistribute the timers into the lower levels
+  while (list) {
+    Timer *next = list->next;
+    insert(list);
+    list = next;
+  }
+}
+
+void TimerWheel::advance(guint64 now)
+{
+  while (current < now) {
+    if (occupied[0]) {
+      // expire the nearest slot of the first level
+      int slot = lowest_bit(occupied[0]);
+      guint64 t = (current & ~SLOT_MASK) | slot;
+      if (t > now)
+        break;
+
+      current = t;
+      Timer *list = slots[0][slot];
+      slots[0][slot] = NULL;
+      occupied[0] &= ~(G_GUINT64_CONSTANT(1) << slot);
+      while (list) {
+        Timer *next = list->next;
+        appendExpired(list);
+        list = next;
+      }
+      continue;
+    }
+
+    /* The first level is empty so nothing expires before the nearest slot of
+     * the lowest non-empty level is cascaded. Jump right to that point. */
+    guint64 boundary;
+    int level;
+    for (level = 1; level < LEVELS_NUM; level++)
+      if (occupied[level])
+        break;
+    if (level < LEVELS_NUM) {
+      int shift = level * SLOT_BITS;
+      boundary = (current >> (shift + SLOT_BITS) << (shift + SLOT_BITS))
+        | (static_cast<guint64>(lowest_bit(occupied[level])) << shift);
+    }
+    else if (overflow) {
+      int shift = LEVELS_NUM * SLOT_BITS;
+      boundary = ((current >> shift) + 1) << shift;
+    }
+    else
+      break;
+
+    if (boundary > now)
+      break;
+
+    current = boundary;
+    // cascade from the top so the timers can fall through several levels
+    for (level = LEVELS_NUM; level >= 1; level--) {
+      guint64 mask = (G_GUINT64_CONSTANT(1) << (level * SLOT_BITS)) - 1;
+      if (!(current & mask))
+        cascade(level);
+    }
+  }
+
+  current = MAX(current, now);
+}
+
+gint64 TimerWheel::getNextExpiration() const
+{
+  if (expired)
+    return current;
+
+  if (occupied[0])
+    return (current & ~SLOT_MASK) | lowest_bit(occupied[0]);
+
+  /* Timers in higher levels are not sorted, find the earliest one in the
+   * nearest non-empty slot. */
+  const Timer *list = overflow;
+  for (int level = 1; level < LEVELS_NUM; level++)
+    if (occupied[level]) {
+      list = slots[level][lowest_bit(occupied[level])];
+      break;
+    }
+
+  gint64 next = -1;
+  for (; list; list = list->next)
+    if (next == -1 || static_cast<gint64>(list->expires) < next)
+      next = list->expires;
+  return next;
+}
+
+void TimerWheel::dispatch()
+{
+  stats.wakeups++;
+
+  // take the current batch of expired timers
+  pending = expired;
+  expired = expired_tail = NULL;
+  for (Timer *timer = pending; timer; timer = timer->next)
+    timer->level = LEVEL_PENDING;
+
+  while (pending) {
+    Timer *timer = pending;
+    unlink(timer);
+
+    stats.dispatched++;
+    gboolean res;
+    {
+      Watchdog::Scope scope(Watchdog::SOURCE_PURPLE_TIMER, NULL,
+          reinterpret_cast<const void*>(timer->function));
+      res = timer->function(timer->data);
+    }
+
+    if (timer->removed) {
+      // the timer was removed by its callback
+      delete timer;
+      continue;
+    }
+
+    if (!res) {
+      g_hash_table_remove(timers, GUINT_TO_POINTER(timer->handle));
+      stats.timers--;
+      delete timer;
+      continue;
+    }
+
+    schedule(timer, getTime());
+  }
+}
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __TIMERWHEEL_H__
+#define __TIMERWHEEL_H__
+
+#include <glib.h>
+
+/**
+ * Hierarchical timer wheel driving all libpurple timeouts from a single
+ * GSource.
+ *
+ * Instead of one GSource per timer (which GLib has to check on every main
+ * loop iteration) all timers are kept in a wheel of four levels with 64
+ * slots each and a millisecond resolution. Adding and removing a timer is
+ * O(1), the main loop is woken up only when the nearest timer expires.
+ * Timers added by addSeconds() are aligned to whole seconds so they expire
+ * together and cause only one wakeup.
+ */
+class TimerWheel
+{
+public:
+  struct Stats
+  {
+    // number of times the main loop was woken up to dispatch timers
+    guint64 wakeups;
+    // number of called timer callbacks
+    guint64 dispatched;
+    // number of currently registered timers
+    guint timers;
+  };
+
+  TimerWheel();
+  virtual ~TimerWheel();
+
+  /**
+   * Adds a timer that calls function every interval milliseconds until it
+   * returns FALSE. Returns a non-zero handle of the timer.
+   */
+  guint add(guint interval, GSourceFunc function, gpointer data);
+  /**
+   * Adds a timer with a granularity of one second, all such timers that
+   * expire in the same second are dispatched together.
+   */
+  guint addSeconds(guint interval, GSourceFunc function, gpointer data);
+  /**
+   * Removes a timer. Returns false if there is no timer with this handle.
+   */
+  bool remove(guint handle);
+
+  const Stats& getStats() const { return stats; }
+
+protected:
+  enum {
+    LEVELS_NUM = 4,
+    SLOT_BITS = 6,
+    SLOTS_NUM = 1 << SLOT_BITS
+  };
+
+  enum {
+    // the timer is in the overflow list
+    LEVEL_OVERFLOW = LEVELS_NUM,
+    // the timer is in the list of expired timers
+    LEVEL_EXPIRED,
+    // the timer is in the batch that is currently being dispatched
+    LEVEL_PENDING,
+    // the timer is not in any list (its callback is running)
+    LEVEL_NONE
+  };
+
+  struct Timer
+  {
+    guint handle;
+    // expiration time in milliseconds
+    guint64 expires;
+    guint interval;
+    bool seconds;
+    // the timer was removed during its own dispatch
+    bool removed;
+
+    GSourceFunc function;
+    gpointer data;
+
+    // position in the wheel
+    int level;
+    int slot;
+    Timer *prev;
+    Timer *next;
+  };
+
+  struct WheelSource
+  {
+    GSource source;
+    TimerWheel *wheel;
+  };
+
+  GSource *source;
+
+  // all timers, indexed by the handle
+  GHashTable *timers;
+  guint next_handle;
+
+  Timer *slots[LEVELS_NUM][SLOTS_NUM];
+  // bitmap of non-empty slots for each level
+  guint64 occupied[LEVELS_NUM];
+  // timers that expire beyond the range of the top level
+  Timer *overflow;
+  // timers ready to be dispatched
+  Timer *expired;
+  Timer *expired_tail;
+  /* Timers being dispatched. Timers that expire during the dispatch are
+   * added to the expired list and are dispatched in the next main loop
+   * iteration. */
+  Timer *pending;
+
+  // time up to which the wheel was advanced, in milliseconds
+  guint64 current;
+  // offset of the second boundaries used by addSeconds()
+  guint64 perturbation;
+
+  Stats stats;
+
+  static GSourceFuncs source_funcs;
+
+  static gboolean source_prepare(GSource *source, gint *timeout);
+  static gboolean source_check(GSource *source);
+  static gboolean source_dispatch(GSource *source, GSourceFunc callback,
+      gpointer user_data);
+
+  static guint64 getTime();
+
+  guint addTimer(guint interval, bool seconds, GSourceFunc function,
+      gpointer data);
+  void schedule(Timer *timer, guint64 now);
+  void insert(Timer *timer);
+  Timer **getListHead(Timer *timer);
+  void unlink(Timer *timer);
+  void appendExpired(Timer *timer);
+  void cascade(int level);
+  void advance(guint64 now);
+  // returns -1 if there is no timer
+  gint64 getNextExpiration() const;
+  void dispatch();
+
+private:
+  TimerWheel(const TimerWheel&);
+  TimerWheel& operator=(const TimerWheel&);
+};
+
+#endif // __TIMERWHEEL_H__
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
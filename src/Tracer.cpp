@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Tracer.h"
+
+#include "Log.h"
+
+#include <cppconsui/ConsUICurses.h>
+#include <cppconsui/CoreManager.h>
+
+#include <errno.h>
+#include <string.h>
+#include "gettext.h"
+
+#define TRACE_MAGIC "CIMTRACE"
+
+Tracer *Tracer::my_instance = NULL;
+
+Tracer *Tracer::instance()
+{
+  return my_instance;
+}
+
+void Tracer::recordCallback(Watchdog::Source source, const char *name,
+    const void *address, gint64 usecs)
+{
+  guint id = getNameId(name, address);
+
+  // the callback has just finished, the record is written at its end
+  writeHeader(RECORD_CALLBACK, Watchdog::getTime());
+  writeVarint(source);
+  writeVarint(id);
+  writeVarint(usecs);
+}
+
+void Tracer::recordBlistNode(UiOp op, PurpleBlistNode *node)
+{
+  guint id = 0;
+  int status = 0;
+  if (PURPLE_BLIST_NODE_IS_BUDDY(node)) {
+    PurpleBuddy *buddy = PURPLE_BUDDY(node);
+    id = getAnonId(user_ids, purple_buddy_get_account(buddy),
+        purple_buddy_get_name(buddy));
+    PurpleStatus *active = purple_presence_get_active_status(
+        purple_buddy_get_presence(buddy));
+    if (active)
+      status = purple_status_type_get_primitive(
+          purple_status_get_type(active));
+  }
+
+  writeHeader(RECORD_UI_OP, Watchdog::getTime());
+  writeVarint(op);
+  writeVarint(purple_blist_node_get_type(node));
+  writeVarint(id);
+  writeVarint(status);
+}
+
+void Tracer::recordWriteConv(PurpleConversation *conv, const char *name,
+    PurpleMessageFlags flags, const char *message)
+{
+  PurpleAccount *account = purple_conversation_get_account(conv);
+  PurpleConversationType type = purple_conversation_get_type(conv);
+  const char *conv_name = purple_conversation_get_name(conv);
+  guint id;
+  if (type == PURPLE_CONV_TYPE_CHAT)
+    id = getAnonId(room_ids, account, conv_name);
+  else
+    id = getAnonId(user_ids, account, conv_name);
+
+  writeHeader(RECORD_UI_OP, Watchdog::getTime());
+  writeVarint(UI_OP_WRITE_CONV);
+  writeVarint(type);
+  writeVarint(id);
+  writeVarint(getAnonId(user_ids, account, name && name[0] ? name : NULL));
+  writeVarint(flags);
+  writeVarint(getLength(message));
+}
+
+void Tracer::recordBuddyTyping(PurpleAccount *account, const char *who)
+{
+  PurpleTypingState state = PURPLE_NOT_TYPING;
+  PurpleConversation *conv = purple_find_conversation_with_account(
+      PURPLE_CONV_TYPE_IM, who, account);
+  if (conv)
+    state = purple_conv_im_get_typing_state(PURPLE_CONV_IM(conv));
+
+  writeHeader(RECORD_UI_OP, Watchdog::getTime());
+  writeVarint(UI_OP_BUDDY_TYPING);
+  writeVarint(getAnonId(user_ids, account, who));
+  writeVarint(state);
+}
+
+void Tracer::recordNotifyMessage(PurpleNotifyMsgType type, const char *title,
+    const char *primary, const char *secondary)
+{
+  writeHeader(RECORD_UI_OP, Watchdog::getTime());
+  writeVarint(UI_OP_NOTIFY_MESSAGE);
+  writeVarint(type);
+  writeVarint(getLength(title));
+  writeVarint(getLength(primary));
+  writeVarint(getLength(secondary));
+}
+
+void Tracer::recordNotifyUserInfo(PurpleConnection *gc, const char *who)
+{
+  writeHeader(RECORD_UI_OP, Watchdog::getTime());
+  writeVarint(UI_OP_NOTIFY_USERINFO);
+  writeVarint(getAnonId(user_ids, purple_connection_get_account(gc), who));
+}
+
+Tracer::Tracer(FILE *file_)
+: file(file_), last_time(Watchdog::getTime()), next_name_id(0)
+{
+  fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), file);
+  fputc(VERSION, file);
+
+  // start with the initial size of the screen
+  onScreenResized();
+
+  resize_conn = COREMANAGER->signal_resize.connect(sigc::mem_fun(this,
+        &Tracer::onScreenResized));
+  COREMANAGER->setInputHook(input_hook_);
+}
+
+Tracer::~Tracer()
+{
+  COREMANAGER->setInputHook(NULL);
+  resize_conn.disconnect();
+
+  bool failed = ferror(file);
+  if (fclose(file))
+    failed = true;
+  if (failed)
+    LOG->error(_("Error writing the trace file (%s)."), g_strerror(errno));
+}
+
+bool Tracer::init(const char *filename)
+{
+  g_assert(!my_instance);
+
+  FILE *file = fopen(filename, "wb");
+  if (!file) {
+    LOG->error(_("Error opening the trace file '%s' (%s)."), filename,
+        g_strerror(errno));
+    return false;
+  }
+
+  my_instance = new Tracer(file);
+  LOG->warning(_("Recording a trace into '%s'. The trace contains "
+        "everything typed until the program exits, including passwords."),
+      filename);
+  return true;
+}
+
+void Tracer::finalize()
+{
+  if (!my_instance)
+    return;
+
+  delete my_instance;
+  my_instance = NULL;
+}
+
+void Tracer::input_hook(const char *bytes, size_t len)
+{
+  writeHeader(RECORD_INPUT, Watchdog::getTime());
+  writeVarint(len);
+  writeBytes(bytes, len);
+}
+
+void Tracer::onScreenResized()
+{
+  writeHeader(RECORD_RESIZE, Watchdog::getTime());
+  writeVarint(CppConsUI::Curses::getmaxx());
+  writeVarint(CppConsUI::Curses::getmaxy());
+}
+
+void Tracer::writeHeader(RecordType type, gint64 time)
+{
+  fputc(type, file);
+  writeVarint(MAX(time - last_time, 0));
+  last_time = MAX(time, last_time);
+}
+
+void Tracer::writeVarint(guint64 value)
+{
+  // unsigned LEB128, 7 bits per byte, least significant group first
+  unsigned char buf[10];
+  size_t len = 0;
+  do {
+    buf[len] = value & 0x7f;
+    value >>= 7;
+    if (value)
+      buf[len] |= 0x80;
+    len++;
+  } while (value);
+  fwrite(buf, 1, len, file);
+}
+
+void Tracer::writeBytes(const char *bytes, size_t len)
+{
+  fwrite(bytes, 1, len, file);
+}
+
+guint Tracer::getNameId(const char *name, const void *address)
+{
+  /* Names are static strings and addresses are function pointers, so
+   * a pointer identifies the callback for the whole session. */
+  const void *key = name ? static_cast<const void*>(name) : address;
+  NameIds::iterator i = name_ids.find(key);
+  if (i != name_ids.end())
+    return i->second;
+
+  guint id = next_name_id++;
+  name_ids[key] = id;
+
+  char *desc = Watchdog::describeCallback(name, address);
+  size_t len = strlen(desc);
+  writeHeader(RECORD_NAME, Watchdog::getTime());
+  writeVarint(id);
+  writeVarint(len);
+  writeBytes(desc, len);
+  g_free(desc);
+
+  return id;
+}
+
+guint Tracer::getAnonId(AnonIds& ids, PurpleAccount *account,
+    const char *name)
+{
+  if (!name)
+    return 0;
+
+  /* Names of different accounts are kept apart, only the assigned numbers
+   * are written into the trace. */
+  std::string key = purple_account_get_protocol_id(account);
+  key += '\n';
+  key += purple_account_get_username(account);
+  key += '\n';
+  const char *normalized = purple_normalize(account, name);
+  key += normalized ? normalized : name;
+
+  AnonIds::iterator i = ids.find(key);
+  if (i != ids.end())
+    return i->second;
+
+  guint id = ids.size() + 1;
+  ids[key] = id;
+  return id;
+}
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __TRACER_H__
+#define __TRACER_H__
+
+#include "Watchdog.h"
+
+#include <glib.h>
+#include <map>
+#include <sigc++/sigc++.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#define TRACER (Tracer::instance())
+
+/**
+ * Records external events into a binary trace file.
+ *
+ * The trace contains terminal input, screen resizes, timings of all main
+ * loop callbacks that are measured by the Watchdog (libpurple ui-ops, timers
+ * and input watches) and arguments of the ui-ops that bring events from the
+ * network. It can be replayed by contrib/cimreplay.py to get reproducible
+ * performance reports without sharing accounts.
+ *
+ * Arguments of the ui-ops are anonymized. Buddy, chat and room names are
+ * replaced by numbers assigned in the order they are first seen and only
+ * lengths of texts are kept. The terminal input is recorded as it is, so it
+ * contains everything typed while tracing, including passwords.
+ *
+ * File format: the "CIMTRACE" magic followed by a version byte and a stream
+ * of records. Each record starts with a type byte and a time delta in
+ * microseconds from the previous record. All integers are unsigned LEB128
+ * varints.
+ *
+ * - RECORD_INPUT: length, raw bytes read from the terminal
+ * - RECORD_RESIZE: columns, lines
+ * - RECORD_NAME: id, length, name; defines a callback name used later
+ * - RECORD_CALLBACK: source, name id, duration in microseconds; the time is
+ *   the end of the callback
+ * - RECORD_UI_OP: ui-op type followed by its arguments; the time is the
+ *   start of the ui-op
+ *   - UI_OP_BLIST_NEW_NODE, UI_OP_BLIST_UPDATE, UI_OP_BLIST_REMOVE: node
+ *     type, user id (buddies only, 0 otherwise), status primitive (buddies
+ *     only, 0 otherwise)
+ *   - UI_OP_WRITE_CONV: conversation type, user id (IMs) or room id
+ *     (chats), user id of the sender (0 if there is none), message flags,
+ *     message length
+ *   - UI_OP_BUDDY_TYPING: user id, typing state
+ *   - UI_OP_NOTIFY_MESSAGE: message type, lengths of the title, the primary
+ *     and the secondary text
+ *   - UI_OP_NOTIFY_USERINFO: user id
+ */
+class Tracer
+{
+public:
+  enum RecordType {
+    RECORD_INPUT = 1,
+    RECORD_RESIZE = 2,
+    RECORD_NAME = 3,
+    RECORD_CALLBACK = 4,
+    RECORD_UI_OP = 5
+  };
+
+  enum UiOp {
+    UI_OP_BLIST_NEW_NODE = 1,
+    UI_OP_BLIST_UPDATE = 2,
+    UI_OP_BLIST_REMOVE = 3,
+    UI_OP_WRITE_CONV = 4,
+    UI_OP_BUDDY_TYPING = 5,
+    UI_OP_NOTIFY_MESSAGE = 6,
+    UI_OP_NOTIFY_USERINFO = 7
+  };
+
+  enum { VERSION = 2 };
+
+  static Tracer *instance();
+
+  /**
+   * Records one callback reported by the Watchdog.
+   */
+  void recordCallback(Watchdog::Source source, const char *name,
+      const void *address, gint64 usecs);
+
+  /**
+   * Record arguments of libpurple ui-ops, they are called before the ui-op
+   * is handled.
+   */
+  void recordBlistNode(UiOp op, PurpleBlistNode *node);
+  void recordWriteConv(PurpleConversation *conv, const char *name,
+      PurpleMessageFlags flags, const char *message);
+  void recordBuddyTyping(PurpleAccount *account, const char *who);
+  void recordNotifyMessage(PurpleNotifyMsgType type, const char *title,
+      const char *primary, const char *secondary);
+  void recordNotifyUserInfo(PurpleConnection *gc, const char *who);
+
+private:
+  typedef std::map<const void*, guint> NameIds;
+  typedef std::map<std::string, guint> AnonIds;
+
+  FILE *file;
+  // time of the last written record
+  gint64 last_time;
+  // ids of callback names indexed by a name pointer or a function address
+  NameIds name_ids;
+  guint next_name_id;
+  // anonymous ids of users and chat rooms indexed by their full names
+  AnonIds user_ids;
+  AnonIds room_ids;
+
+  sigc::connection resize_conn;
+
+  static Tracer *my_instance;
+
+  Tracer(FILE *file_);
+  Tracer(const Tracer&);
+  Tracer& operator=(const Tracer&);
+  ~Tracer();
+
+  /**
+   * Starts tracing into a given file. Returns false if the file can not be
+   * created.
+   */
+  static bool init(const char *filename);
+  static void finalize();
+  friend class CenterIM;
+
+  // called by CoreManager when input is read from the terminal
+  static void input_hook_(const char *bytes, size_t len)
+    { if (my_instance) my_instance->input_hook(bytes, len); }
+  void input_hook(const char *bytes, size_t len);
+
+  void onScreenResized();
+
+  void writeHeader(RecordType type, gint64 time);
+  void writeVarint(guint64 value);
+  void writeBytes(const char *bytes, size_t len);
+  guint getNameId(const char *name, const void *address);
+  /**
+   * Returns an anonymous id of a name of a given account, the first id is
+   * 1. Zero is returned for a NULL name.
+   */
+  guint getAnonId(AnonIds& ids, PurpleAccount *account, const char *name);
+  size_t getLength(const char *text) { return text ? strlen(text) : 0; }
+};
+
+#endif // __TRACER_H__
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
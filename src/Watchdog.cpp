@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Watchdog.h"
+
+#include "Log.h"
+#include "Tracer.h"
+
+#include <cppconsui/CoreManager.h>
+
+#include "config.h"
+#include <string.h> // memset
+#include "gettext.h"
+
+#ifdef HAVE_DLADDR
+#include <dlfcn.h>
+#endif
+
+Watchdog *Watchdog::my_instance = NULL;
+int Watchdog::Scope::depth = 0;
+
+Watchdog *Watchdog::instance()
+{
+  return my_instance;
+}
+
+void Watchdog::report(Source source, const char *name, const void *address,
+    PurpleAccount *account, gint64 usecs)
+{
+  g_assert(source >= 0 && source < SOURCES_NUM);
+
+  if (usecs < 0)
+    usecs = 0;
+
+  if (TRACER)
+    TRACER->recordCallback(source, name, address, usecs);
+
+  Histogram &h = histograms[source];
+  h.count++;
+  h.total += usecs;
+  if (usecs > h.max)
+    h.max = usecs;
+
+  int bucket = 0;
+  if (usecs >= G_GINT64_CONSTANT(1) << (BUCKETS_NUM - 1))
+    bucket = BUCKETS_NUM - 1;
+  else if (usecs > 0)
+    bucket = g_bit_storage(static_cast<gulong>(usecs)) - 1;
+  h.buckets[bucket]++;
+
+  if (!threshold || usecs < threshold)
+    return;
+
+  // the callback was too slow, report it
+  char *desc = describeCallback(name, address);
+  if (account)
+    LOG->warning(_("centerim/watchdog: %s callback %s (account %s/%s) "
+          "took %d ms."), getSourceName(source), desc,
+        purple_account_get_protocol_name(account),
+        purple_account_get_username(account),
+        static_cast<int>(usecs / 1000));
+  else
+    LOG->warning(_("centerim/watchdog: %s callback %s took %d ms."),
+        getSourceName(source), desc, static_cast<int>(usecs / 1000));
+  g_free(desc);
+}
+
+void Watchdog::reset()
+{
+  memset(histograms, 0, sizeof(histograms));
+}
+
+gint64 Watchdog::getTime()
+{
+  return CppConsUI::CoreManager::getMonotonicTime();
+}
+
+const char *Watchdog::getSourceName(Source source)
+{
+  switch (source) {
+    case SOURCE_CPPCONSUI:
+      return "cppconsui";
+    case SOURCE_PURPLE_TIMER:
+      return "purple-timer";
+    case SOURCE_PURPLE_INPUT:
+      return "purple-input";
+    case SOURCE_UI_OP:
+      return "ui-op";
+    case SOURCES_NUM:
+      break;
+  }
+  return "unknown";
+}
+
+PurpleAccount *Watchdog::getNodeAccount(PurpleBlistNode *node)
+{
+  if (PURPLE_BLIST_NODE_IS_BUDDY(node))
+    return purple_buddy_get_account(PURPLE_BUDDY(node));
+  if (PURPLE_BLIST_NODE_IS_CHAT(node))
+    return purple_chat_get_account(PURPLE_CHAT(node));
+  return NULL;
+}
+
+Watchdog::Watchdog()
+: threshold(0)
+{
+  reset();
+
+  // init prefs
+  purple_prefs_add_none(CONF_PREFIX "/watchdog");
+  purple_prefs_add_int(CONF_PREFIX "/watchdog/threshold", 100);
+
+  updateCachedPreference(CONF_PREFIX "/watchdog/threshold");
+
+  // connect callbacks
+  purple_prefs_connect_callback(this, CONF_PREFIX "/watchdog",
+      watchdog_pref_change_, this);
+
+  COREMANAGER->setDispatchHook(dispatch_hook_);
+}
+
+Watchdog::~Watchdog()
+{
+  COREMANAGER->setDispatchHook(NULL);
+  purple_prefs_disconnect_by_handle(this);
+}
+
+void Watchdog::init()
+{
+  g_assert(!my_instance);
+
+  my_instance = new Watchdog;
+}
+
+void Watchdog::finalize()
+{
+  g_assert(my_instance);
+
+  delete my_instance;
+  my_instance = NULL;
+}
+
+void Watchdog::watchdog_pref_change(const char *name,
+    PurplePrefType /*type*/, gconstpointer /*val*/)
+{
+  // watchdog/* preference changed
+  updateCachedPreference(name);
+}
+
+void Watchdog::updateCachedPreference(const char *name)
+{
+  if (!strcmp(name, CONF_PREFIX "/watchdog/threshold"))
+    threshold = static_cast<gint64>(MAX(0, purple_prefs_get_int(name)))
+      * 1000;
+}
+
+char *Watchdog::describeCallback(const char *name, const void *address)
+{
+  if (name)
+    return g_strdup(name);
+  if (!address)
+    return g_strdup(_("unknown"));
+
+#ifdef HAVE_DLADDR
+  // try to find the name of the function and its library
+  Dl_info info;
+  if (dladdr(address, &info) && info.dli_fname) {
+    char *base = g_path_get_basename(info.dli_fname);
+    char *res;
+    if (info.dli_sname)
+      res = g_strdup_printf("%s (%s)", info.dli_sname, base);
+    else
+      res = g_strdup_printf("%p (%s)", address, base);
+    g_free(base);
+    return res;
+  }
+#endif
+
+  return g_strdup_printf("%p", address);
+}
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __WATCHDOG_H__
+#define __WATCHDOG_H__
+
+#include <glib.h>
+#include <libpurple/purple.h>
+
+#define WATCHDOG (Watchdog::instance())
+
+/**
+ * Measures how long main loop callbacks take.
+ *
+ * Durations of all dispatched callbacks are collected in a histogram for
+ * each source type. Callbacks that take longer than the "/watchdog/threshold"
+ * pref are reported in the log together with their identity.
+ */
+class Watchdog
+{
+public:
+  enum Source {
+    // CppConsUI timeouts and terminal input
+    SOURCE_CPPCONSUI,
+    // libpurple timeouts
+    SOURCE_PURPLE_TIMER,
+    // libpurple input watches
+    SOURCE_PURPLE_INPUT,
+    // libpurple ui-ops
+    SOURCE_UI_OP,
+    SOURCES_NUM
+  };
+
+  /**
+   * Bucket i counts durations in range <2^i, 2^(i+1)) microseconds, the last
+   * bucket counts everything longer.
+   */
+  enum { BUCKETS_NUM = 25 };
+
+  struct Histogram
+  {
+    guint64 count;
+    // sum of all durations in microseconds
+    guint64 total;
+    gint64 max;
+    guint64 buckets[BUCKETS_NUM];
+  };
+
+  /**
+   * Measures the time of the enclosing block and reports it when the block
+   * is left. Nothing is measured when the watchdog is not initialized. Only
+   * the outermost scope is measured when scopes are nested (for example
+   * a ui-op called from a libpurple input watch), so the time isn't counted
+   * and reported twice.
+   */
+  class Scope
+  {
+  public:
+    Scope(Source source_, const char *name_, const void *address_ = NULL,
+        PurpleAccount *account_ = NULL)
+      : source(source_), name(name_), address(address_), account(account_)
+      , start(my_instance && !depth ? getTime() : -1) { depth++; }
+    ~Scope()
+      { depth--; if (start != -1 && my_instance) my_instance->report(source,
+          name, address, account, getTime() - start); }
+
+  protected:
+    Source source;
+    const char *name;
+    const void *address;
+    PurpleAccount *account;
+    gint64 start;
+
+  private:
+    // number of scopes that are currently entered
+    static int depth;
+
+    Scope(const Scope&);
+    Scope& operator=(const Scope&);
+  };
+
+  static Watchdog *instance();
+
+  /**
+   * Adds a duration of one callback. The callback is identified by a name
+   * (a static string) or by an address of its function.
+   */
+  void report(Source source, const char *name, const void *address,
+      PurpleAccount *account, gint64 usecs);
+
+  const Histogram& getHistogram(Source source) const
+    { return histograms[source]; }
+  void reset();
+
+  // returns a monotonic time in microseconds
+  static gint64 getTime();
+  static const char *getSourceName(Source source);
+  static PurpleAccount *getNodeAccount(PurpleBlistNode *node);
+  // returns a newly allocated description of a callback
+  static char *describeCallback(const char *name, const void *address);
+
+protected:
+
+private:
+  Histogram histograms[SOURCES_NUM];
+  // cached value of the "/watchdog/threshold" pref in microseconds
+  gint64 threshold;
+
+  static Watchdog *my_instance;
+
+  Watchdog();
+  Watchdog(const Watchdog&);
+  Watchdog& operator=(const Watchdog&);
+  ~Watchdog();
+
+  static void init();
+  static void finalize();
+  friend class CenterIM;
+
+  // called by CoreManager after each of its callbacks
+  static void dispatch_hook_(const char *name, gint64 usecs)
+    { if (my_instance) my_instance->report(SOURCE_CPPCONSUI, name, NULL,
+        NULL, usecs); }
+
+  static void watchdog_pref_change_(const char *name, PurplePrefType type,
+      gconstpointer val, gpointer data)
+    { reinterpret_cast<Watchdog*>(data)->watchdog_pref_change(name, type,
+        val); }
+  void watchdog_pref_change(const char *name, PurplePrefType type,
+      gconstpointer val);
+
+  void updateCachedPreference(const char *name);
+};
+
+#endif // __WATCHDOG_H__
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "WatchdogWindow.h"
+
+#include "CenterIM.h"
+#include "Log.h"
+#include "Watchdog.h"
+
+#include <cppconsui/CoreManager.h>
+#include <cppconsui/HorizontalListBox.h>
+#include <cppconsui/Spacer.h>
+#include <libpurple/purple.h>
+#include <map>
+#include <string>
+#include <string.h> // memset
+#include "gettext.h"
+
+// maximum width of a histogram bar
+#define BAR_WIDTH 30
+
+WatchdogWindow::WatchdogWindow()
+: SplitDialog(0, 0, 80, 24, _("Main loop latency"))
+{
+  setColorScheme("generalwindow");
+
+  CppConsUI::HorizontalListBox *lbox = new CppConsUI::HorizontalListBox(
+      AUTOSIZE, AUTOSIZE);
+  lbox->appendWidget(*(new CppConsUI::Spacer(1, AUTOSIZE)));
+  textview = new CppConsUI::TextView(AUTOSIZE, AUTOSIZE, false, true);
+  lbox->appendWidget(*textview);
+  lbox->appendWidget(*(new CppConsUI::Spacer(1, AUTOSIZE)));
+  setContainer(*lbox);
+
+  buttons->appendItem(_("Refresh"), sigc::mem_fun(this,
+        &WatchdogWindow::onRefresh));
+  buttons->appendSeparator();
+  buttons->appendItem(_("Reset"), sigc::mem_fun(this,
+        &WatchdogWindow::onReset));
+  buttons->appendSeparator();
+  buttons->appendItem(_("Save"), sigc::mem_fun(this,
+        &WatchdogWindow::onSave));
+  buttons->appendSeparator();
+  buttons->appendItem(_("Done"), sigc::hide(sigc::mem_fun(this,
+          &WatchdogWindow::close)));
+
+  update();
+}
+
+void WatchdogWindow::onScreenResized()
+{
+  moveResizeRect(CENTERIM->getScreenArea(CenterIM::CHAT_AREA));
+}
+
+void WatchdogWindow::update()
+{
+  textview->clear();
+
+  GString *report = g_string_new(NULL);
+  writeReport(report);
+  textview->append(report->str);
+  g_string_free(report, TRUE);
+}
+
+void WatchdogWindow::writeReport(GString *report) const
+{
+  writeInputLatencyReport(report);
+  writeWatchdogReport(report);
+}
+
+void WatchdogWindow::writeWatchdogReport(GString *report) const
+{
+  if (!WATCHDOG)
+    return;
+
+  g_string_append_printf(report, "%s\n\n", _("Main loop callbacks"));
+
+  char from[32], to[32], avg[32], max[32];
+  for (int i = 0; i < Watchdog::SOURCES_NUM; i++) {
+    Watchdog::Source source = static_cast<Watchdog::Source>(i);
+    const Watchdog::Histogram& h = WATCHDOG->getHistogram(source);
+
+    if (!h.count) {
+      g_string_append_printf(report, _("%s: no callbacks"),
+          Watchdog::getSourceName(source));
+      g_string_append(report, "\n\n");
+      continue;
+    }
+
+    formatDuration(avg, sizeof(avg), h.total / h.count);
+    formatDuration(max, sizeof(max), h.max);
+    g_string_append_printf(report,
+        _("%s: %" G_GUINT64_FORMAT " callbacks, average %s, maximum %s"),
+        Watchdog::getSourceName(source), h.count, avg, max);
+    g_string_append_c(report, '\n');
+
+    guint64 biggest = 0;
+    for (int j = 0; j < Watchdog::BUCKETS_NUM; j++)
+      biggest = MAX(biggest, h.buckets[j]);
+
+    for (int j = 0; j < Watchdog::BUCKETS_NUM; j++) {
+      if (!h.buckets[j])
+        continue;
+
+      formatDuration(from, sizeof(from), j ? G_GINT64_CONSTANT(1) << j : 0);
+      if (j < Watchdog::BUCKETS_NUM - 1)
+        formatDuration(to, sizeof(to), G_GINT64_CONSTANT(1) << (j + 1));
+      else
+        g_strlcpy(to, "...", sizeof(to));
+
+      char bar[BAR_WIDTH + 1];
+      int width = MAX(1, h.buckets[j] * BAR_WIDTH / biggest);
+      memset(bar, '#', width);
+      bar[width] = '\0';
+
+      g_string_append_printf(report, "  %9s - %-9s %10" G_GUINT64_FORMAT
+          " %s\n", from, to, h.buckets[j], bar);
+    }
+    g_string_append_c(report, '\n');
+  }
+}
+
+void WatchdogWindow::writeInputLatencyReport(GString *report) const
+{
+  g_string_append_printf(report, "%s\n\n", _("Key to screen latency"));
+
+  const CppConsUI::CoreManager::LatencyHistograms& latencies
+    = COREMANAGER->getInputLatencies();
+  if (latencies.empty())
+    g_string_append_printf(report, "%s\n", _("No keys processed."));
+
+  // sort the contexts by name, the map is sorted by pointers
+  std::map<std::string, const CppConsUI::LatencyHistogram*> sorted;
+  for (CppConsUI::CoreManager::LatencyHistograms::const_iterator i
+      = latencies.begin(); i != latencies.end(); i++)
+    sorted[i->first] = &i->second;
+  for (std::map<std::string, const CppConsUI::LatencyHistogram*>::iterator i
+      = sorted.begin(); i != sorted.end(); i++)
+    writeLatency(report, i->first.c_str(), *i->second);
+
+  writeLatency(report, _("background"), COREMANAGER->getBackgroundLatency());
+  g_string_append_c(report, '\n');
+}
+
+void WatchdogWindow::writeLatency(GString *report, const char *name,
+    const CppConsUI::LatencyHistogram& h)
+{
+  if (!h.getCount()) {
+    g_string_append_printf(report, _("%s: no screen updates"), name);
+    g_string_append_c(report, '\n');
+    return;
+  }
+
+  char p50[32], p95[32], p99[32], max[32];
+  formatDuration(p50, sizeof(p50), h.getPercentile(50));
+  formatDuration(p95, sizeof(p95), h.getPercentile(95));
+  formatDuration(p99, sizeof(p99), h.getPercentile(99));
+  formatDuration(max, sizeof(max), h.getMax());
+  g_string_append_printf(report,
+      _("%s: %" G_GUINT64_FORMAT " updates, p50 %s, p95 %s, p99 %s, "
+        "maximum %s"), name, h.getCount(), p50, p95, p99, max);
+  g_string_append_c(report, '\n');
+}
+
+void WatchdogWindow::onRefresh(CppConsUI::Button& /*activator*/)
+{
+  update();
+}
+
+void WatchdogWindow::onReset(CppConsUI::Button& /*activator*/)
+{
+  if (WATCHDOG)
+    WATCHDOG->reset();
+  COREMANAGER->resetLatencies();
+  update();
+}
+
+void WatchdogWindow::onSave(CppConsUI::Button& /*activator*/)
+{
+  GString *report = g_string_new(NULL);
+  writeReport(report);
+
+  char *filename = g_build_filename(purple_user_dir(), "latency.log", NULL);
+  GError *err = NULL;
+  if (g_file_set_contents(filename, report->str, report->len, &err))
+    LOG->message(_("Latency report saved to %s."), filename);
+  else {
+    LOG->error(_("Saving of the latency report to %s failed (%s)."),
+        filename, err->message);
+    g_clear_error(&err);
+  }
+
+  g_free(filename);
+  g_string_free(report, TRUE);
+}
+
+void WatchdogWindow::formatDuration(char *buf, size_t size, gint64 usecs)
+{
+  if (usecs < 1000)
+    g_snprintf(buf, size, _("%d us"), static_cast<int>(usecs));
+  else if (usecs < G_USEC_PER_SEC)
+    g_snprintf(buf, size, _("%.1f ms"), usecs / 1000.0);
+  else
+    g_snprintf(buf, size, _("%.1f s"), usecs
+        / static_cast<double>(G_USEC_PER_SEC));
+}
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2010-2013 by CenterIM developers
+ *
+ * This file is part of CenterIM.
+ *
+ * CenterIM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CenterIM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __WATCHDOGWINDOW_H__
+#define __WATCHDOGWINDOW_H__
+
+#include <cppconsui/LatencyHistogram.h>
+#include <cppconsui/SplitDialog.h>
+#include <cppconsui/TextView.h>
+
+/**
+ * Shows histograms of main loop callback durations collected by Watchdog and
+ * key to screen latencies measured by CoreManager.
+ */
+class WatchdogWindow
+: public CppConsUI::SplitDialog
+{
+public:
+  WatchdogWindow();
+  virtual ~WatchdogWindow() {}
+
+  // FreeWindow
+  virtual void onScreenResized();
+
+protected:
+  CppConsUI::TextView *textview;
+
+  void update();
+  void onRefresh(CppConsUI::Button& activator);
+  void onReset(CppConsUI::Button& activator);
+  void onSave(CppConsUI::Button& activator);
+
+  // appends the whole report to the string
+  void writeReport(GString *report) const;
+  void writeWatchdogReport(GString *report) const;
+  void writeInputLatencyReport(GString *report) const;
+  static void writeLatency(GString *report, const char *name,
+      const CppConsUI::LatencyHistogram& h);
+
+  // writes a human readable duration into buf
+  static void formatDuration(char *buf, size_t size, gint64 usecs);
+
+private:
+  WatchdogWindow(const WatchdogWindow&);
+  WatchdogWindow& operator=(const WatchdogWindow&);
+};
+
+#endif // __WATCHDOGWINDOW_H__
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
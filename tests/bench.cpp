@@ -0,0 +1,673 @@
+#include <cppconsui/Button.h>
+#include <cppconsui/CoreManager.h>
+#include <cppconsui/HorizontalListBox.h>
+#include <cppconsui/KeyConfig.h>
+#include <cppconsui/LatencyHistogram.h>
+#include <cppconsui/ListBox.h>
+#include <cppconsui/ListView.h>
+#include <cppconsui/TextEdit.h>
+#include <cppconsui/TextView.h>
+#include <cppconsui/TreeView.h>
+#include <cppconsui/Window.h>
+
+#include <locale.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/* Scripted rendering benchmark. All scenarios run on the headless Curses
+ * backend, so no terminal is needed and the results are repeatable. Each
+ * scenario prints one JSON object per line to the standard output:
+ *
+ * scenario     name of the scenario
+ * steps        number of measured steps, each step is a change followed by
+ *              a complete screen update
+ * total_us     time of all steps
+ * avg_us, p50_us, p95_us, p99_us, max_us
+ *              time per step (frame)
+ * new_allocs, new_bytes
+ *              number and size of allocations made by C++ operator new in
+ *              all steps; memory that is allocated by g_malloc() or malloc()
+ *              directly (GLib, ncurses, libtermkey, C strings) isn't counted
+ *              because GLib 2.46 and later don't allow to intercept it
+ * newpad_calls, newwin_calls, subpad_calls, doupdate_calls,
+ * cells_emitted, bytes_emitted
+ *              sum of Curses::Stats counters of all steps
+ */
+
+#if __cplusplus >= 201103L
+#define THROW_BAD_ALLOC
+#define NOTHROW noexcept
+#else
+#define THROW_BAD_ALLOC throw(std::bad_alloc)
+#define NOTHROW throw()
+#endif
+
+#define SEED 42
+
+// only allocations by operator new are counted
+static unsigned long alloc_count = 0;
+static unsigned long alloc_bytes = 0;
+
+void *operator new(size_t size) THROW_BAD_ALLOC
+{
+  alloc_count++;
+  alloc_bytes += size;
+  void *res = malloc(size ? size : 1);
+  if (!res)
+    throw std::bad_alloc();
+  return res;
+}
+
+void *operator new[](size_t size) THROW_BAD_ALLOC
+{
+  return operator new(size);
+}
+
+void operator delete(void *ptr) NOTHROW
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr) NOTHROW
+{
+  free(ptr);
+}
+
+#if __cplusplus >= 201402L
+void operator delete(void *ptr, size_t /*size*/) NOTHROW
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr, size_t /*size*/) NOTHROW
+{
+  free(ptr);
+}
+#endif
+
+static const char *lorem = "Lorem ipsum dolor sit amet, consectetur "
+  "adipiscing elit. Duis dui dui, interdum eget tempor auctor, viverra "
+  "suscipit velit. Phasellus vel magna odio. Duis rutrum tortor at nisi "
+  "auctor tincidunt. Mauris libero neque, faucibus sit amet semper in, "
+  "dictum ut tortor. Duis lacinia justo non lorem blandit ultrices.";
+
+// divisor of the scenario sizes, set by --quick
+static int scale = 1;
+static GRand *rnd = NULL;
+
+// ignore every message
+static void g_log_func_(const gchar * /*log_domain*/,
+    GLogLevelFlags /*log_level*/, const gchar * /*message*/,
+    gpointer /*user_data*/)
+{
+}
+
+/* Dispatches all pending events. This processes resizes and draws the
+ * screen if a redraw was requested. */
+static void run_frame()
+{
+  while (g_main_context_iteration(NULL, FALSE))
+    ;
+}
+
+static void resize_screen(int w, int h)
+{
+  CppConsUI::Curses::resizeterm(h, w);
+  COREMANAGER->onScreenResized();
+}
+
+static void push_keys(const char *keys)
+{
+  COREMANAGER->pushInput(keys, strlen(keys));
+}
+
+// Measurement class
+class Measurement
+{
+public:
+  explicit Measurement(const char *name_);
+  virtual ~Measurement() {}
+
+  // starts one step
+  void start();
+  // updates the screen and finishes the step
+  void finish();
+
+  void print() const;
+
+protected:
+  const char *name;
+  CppConsUI::LatencyHistogram steps;
+  gint64 total;
+  gint64 step_start;
+  unsigned long allocs;
+  unsigned long bytes;
+  unsigned long step_allocs;
+  unsigned long step_bytes;
+  CppConsUI::Curses::Stats stats;
+
+private:
+  Measurement(const Measurement&);
+  Measurement& operator=(const Measurement&);
+};
+
+Measurement::Measurement(const char *name_)
+: name(name_), total(0), step_start(0), allocs(0), bytes(0), step_allocs(0)
+, step_bytes(0)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+void Measurement::start()
+{
+  // don't count anything that happened before the step
+  run_frame();
+  CppConsUI::Curses::reset_stats();
+
+  step_allocs = alloc_count;
+  step_bytes = alloc_bytes;
+  step_start = CppConsUI::CoreManager::getMonotonicTime();
+}
+
+void Measurement::finish()
+{
+  run_frame();
+
+  gint64 usecs = CppConsUI::CoreManager::getMonotonicTime() - step_start;
+  steps.add(usecs);
+  total += usecs;
+
+  allocs += alloc_count - step_allocs;
+  bytes += alloc_bytes - step_bytes;
+
+  const CppConsUI::Curses::Stats *s = CppConsUI::Curses::get_stats();
+  stats.newpad_calls += s->newpad_calls;
+  stats.newwin_calls += s->newwin_calls;
+  stats.subpad_calls += s->subpad_calls;
+  stats.doupdate_calls += s->doupdate_calls;
+  stats.cells_emitted += s->cells_emitted;
+  stats.bytes_emitted += s->bytes_emitted;
+}
+
+void Measurement::print() const
+{
+  printf("{\"scenario\": \"%s\", \"steps\": %" G_GUINT64_FORMAT ", "
+      "\"total_us\": %" G_GINT64_FORMAT ", "
+      "\"avg_us\": %" G_GINT64_FORMAT ", \"p50_us\": %" G_GINT64_FORMAT ", "
+      "\"p95_us\": %" G_GINT64_FORMAT ", \"p99_us\": %" G_GINT64_FORMAT ", "
+      "\"max_us\": %" G_GINT64_FORMAT ", "
+      "\"new_allocs\": %lu, \"new_bytes\": %lu, "
+      "\"newpad_calls\": %u, \"newwin_calls\": %u, \"subpad_calls\": %u, "
+      "\"doupdate_calls\": %u, \"cells_emitted\": %u, "
+      "\"bytes_emitted\": %u}\n",
+      name, steps.getCount(), total, steps.getAverage(),
+      steps.getPercentile(50), steps.getPercentile(95),
+      steps.getPercentile(99), steps.getMax(), allocs, bytes,
+      stats.newpad_calls, stats.newwin_calls, stats.subpad_calls,
+      stats.doupdate_calls, stats.cells_emitted, stats.bytes_emitted);
+  fflush(stdout);
+}
+
+/* A tree of 100 groups with 99 items each, random groups are collapsed and
+ * expanded. */
+static void bench_treeview()
+{
+  resize_screen(80, 24);
+
+  CppConsUI::Window *win = new CppConsUI::Window(0, 0, AUTOSIZE, AUTOSIZE);
+  CppConsUI::TreeView *tree = new CppConsUI::TreeView(AUTOSIZE, AUTOSIZE);
+  win->addWidget(*tree, 0, 0);
+
+  std::vector<CppConsUI::TreeView::NodeReference> groups;
+  int groups_num = 100 / scale;
+  for (int i = 0; i < groups_num; i++) {
+    char *text = g_strdup_printf("Group %d", i);
+    CppConsUI::TreeView::NodeReference group = tree->appendNode(
+        tree->getRootNode(), *(new CppConsUI::Button(text)));
+    g_free(text);
+    groups.push_back(group);
+
+    for (int j = 0; j < 99; j++) {
+      text = g_strdup_printf("Item %d-%d", i, j);
+      tree->appendNode(group, *(new CppConsUI::Button(text)));
+      g_free(text);
+    }
+  }
+  win->show();
+
+  Measurement m("treeview");
+  for (int i = 0; i < 1000 / scale; i++) {
+    m.start();
+    tree->toggleCollapsed(groups[g_rand_int_range(rnd, 0, groups_num)]);
+    m.finish();
+  }
+  m.print();
+
+  win->close();
+}
+
+// row of the treeview-rows scenario, only the focused row gets a Button
+class BenchRow
+: public CppConsUI::TreeView::Row
+{
+public:
+  BenchRow(const char *text_) { text = g_strdup(text_); }
+  virtual ~BenchRow() { g_free(text); }
+
+  virtual bool isRowVisible() const { return true; }
+  virtual void drawRow(CppConsUI::Curses::Window& area, int x, int y, int w)
+    { area.mvaddstring(x, y, w, text); }
+  virtual CppConsUI::Widget *createRowWidget()
+    { return new CppConsUI::Button(text); }
+
+protected:
+  char *text;
+
+private:
+  BenchRow(const BenchRow&);
+  BenchRow& operator=(const BenchRow&);
+};
+
+/* The tree of the treeview scenario made of rows instead of Buttons. Groups
+ * are toggled the same way, then the focus is moved through the tree. */
+static void bench_treeview_rows()
+{
+  resize_screen(80, 24);
+
+  CppConsUI::Window *win = new CppConsUI::Window(0, 0, AUTOSIZE, AUTOSIZE);
+  CppConsUI::TreeView *tree = new CppConsUI::TreeView(AUTOSIZE, AUTOSIZE);
+  win->addWidget(*tree, 0, 0);
+
+  std::vector<CppConsUI::TreeView::NodeReference> groups;
+  int groups_num = 100 / scale;
+  for (int i = 0; i < groups_num; i++) {
+    char *text = g_strdup_printf("Group %d", i);
+    CppConsUI::TreeView::NodeReference group = tree->appendNode(
+        tree->getRootNode(), *(new BenchRow(text)));
+    g_free(text);
+    groups.push_back(group);
+
+    for (int j = 0; j < 99; j++) {
+      text = g_strdup_printf("Item %d-%d", i, j);
+      tree->appendNode(group, *(new BenchRow(text)));
+      g_free(text);
+    }
+  }
+  win->show();
+
+  Measurement m("treeview-rows");
+  for (int i = 0; i < 1000 / scale; i++) {
+    m.start();
+    tree->toggleCollapsed(groups[g_rand_int_range(rnd, 0, groups_num)]);
+    m.finish();
+  }
+  m.print();
+
+  Measurement f("treeview-rows-focus");
+  for (int i = 0; i < 1000 / scale; i++) {
+    f.start();
+    push_keys("\033[B");
+    f.finish();
+  }
+  f.print();
+
+  win->close();
+}
+
+/* A TextView that receives a lot of lines, then the lines are wrapped again
+ * at several screen widths. */
+static void bench_textview()
+{
+  resize_screen(80, 24);
+
+  CppConsUI::Window *win = new CppConsUI::Window(0, 0, AUTOSIZE, AUTOSIZE);
+  CppConsUI::TextView *textview = new CppConsUI::TextView(AUTOSIZE,
+      AUTOSIZE, true);
+  win->addWidget(*textview, 0, 0);
+  win->show();
+
+  int lorem_len = strlen(lorem);
+  int batches = 100;
+  int batch_lines = 10000 / scale;
+
+  Measurement append("textview-append");
+  for (int i = 0; i < batches; i++) {
+    append.start();
+    for (int j = 0; j < batch_lines; j++) {
+      // lines of different lengths, some of them are wrapped
+      int len = 10 + (i * batch_lines + j) * 37 % (lorem_len - 10);
+      std::string line(lorem, len);
+      textview->append(line.c_str(), j % 8);
+    }
+    append.finish();
+  }
+  append.print();
+
+  const int widths[] = {40, 80, 132, 200, 80};
+  Measurement rewrap("textview-rewrap");
+  for (size_t i = 0; i < G_N_ELEMENTS(widths); i++) {
+    rewrap.start();
+    resize_screen(widths[i], 50);
+    rewrap.finish();
+  }
+  rewrap.print();
+
+  win->close();
+}
+
+// A TextEdit with 100 KB of text, the cursor is moved around and text typed.
+static void bench_textedit()
+{
+  resize_screen(80, 24);
+
+  std::string text;
+  int lorem_len = strlen(lorem);
+  for (int i = 0; text.size() < 100 * 1024 / static_cast<size_t>(scale);
+      i++) {
+    text.append(lorem, 10 + i * 37 % (lorem_len - 10));
+    text.append("\n");
+  }
+
+  CppConsUI::Window *win = new CppConsUI::Window(0, 0, AUTOSIZE, AUTOSIZE);
+  CppConsUI::TextEdit *edit = new CppConsUI::TextEdit(AUTOSIZE, AUTOSIZE,
+      text.c_str());
+  win->addWidget(*edit, 0, 0);
+  win->show();
+  edit->grabFocus();
+
+  // Down, Up, Right, Left, Ctrl-Right, End, Home and a typed character
+  const char *keys[] = {"\033[B", "\033[A", "\033[C", "\033[D", "\033[1;5C",
+    "\033[F", "\033[H", "x"};
+  Measurement m("textedit");
+  for (int i = 0; i < 2000 / scale; i++) {
+    const char *key;
+    // mostly move down so the cursor travels through the whole text
+    if (g_rand_int_range(rnd, 0, 2))
+      key = keys[0];
+    else
+      key = keys[g_rand_int_range(rnd, 0, G_N_ELEMENTS(keys))];
+
+    m.start();
+    push_keys(key);
+    m.finish();
+  }
+  m.print();
+
+  win->close();
+}
+
+// Windows with scrollable content while the screen size changes rapidly.
+static void bench_resize()
+{
+  resize_screen(80, 24);
+
+  CppConsUI::Window *win = new CppConsUI::Window(0, 0, AUTOSIZE, AUTOSIZE);
+  CppConsUI::ListBox *listbox = new CppConsUI::ListBox(AUTOSIZE, AUTOSIZE);
+  win->addWidget(*listbox, 0, 0);
+  for (int i = 0; i < 200; i++) {
+    char *text = g_strdup_printf("Item %d", i);
+    listbox->appendWidget(*(new CppConsUI::Button(text)));
+    g_free(text);
+  }
+  win->show();
+
+  CppConsUI::Window *win2 = new CppConsUI::Window(10, 5, 40, 12);
+  CppConsUI::TextView *textview = new CppConsUI::TextView(AUTOSIZE,
+      AUTOSIZE);
+  win2->addWidget(*textview, 0, 0);
+  for (int i = 0; i < 50; i++)
+    textview->append(lorem);
+  win2->show();
+
+  Measurement m("resize");
+  for (int i = 0; i < 1000 / scale; i++) {
+    m.start();
+    resize_screen(g_rand_int_range(rnd, 20, 201),
+        g_rand_int_range(rnd, 5, 81));
+    m.finish();
+  }
+  m.print();
+
+  win2->close();
+  win->close();
+}
+
+/* A ListBox and a HorizontalListBox whose items change their size and
+ * visibility. */
+static void bench_listbox()
+{
+  resize_screen(120, 40);
+
+  CppConsUI::Window *win = new CppConsUI::Window(0, 0, AUTOSIZE, AUTOSIZE);
+  CppConsUI::HorizontalListBox *hlistbox
+    = new CppConsUI::HorizontalListBox(AUTOSIZE, 1);
+  win->addWidget(*hlistbox, 0, 0);
+  CppConsUI::ListBox *listbox = new CppConsUI::ListBox(60, AUTOSIZE);
+  win->addWidget(*listbox, 0, 1);
+
+  std::vector<CppConsUI::Button*> items;
+  std::vector<CppConsUI::Button*> hitems;
+  for (int i = 0; i < 1000 / scale; i++) {
+    char *text = g_strdup_printf("Item %d", i);
+    CppConsUI::Button *button = new CppConsUI::Button(text);
+    listbox->appendWidget(*button);
+    items.push_back(button);
+    if (i < 100) {
+      button = new CppConsUI::Button(text);
+      hlistbox->appendWidget(*button);
+      hitems.push_back(button);
+    }
+    g_free(text);
+  }
+  win->show();
+
+  int lorem_len = strlen(lorem);
+  Measurement m("listbox");
+  for (int i = 0; i < 2000 / scale; i++) {
+    std::vector<CppConsUI::Button*>& v = i % 2 ? items : hitems;
+    CppConsUI::Button *button = v[g_rand_int_range(rnd, 0, v.size())];
+
+    m.start();
+    if (g_rand_int_range(rnd, 0, 2))
+      button->setVisibility(!button->isVisible());
+    else {
+      std::string text(lorem, g_rand_int_range(rnd, 1, lorem_len / 4));
+      button->setText(text.c_str());
+    }
+    m.finish();
+  }
+  m.print();
+
+  win->close();
+}
+
+// model of the listview scenario, texts are formatted when rows are drawn
+class BenchModel
+: public CppConsUI::ListView::Model
+{
+public:
+  BenchModel(int rows_num);
+  virtual ~BenchModel() {}
+
+  virtual int getRowsNumber() const { return ids.size(); }
+  virtual const char *getRowText(int row) const;
+
+  void insertRow(int row);
+  void removeRow(int row);
+  void changeRow(int row);
+
+protected:
+  std::vector<int> ids;
+  int next_id;
+  mutable char buf[32];
+
+private:
+  BenchModel(const BenchModel&);
+  BenchModel& operator=(const BenchModel&);
+};
+
+BenchModel::BenchModel(int rows_num)
+: next_id(0)
+{
+  for (int i = 0; i < rows_num; i++)
+    ids.push_back(next_id++);
+}
+
+const char *BenchModel::getRowText(int row) const
+{
+  g_snprintf(buf, sizeof(buf), "Item %d", ids[row]);
+  return buf;
+}
+
+void BenchModel::insertRow(int row)
+{
+  ids.insert(ids.begin() + row, next_id++);
+  signal_rows_inserted(*this, row, 1);
+}
+
+void BenchModel::removeRow(int row)
+{
+  ids.erase(ids.begin() + row);
+  signal_rows_removed(*this, row, 1);
+}
+
+void BenchModel::changeRow(int row)
+{
+  ids[row] = next_id++;
+  signal_rows_changed(*this, row, 1);
+}
+
+/* A ListView that shows a big model. The cursor is moved by keys and rows
+ * are inserted, removed and changed around it. */
+static void bench_listview()
+{
+  resize_screen(80, 24);
+
+  BenchModel *model = new BenchModel(100000 / scale);
+  CppConsUI::Window *win = new CppConsUI::Window(0, 0, AUTOSIZE, AUTOSIZE);
+  CppConsUI::ListView *listview = new CppConsUI::ListView(AUTOSIZE,
+      AUTOSIZE);
+  listview->setModel(model);
+  win->addWidget(*listview, 0, 0);
+  win->show();
+
+  static const char *keys[] = {
+    "\033[A", // Up
+    "\033[B", // Down
+    "\033[5~", // PageUp
+    "\033[6~", // PageDown
+  };
+
+  Measurement m("listview");
+  for (int i = 0; i < 2000 / scale; i++) {
+    int cursor = listview->getCursor();
+
+    m.start();
+    switch (g_rand_int_range(rnd, 0, 8)) {
+      case 0:
+        model->insertRow(cursor);
+        break;
+      case 1:
+        model->removeRow(cursor);
+        break;
+      case 2:
+        model->changeRow(cursor);
+        break;
+      case 3:
+        // jump to a random row
+        listview->setCursor(g_rand_int_range(rnd, 0,
+              model->getRowsNumber()));
+        break;
+      default:
+        push_keys(keys[g_rand_int_range(rnd, 0, G_N_ELEMENTS(keys))]);
+        break;
+    }
+    m.finish();
+  }
+  m.print();
+
+  win->close();
+  delete model;
+}
+
+struct Scenario
+{
+  const char *name;
+  void (*run)();
+};
+
+static const Scenario scenarios[] = {
+  {"treeview", bench_treeview},
+  {"treeview-rows", bench_treeview_rows},
+  {"textview", bench_textview},
+  {"textedit", bench_textedit},
+  {"resize", bench_resize},
+  {"listbox", bench_listbox},
+  {"listview", bench_listview}
+};
+
+// main function
+int main(int argc, char **argv)
+{
+  setlocale(LC_ALL, "");
+
+  std::vector<const Scenario*> selected;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--quick")) {
+      scale = 10;
+      continue;
+    }
+
+    size_t j;
+    for (j = 0; j < G_N_ELEMENTS(scenarios); j++)
+      if (!strcmp(argv[i], scenarios[j].name)) {
+        selected.push_back(&scenarios[j]);
+        break;
+      }
+    if (j == G_N_ELEMENTS(scenarios)) {
+      fprintf(stderr, "Usage: %s [--quick] [scenario...]\nScenarios:",
+          argv[0]);
+      for (j = 0; j < G_N_ELEMENTS(scenarios); j++)
+        fprintf(stderr, " %s", scenarios[j].name);
+      fprintf(stderr, "\n");
+      return 1;
+    }
+  }
+  if (selected.empty())
+    for (size_t j = 0; j < G_N_ELEMENTS(scenarios); j++)
+      selected.push_back(&scenarios[j]);
+
+  // initialize CppConsUI without a terminal
+  CppConsUI::Curses::set_backend(CppConsUI::Curses::BACKEND_HEADLESS);
+  int consui_res = CppConsUI::initializeConsUI();
+  if (consui_res) {
+    fprintf(stderr, "CppConsUI initialization failed.\n");
+    return consui_res;
+  }
+
+  KEYCONFIG->loadDefaultKeyConfig();
+  g_log_set_default_handler(g_log_func_, NULL);
+
+  rnd = g_rand_new_with_seed(SEED);
+  for (std::vector<const Scenario*>::iterator i = selected.begin();
+      i != selected.end(); i++) {
+    (*i)->run();
+    run_frame();
+  }
+  g_rand_free(rnd);
+
+  // finalize CppConsUI
+  consui_res = CppConsUI::finalizeConsUI();
+  if (consui_res) {
+    fprintf(stderr, "CppConsUI deinitialization failed.\n");
+    return consui_res;
+  }
+
+  return 0;
+}
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */
@@ -0,0 +1,251 @@
+#include <cppconsui/CoreManager.h>
+#include <cppconsui/Label.h>
+#include <cppconsui/KeyConfig.h>
+#include <cppconsui/ListView.h>
+#include <cppconsui/Window.h>
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// TestModel class
+class TestModel
+: public CppConsUI::ListView::Model
+{
+public:
+  TestModel(int rows_num);
+  virtual ~TestModel() {}
+
+  // ListView::Model
+  virtual int getRowsNumber() const { return rows.size(); }
+  virtual const char *getRowText(int row) const
+    { return rows[row].c_str(); }
+
+  void insertRow(int row);
+  void removeRow(int row);
+  void changeRow(int row);
+
+protected:
+  std::vector<std::string> rows;
+  int counter;
+
+  std::string makeText();
+
+private:
+  TestModel(const TestModel&);
+  TestModel& operator=(const TestModel&);
+};
+
+TestModel::TestModel(int rows_num)
+: counter(0)
+{
+  for (int i = 0; i < rows_num; i++)
+    rows.push_back(makeText());
+}
+
+void TestModel::insertRow(int row)
+{
+  if (row < 0)
+    row = 0;
+  rows.insert(rows.begin() + row, makeText());
+  signal_rows_inserted(*this, row, 1);
+}
+
+void TestModel::removeRow(int row)
+{
+  if (row < 0)
+    return;
+  rows.erase(rows.begin() + row);
+  signal_rows_removed(*this, row, 1);
+}
+
+void TestModel::changeRow(int row)
+{
+  if (row < 0)
+    return;
+  rows[row] += " (changed)";
+  signal_rows_changed(*this, row, 1);
+}
+
+std::string TestModel::makeText()
+{
+  char text[64];
+  g_snprintf(text, sizeof(text), "Row %d", counter++);
+  return text;
+}
+
+// TestWindow class
+class TestWindow
+: public CppConsUI::Window
+{
+public:
+  TestWindow();
+  virtual ~TestWindow();
+
+protected:
+  TestModel *model;
+  CppConsUI::ListView *listview;
+  CppConsUI::Label *status;
+
+  void onCursorChanged(CppConsUI::ListView& activator, int row);
+  void onActivate(CppConsUI::ListView& activator, int row);
+
+private:
+  TestWindow(const TestWindow&);
+  TestWindow& operator=(const TestWindow&);
+
+  void actionInsertRow();
+  void actionRemoveRow();
+  void actionChangeRow();
+
+  void declareBindables();
+};
+
+TestWindow::TestWindow()
+: Window(0, 0, AUTOSIZE, AUTOSIZE)
+{
+  addWidget(*(new CppConsUI::Label(AUTOSIZE, 1,
+          "Press F10 to quit, i/d/c to insert/delete/change a row.")), 1, 1);
+
+  status = new CppConsUI::Label(AUTOSIZE, 1, "");
+  addWidget(*status, 1, 2);
+
+  model = new TestModel(10000);
+
+  listview = new CppConsUI::ListView(30, 12);
+  listview->signal_cursor_changed.connect(sigc::mem_fun(this,
+        &TestWindow::onCursorChanged));
+  listview->signal_activate.connect(sigc::mem_fun(this,
+        &TestWindow::onActivate));
+  listview->setModel(model);
+  addWidget(*listview, 1, 4);
+  setInputChild(*listview);
+
+  declareBindables();
+}
+
+TestWindow::~TestWindow()
+{
+  listview->setModel(NULL);
+  delete model;
+}
+
+void TestWindow::onCursorChanged(CppConsUI::ListView& /*activator*/,
+    int row)
+{
+  char *text = g_strdup_printf("Cursor: %d/%d", row,
+      model->getRowsNumber());
+  status->setText(text);
+  g_free(text);
+}
+
+void TestWindow::onActivate(CppConsUI::ListView& /*activator*/, int row)
+{
+  char *text = g_strdup_printf("Activated: %s", model->getRowText(row));
+  status->setText(text);
+  g_free(text);
+}
+
+void TestWindow::actionInsertRow()
+{
+  model->insertRow(listview->getCursor());
+}
+
+void TestWindow::actionRemoveRow()
+{
+  model->removeRow(listview->getCursor());
+}
+
+void TestWindow::actionChangeRow()
+{
+  model->changeRow(listview->getCursor());
+}
+
+void TestWindow::declareBindables()
+{
+  declareBindable("testwindow", "insert-row",
+      sigc::mem_fun(this, &TestWindow::actionInsertRow),
+      InputProcessor::BINDABLE_NORMAL);
+  declareBindable("testwindow", "remove-row",
+      sigc::mem_fun(this, &TestWindow::actionRemoveRow),
+      InputProcessor::BINDABLE_NORMAL);
+  declareBindable("testwindow", "change-row",
+      sigc::mem_fun(this, &TestWindow::actionChangeRow),
+      InputProcessor::BINDABLE_NORMAL);
+}
+
+// TestApp class
+class TestApp
+: public CppConsUI::InputProcessor
+{
+public:
+  TestApp();
+  virtual ~TestApp() {}
+
+  void run();
+
+  // ignore every message
+  static void g_log_func_(const gchar * /*log_domain*/,
+      GLogLevelFlags /*log_level*/, const gchar * /*message*/,
+      gpointer /*user_data*/)
+    {}
+
+protected:
+
+private:
+  TestApp(const TestApp&);
+  TestApp& operator=(const TestApp&);
+};
+
+TestApp::TestApp()
+{
+  KEYCONFIG->loadDefaultKeyConfig();
+  KEYCONFIG->bindKey("testapp", "quit", "F10");
+  KEYCONFIG->bindKey("testwindow", "insert-row", "i");
+  KEYCONFIG->bindKey("testwindow", "remove-row", "d");
+  KEYCONFIG->bindKey("testwindow", "change-row", "c");
+
+  g_log_set_default_handler(g_log_func_, this);
+
+  declareBindable("testapp", "quit", sigc::mem_fun(COREMANAGER,
+        &CppConsUI::CoreManager::quitMainLoop),
+      InputProcessor::BINDABLE_OVERRIDE);
+}
+
+void TestApp::run()
+{
+  TestWindow *win = new TestWindow;
+  win->show();
+
+  COREMANAGER->setTopInputProcessor(*this);
+  COREMANAGER->enableResizing();
+  COREMANAGER->startMainLoop();
+}
+
+// main function
+int main()
+{
+  setlocale(LC_ALL, "");
+
+  // initialize CppConsUI
+  int consui_res = CppConsUI::initializeConsUI();
+  if (consui_res) {
+    fprintf(stderr, "CppConsUI initialization failed.\n");
+    return consui_res;
+  }
+
+  TestApp *app = new TestApp;
+  app->run();
+  delete app;
+
+  // finalize CppConsUI
+  consui_res = CppConsUI::finalizeConsUI();
+  if (consui_res) {
+    fprintf(stderr, "CppConsUI deinitialization failed.\n");
+    return consui_res;
+  }
+
+  return 0;
+}
+
+/* vim: set tabstop=2 shiftwidth=2 textwidth=78 expandtab : */